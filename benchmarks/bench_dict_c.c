@@ -0,0 +1,394 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Microbenchmark and regression check of libdict_c.
+ *
+ * Builds realistic MADCAT events (TCP SYN with options, UDP flow with 4 KB payload,
+ * ICMP unreach with inner packet) with dict_update, looks up every element with dict_get,
+ * serializes them with dict_dumpstr and releases them with dict_free.
+ * array_add is measured by filling arrays of different length.
+ * For every operation ns/op and heap allocations/op are printed.
+ * Allocations are counted by wrapping malloc, calloc, realloc and aligned_alloc of glibc.
+ *
+ * Before measuring, the output of every event is checked against dict_dumpbuf
+ * and every element is checked to be found by dict_get, thus the benchmark fails on functional regressions.
+ *
+ * Usage: bench_dict_c [iterations]
+ * Built by cmake -DCMAKE_BENCH=ON, which defaults to CMAKE_BUILD_TYPE Release, i.e. -O3 -DNDEBUG.
+ *
+ * BSI 2018-2023
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libdict_c.h"
+
+#define DEFAULT_ITERATIONS 20000
+#define BATCH 64 //Events build at once, so lookups, dumps and frees are measured on distinct dicts
+#define MAX_PATH 4
+#define PAYLOAD_LEN 4096
+
+//Counting wrappers around the allocator of glibc
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static unsigned long int allocs = 0;
+static volatile size_t bench_sink; //Results of the measured loops, so the compiler can not optimize them away
+
+void* malloc(size_t size) { allocs++; return __libc_malloc(size); }
+void* calloc(size_t nmemb, size_t size) { allocs++; return __libc_calloc(nmemb, size); }
+void* realloc(void* ptr, size_t size) { allocs++; return __libc_realloc(ptr, size); }
+void* aligned_alloc(size_t alignment, size_t size) { allocs++; return __libc_memalign(alignment, size); }
+void free(void* ptr) { __libc_free(ptr); }
+
+//One dict_update(...) of an event template
+struct bench_element {
+    __uint8_t type;
+    union json_type value;
+    unsigned int path_len;
+    char* path[MAX_PATH];
+};
+
+struct bench_template {
+    const char* name;
+    struct bench_element* elements;
+    int count;
+};
+
+#define STR(s) { .string = s }
+#define INT(i) { .integer = i }
+#define HEX(n, f) { .hex = { .number = n, .format = f } }
+#define BOOL(b) { .boolean = b }
+#define FLOAT(f) { .floating = f }
+
+//TCP SYN header event with options, as put out by the sniffer of tcp_ip_port_mon
+static struct bench_element tcp_syn[] = {
+    { JSON_STR, STR("MADCAT"), 1, { "origin" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 1, { "timestamp" } },
+    { JSON_INT, INT(20), 2, { "IP", "hdr_len" } },
+    { JSON_INT, INT(4), 2, { "IP", "version" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_02), 2, { "IP", "tos" } },
+    { JSON_INT, INT(60), 2, { "IP", "tot_len" } },
+    { JSON_HEX, HEX(0xbeef, HEX_FORMAT_04), 2, { "IP", "id" } },
+    { JSON_HEX, HEX(0x4000, HEX_FORMAT_04), 2, { "IP", "flags" } },
+    { JSON_INT, INT(52), 2, { "IP", "ttl" } },
+    { JSON_INT, INT(6), 2, { "IP", "protocol" } },
+    { JSON_HEX, HEX(0x1c46, HEX_FORMAT_04), 2, { "IP", "checksum" } },
+    { JSON_STR, STR("192.0.2.17"), 2, { "IP", "src_addr" } },
+    { JSON_STR, STR("198.51.100.1"), 2, { "IP", "dest_addr" } },
+    { JSON_INT, INT(54321), 2, { "TCP", "src_port" } },
+    { JSON_INT, INT(23), 2, { "TCP", "dest_port" } },
+    { JSON_INT, INT(3221225472), 2, { "TCP", "seq" } },
+    { JSON_INT, INT(0), 2, { "TCP", "ack_seq" } },
+    { JSON_INT, INT(40), 2, { "TCP", "hdr_len" } },
+    { JSON_INT, INT(0), 2, { "TCP", "res1" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "ecn" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "cwr" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "urg" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "ack" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "psh" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "rst" } },
+    { JSON_BOOL, BOOL(true), 2, { "TCP", "syn" } },
+    { JSON_BOOL, BOOL(false), 2, { "TCP", "fin" } },
+    { JSON_HEX, HEX(0x02, HEX_FORMAT_02), 2, { "TCP", "tcp_flags" } },
+    { JSON_INT, INT(64240), 2, { "TCP", "window" } },
+    { JSON_HEX, HEX(0x9f3a, HEX_FORMAT_04), 2, { "TCP", "checksum" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_04), 2, { "TCP", "urg_ptr" } },
+    { JSON_STR, STR("05b4"), 3, { "TCP", "tcp_options", "mss" } },
+    { JSON_STR, STR(""), 3, { "TCP", "tcp_options", "sack_perm" } },
+    { JSON_STR, STR("a1b2c3d400000000"), 3, { "TCP", "tcp_options", "timestamp" } },
+    { JSON_STR, STR(""), 3, { "TCP", "tcp_options", "nop" } },
+    { JSON_STR, STR("07"), 3, { "TCP", "tcp_options", "window" } },
+    { JSON_INT, INT(0), 1, { "data_bytes" } },
+    { JSON_FLOAT, FLOAT(1704106800.123456), 1, { "unixtime" } },
+};
+
+//UDP flow event with 4 KB payload, as put out by udp_ip_port_mon. Payload strings are filled in by init_payload()
+static struct bench_element udp_flow[] = {
+    { JSON_STR, STR("MADCAT"), 1, { "origin" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 1, { "timestamp" } },
+    { JSON_STR, STR("192.0.2.17"), 1, { "src_ip" } },
+    { JSON_STR, STR("198.51.100.1"), 1, { "dest_ip" } },
+    { JSON_INT, INT(40123), 1, { "src_port" } },
+    { JSON_INT, INT(1900), 1, { "dest_port" } },
+    { JSON_STR, STR("UDP"), 1, { "proto" } },
+    { JSON_STR, STR("flow"), 1, { "event_type" } },
+    { JSON_FLOAT, FLOAT(1704106800.123456), 1, { "unixtime" } },
+    { JSON_INT, INT(20), 2, { "IP", "hdr_len" } },
+    { JSON_INT, INT(4), 2, { "IP", "version" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_02), 2, { "IP", "tos" } },
+    { JSON_INT, INT(20 + 8 + PAYLOAD_LEN), 2, { "IP", "tot_len" } },
+    { JSON_HEX, HEX(0x1234, HEX_FORMAT_04), 2, { "IP", "id" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_04), 2, { "IP", "flags" } },
+    { JSON_INT, INT(117), 2, { "IP", "ttl" } },
+    { JSON_INT, INT(17), 2, { "IP", "protocol" } },
+    { JSON_HEX, HEX(0x7e21, HEX_FORMAT_04), 2, { "IP", "checksum" } },
+    { JSON_STR, STR("192.0.2.17"), 2, { "IP", "src_addr" } },
+    { JSON_STR, STR("198.51.100.1"), 2, { "IP", "dest_addr" } },
+    { JSON_INT, INT(40123), 2, { "UDP", "src_port" } },
+    { JSON_INT, INT(1900), 2, { "UDP", "dest_port" } },
+    { JSON_INT, INT(8 + PAYLOAD_LEN), 2, { "UDP", "len" } },
+    { JSON_INT, INT(0x4a1f), 2, { "UDP", "checksum" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 2, { "FLOW", "start" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 2, { "FLOW", "end" } },
+    { JSON_STR, STR("closed"), 2, { "FLOW", "state" } },
+    { JSON_STR, STR("timeout"), 2, { "FLOW", "reason" } },
+    { JSON_INT, INT(PAYLOAD_LEN), 2, { "FLOW", "bytes_toserver" } },
+    { JSON_STR, STR(NULL), 2, { "FLOW", "payload_hd" } },
+    { JSON_STR, STR(NULL), 2, { "FLOW", "payload_str" } },
+    { JSON_STR, STR("9c1185a5c5e9fc54612808977ee8f548b2258d31"), 2, { "FLOW", "payload_sha1" } },
+};
+#define UDP_PAYLOAD_HD 29
+#define UDP_PAYLOAD_STR 30
+
+//ICMP port unreach event with inner IP/UDP packet, as put out by icmp_mon
+static struct bench_element icmp_unreach[] = {
+    { JSON_STR, STR("MADCAT"), 1, { "origin" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 1, { "timestamp" } },
+    { JSON_FLOAT, FLOAT(1704106800.123456), 1, { "unixtime" } },
+    { JSON_STR, STR("192.0.2.17"), 1, { "src_ip" } },
+    { JSON_STR, STR("198.51.100.1"), 1, { "dest_ip" } },
+    { JSON_INT, INT(3), 1, { "icmp_type" } },
+    { JSON_INT, INT(3), 1, { "icmp_code" } },
+    { JSON_STR, STR("ICMP"), 1, { "proto" } },
+    { JSON_STR, STR("flow"), 1, { "event_type" } },
+    { JSON_INT, INT(20), 2, { "IP", "hdr_len" } },
+    { JSON_INT, INT(4), 2, { "IP", "version" } },
+    { JSON_HEX, HEX(0xc0, HEX_FORMAT_02), 2, { "IP", "tos" } },
+    { JSON_INT, INT(56), 2, { "IP", "tot_len" } },
+    { JSON_HEX, HEX(0x5d3e, HEX_FORMAT_04), 2, { "IP", "id" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_04), 2, { "IP", "flags" } },
+    { JSON_INT, INT(244), 2, { "IP", "ttl" } },
+    { JSON_INT, INT(1), 2, { "IP", "protocol" } },
+    { JSON_HEX, HEX(0x2e80, HEX_FORMAT_04), 2, { "IP", "checksum" } },
+    { JSON_STR, STR("192.0.2.17"), 2, { "IP", "src_addr" } },
+    { JSON_STR, STR("198.51.100.1"), 2, { "IP", "dest_addr" } },
+    { JSON_INT, INT(3), 2, { "ICMP", "type" } },
+    { JSON_INT, INT(3), 2, { "ICMP", "code" } },
+    { JSON_HEX, HEX(0x8bd2, HEX_FORMAT_04), 2, { "ICMP", "checksum" } },
+    { JSON_STR, STR("unreach"), 2, { "ICMP", "type_str" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_08), 2, { "ICMP", "unused" } },
+    { JSON_STR, STR("port_unreach"), 2, { "ICMP", "code_str" } },
+    { JSON_INT, INT(20), 3, { "ICMP", "IP", "hdr_len" } },
+    { JSON_INT, INT(4), 3, { "ICMP", "IP", "version" } },
+    { JSON_HEX, HEX(0, HEX_FORMAT_02), 3, { "ICMP", "IP", "tos" } },
+    { JSON_INT, INT(28), 3, { "ICMP", "IP", "tot_len" } },
+    { JSON_HEX, HEX(0xa11c, HEX_FORMAT_04), 3, { "ICMP", "IP", "id" } },
+    { JSON_HEX, HEX(0x4000, HEX_FORMAT_04), 3, { "ICMP", "IP", "flags" } },
+    { JSON_INT, INT(64), 3, { "ICMP", "IP", "ttl" } },
+    { JSON_INT, INT(17), 3, { "ICMP", "IP", "protocol" } },
+    { JSON_HEX, HEX(0x98d4, HEX_FORMAT_04), 3, { "ICMP", "IP", "checksum" } },
+    { JSON_STR, STR("198.51.100.1"), 3, { "ICMP", "IP", "src_addr" } },
+    { JSON_STR, STR("192.0.2.17"), 3, { "ICMP", "IP", "dest_addr" } },
+    { JSON_INT, INT(53), 3, { "ICMP", "UDP", "src_port" } },
+    { JSON_INT, INT(33434), 3, { "ICMP", "UDP", "dest_port" } },
+    { JSON_INT, INT(8), 3, { "ICMP", "UDP", "len" } },
+    { JSON_INT, INT(0), 3, { "ICMP", "UDP", "checksum" } },
+    { JSON_BOOL, BOOL(false), 2, { "ICMP", "tainted" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 2, { "FLOW", "start" } },
+    { JSON_STR, STR("2024-01-01T12:00:00.123456+0100"), 2, { "FLOW", "end" } },
+    { JSON_FLOAT, FLOAT(0.0), 2, { "FLOW", "duration" } },
+    { JSON_INT, INT(8), 2, { "FLOW", "bytes_toserver" } },
+    { JSON_STR, STR("0000000000000000"), 2, { "FLOW", "payload_hd" } },
+    { JSON_STR, STR("0000000000000000"), 2, { "FLOW", "payload_str" } },
+    { JSON_STR, STR("05fe405753166f125559e7c9ac558654f107c7e9"), 2, { "FLOW", "payload_sha1" } },
+};
+
+#define TEMPLATE(name, elements) { name, elements, sizeof(elements) / sizeof(struct bench_element) }
+static struct bench_template templates[] = {
+    TEMPLATE("TCP SYN", tcp_syn),
+    TEMPLATE("UDP 4KB", udp_flow),
+    TEMPLATE("ICMP unreach", icmp_unreach),
+};
+
+//Fills the payload strings of the UDP template in the format of hex_dump(...) and print_hex_string(...)
+static void init_payload()
+{
+    static char payload_hd[(PAYLOAD_LEN / 16) * 80 + 1]; //80 chars per line and the terminating 0
+    static char payload_str[PAYLOAD_LEN * 2 + 1];
+    char* hd = payload_hd;
+
+    for(int i = 0; i < PAYLOAD_LEN; i++)
+        sprintf(payload_str + 2 * i, "%02x", (i * 7) & 0xff);
+    for(int line = 0; line < PAYLOAD_LEN / 16; line++) {
+        hd += sprintf(hd, "%08x  ", line * 16);
+        for(int i = 0; i < 16; i++)
+            hd += sprintf(hd, i == 7 ? "%02x  " : "%02x ", ((line * 16 + i) * 7) & 0xff);
+        hd += sprintf(hd, " |................|\\n");
+    }
+    udp_flow[UDP_PAYLOAD_HD].value.string = payload_hd;
+    udp_flow[UDP_PAYLOAD_STR].value.string = payload_str;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static struct dict* build(struct dict* dict, const struct bench_template* template)
+{
+    for(int i = 0; i < template->count; i++) {
+        const struct bench_element* element = &template->elements[i];
+        dict_update(dict, element->type, element->value, element->path_len,
+                    element->path[0], element->path[1], element->path[2], element->path[3]);
+    }
+    return dict;
+}
+
+static struct dict* lookup(struct dict* dict, const struct bench_element* element)
+{
+    return dict_get(dict, element->path_len, element->path[0], element->path[1], element->path[2], element->path[3]);
+}
+
+//Checks the template for functional regressions. Returns 0 on success.
+static int check(const struct bench_template* template)
+{
+    struct dict* dict = build(dict_new(), template);
+    struct dict_buffer output = {0};
+    char* str = dict_dumpstr(dict);
+    int ret = 0;
+
+    for(int i = 0; i < template->count; i++) {
+        struct dict* found = lookup(dict, &template->elements[i]);
+        if(found == NULL || found->type != template->elements[i].type) {
+            fprintf(stderr, "ERROR: %s: element %d (%s) not found by dict_get\n", template->name, i, template->elements[i].path[template->elements[i].path_len - 1]);
+            ret = 1;
+        }
+    }
+    dict_dumpbuf(&output, dict);
+    if(strcmp(str, output.data) != 0 || str[0] != '{' || str[strlen(str) - 1] != '}') {
+        fprintf(stderr, "ERROR: %s: dict_dumpstr and dict_dumpbuf differ:\n%s\n%s\n", template->name, str, output.data);
+        ret = 1;
+    }
+    free(str);
+    dict_buffer_free(&output);
+    dict_free(dict);
+    return ret;
+}
+
+static void report(const char* name, const char* op, double ns, unsigned long int allocs, long int ops)
+{
+    fprintf(stdout, "%-14s %-12s %12.1f ns/op %8.2f allocs/op\n", name, op, ns / ops, (double) allocs / ops);
+}
+
+static void bench_template(const struct bench_template* template, long int iterations)
+{
+    struct dict* dicts[BATCH];
+    double ns[4] = {0};
+    unsigned long int counted[4] = {0};
+    unsigned long int start_allocs;
+    double start;
+    size_t total = 0; //stored to bench_sink
+
+    for(long int done = 0; done < iterations; done += BATCH) {
+        start_allocs = allocs; start = now_ns();
+        for(int b = 0; b < BATCH; b++)
+            dicts[b] = build(dict_new(), template);
+        ns[0] += now_ns() - start; counted[0] += allocs - start_allocs;
+
+        start_allocs = allocs; start = now_ns();
+        for(int b = 0; b < BATCH; b++)
+            for(int i = 0; i < template->count; i++)
+                total += (size_t) lookup(dicts[b], &template->elements[i]);
+        ns[1] += now_ns() - start; counted[1] += allocs - start_allocs;
+
+        start_allocs = allocs; start = now_ns();
+        for(int b = 0; b < BATCH; b++) {
+            char* str = dict_dumpstr(dicts[b]);
+            total += str[0];
+            free(str);
+        }
+        ns[2] += now_ns() - start; counted[2] += allocs - start_allocs;
+
+        start_allocs = allocs; start = now_ns();
+        for(int b = 0; b < BATCH; b++)
+            dict_free(dicts[b]);
+        ns[3] += now_ns() - start; counted[3] += allocs - start_allocs;
+    }
+
+    iterations = ((iterations + BATCH - 1) / BATCH) * BATCH;
+    report(template->name, "dict_update", ns[0], counted[0], iterations * template->count);
+    report(template->name, "dict_get", ns[1], counted[1], iterations * template->count);
+    report(template->name, "dict_dumpstr", ns[2], counted[2], iterations);
+    report(template->name, "dict_free", ns[3], counted[3], iterations);
+    bench_sink = total;
+}
+
+//Fills arrays of len elements alternating between integers and strings
+static void bench_array_add(long int len, long int iterations)
+{
+    union json_type json_value;
+    unsigned long int start_allocs = allocs;
+    double start = now_ns();
+    char name[32];
+
+    for(long int it = 0; it < iterations; it++) {
+        struct array* array = array_new();
+        for(long int i = 0; i < len; i++) {
+            if(i & 1) {
+                json_value.string = "192.0.2.17";
+                array_add(array, JSON_STR, json_value);
+            } else {
+                json_value.integer = i;
+                array_add(array, JSON_INT, json_value);
+            }
+        }
+        array_free(array);
+    }
+    snprintf(name, sizeof(name), "array[%ld]", len);
+    report(name, "array_add", now_ns() - start, allocs - start_allocs, iterations * len);
+}
+
+int main(int argc, char *argv[])
+{
+    long int iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    int ret = 0;
+
+    if(iterations < 1) iterations = 1;
+    init_payload();
+    for(int t = 0; t < sizeof(templates) / sizeof(struct bench_template); t++)
+        ret |= check(&templates[t]);
+    if(ret != 0) return ret;
+
+    for(int t = 0; t < sizeof(templates) / sizeof(struct bench_template); t++)
+        bench_template(&templates[t], iterations);
+    bench_array_add(16, iterations);
+    bench_array_add(1024, iterations / 64 + 1);
+    return 0;
+}
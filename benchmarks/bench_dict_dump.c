@@ -0,0 +1,203 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Microbenchmark of JSON serialization in libdict_c.
+ *
+ * Serializes a typical TCP SYN header event, as put out by the sniffer of tcp_ip_port_mon,
+ * by the former open_memstream/fprintf path (dict_dump to a memory stream),
+ * by dict_dumpstr and by dict_dumpbuf with a reused buffer and prints ns/op for each.
+ *
+ * Usage: bench_dict_dump [iterations]
+ *
+ * BSI 2018-2023
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libdict_c.h"
+
+#define DEFAULT_ITERATIONS 200000
+
+//Builds a TCP SYN header event with the same layout as the sniffer in tcp_ip_port_mon
+static struct dict* tcp_syn_event()
+{
+    struct dict* dict = dict_new();
+    union json_type json_value;
+
+    json_value.string = "MADCAT";
+    dict_update(dict, JSON_STR, json_value, 1, "origin");
+    json_value.string = "2024-01-01T12:00:00.123456+0100";
+    dict_update(dict, JSON_STR, json_value, 1, "timestamp");
+
+    json_value.integer = 20;
+    dict_update(dict, JSON_INT, json_value, 2, "IP", "hdr_len");
+    json_value.integer = 4;
+    dict_update(dict, JSON_INT, json_value, 2, "IP", "version");
+    json_value.hex.number = 0; json_value.hex.format = HEX_FORMAT_02;
+    dict_update(dict, JSON_HEX, json_value, 2, "IP", "tos");
+    json_value.integer = 60;
+    dict_update(dict, JSON_INT, json_value, 2, "IP", "tot_len");
+    json_value.hex.number = 0xbeef; json_value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, json_value, 2, "IP", "id");
+    json_value.hex.number = 0x4000; json_value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, json_value, 2, "IP", "flags");
+    json_value.integer = 52;
+    dict_update(dict, JSON_INT, json_value, 2, "IP", "ttl");
+    json_value.integer = 6;
+    dict_update(dict, JSON_INT, json_value, 2, "IP", "protocol");
+    json_value.hex.number = 0x1c46; json_value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, json_value, 2, "IP", "checksum");
+    json_value.string = "192.0.2.17";
+    dict_update(dict, JSON_STR, json_value, 2, "IP", "src_addr");
+    json_value.string = "198.51.100.1";
+    dict_update(dict, JSON_STR, json_value, 2, "IP", "dest_addr");
+
+    json_value.integer = 54321;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "src_port");
+    json_value.integer = 23;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "dest_port");
+    json_value.integer = 3221225472;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "seq");
+    json_value.integer = 0;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "ack_seq");
+    json_value.integer = 40;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "hdr_len");
+    json_value.integer = 0;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "res1");
+    json_value.boolean = false;
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "ecn");
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "cwr");
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "urg");
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "ack");
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "psh");
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "rst");
+    json_value.boolean = true;
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "syn");
+    json_value.boolean = false;
+    dict_update(dict, JSON_BOOL, json_value, 2, "TCP", "fin");
+    json_value.hex.number = 0x02; json_value.hex.format = HEX_FORMAT_02;
+    dict_update(dict, JSON_HEX, json_value, 2, "TCP", "tcp_flags");
+    json_value.integer = 64240;
+    dict_update(dict, JSON_INT, json_value, 2, "TCP", "window");
+    json_value.hex.number = 0x9f3a; json_value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, json_value, 2, "TCP", "checksum");
+    json_value.hex.number = 0; json_value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, json_value, 2, "TCP", "urg_ptr");
+    json_value.string = "05b4";
+    dict_update(dict, JSON_STR, json_value, 3, "TCP", "tcp_options", "mss");
+    json_value.string = "";
+    dict_update(dict, JSON_STR, json_value, 3, "TCP", "tcp_options", "sack_perm");
+    json_value.string = "a1b2c3d400000000";
+    dict_update(dict, JSON_STR, json_value, 3, "TCP", "tcp_options", "timestamp");
+    json_value.string = "";
+    dict_update(dict, JSON_STR, json_value, 3, "TCP", "tcp_options", "nop");
+    json_value.string = "07";
+    dict_update(dict, JSON_STR, json_value, 3, "TCP", "tcp_options", "window");
+
+    json_value.integer = 0;
+    dict_update(dict, JSON_INT, json_value, 1, "data_bytes");
+    json_value.floating = 1704106800.123456;
+    dict_update(dict, JSON_FLOAT, json_value, 1, "unixtime");
+    return dict;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Previous implementation of dict_dumpstr
+static char* memstream_dumpstr(struct dict* dict)
+{
+    char* buf = 0;
+    size_t len = 0;
+    FILE* stream = open_memstream(&buf, &len);
+    if (stream == NULL) abort();
+    dict_dump(stream, dict);
+    fclose(stream);
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    long int iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    struct dict* dict = tcp_syn_event();
+    struct dict_buffer output = {0};
+    size_t total = 0; //keeps the compiler from optimizing the loops away
+    double start, ns_memstream, ns_dumpstr, ns_dumpbuf;
+
+    //outputs must be identical
+    char* reference = memstream_dumpstr(dict);
+    char* dumpstr = dict_dumpstr(dict);
+    dict_dumpbuf(&output, dict);
+    if(strcmp(reference, dumpstr) != 0 || strcmp(reference, output.data) != 0) {
+        fprintf(stderr, "ERROR: Outputs differ:\n%s\n%s\n%s\n", reference, dumpstr, output.data);
+        return 1;
+    }
+    fprintf(stdout, "Event (%zu bytes): %s\n", output.len, output.data);
+    free(reference);
+    free(dumpstr);
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++) {
+        char* str = memstream_dumpstr(dict);
+        total += strlen(str);
+        free(str);
+    }
+    ns_memstream = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++) {
+        char* str = dict_dumpstr(dict);
+        total += strlen(str);
+        free(str);
+    }
+    ns_dumpstr = (now_ns() - start) / iterations;
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++)
+        total += dict_dumpbuf(&output, dict);
+    ns_dumpbuf = (now_ns() - start) / iterations;
+
+    fprintf(stdout, "%-40s %10.1f ns/op\n", "open_memstream + fprintf (previous)", ns_memstream);
+    fprintf(stdout, "%-40s %10.1f ns/op (x%.1f)\n", "dict_dumpstr", ns_dumpstr, ns_memstream / ns_dumpstr);
+    fprintf(stdout, "%-40s %10.1f ns/op (x%.1f)\n", "dict_dumpbuf, reused buffer", ns_dumpbuf, ns_memstream / ns_dumpbuf);
+    fprintf(stderr, "(%zu bytes serialized)\n", total);
+
+    dict_buffer_free(&output);
+    dict_free(dict);
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Benchmark of hex string and hexdump encoding of payloads.
+ *
+ * Compares hex_encode(...) and hex_dump_encode(...) to the former sprintf based implementations
+ * of print_hex_string(...) and hex_dump(...), kept here as reference, and prints GB/s of encoded payload.
+ * Outputs are checked to be byte-identical for all payload lengths up to 2 KB before measuring.
+ *
+ * Usage: bench_hex [payload length] [iterations]
+ * Built by cmake -DCMAKE_BENCH=ON, which defaults to CMAKE_BUILD_TYPE Release, i.e. -O3 -DNDEBUG.
+ * On x86_64 the SSE2 encoders are measured, the AVX2 encoders need e.g. CFLAGS=-mavx2.
+ *
+ * BSI 2018-2023
+*/
+
+#include "madcat.helper.h"
+
+#define DEFAULT_PAYLOAD_LEN 4096
+#define DEFAULT_ITERATIONS 2000
+#define CHECK_LEN 2048
+
+static volatile size_t bench_sink; //Results of the measured loops, so the compiler can not optimize them away
+
+//Former implementations, as reference for output and speed
+
+static char* sprintf_hex_string(const unsigned char* buffer, unsigned int buffsize)
+{
+    char* output = malloc(2*buffsize+1); //output has to be min. 2*buffsize + 1 for 2 characters per byte and null-termination.
+    if(buffsize<=0) {
+        output[0] = 0;
+        return output;
+    }; //return proper empty string
+    int i = 0;
+    for(i=0; i<buffsize; i++)
+        sprintf(output+2*i, "%02x", (unsigned char) buffer[i]);
+    output[2*i] = 0; //Terminate string with \0
+    return output;
+}
+static char* snprintf_hex_dump(const void *addr, int len, const bool json)
+{
+    char* output = 0;
+    
+    if(len <= 0) { //return empty string
+        output = malloc(1);
+        memset(output, 0, 1);
+        return output;
+    }
+  
+    int i =0;
+    unsigned char ascii_buff[17]; //size is 16 character + \0
+    const unsigned char *pc = (const unsigned char*)addr;
+    //Hex output is 3 characters per Byte e.g. "ff " for 16 Bytes per row plus offset, ascii and padding with spaces. Number of rows is len div 16 plus first row.
+    int out_len = (16 * 3 + 32) * (len / 16 + 1);
+    output = malloc(out_len); //must be freed
+    char* out_ptr = output;
+    memset(output, 0, out_len);
+
+    if (len == 0) {
+        return output;
+    }
+    if (len < 0) {
+        return output;
+    }
+    //Cap length to prevent possible overflow in output.
+    //Okay. It's at 4GB...
+    if (len > 0xFFFFFFFF) {
+        len = 0xFFFFFFFF;
+    }
+
+    // Process every byte in the data.
+    for (i = 0; i < len; i++) {
+        // Multiple of 16 means new line (with line offset).
+
+        if ((i % 16) == 0) {
+            // Just don't print ASCII for the zeroth line.
+            if (i != 0) {
+                out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"  |%s|", ascii_buff);
+
+                if (json)
+                    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"\\n");
+                else
+                    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"\n");
+            }
+
+            // Output the offset.
+            out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"%08x ", i);
+        } else if ((i % 8) == 0) {
+            if (i != 0)
+                out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," ");
+        }
+
+
+        // Now the hex code for the specific character.
+        out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," %02x", pc[i]);
+
+        // And store a printable ASCII character for later.
+        if ((pc[i] < 0x20) || (pc[i] > 0x7e))
+            ascii_buff[i % 16] = '.';
+        else if (json && pc[i] == 0x22) //Do not insert " in JSON!
+            ascii_buff[i % 16] = '\'';
+        else if (json && pc[i] == 0x5c) //Do not insert \ in JSON!
+            ascii_buff[i % 16] = '/';
+        else
+            ascii_buff[i % 16] = pc[i];
+        ascii_buff[(i % 16) + 1] = '\0';
+    }
+
+    // Pad out last line if not exactly 16 characters.
+    while ((i % 16) != 0) {
+        out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"   ");
+        if ((i % 8) == 0)
+            out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," ");
+
+        i++;
+    }
+
+    // And print the final ASCII bit.
+    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"  |%s|", ascii_buff);
+    out_ptr = 0;
+
+    return output;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+//Checks outputs of all lengths up to CHECK_LEN for equality. Returns 0 on success.
+static int check(const unsigned char* payload)
+{
+    char* output = malloc(HEX_DUMP_LEN(CHECK_LEN));
+    for(int len = 0; len <= CHECK_LEN; len++) {
+        char* reference = sprintf_hex_string(payload, len);
+        if(hex_encode(output, payload, len) != strlen(reference) || strcmp(reference, output) != 0) {
+            fprintf(stderr, "ERROR: hex string of %d Bytes differs:\n%s\n%s\n", len, reference, output);
+            return 1;
+        }
+        free(reference);
+        for(int json = 0; json <= 1; json++) {
+            reference = snprintf_hex_dump(payload, len, json);
+            if(hex_dump_encode(output, payload, len, json) != strlen(reference) || strcmp(reference, output) != 0) {
+                fprintf(stderr, "ERROR: hexdump of %d Bytes (json: %d) differs:\n%s\n%s\n", len, json, reference, output);
+                return 1;
+            }
+            free(reference);
+        }
+    }
+    free(output);
+    return 0;
+}
+
+static void report(const char* name, double ns, long int bytes)
+{
+    fprintf(stdout, "%-32s %10.3f GB/s\n", name, bytes / ns);
+}
+
+int main(int argc, char *argv[])
+{
+    long int payload_len = argc > 1 ? atol(argv[1]) : DEFAULT_PAYLOAD_LEN;
+    long int iterations = argc > 2 ? atol(argv[2]) : DEFAULT_ITERATIONS;
+    long int check_len = payload_len > CHECK_LEN ? payload_len : CHECK_LEN;
+    unsigned char* payload = malloc(check_len);
+    char* output = malloc(HEX_DUMP_LEN(payload_len));
+    size_t total = 0; //stored to bench_sink
+    double start;
+
+    srand(42);
+    for(long int i = 0; i < check_len; i++) payload[i] = rand(); //all byte values, printable or not
+    if(check(payload) != 0) return 1;
+    fprintf(stdout, "Payload: %ld Bytes, %ld iterations\n", payload_len, iterations);
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++) {
+        char* str = sprintf_hex_string(payload, payload_len);
+        total += str[0];
+        free(str);
+    }
+    report("sprintf hex string (previous)", now_ns() - start, payload_len * iterations);
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++)
+        total += hex_encode(output, payload, payload_len);
+    report("hex_encode", now_ns() - start, payload_len * iterations);
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++) {
+        char* str = snprintf_hex_dump(payload, payload_len, true);
+        total += str[0];
+        free(str);
+    }
+    report("snprintf hexdump (previous)", now_ns() - start, payload_len * iterations);
+
+    start = now_ns();
+    for(long int i = 0; i < iterations; i++)
+        total += hex_dump_encode(output, payload, payload_len, true);
+    report("hex_dump_encode", now_ns() - start, payload_len * iterations);
+    bench_sink = total;
+
+    free(output);
+    free(payload);
+    return 0;
+}
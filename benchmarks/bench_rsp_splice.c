@@ -0,0 +1,273 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Throughput test of the TCP proxy, copying vs. splicing data.
+ *
+ * Runs rsp_multi(...) for one port on the loopback device in a child process, once with
+ * connection_splice unset (read(2) and write(2) through user space) and once with it set (splice(2) through pipes).
+ * Each client sends its data through the proxy to a backend, which echoes it, and closes after it has received it back.
+ * Prints throughput, CPU time and peak memory of the proxy for both modes.
+ * Checks, that all data has been forwarded and counted in bytes_toserver and bytes_toclient of the flow events.
+ *
+ * Usage: bench_rsp_splice [MB per connection] [connections]
+ *
+ * BSI 2018-2023
+*/
+
+#include "tcp_ip_port_mon.h"
+#include <sys/resource.h>
+
+#define DEFAULT_MB 64
+#define DEFAULT_CONNECTIONS 4
+#define BENCH_CHUNK 65536
+
+static long long int bench_bytes; //bytes per connection and direction
+static uint16_t bench_proxy_port;
+static volatile long int bench_failed; //connections with missing data
+
+//Returns a socket listening on an ephemeral port of the loopback device, its port in *port
+static int bench_listen(uint16_t* port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (bind(fd, (struct sockaddr*) &addr, addr_len) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        getsockname(fd, (struct sockaddr*) &addr, &addr_len) != 0) {
+        perror("listen");
+        exit(1);
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static long long int bench_recv(int fd, char* buf, long long int len)
+{
+    long long int total = 0;
+    ssize_t n;
+    while (total < len && (n = read(fd, buf, BENCH_CHUNK)) > 0) total += n;
+    return total;
+}
+
+static long long int bench_send(int fd, char* buf, long long int len)
+{
+    long long int total = 0;
+    ssize_t n;
+    while (total < len && (n = write(fd, buf, len - total < BENCH_CHUNK ? len - total : BENCH_CHUNK)) > 0) total += n;
+    return total;
+}
+
+//Backend connection: echo until EOF
+static void* bench_backend_conn(void* arg)
+{
+    int fd = (int) (intptr_t) arg;
+    char* buf = malloc(BENCH_CHUNK);
+    ssize_t n;
+    while ((n = read(fd, buf, BENCH_CHUNK)) > 0 && bench_send(fd, buf, n) == n)
+        ;
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static void* bench_backend(void* arg)
+{
+    int listenfd = (int) (intptr_t) arg;
+    while (1) {
+        int fd = accept(listenfd, NULL, NULL);
+        if (fd == -1) continue;
+        pthread_t thread;
+        pthread_create(&thread, NULL, bench_backend_conn, (void*) (intptr_t) fd);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+//Sends the data of a client connection, while bench_client(...) receives the echo
+static void* bench_client_send(void* arg)
+{
+    int fd = (int) (intptr_t) arg;
+    char* buf = malloc(BENCH_CHUNK);
+    memset(buf, 'c', BENCH_CHUNK);
+    if (bench_send(fd, buf, bench_bytes) != bench_bytes)
+        __atomic_add_fetch(&bench_failed, 1, __ATOMIC_RELAXED);
+    free(buf);
+    return NULL;
+}
+
+static void* bench_client(void* arg)
+{
+    (void) arg;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(bench_proxy_port);
+    char* buf = malloc(BENCH_CHUNK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        __atomic_add_fetch(&bench_failed, 1, __ATOMIC_RELAXED);
+        close(fd);
+        free(buf);
+        return NULL;
+    }
+    pthread_t sender;
+    pthread_create(&sender, NULL, bench_client_send, (void*) (intptr_t) fd);
+    if (bench_recv(fd, buf, bench_bytes) != bench_bytes)
+        __atomic_add_fetch(&bench_failed, 1, __ATOMIC_RELAXED);
+    pthread_join(sender, NULL);
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+static double bench_seconds(const struct timespec* begin)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - begin->tv_sec) + 1e-9 * (now.tv_nsec - begin->tv_nsec);
+}
+
+//Returns peak resident memory of process pid in kB
+static long int bench_peak_rss(pid_t pid)
+{
+    char path[64], line[256];
+    long int rss = -1;
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* status = fopen(path, "r");
+    if (status == NULL) return -1;
+    while (fgets(line, sizeof(line), status) != NULL)
+        if (sscanf(line, "VmHWM: %ld kB", &rss) == 1) break;
+    fclose(status);
+    return rss;
+}
+
+//Proxies all connections through a new proxy process, returns the number of flow events with all bytes counted
+static long int bench_run(bool splice, int connections, double* elapsed, double* cpu, long int* rss)
+{
+    int probe = bench_listen(&bench_proxy_port); //free port for the proxy
+    close(probe);
+
+    fflush(stdout);
+    pid_t proxy_pid = fork();
+    if (proxy_pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        freopen("/dev/null", "w", stdout);
+        freopen("/dev/null", "w", stderr); //connection log
+        signal(SIGTERM, sig_handler_proxychild);
+        connection_splice = splice;
+        pctcp_push(pc, bench_proxy_port, "127.0.0.1", atoi(pc->portlist->backendport_str));
+        rsp_multi(pc, "127.0.0.1");
+        _exit(1);
+    }
+    usleep(200000); //until the proxy is listening
+
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_t client[connections];
+    for (int i = 0; i < connections; i++)
+        pthread_create(&client[i], NULL, bench_client, NULL);
+    for (int i = 0; i < connections; i++)
+        pthread_join(client[i], NULL);
+    *elapsed = bench_seconds(&begin);
+    usleep(100000); //until the last flows have been logged
+
+    struct rusage usage;
+    *rss = bench_peak_rss(proxy_pid);
+    kill(proxy_pid, SIGTERM);
+    wait4(proxy_pid, NULL, 0, &usage);
+    *cpu = usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec + usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+
+    //Check the byte counters of the flow events
+    FILE* events = tmpfile();
+    event_ring_drain(event_ring, TCP_RING_CON, events);
+    rewind(events);
+    long int counted = 0;
+    long long int toserver = 0, toclient = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, events) > 0) {
+        char* field_toserver = strstr(line, "\"bytes_toserver\":");
+        char* field_toclient = strstr(line, "\"bytes_toclient\":");
+        if (field_toserver != NULL && sscanf(field_toserver, "\"bytes_toserver\":%lld", &toserver) == 1 &&
+            field_toclient != NULL && sscanf(field_toclient, "\"bytes_toclient\":%lld", &toclient) == 1 &&
+            toserver == bench_bytes && toclient == bench_bytes)
+            counted++;
+    }
+    free(line);
+    fclose(events);
+    return counted;
+}
+
+int main(int argc, char* argv[])
+{
+    long int mb = argc > 1 ? atol(argv[1]) : DEFAULT_MB;
+    int connections = argc > 2 ? atoi(argv[2]) : DEFAULT_CONNECTIONS;
+    if (mb < 1) mb = 1;
+    if (connections < 1) connections = 1;
+    bench_bytes = mb * 1024 * 1024;
+
+    //Globals of the TCP module used by the proxy
+    EMPTY_STR[0] = 0;
+    loglevel = 0;
+    output_format = DICT_FORMAT_JSON;
+    snprintf(user.name, sizeof(user.name), "nobody"); //if run as root
+    event_ring = event_ring_init(2, EVENT_RING_SIZE);
+    signal(SIGPIPE, SIG_IGN);
+
+    //Backend, its port is passed to the proxy by the first element of the port list
+    uint16_t backend_port;
+    int backendfd = bench_listen(&backend_port);
+    pthread_t backend;
+    pthread_create(&backend, NULL, bench_backend, (void*) (intptr_t) backendfd);
+    pc = pctcp_init();
+    pctcp_push(pc, 0, "127.0.0.1", backend_port);
+
+    const char* mode[2] = { "copy", "splice" };
+    double elapsed[2], cpu[2];
+    long int counted[2], rss[2];
+    printf("connections: %d, %ld MB per connection and direction\n", connections, mb);
+    for (int i = 0; i < 2; i++) {
+        counted[i] = bench_run(i == 1, connections, &elapsed[i], &cpu[i], &rss[i]);
+        double gb = 2.0 * connections * bench_bytes / (1024.0 * 1024 * 1024);
+        printf("%-6s: %8.1f MB/s, proxy CPU %.3f s (%.3f s/GB), proxy peak RSS %ld kB, %.3f s, flow events with all bytes counted: %ld\n", \
+               mode[i], gb * 1024 / elapsed[i], cpu[i], cpu[i] / gb, rss[i], elapsed[i], counted[i]);
+    }
+
+    if (bench_failed != 0 || counted[0] != connections || counted[1] != connections) {
+        fprintf(stderr, "ERROR: %ld connections with missing data, flow events differ\n", bench_failed);
+        return 1;
+    }
+    return 0;
+}
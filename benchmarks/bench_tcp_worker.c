@@ -0,0 +1,197 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Load test of the TCP connection worker.
+ *
+ * Runs worker_tcp(...) on a listening socket on the loopback device in a child process,
+ * opens connections from several client threads, each sending a small payload,
+ * and reads the flow events from the FIFO pipe until all connections have been logged.
+ * Prints the sustained rate of accepted and logged connections/s and the peak memory of the worker.
+ * Checks, that every connection results in exactly one flow event and one .tpm file with the payload.
+ *
+ * Usage: bench_tcp_worker [connections] [client threads]
+ *
+ * BSI 2018-2023
+*/
+
+#include "tcp_ip_port_mon.h"
+#include <dirent.h>
+
+#define DEFAULT_CONNECTIONS 10000
+#define DEFAULT_THREADS 8
+#define BENCH_TIMEOUT 0.5 //Connection timeout of the worker in s, flows end this long after the last data
+#define BENCH_PAYLOAD "GET / HTTP/1.0\r\nHost: madcat\r\n\r\n"
+
+static struct sockaddr_in bench_addr; //address of the listening socket
+static long int bench_per_thread; //connections per client thread
+static volatile long int bench_failed; //failed connects
+
+static void* bench_client(void* arg)
+{
+    (void) arg;
+    for (long int i = 0; i < bench_per_thread; i++) {
+        int s = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(s, (struct sockaddr*) &bench_addr, sizeof(bench_addr)) != 0 ||
+            send(s, BENCH_PAYLOAD, strlen(BENCH_PAYLOAD), 0) != (ssize_t) strlen(BENCH_PAYLOAD))
+            __atomic_add_fetch(&bench_failed, 1, __ATOMIC_RELAXED);
+        close(s);
+    }
+    return NULL;
+}
+
+static double bench_seconds(const struct timespec* begin)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - begin->tv_sec) + 1e-9 * (now.tv_nsec - begin->tv_nsec);
+}
+
+//Returns peak resident memory of process pid in kB
+static long int bench_peak_rss(pid_t pid)
+{
+    char path[64], line[256];
+    long int rss = -1;
+    snprintf(path, sizeof(path), "/proc/%d/status", pid);
+    FILE* status = fopen(path, "r");
+    if (status == NULL) return -1;
+    while (fgets(line, sizeof(line), status) != NULL)
+        if (sscanf(line, "VmHWM: %ld kB", &rss) == 1) break;
+    fclose(status);
+    return rss;
+}
+
+int main(int argc, char* argv[])
+{
+    long int connections = argc > 1 ? atol(argv[1]) : DEFAULT_CONNECTIONS;
+    int threads = argc > 2 ? atoi(argv[2]) : DEFAULT_THREADS;
+    if (connections < threads) connections = threads;
+    bench_per_thread = connections / threads;
+    connections = bench_per_thread * threads;
+
+    //Globals of the TCP module used by the worker
+    EMPTY_STR[0] = 0;
+    loglevel = 0;
+    output_format = DICT_FORMAT_JSON;
+    snprintf(hostaddr, sizeof(hostaddr), "127.0.0.1");
+    event_ring = event_ring_init(2, EVENT_RING_SIZE);
+    char data_path[] = "/tmp/bench_tcp_worker.XXXXXX/";
+    data_path[strlen(data_path) - 1] = 0;
+    if (mkdtemp(data_path) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    data_path[strlen(data_path)] = '/';
+
+    int listenfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    memset(&bench_addr, 0, sizeof(bench_addr));
+    bench_addr.sin_family = AF_INET;
+    bench_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(bench_addr);
+    if (bind(listenfd, (struct sockaddr*) &bench_addr, addr_len) != 0 || listen(listenfd, SOMAXCONN) != 0 ||
+        getsockname(listenfd, (struct sockaddr*) &bench_addr, &addr_len) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    int fifo[2];
+    if (pipe(fifo) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t worker_pid = fork();
+    if (worker_pid == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        close(fifo[0]);
+        close(fifo[1]);
+        freopen("/dev/null", "w", stdout); //JSON log lines
+        freopen("/dev/null", "w", stderr); //connection log
+        struct tcp_worker_conf_t conf = { BENCH_TIMEOUT, data_path, 1024, event_ring, "TCP", 0, false, 1024 };
+        worker_tcp(listenfd, &conf);
+        _exit(0);
+    }
+    close(listenfd);
+    FILE* confifo = fdopen(fifo[0], "r");
+    //Flow events are written by the worker to the ring and by the drain thread to the pipe, as in tcp_ip_port_mon
+    event_drain.ring = event_ring;
+    event_drain.output[TCP_RING_CON] = fdopen(fifo[1], "w");
+    event_drain_start(&event_drain);
+
+    //Connect from client threads and wait for all flow events
+    struct timespec begin;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_t client[threads];
+    for (int i = 0; i < threads; i++)
+        pthread_create(&client[i], NULL, bench_client, NULL);
+
+    long int events = 0, bytes = 0, bytes_ok = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    while (events < connections - bench_failed && getline(&line, &line_size, confifo) > 0) {
+        events++;
+        char* field = strstr(line, "\"bytes_toserver\":");
+        if (field != NULL && sscanf(field, "\"bytes_toserver\":%ld", &bytes) == 1 && bytes == (long int) strlen(BENCH_PAYLOAD))
+            bytes_ok++;
+    }
+    double elapsed = bench_seconds(&begin);
+    for (int i = 0; i < threads; i++)
+        pthread_join(client[i], NULL);
+    long int rss = bench_peak_rss(worker_pid);
+    kill(worker_pid, SIGKILL);
+    waitpid(worker_pid, NULL, 0);
+    event_drain_stop(&event_drain);
+
+    //Count and remove .tpm files
+    long int files = 0;
+    DIR* dir = opendir(data_path);
+    struct dirent* entry;
+    char file_name[2*PATH_LEN];
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        if (strstr(entry->d_name, ".tpm") == NULL) continue;
+        files++;
+        snprintf(file_name, sizeof(file_name), "%s%s", data_path, entry->d_name);
+        unlink(file_name);
+    }
+    if (dir != NULL) closedir(dir);
+    rmdir(data_path);
+    free(line);
+
+    printf("connections: %ld, client threads: %d, failed connects: %ld\n", connections, threads, bench_failed);
+    printf("flow events: %ld, with payload: %ld, .tpm files: %ld\n", events, bytes_ok, files);
+    printf("%.0f connections/s accepted and logged (%.3f s, the last flows end %.2f s timeout after their data), worker peak RSS %ld kB\n", \
+           events / (elapsed - BENCH_TIMEOUT), elapsed, BENCH_TIMEOUT, rss);
+
+    if (bench_failed != 0 || events != connections || bytes_ok != connections || files != connections) {
+        fprintf(stderr, "ERROR: connections, flow events and .tpm files differ\n");
+        return 1;
+    }
+    return 0;
+}
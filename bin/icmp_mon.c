@@ -48,6 +48,7 @@ int main(int argc, char *argv[])
     fprintf(stderr, "\n%s%s\n", MASCOTT, VERSION);
 
     loglevel = 0; //Default Loglevel 0: Standard, 1: Debug
+    output_format = DICT_FORMAT_JSON; //Default JSON output
 
     char log_time[64] = "";
     time_str(NULL, 0, log_time, sizeof(log_time)); //...generate string with current time
@@ -108,6 +109,10 @@ int main(int argc, char *argv[])
             loglevel = atoi(get_config_opt(luaState, "loglevel")); //convert string type to integer type (loglevel)
         }
         fprintf(stderr, "\tloglevel: %d\n", loglevel);
+        if(strcmp(get_config_opt(luaState, "output_format"), "cbor") == 0) { //if optional parameter is given, set it.
+            output_format = DICT_FORMAT_CBOR;
+        }
+        fprintf(stderr, "\toutput_format: %s\n", output_format == DICT_FORMAT_CBOR ? "cbor" : "json");
 
         fflush(stderr);
         lua_close(luaState);
@@ -168,15 +173,8 @@ int main(int argc, char *argv[])
         memset(buffer,0, bufsize + 1);   //zeroize buffer
         int recv_len = CHECK(recvfrom(listenfd, buffer, bufsize, 0, (struct sockaddr *) &trgaddr, &trgaddr_len), != -1);  //Accept Incoming data
 
-        //parse buffer, log, assemble JSON, parse IP/TCP/UDP headers, do stuff...
+        //parse buffer, log, assemble and print JSON, parse IP/TCP/UDP headers, do stuff...
         worker_icmp(buffer, recv_len, hostaddr,data_path);
-        //print JSON output for logging and further analysis, if JSON-Object is not empty (happens if e.g. UDP is seen by ICMP Raw Socket)
-        char* output = dict_dumpstr(json_dict(false));
-        if(strlen(output) > 2) {
-            fprintf(stdout,"%s\n", output);
-            fflush(stdout);
-        }
-        free(output);
     }
     return 0;
 }
@@ -41,8 +41,6 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 //Variabels for PCAP sniffing
 char* filter_exp; //The configured PCAP Filter string
 pcap_t *handle; //pcap Session handle
-struct pcap_pkthdr header; // The pcap header it gives back
-unsigned char* packet; //The Packet from pcap
 
 //Main
 
@@ -56,12 +54,12 @@ int main(int argc, char *argv[])
     fprintf(stderr, "\n%s%s\n", MASCOTT, VERSION);
 
     loglevel = 0; //Default Loglevel 0: Standard, 1: Debug
+    output_format = DICT_FORMAT_JSON; //Default JSON output
 
     //pseudo constant empty string e.g. for initialization of json_data_node_t and checks. Not used #define here, because this would lead to several instances of an empty constant string with different addresses.
     EMPTY_STR[0] = 0;
     //Start time
     char log_time[64] = ""; //Human readable start time (actual time zone)
-    char log_time_unix[64] = ""; //Unix timestamp (UTC)
 
     //Register Signal Handlers
     signal(SIGUSR1, sig_handler_raw); //register handler as callback function used by CHECK-Macro
@@ -72,6 +70,7 @@ int main(int argc, char *argv[])
     char interface[64]= "";
     int max_file_size = -1;
     filter_exp = EMPTY_STR;
+    struct capture_conf_t capture_conf = { CAPTURE_PCAP, BUFSIZ, 0, false, 0, 1 }; //capture settings
 
     // Checking if number of arguments is one (config file).
     if (argc != 2) {
@@ -119,6 +118,12 @@ int main(int argc, char *argv[])
             loglevel = atoi(get_config_opt(luaState, "loglevel")); //convert string type to integer type (loglevel)
         }
         fprintf(stderr, "\tloglevel: %d\n", loglevel);
+        if(strcmp(get_config_opt(luaState, "output_format"), "cbor") == 0) { //if optional parameter is given, set it.
+            output_format = DICT_FORMAT_CBOR;
+        }
+        fprintf(stderr, "\toutput_format: %s\n", output_format == DICT_FORMAT_CBOR ? "cbor" : "json");
+
+        capture_config(luaState, &capture_conf);
 
         fflush(stderr);
         lua_close(luaState);
@@ -132,169 +137,26 @@ int main(int argc, char *argv[])
 #if DEBUG >= 2
     fprintf(stderr, "*** DEBUG [PID %d] Initialize PCAP\n", getpid());
 #endif
-    CHECK(init_pcap(interface, &handle, filter_exp), == 0); //Init libpcap
+    //Fork additional workers sharing the interface in a fanout group, each one initializing its own capture
+    fork_workers(capture_conf.workers);
+    struct capture_t capture = { .backend = CAPTURE_PCAP };
+    if (capture_conf.backend == CAPTURE_AFPACKET) {
+        CHECK(init_afpacket(&capture, interface, filter_exp, &capture_conf), == 0); //Init AF_PACKET ring
+    } else {
+        CHECK(init_pcap(interface, &handle, filter_exp, &capture_conf), == 0); //Init libpcap
+        capture.pcap = handle;
+    }
 
     fprintf(stderr, "%s [PID %d] ", log_time, getpid());
     drop_root_privs(user, "Sniffer"); //drop priviliges
 
-    struct json_data_node_t json_data; //JSON Data structure for output generation
-    //Link (POINTERS!!!) timestamp(s) in JSON Data Structure to timestamp variables (multiple times to match the data model of other modules)
-
-    char* payload_str = 0; //Payload as string
-    char* payload_hd_str = 0; //Payload as string in HexDump Format
-    char * payload_sha1_str = 0;
-    unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
-    bool size_exceeded = false; //max file size exceeded?
     fprintf(stderr, "%s [PID %d] Sniffing...\n", log_time, getpid());
     while (1) {
-        //Sniff packet
-        packet = 0;
-        packet = (unsigned char*) pcap_next(handle, &header); //Wait for and grab Packet (see PCAP_FILTER) (Maybe of maybe not BLOCKING!)
-
-        //Test if something went wrong
-        if (packet == 0) continue;
-        if (!(header.len > ETHERNET_HEADER_LEN)) continue;
-
-        //Preserve actuall time of Connection attempt, linked to timestamps in json_data
-        json_data.timeasdouble = time_str(log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
-        json_data.unixtime = log_time_unix;
-        json_data.timestamp = log_time;
-        json_data.start = log_time;
-        fprintf(stderr, "%s [PID %d] RAW Packet received\n", log_time, getpid());
-
-        //Set pointer and length to address layer 3 directly in received data
-        int packet_len = header.len - ETHERNET_HEADER_LEN;
-        unsigned char* packet_layer3 = (unsigned char*) packet + ETHERNET_HEADER_LEN;
-
-        if (packet_len > max_file_size && max_file_size > 0)
-            size_exceeded = true;
-        else
-            size_exceeded = false;
-
-#if DEBUG >= 2
-        fprintf(stdout, "\n%s\n", hex_dump(packet_layer3, packet_len, false));
-#endif
-
-        json_data.bytes_toserver = packet_len; //Len is defined here as layer 3 protokoll data + encapsulated protocols and their payload
-
-        //Process packet data
-        //Compute SHA1 of packet
-        SHA1(packet_layer3, (size_exceeded ? max_file_size : packet_len), payload_sha1);
-        payload_sha1_str = print_hex_string(payload_sha1, SHA_DIGEST_LENGTH);  //must be freed
-        //Make HexDump output out of binary packet contents
-        // entweder unsigned char als type in der Funktion oder payload_hd_str
-        payload_hd_str = hex_dump(packet_layer3, (size_exceeded ? max_file_size : packet_len), true); //must be freed
-        payload_str = print_hex_string(packet_layer3, (size_exceeded ? max_file_size : packet_len)); //must be freed
-
-        //Begin new global JSON output and open JSON object
-        json_data.duration = time_str(NULL, 0, log_time, sizeof(log_time)) - json_data.timeasdouble;
-        json_data.end = log_time;
-
-        json_value.string = "MADCAT";
-        dict_update(json_dict(true), JSON_STR, json_value, 1, "origin"); //begin new JSON Output
-        json_value.string = json_data.timestamp;
-        dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-
-        //Assumption of IP (v4 or v6) to determine version
-        struct ether_header * ethhdr = (struct ether_header *) packet; //Ethernet Header 
-        uint16_t ether_type =  ntohs(ethhdr->ether_type);
-        struct iphdr *iphdr = (struct iphdr *)(packet + ETHERNET_HEADER_LEN); //IPv4 header structure
-        struct ipv6hdr *ip6hdr = (struct ipv6hdr *) iphdr; //Interpretation of the header as IPv6 Header
-        char* proto_str = EMPTY_STR;
-        char* dest_ip = malloc(INET6_ADDRSTRLEN); dest_ip[0] = 0;
-        char* src_ip = malloc(INET6_ADDRSTRLEN); src_ip[0] = 0;
-        bool tainted = false;
-        //Source: https://www.iana.org/assignments/ieee-802-numbers/ieee-802-numbers.xhtml
-        switch(ether_type) { //Determine protocol type by ethertype
-            case 0x0800: json_data.proto = 4; break;
-            case 0x86DD: json_data.proto = 6; break;
-            default: json_data.proto = -1*ether_type; break;
+        //Wait for and process all packets (see filter_exp) of one capture buffer resp. ring block
+        if (capture_dispatch(&capture, worker_raw, (u_char*) &max_file_size) == PCAP_ERROR) {
+            time_str(NULL, 0, log_time, sizeof(log_time));
+            fprintf(stderr, "%s [PID %d] capture_dispatch: %s\n", log_time, getpid(), capture.backend == CAPTURE_PCAP ? pcap_geterr(handle) : strerror(errno));
         }
-        //Check packet length for detected IP version.
-        //For IPv4 minimum ist 20bytes
-        //For IPv6 the Headerlength is fixed 40bytes
-        if ((json_data.proto == 4 && packet_len < IPV4_HEADER_MIN_LEN) ||
-            (json_data.proto == 6 && packet_len < IPV6_HEADER_LEN )) {
-                proto_str = malloc(10);
-                snprintf(proto_str, 10, "MALFORMED");
-                tainted = true;
-                break;
-             }
-        else {
-            //Try to determine IPv4/IPv6 transport protocol
-            switch(json_data.proto) {
-                case 4: //If IPv4 has been detected, no suffix is used (tcpdump-style)
-                    proto_str = itoprotostr(iphdr->protocol, "");
-                    inet_ntop(AF_INET, &(iphdr->saddr), src_ip, INET6_ADDRSTRLEN);
-                    inet_ntop(AF_INET, &(iphdr->daddr), dest_ip, INET6_ADDRSTRLEN);
-                    //Include IP Information only if IPv4/v6 has been detected
-                    json_value.string = src_ip;
-                    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-                    json_value.string = dest_ip;
-                    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-                    break;
-                case 6: //If IPv6 has been detected, the suffix "v6" is used
-                    proto_str = itoprotostr(ip6hdr->nexthdr, "v6");
-                    inet_ntop(AF_INET6, &(ip6hdr->saddr), src_ip, INET6_ADDRSTRLEN);
-                    inet_ntop(AF_INET6, &(ip6hdr->daddr), dest_ip, INET6_ADDRSTRLEN);
-                    //Include IP Information only if IPv4/v6 has been detected
-                    json_value.string = src_ip;
-                    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-                    json_value.string = dest_ip;
-                    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-                    break;
-                default: //If neither IPv4 nor IPv6 could be detected, raw ethertype is used
-                    proto_str = malloc(20);
-                    snprintf(proto_str, 20, "0x%04X", ether_type); break;
-                    break;
-            }
-        }
-        
-        json_value.string = proto_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 1, "proto");
-        json_value.string = "RAW";
-        dict_update(json_dict(false), JSON_STR, json_value, 1, "event_type");
-        json_value.boolean = tainted;
-        dict_update(json_dict(false), JSON_BOOL, json_value, 1, "tainted");
-        json_value.floating = atof(json_data.unixtime);
-        dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
-        json_value.string = json_data.start;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "start");
-        json_value.string = json_data.end;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "end");
-        json_value.floating = json_data.duration;
-        dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "duration");
-        json_value.string = "closed";
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "state");
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "reason");
-        json_value.integer = json_data.bytes_toserver;
-        dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
-        json_value.string = payload_hd_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_hd");
-        json_value.string = payload_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_str");
-        json_value.string = payload_sha1_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_sha1");
-        json_value.string = filter_exp;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "RAW", "pcap_filter");
-        json_value.hex.number = ether_type; json_value.hex.format = HEX_FORMAT_04;
-        dict_update(json_dict(false), JSON_HEX, json_value, 2, "RAW", "ether_type");
-
-        //print JSON Object to stdout for logging
-        char* output = dict_dumpstr(json_dict(false));
-        if(strlen(output) > 2) { //do not print empty JSON-Objects
-            fprintf(stdout,"%s\n", output);
-            fflush(stdout);
-        }
-        free(output);
-
-        free(proto_str);
-        free(src_ip);
-        free(dest_ip);
-
-        free(payload_sha1_str);
-        free(payload_str);
-        free(payload_hd_str);
     }
 
     return 0;
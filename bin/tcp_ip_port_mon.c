@@ -51,12 +51,12 @@ int main(int argc, char *argv[])
     fprintf(stderr, "\n%s%s\n", MASCOTT, VERSION);
 
     loglevel = 0; //Default Loglevel 0: Standard, 1: Debug
+    output_format = DICT_FORMAT_JSON; //Default JSON output
 
     //pseudo constant empty string e.g. for initialization of json_data_node_t and checks. Not used #define here, because this would lead to several instances of an empty constant string with different addresses.
     EMPTY_STR[0] = 0;
     //Start time
     char log_time[64] = ""; //Human readable start time (actual time zone)
-    char log_time_unix[64] = ""; //Unix timestamp (UTC)
     struct timeval begin;
     gettimeofday(&begin, NULL);
     time_str(NULL, 0, log_time, sizeof(log_time)); //Get Human readable string only
@@ -75,10 +75,21 @@ int main(int argc, char *argv[])
     double timeout = 30;
     char data_path[PATH_LEN] = "";
     int max_file_size = -1;
+    double max_duration = 0; //Maximum duration of a connection in seconds, 0 for unlimited
+    bool close_size_exceeded = false; //Close connections as soon as max_file_size has been exceeded
+    long int max_stream_size = -2; //Maximum size of .tpm files, defaults to max_file_size
+    int listen_workers = 1; //Number of listner processes, each one accepting on its own SO_REUSEPORT socket
+    int listen_backlog = TCP_LISTEN_BACKLOG; //Backlog of each listening socket
+    char listen_cpus[STR_BUFFER_SIZE] = ""; //Optional comma separated list of CPUs to pin the listner processes to
+    //Settings of the optional correlator, defaults as in tcp_ip_port_mon_postprocessor.py
+    struct tcp_corr_conf_t corr_conf = { 10, 70, 100, NULL, NULL };
+    pid_t corr_pid = 0; //PID of the correlator process, if tcp_correlation is enabled
 
     //Structure holding proxy configuration items
     pc = pctcp_init();
     double proxy_wait_restart = 5; //time to wait before a crashed proxy restarts, e.g. because backend has failed, defaults to 5 seconds
+    bool proxy_single_process = false; //one proxy process serves all ports in one epoll set, instead of one process per port
+    struct capture_conf_t capture_conf = { CAPTURE_PCAP, PCAP_SNAPLEN, PCAP_BUFFER_SIZE, false, 0, 1 }; //capture settings of the TCP-SYN sniffer
 
     // Checking if number of arguments is one (config file) or 6 or 7 (command line).
     if (argc != 2  && (argc < 7 || argc > 8)) {
@@ -128,17 +139,71 @@ int main(int argc, char *argv[])
             max_file_size = atoi(get_config_opt(luaState, "max_file_size"));
         }
         fprintf(stderr, "\tmax_file_size: %d\n", max_file_size);
+        if(get_config_opt(luaState, "tcp_max_stream_size") != EMPTY_STR) { //if optional parameter is given, set it.
+            max_stream_size = atol(get_config_opt(luaState, "tcp_max_stream_size"));
+        }
+        fprintf(stderr, "\ttcp_max_stream_size: %ld\n", max_stream_size < -1 ? (long int) max_file_size : max_stream_size);
+        if(strcmp(get_config_opt(luaState, "tcp_close_size_exceeded"), "true") == 0) { //if optional parameter is given, set it.
+            close_size_exceeded = true;
+        }
+        fprintf(stderr, "\ttcp_close_size_exceeded: %s\n", close_size_exceeded ? "true" : "false");
+        if(get_config_opt(luaState, "tcp_connection_max_duration") != EMPTY_STR) { //if optional parameter is given, set it.
+            max_duration = (double) atof(get_config_opt(luaState, "tcp_connection_max_duration"));
+        }
+        fprintf(stderr, "\ttcp_connection_max_duration: %lf\n", max_duration);
+        if(strcmp(get_config_opt(luaState, "tcp_correlation"), "true") == 0) { //if optional parameter is given, set it.
+            tcp_correlation = true;
+        }
+        fprintf(stderr, "\ttcp_correlation: %s\n", tcp_correlation ? "true" : "false");
+        if(tcp_correlation) { //same timeouts as for the postprocessor
+            if(get_config_opt(luaState, "con_wait") != EMPTY_STR) corr_conf.con_wait = atof(get_config_opt(luaState, "con_wait"));
+            if(get_config_opt(luaState, "syn_timeout") != EMPTY_STR) corr_conf.syn_timeout = atof(get_config_opt(luaState, "syn_timeout"));
+            if(get_config_opt(luaState, "syn_wait_proxy") != EMPTY_STR) corr_conf.syn_wait_proxy = atof(get_config_opt(luaState, "syn_wait_proxy"));
+            fprintf(stderr, "\tcon_wait: %Lf\n\tsyn_timeout: %Lf\n\tsyn_wait_proxy: %Lf\n", corr_conf.con_wait, corr_conf.syn_timeout, corr_conf.syn_wait_proxy);
+        }
+
+        if(get_config_opt(luaState, "tcp_listening_workers") != EMPTY_STR) { //if optional parameter is given, set it.
+            listen_workers = atoi(get_config_opt(luaState, "tcp_listening_workers"));
+            if(listen_workers < 1) listen_workers = 1;
+        }
+        fprintf(stderr, "\ttcp_listening_workers: %d\n", listen_workers);
+        if(get_config_opt(luaState, "tcp_listening_backlog") != EMPTY_STR) { //if optional parameter is given, set it.
+            listen_backlog = atoi(get_config_opt(luaState, "tcp_listening_backlog"));
+        }
+        fprintf(stderr, "\ttcp_listening_backlog: %d\n", listen_backlog);
+        strncpy(listen_cpus, get_config_opt(luaState, "tcp_listening_cpus"), sizeof(listen_cpus));
+        listen_cpus[sizeof(listen_cpus)-1] = 0;
+        fprintf(stderr, "\ttcp_listening_cpus: %s\n", strlen(listen_cpus) > 0 ? listen_cpus : "any");
 
         if(get_config_opt(luaState, "loglevel") != EMPTY_STR) { //if optional parameter is given, set it.
             loglevel = atoi(get_config_opt(luaState, "loglevel")); //convert string type to integer type (loglevel)
         }
         fprintf(stderr, "\tloglevel: %d\n", loglevel);
+        if(strcmp(get_config_opt(luaState, "output_format"), "cbor") == 0) { //if optional parameter is given, set it.
+            output_format = DICT_FORMAT_CBOR;
+        }
+        fprintf(stderr, "\toutput_format: %s\n", output_format == DICT_FORMAT_CBOR ? "cbor" : "json");
+
+        //Read sniffer configuration
+        capture_config(luaState, &capture_conf);
 
         //Read proxy configuration
         if(get_config_opt(luaState, "proxy_wait_restart") != EMPTY_STR) { //if optional parameter is given, set it.
             proxy_wait_restart = (double) atof(get_config_opt(luaState, "proxy_wait_restart")); //convert string ype to integer type (proxy_wait_restart)
         }
         fprintf(stderr, "\tFailed proxy restart time: %lf\n", proxy_wait_restart);
+        if(get_config_opt(luaState, "proxy_epoll_events") != EMPTY_STR) { //if optional parameter is given, set it.
+            epoll_max_events = atoi(get_config_opt(luaState, "proxy_epoll_events")); //global, inherited by the proxies
+        }
+        fprintf(stderr, "\tProxy events per epoll_wait: %d\n", epoll_max_events);
+        if(strcmp(get_config_opt(luaState, "proxy_single_process"), "true") == 0) { //if optional parameter is given, set it.
+            proxy_single_process = true;
+        }
+        fprintf(stderr, "\tproxy_single_process: %s\n", proxy_single_process ? "true" : "false");
+        if(strcmp(get_config_opt(luaState, "proxy_splice"), "true") == 0) { //if optional parameter is given, set it.
+            connection_splice = true; //global, inherited by the proxies
+        }
+        fprintf(stderr, "\tproxy_splice: %s\n", connection_splice ? "true" : "false");
 
         get_config_table(luaState, "tcpproxy", pc);
         pctcp_print(pc);
@@ -171,20 +236,11 @@ int main(int argc, char *argv[])
     fprintf(stderr, "%s [PID %d] Starting on interface %s with hostaddress %s on port %d, timeout is %lfs, data path is %s\n", \
             log_time, getpid(), interface, hostaddr, port, timeout, data_path);
 
-    //Unlink possibly existing old semaphores
-    sem_unlink ("hdrsem");
-    sem_unlink ("consem");
-
-    //Semaphores for output globally defined for easy access inside functions
-    hdrsem = CHECK(sem_open ("hdrsem", O_CREAT | O_EXCL, 0644, 1), !=  SEM_FAILED);  //open semaphore for named pipe containing TCP/IP data
-    //Semaphore for named pipe containing connection data
-    consem = CHECK(sem_open ("consem", O_CREAT | O_EXCL, 0644, 1), !=  SEM_FAILED);
+    //Shared memory rings for output of all childs, globally defined for easy access inside functions. Mapped before forking.
+    event_ring = CHECK(event_ring_init(2, EVENT_RING_SIZE), != NULL); //TCP_RING_HDR for TCP/IP data, TCP_RING_CON for connection data
 
     //Variabels for PCAP sniffing
 
-    struct pcap_pkthdr header; // The pcap header it gives back
-    const unsigned char* packet; //The Packet from pcap
-    bpf_u_int32 caplen = 0; //size of pcap packet
     pcap_pid = 0; //PID of the Child doing the PCAP-Sniffing. Globally defined, cause it's used in CHECK-Makro callback function.
     listner_pid = 0; //PID of the Child doing the TCP Connection handling. Globally defined, cause it's used in CHECK-Makro callback function.
     //Make FIFO for connection discribing JSON Output
@@ -199,22 +255,45 @@ int main(int argc, char *argv[])
     fprintf(stderr, "%s [PID %d] FIFO for header JSON: %s\n", log_time, getpid(), HEADER_FIFO);
 
     /*********************************************************************************************************
-     * Start proxys.
+     * Fork correlator, matching SYNs and flows instead of tcp_ip_port_mon_postprocessor.py, if enabled.
+     * Forked first, so it does not hold the writing ends of its own pipes. These replace hdrfifo resp. confifo
+     * and are only written by the drain thread of the parent, the other childs detach from them, see detach_fifos().
     *********************************************************************************************************/
 
-    for (int listenport = 1; listenport<65536; listenport++) { //More Clever solution thus this is brute force?
-        if(pc->portmap[listenport]) {
-            if ( !(pctcp_get_lport(pc, listenport)->pid = fork()) ) { //Create Reverse Proxy child process(es) and save PID for parent watchdog.
-                pctcp_get_lport(pc, listenport)->pid = getpid(); //update copy of listelemnt in this (forked) copy with own PID, to be able to find own config.
-                //fprintf(stderr, "%s [PID %d] Starting Proxy on Port %d...\n", log_time, getpid(), listenport);
-                prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
-                CHECK(signal(SIGTERM, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGTERM for child process
-                CHECK(signal(SIGINT, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGINT for child process
-                CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR); //register handler for parents to prevent childs becoming Zombies
-                CHECK(rsp(pctcp_get_lport(pc, listenport), hostaddr), != 0); //start proxy
-            }
-            usleep(10000); //sleep 10ms, so output is not mangled between forks
+    if (tcp_correlation) {
+        int synpipe[2], flowpipe[2];
+        CHECK(tcp_corr_pipe(synpipe), == 0);
+        CHECK(tcp_corr_pipe(flowpipe), == 0);
+        corr_conf.portmap = pc->portmap;
+        corr_conf.output = confifo; //merged events are written to the FIFO, the postprocessor would have written them to
+        if ( !(corr_pid=fork()) ) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
+            CHECK(signal(SIGTERM, sig_handler_corrchild), != SIG_ERR); //re-register handler for SIGTERM for child process
+            CHECK(signal(SIGINT, sig_handler_corrchild), != SIG_ERR); //re-register handler for SIGINT for child process
+            close(synpipe[1]);
+            close(flowpipe[1]);
+            fprintf(stderr, "%s [PID %d] ", log_time, getpid());
+            drop_root_privs(user, "Correlator:", false); //drop priviliges
+            worker_corr(synpipe[0], flowpipe[0], &corr_conf); //returns after pending SYNs and flows have been written
+            _exit(0); //exit() somtimes hangs, see man _exit and man exit
         }
+        close(synpipe[0]);
+        close(flowpipe[0]);
+        confifo = CHECK(fdopen(flowpipe[1], "w"), != NULL);
+        hdrfifo = CHECK(fdopen(synpipe[1], "w"), != NULL);
+        fprintf(stderr, "%s [PID %d] Correlator with PID %d writes merged events to %s\n", log_time, getpid(), corr_pid, CONNECT_FIFO);
+        usleep(10000); //sleep 10ms, so output is not mangled between forks
+    }
+
+    /*********************************************************************************************************
+     * Start proxys.
+    *********************************************************************************************************/
+
+    if (proxy_single_process && pc->portlist != NULL) {
+        start_proxies(pc, hostaddr, NULL, 0); //one Reverse Proxy child process for all ports
+    } else {
+        for (struct proxy_conf_tcp_node_t* pcn = pc->portlist; pcn != NULL; pcn = pcn->next)
+            start_proxies(pc, hostaddr, pcn, 0); //one Reverse Proxy child process per port
     }
 
     /*********************************************************************************************************
@@ -223,6 +302,7 @@ int main(int argc, char *argv[])
 
     if( !(pcap_pid=fork()) ) {
         prctl(PR_SET_PDEATHSIG, SIGKILL); //request SIGKILL if parent dies.
+        detach_fifos(); //events are written by the drain thread of the parent
         CHECK(signal(SIGTERM, sig_handler_pcapchild), != SIG_ERR); //re-register handler for SIGTERM for child process
         CHECK(signal(SIGINT, sig_handler_pcapchild), != SIG_ERR); //re-register handler for SIGINT for child process
         CHECK(signal(SIGABRT, sig_handler_pcapchild), != SIG_ERR); //register handler for SIGABRT for child process
@@ -230,56 +310,35 @@ int main(int argc, char *argv[])
 #if DEBUG >= 2
         fprintf(stderr, "*** DEBUG [PID %d] Initialize PCAP\n", getpid());
 #endif
-        CHECK(init_pcap(interface, hostaddr, &handle, PCAP_FILTER), == 0); //Init libpcap
+        //Fork additional sniffer workers sharing the interface in a fanout group, each one initializing its own capture
+        fork_workers(capture_conf.workers);
+        struct capture_t capture = { .backend = CAPTURE_PCAP };
+        if (capture_conf.backend == CAPTURE_AFPACKET) {
+            char filter_exp[strlen(PCAP_FILTER) + strlen(hostaddr) + 1];
+            snprintf(filter_exp, sizeof(filter_exp), "%s%s", PCAP_FILTER, hostaddr);
+            CHECK(init_afpacket(&capture, interface, filter_exp, &capture_conf), == 0); //Init AF_PACKET ring
+        } else {
+            CHECK(init_pcap(interface, hostaddr, &handle, PCAP_FILTER, &capture_conf), == 0); //Init libpcap
+            capture.pcap = handle;
+        }
 
         fprintf(stderr, "%s [PID %d] ", log_time, getpid());
         drop_root_privs(user, "Sniffer:", false); //drop priviliges
 
-        int data_bytes = 0; //eventually exisiting data bytes in SYN (yes, this would be akward)
         long int syn_count = 0;
-        int ip_hdr_id;
+        struct timespec now, last_stats; //time of last logging of pcap statistics
+        time_now(&last_stats, true);
         while (1) {
-            packet = 0;
-            packet = pcap_next(handle, &header); //Wait for and grab TCP-SYN (see PCAP_FILTER) (Maybe or maybe not BLOCKING!)
-            if (packet == NULL) {
-                continue;
-            }
-            caplen = header.caplen;
-            //Preserve actuall start time of Connection attempt.
-            time_str(log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
-            //Begin new global JSON output and open JSON object
-            json_value.string = "MADCAT";
-            dict_update(json_dict(true), JSON_STR, json_value, 1, "origin");
-            json_value.string = log_time;
-            dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-            //Analyze Headers and discard malformed packets
-            ip_hdr_id = analyze_ip_header(packet, caplen);
-            if( ip_hdr_id < 0) {
-                continue;
-            }
-            data_bytes = analyze_tcp_header(packet, caplen);
-            if(data_bytes < 0) {
-                continue;
+            //Wait for and process all TCP-SYNs (see PCAP_FILTER) of one capture buffer resp. ring block, returns at least after PCAP_TIMEOUT
+            if (capture_dispatch(&capture, worker_syn, (u_char*) &syn_count) == PCAP_ERROR) {
+                time_str(NULL, 0, log_time, sizeof(log_time));
+                fprintf(stderr, "%s [PID %d] Sniffer: capture_dispatch: %s\n", log_time, getpid(), capture.backend == CAPTURE_PCAP ? pcap_geterr(handle) : strerror(errno));
             }
-            //final JSON Ouput
-            json_value.integer = data_bytes;
-            dict_update(json_dict(false), JSON_INT, json_value, 1, "data_bytes");
-            json_value.floating = atof(log_time_unix);
-            dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
-            struct timespec sem_timeout; //time to wait in sem_timedwait() call
-            clock_gettime(CLOCK_REALTIME, &sem_timeout);
-            sem_timeout.tv_sec += 1;
-            char* output = dict_dumpstr(json_dict(false));
-            if(strlen(output) > 2) { //do not print empty JSON-Objects
-                sem_timedwait(hdrsem, &sem_timeout); //Acquire lock for output
-                fprintf(hdrfifo, "%s\n", output); //print json output for further analysis
-                fflush(hdrfifo);
-                sem_post(hdrsem); //release lock
-                fprintf(stdout,"{\"HEADER\": %s}\n", output); //print json output for logging
-                fflush(stdout);
+            time_now(&now, true);
+            if (now.tv_sec - last_stats.tv_sec >= PCAP_STATS_INTERVAL) {
+                log_capture_stats(&capture, syn_count);
+                last_stats = now;
             }
-            free(output);
-            fprintf(stderr, "%s [PID %d] Sniffer: TCP-SYN No. %ld with id 0x%x received\n", log_time, getpid(), ++syn_count, ip_hdr_id);
         }
     }
 
@@ -292,19 +351,26 @@ int main(int argc, char *argv[])
     if ( !(listner_pid=fork()) ) {
         //Variables for listning socket
         struct sockaddr_in addr; //Hostaddress
-        struct sockaddr_in trgaddr; //Storage for original destination port
-        struct sockaddr_in claddr; //Clientaddress
-        char clientaddr[INET_ADDRSTRLEN] = "";
 
         prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
+        detach_fifos(); //events are written by the drain thread of the parent
         CHECK(signal(SIGTERM, sig_handler_listnerchild), != SIG_ERR); //re-register handler for SIGTERM for child process
         CHECK(signal(SIGINT, sig_handler_listnerchild), != SIG_ERR); //re-register handler for SIGINT for child process
         CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR); //register handler for parents to prevent childs becoming Zombies
 
         listner_pid = getpid();
 
-        socklen_t trgaddr_len = sizeof(trgaddr);
-        socklen_t claddr_len = sizeof(claddr);
+        //Fork several listners, each one accepting on its own SO_REUSEPORT socket, so the kernel spreads incoming connections across them.
+        //This process supervises and restarts them then.
+        int listen_worker = listen_workers > 1 ? supervise_listners(listen_workers) : 0;
+        if (listen_worker < 0) { //Supervisor: all listners have been stopped
+            time_str(NULL, 0, log_time, sizeof(log_time));
+            fprintf(stderr, "\n%s [PID %d] Listner-Supervisor received Signal %s, shutting down...\n", log_time, getpid(), strsignal(tcp_worker_stop));
+            sig_handler_common();
+            kill(getpid(), SIGKILL); //avoid calling exit() in forked childs, use kill instead!
+        }
+        int listen_cpu = strlen(listen_cpus) > 0 ? set_cpu_affinity(listen_cpus, listen_worker) : -1;
+
         socklen_t addr_len = sizeof(addr);
         int listenfd = CHECK(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP), != -1); //create socket filedescriptor
 
@@ -318,78 +384,44 @@ int main(int argc, char *argv[])
         int on = 1;
 
         CHECK(setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, (socklen_t)sizeof(on)), != -1);
+        CHECK(setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, (socklen_t)sizeof(on)), != -1);
         CHECK(setsockopt(listenfd, SOL_SOCKET, SO_LINGER, &sl, (socklen_t)sizeof(sl)), != -1);
+        if (listen_cpu >= 0) //prefer connections, whose packets are processed on the same CPU (Linux >= 6.2 for SO_REUSEPORT groups), optional.
+            setsockopt(listenfd, SOL_SOCKET, SO_INCOMING_CPU, &listen_cpu, (socklen_t)sizeof(listen_cpu));
 
         //Bind socket and begin listening
         CHECK(bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)), != -1);
-        CHECK(listen(listenfd, 5), != -1);
+        CHECK(listen(listenfd, listen_backlog), != -1);
+        fprintf(stderr, "%s [PID %d] Listner %d of %d listening with backlog %d on CPU %d (-1: any)\n", log_time, getpid(), \
+                listen_worker + 1, listen_workers, listen_backlog, listen_cpu);
 
         //drop root priviliges
         fprintf(stderr, "%s [PID %d] ", log_time, getpid());
         drop_root_privs(user, "Listner:", false);
 
-        //Main listening loop
-        long int flow_count = 0;
-        int status = 0; //Status int for waitpid()
-        pid_t kidpid = 0; //Child Pid for stream accepting child, returned by waitpid()
-        while (1) {
-#if DEBUG >= 2
-            fprintf(stderr, "*** DEBUG [PID %d] Listner Loop\n", getpid());
-#endif
-            claddr_len = sizeof(claddr); //reinitialize claddr_len, because in the call to accept(...) it is a value-result argument!
-            openfd = CHECK(accept(listenfd, (struct sockaddr*)&claddr, &claddr_len), != -1);  //Accept incoming connection
-            do
-            {
-                kidpid = waitpid(-1, &status, WNOHANG); //Check if a childs have returned before forking, while waiting for next incoming connection
-#if DEBUG >= 2
-                if (kidpid > 0)
-                    fprintf(stderr, "*** DEBUG [PID %d] Stream accepting child %d exited\n", getpid(),kidpid);
-#endif
-            } 
-            while (kidpid > 0);
-            if (!fork()) { //Create stream accepting child process
-#if DEBUG >= 2
-                fprintf(stderr, "*** DEBUG [PID %d] Accept-Child forked\n", getpid());
-#endif
-                prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
-                CHECK(signal(SIGTERM, sig_handler_listnerchild), != SIG_ERR); //register handler for SIGTERM for child process
-                CHECK(signal(SIGINT, sig_handler_listnerchild), != SIG_ERR); //re-register handler for SIGINT for child process
-                CHECK(signal(SIGUSR2, sig_handler_listnerchild), != SIG_ERR); //Register handler for SIGUSR2 for child process for gracefull shutdown
-                //Preserve actual start time of connection attempt.
-                if (loglevel > 1) {
-                    time_str(log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
-                    fprintf(stderr, "%s [PID %d] Connection incoming, trying to resolve original destination port on socket fd: %d...\n", log_time, getpid(), openfd);
-                }
+        //Main listening loop: handle all connections in one event loop
+        if(max_stream_size < -1 || max_file_size < 0) max_stream_size = max_file_size; //default, and without max_file_size all data ends up in the payload anyway
+        struct tcp_worker_conf_t worker_conf = { timeout, data_path, max_file_size, event_ring, "TCP", max_duration, close_size_exceeded, max_stream_size };
+        worker_tcp(listenfd, &worker_conf);
 
-                CHECK(getsockopt(openfd, SOL_IP, SO_ORIGINAL_DST, (struct sockaddr*)&trgaddr, &trgaddr_len), != -1); //Read original dst. port from NAT-table, abort if it fails (may collide with TCP Postprcessor lookup)
-                //retrieve client target IPv4 (important when listening on ANY_ADDR)
-                inet_ntop(AF_INET, &(claddr.sin_addr), clientaddr, sizeof clientaddr);
-                //worker_tcp: Log, save stream, hold connection, timeout and JSON output
-#if DEBUG >= 2
-                fprintf(stderr, "*** DEBUG [PID %d] Accept-Child %s:%d\n", getpid(), inet_ntoa(trgaddr.sin_addr), ntohs(trgaddr.sin_port));
-                fprintf(stderr, "*** DEBUG [PID %d] Accept-Child entering Worker\n", getpid());
-#endif
-                worker_tcp(inet_ntoa(trgaddr.sin_addr), ntohs(trgaddr.sin_port), clientaddr, ntohs(claddr.sin_port),\
-                           timeout, data_path, max_file_size, openfd, confifo, "TCP");
-#if DEBUG >= 2
-                fprintf(stderr, "*** DEBUG [PID %d] Accept-Child left Worker\n", getpid());
-#endif
-                //Shutdown child process
-                close(openfd); //Close connection
-                dict_free(json_dict("false"));
-                pctcp_free_list(pc->portlist);
-#if DEBUG >= 2
-                fprintf(stderr, "*** DEBUG [PID %d] Accept-Child openfd closed, returning.\n", getpid());
-#endif
-                fflush(confifo);
-                kill(getpid(), SIGKILL); //kill child process //exit may hang when used in forged child processes, thus using SIGKILL instead.; //exit(signo); //hangs sometimes under  high load>
-                _exit(0);
-            }
-            fprintf(stderr, "%s [PID %d] Connection No. %ld accepted\n", log_time, getpid(), ++flow_count);
-            close(openfd); //Close connection
-        }
+        //Stopped by SIGTERM or SIGINT, all open connections have been closed
+        time_str(NULL, 0, log_time, sizeof(log_time));
+        fprintf(stderr, "\n%s [PID %d] Listner-Child received Signal %s, shutting down...\n", log_time, getpid(), strsignal(tcp_worker_stop));
+        sig_handler_common();
+        kill(getpid(), SIGKILL); //avoid calling exit() in forked childs, use kill instead!
 
     } else {
+        /*********************************************************************************************************
+         * Start drain thread, writing the events of all childs from the rings to the FIFOs (resp. the pipes to the correlator).
+         * Started after the last child has been forked, so none inherits a FIFO locked by the thread.
+         * Proxys restarted by the watchdog do not touch the FIFOs, see detach_fifos().
+        *********************************************************************************************************/
+
+        event_drain.ring = event_ring;
+        event_drain.output[TCP_RING_HDR] = hdrfifo;
+        event_drain.output[TCP_RING_CON] = confifo;
+        CHECK(event_drain_start(&event_drain), == 0);
+
         sleep(2); //Wait before starting Watchdog
 
         /*********************************************************************************************************
@@ -405,85 +437,65 @@ int main(int argc, char *argv[])
         // Parent Watchdog Loop.
         int stat_pcap = 0;
         int stat_accept = 0;
-        int sem_sval_1 = 0;
-        int sem_sval_2 = 0;
+        const char* const ring_names[] = { "header", "connection" }; //TCP_RING_HDR, TCP_RING_CON
         bool firstrun = true;
-        while (1) {
+        while (!parent_stop) { //set by sig_handler_parent(...)
             gettimeofday(&begin, NULL);
             time_str(NULL, 0, log_time, sizeof(log_time)); //Get Human readable string only for this watchdog cycle
             if (firstrun) fprintf(stderr, "\tSniffer\t\t\t: %d\n\tListner\t\t\t: %d\n", pcap_pid, listner_pid);
+            if (firstrun && corr_pid != 0) fprintf(stderr, "\tCorrelator\t\t: %d\n", corr_pid);
 
             if ( waitpid(pcap_pid, &stat_pcap, WNOHANG) ) {
                 fprintf(stderr, "%s [PID %d] Sniffer (PID %d) crashed. ARE YOU ROOT?", log_time, getpid(), pcap_pid);
-                sig_handler_parent(SIGTERM);
+                parent_stop = SIGTERM;
                 break;
             }
             if ( waitpid(listner_pid, &stat_accept, WNOHANG) ) {
                 fprintf(stderr, "%s [PID %d] Listner (PID %d) crashed. ARE YOU ROOT?", log_time, getpid(), listner_pid);
-                sig_handler_parent(SIGTERM);
+                parent_stop = SIGTERM;
                 break;
             }
-            for (int listenport = 1; listenport <65536; listenport++) {
-                if (firstrun && pc->portmap[listenport]) fprintf(stderr, "\tProxy at Port %d\t: %d\n", listenport, pctcp_get_lport(pc, listenport)->pid);
-
-                if ( pc->portmap[listenport] && waitpid(pctcp_get_lport(pc, listenport)->pid, &stat_accept, WNOHANG) ) {
-                    pid_t old_pid = pctcp_get_lport(pc, listenport)->pid;
-                    if ( !(pctcp_get_lport(pc, listenport)->pid=fork()) ) { //Re-create Reverse Proxy child process and save PID.
-                        sleep(proxy_wait_restart);
-                        pctcp_get_lport(pc, listenport)->pid = getpid(); //update copy of listelemnt in this (forked) copy with own PID, to be able to find own config.
-#if DEBUG >= 2
-                        fprintf(stderr, "%s [PID %d] Starting Proxy on Port %d...\n", log_time, getpid(), listenport);
-#endif
-                        prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
-                        CHECK(signal(SIGTERM, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGTERM for child process
-                        CHECK(signal(SIGINT, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGINT for child process
-                        CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR); //register handler for parents to prevent childs becoming Zombies
-                        CHECK(rsp(pctcp_get_lport(pc, listenport), hostaddr), != 0); //start proxy
-                    }
+            if ( corr_pid != 0 && waitpid(corr_pid, &stat_accept, WNOHANG) ) {
+                fprintf(stderr, "%s [PID %d] Correlator (PID %d) crashed.", log_time, getpid(), corr_pid);
+                parent_stop = SIGTERM;
+                break;
+            }
+            if (firstrun && pc->pid != 0) fprintf(stderr, "\tProxy for %d ports\t: %d\n", pc->num_elements, pc->pid);
+            if ( pc->pid != 0 && waitpid(pc->pid, &stat_accept, WNOHANG) ) {
+                pid_t old_pid = pc->pid;
+                start_proxies(pc, hostaddr, NULL, proxy_wait_restart); //Re-create Reverse Proxy child process for all ports
+                fprintf(stderr, "%s [PID %d] Proxy with PID %d for %d ports exited, restarting in %f seconds with PID %d...\n",\
+                        log_time, getpid(), old_pid, pc->num_elements, proxy_wait_restart, pc->pid);
+            }
+            for (struct proxy_conf_tcp_node_t* pcn = pc->portlist; pcn != NULL; pcn = pcn->next) {
+                if (pcn->pid == 0) continue; //served by the proxy for all ports
+                if (firstrun) fprintf(stderr, "\tProxy at Port %d\t: %d\n", pcn->listenport, pcn->pid);
+
+                if ( waitpid(pcn->pid, &stat_accept, WNOHANG) ) {
+                    pid_t old_pid = pcn->pid;
+                    start_proxies(pc, hostaddr, pcn, proxy_wait_restart); //Re-create Reverse Proxy child process for this port
 
                     fprintf(stderr, "%s [PID %d] Proxy with PID %d, local port: %d -> Backend socket: %s:%d, exited, restarting in %f seconds with PID %d...\n",\
                             log_time,\
                             getpid(),\
                             old_pid,\
-                            pctcp_get_lport(pc, listenport)->listenport,\
-                            pctcp_get_lport(pc, listenport)->backendaddr,\
-                            pctcp_get_lport(pc, listenport)->backendport,\
+                            pcn->listenport,\
+                            pcn->backendaddr,\
+                            pcn->backendport,\
                             proxy_wait_restart,\
-                            pctcp_get_lport(pc, listenport)->pid\
+                            pcn->pid\
                            );
-
-                    usleep(10000); //sleep 10ms, so output is not mangled between forks
                 }
             }
 
 
-            /*
-            If one or more processes or threads are blocked waiting to lock the semaphore with sem_wait(3),
-            POSIX.1-2001 permits two possibilities for the value returned in sval:
-            either 0 is returned; or a negative number whose absolute value is the count of the number of processes and threads
-            currently blocked in sem_wait(3).
-            Linux adopts the former behavior.
-            */
-            //For connection semaphore:
-            sem_getvalue(consem, &sem_sval_1); //Look up number of processes waiting
-            if(sem_sval_1 < 0) { //Test if processe(s) are waiting
-                usleep(20); // needs integer use usleep
-                sem_getvalue(consem, &sem_sval_2); //Look up again after 0.02 sec.
-                if (sem_sval_2 <= sem_sval_1) //Test if Number of processes stayed the same or growed
-                    sem_post(consem); //If so, assume a deadlock situation happend and release one lock
-            }
-            //For header semaphore:
-            sem_getvalue(hdrsem, &sem_sval_1); //Look up number of processes waiting
-            if(sem_sval_1 < 0) { //Test if processe(s) are waiting
-                usleep(20); // needs integer
-                sem_getvalue(hdrsem, &sem_sval_2); //Look up again after 0.02 sec.
-                if (sem_sval_2 <= sem_sval_1) //Test if Number of processes stayed the same or growed
-                    sem_post(hdrsem); //If so, assume a deadlock situation happend and release one lock
-            }
+            //Events are dropped instead of blocking the childs, if the FIFOs are not read fast enough
+            event_ring_log_stats(event_ring, ring_names);
 
             firstrun = false;
-            sleep(2); //Watch for childs every 2 seconds.
+            sleep(2); //Watch for childs every 2 seconds, interrupted by signals
         }
+        parent_shutdown(parent_stop);
     }
 
     return 0;
@@ -876,6 +876,11 @@ def main(argv):
             if key in "group":
                 DEF_GROUP = str(value)
                 eprint("\t" + key + " = " + str(value))
+            if key == "tcp_correlation" and value_list.get('String', {}).get('s') == "true":
+                # The TCP module correlates itself and writes the merged events to the connection FIFO
+                eprint(logtime + " [PID " + str(os.getpid()) + "]" +
+                       " ERROR: tcp_correlation is enabled, SYNs and connections are correlated by the TCP module. Quitting.")
+                sys.exit(-1)
             if key in "best_guess":
                 DEF_BEST_GUESS = bool(value)
                 eprint("\t" + key + " = " + str(value))
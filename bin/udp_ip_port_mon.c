@@ -77,6 +77,7 @@ int main(int argc, char *argv[])
     fprintf(stderr, "\n%s%s\n", MASCOTT, VERSION);
 
     loglevel = 0; //Default Loglevel 0: Standard, 1: Debug
+    output_format = DICT_FORMAT_JSON; //Default JSON output
 
     //get start time
     char log_time[64] = "";
@@ -149,6 +150,10 @@ int main(int argc, char *argv[])
             loglevel = atoi(get_config_opt(luaState, "loglevel")); //convert string type to integer type (loglevel)
         }
         fprintf(stderr, "\tloglevel: %d\n", loglevel);
+        if(strcmp(get_config_opt(luaState, "output_format"), "cbor") == 0) { //if optional parameter is given, set it.
+            output_format = DICT_FORMAT_CBOR;
+        }
+        fprintf(stderr, "\toutput_format: %s\n", output_format == DICT_FORMAT_CBOR ? "cbor" : "json");
 
         if (get_config_table(luaState, "udpproxy", pc) > 0) {
             strncpy(pc->proxy_ip, get_config_opt(luaState, "udpproxy_tobackend_addr"), sizeof(pc->proxy_ip));
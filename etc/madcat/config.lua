@@ -36,6 +36,9 @@
 loglevel = "2" --optional: loglevel (0: Default logging no source IPs to stderr, 1: Full logging, >=2: Debug)
 user = "madcat" --user to drop privileges to.
 group = "madcat" --group is only needed by python modules
+--output_format = "json" --optional: format of event output of TCP-, UDP-, ICMP- and RAW-Module, "json" (default) or "cbor".
+-- "cbor" writes binary CBOR (RFC 8949) events as CBOR sequence with raw payload bytes and w/o hexdump to the outputs resp. FIFOs, and consumers have to decode it.
+-- The TCP-Module omits its JSON log lines to STDOUT in this case.
 --TCPv4 configuration
 hostaddress = "192.168.2.55" --address to listen on
 --TCPv6 configuration
@@ -45,6 +48,20 @@ hostaddress = "192.168.2.55" --address to listen on
 interface = "enp92s0" --interface to listen on, choose loopback device for local test, even on external IP
 tcp_listening_port = "65535" --TCP-Port to listen on
 tcp_connection_timeout = "5" --Timout for TCP-Connections
+--tcp_connection_max_duration = "300" --optional: Maximum duration of TCP-Connections in seconds, even if data is still received. Defaults to "0" (unlimited).
+--tcp_close_size_exceeded = "false" --optional: Close TCP-Connections as soon as max_file_size has been exceeded, "true" or "false" (default: wait for timeout).
+--tcp_correlation = "false" --optional: Match SYNs and connections in the TCP module and write the merged events to the connection FIFO, instead of tcp_ip_port_mon_postprocessor.py, "true" or "false" (default). Uses con_wait, syn_timeout and syn_wait_proxy below. The merged events have the format of the postprocessor's output, so the connection FIFO is piped to madcatlog_fifo instead of starting the postprocessor, which quits if this is enabled (see scripts/run_madcat.sh).
+--tcp_listening_workers = "1" --optional: Number of listening processes, each one accepting connections on its own SO_REUSEPORT socket. More than one are supervised by an additional process, which restarts them if they exit.
+--tcp_listening_backlog = "4096" --optional: Backlog of each listening socket, defaults to SOMAXCONN.
+--tcp_listening_cpus = "0,1,2,3" --optional: Comma separated list of CPUs, the listening processes are pinned to in turn.
+--pcap_snaplen = "8192" --optional: Snapshot length of the TCP-SYN sniffer, defaults to BUFSIZ.
+--pcap_buffer_size = "16777216" --optional: Capture buffer size of the TCP-SYN sniffer in bytes, defaults to libpcap default (2MB on Linux). Increase if pcap drops are logged.
+--pcap_immediate = "false" --optional: Deliver TCP-SYNs to the sniffer without buffering delay, "true" or "false" (default).
+-- The sniffer logs received and dropped packet counters of libpcap every 60 seconds.
+--Capture backend of the TCP-SYN sniffer and the RAW module, both apply pcap_snaplen, pcap_buffer_size and pcap_immediate:
+--capture_backend = "pcap" --optional: "pcap" (default) or "afpacket" for a native AF_PACKET TPACKET_V3 mmap ring (Linux), the pcap filter expressions still apply.
+--capture_workers = "1" --optional: Number of capturing processes for "afpacket", sharing the interface in a PACKET_FANOUT group.
+--capture_fanout = "1042" --optional: PACKET_FANOUT group id (1-65535) for "afpacket", e.g. to share one interface with other instances. Defaults to a group id unique to this instance, if capture_workers > 1.
 
 --LEGACY v1: Paths for Files containing Payload: Must end with trailing "/", will be handled as prefix otherwise.
 -- RAW Module does not save files, beacause it is not a legacy module.
@@ -52,10 +69,14 @@ path_to_save_tcp_streams = "/data/tpm/"
 path_to_save_udp_data = "/data/upm/"
 path_to_save_icmp_data = "/data/ipm/"
 --max_file_size = "10000" --optional: Max. Size for payloads to be saved as file or jsonized.
+--tcp_max_stream_size = "10000000" --optional: Max. Size of TCP stream files (.tpm). Data beyond max_file_size is only written to the file, without copying it (splice), "-1" for unlimited. Defaults to max_file_size. Stream data is written in batches of 64 KiB, smaller ones within 1 s, and on close resp. shutdown (SIGTERM).
 bufsize = "16384" --optional: Receiving Buffer size for UDP or ICMP Module
 udpproxy_connection_timeout = "5" --Timeout for UDP "Connections". Optional.
 
 proxy_wait_restart = "2" --optional: time to wait before a crashed TCP proxy restarts, e.g. because backend has failed
+--proxy_single_process = "false" --optional: One TCP proxy process serves all ports of tcpproxy, instead of one process per port, "true" or "false" (default).
+--proxy_epoll_events = "64" --optional: Max. number of events a TCP proxy handles per call to epoll_wait, defaults to 64.
+--proxy_splice = "false" --optional: TCP proxies forward data between client and backend by splice(2) without copying it, "true" or "false" (default).
 
 --Optional filter expresion for RAW module, defaults to none (empty string).
 --Syntax: https://www.tcpdump.org/manpages/pcap-filter.7.html
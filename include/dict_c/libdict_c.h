@@ -28,6 +28,26 @@
 //Enable or disable dynamic path update capability
 #define DICT_DYN_PATH_UPDATES 1
 
+//Number of elements in one object, above which a hash index is build for key lookups
+#define DICT_INDEX_THRESHOLD 8
+//Initial number of slots of a hash index; must be a power of 2
+#define DICT_INDEX_MIN_SIZE 32
+
+//Enable or disable arena allocation for the static dict of json_dict(...)
+#define DICT_JSON_DICT_ARENA 1
+//Size of one arena chunk in bytes; larger allocations get a chunk of their own
+#define DICT_ARENA_CHUNK_SIZE 65536
+//Alignment of arena allocations, suitable for all members of union json_type
+#define DICT_ARENA_ALIGN 16
+
+//Initial size of a struct dict_buffer in bytes and number of levels of its nesting stack
+#define DICT_BUFFER_MIN_SIZE 1024
+#define DICT_BUFFER_MIN_DEPTH 16
+
+//Output formats of struct dict_buffer, used by dict_emit_*(...)
+#define DICT_FORMAT_JSON 0
+#define DICT_FORMAT_CBOR 1 //Binary format as of RFC 8949, objects and arrays are of indefinite length
+
 /**
  * \brief Constants for type definition in JSON-Dictionaries and -Arrays
  *
@@ -52,6 +72,8 @@
 #define JSON_FLOAT 31 //Double type in C
 #define JSON_HEX 32 //Hex is an long int put out as String with %x
 #define JSON_STR 40
+#define JSON_STR_REF 41 //Input type only: string is referenced, not copied. Stored as JSON_STR.
+#define JSON_STR_OWN 42 //Input type only: ownership of a malloc'd string is taken over. Stored as JSON_STR.
 #define JSON_ARRAY 50
 #define JSON_OBJ 60
 
@@ -85,6 +107,22 @@
 #define HEX_FORMAT_05  3
 #define HEX_FORMAT_08  4
 
+/**
+ * \brief Storage modes of strings
+ *
+ *     Strings are added to dicts and arrays as JSON_STR (copied), JSON_STR_REF (referenced) or JSON_STR_OWN (taken over).
+ *     The element is always of type JSON_STR afterwards, the way its string has to be released is stored as one of the DICT_STR_* constants.
+ *
+ *     DICT_STR_COPY: string has been copied and is released with the element.
+ *     DICT_STR_REF: string belongs to the calling function and is never released by libdict_c.
+ *                   It must stay valid until the element has been dumped and emptied, resp. its dict has been freed or reset.
+ *     DICT_STR_OWN: malloc'd string has been taken over and is freed with the element,
+ *                   resp. by dict_arena_reset(...) if the element is allocated from an arena.
+ */
+#define DICT_STR_COPY 0 //DICT_STR_COPY is 0, so memset to 0 works as if set to DICT_STR_COPY.
+#define DICT_STR_REF  1
+#define DICT_STR_OWN  2
+
 /**
  * \brief Representation of JSON-Types
  *
@@ -105,21 +143,103 @@ union json_type {
     struct dict* object;
 };
 
+/**
+ * \brief Chunk of memory of an arena
+ *
+ *     -next is the pointer to maintain the linked list of chunks
+ *     -size size of the usable memory following this header
+ *     -used number of bytes handed out from this chunk
+ *
+ */
+struct dict_arena_chunk {
+    struct dict_arena_chunk* next;
+    size_t size;
+    size_t used;
+};
+
+/**
+ * \brief Arena (bump) allocator for dicts and arrays
+ *
+ *     All elements, keys and strings of dicts and arrays created by dict_new_arena(...) or array_new_arena(...)
+ *     are taken from the arena and are not freed one by one, but all at once by dict_arena_reset(...).
+ *
+ *     -chunks list of chunks of size chunk_size, kept for reuse after a reset
+ *     -current chunk allocations are taken from
+ *     -large list of chunks for allocations larger than chunk_size, freed on reset
+ *     -chunk_size size of regular chunks
+ *     -owned malloc'd strings taken over by JSON_STR_OWN, freed on reset
+ *     -owned_count number of strings in owned
+ *     -owned_size allocated number of entries in owned
+ *
+ */
+struct dict_arena {
+    struct dict_arena_chunk* chunks;
+    struct dict_arena_chunk* current;
+    struct dict_arena_chunk* large;
+    size_t chunk_size;
+    void** owned;
+    size_t owned_count;
+    size_t owned_size;
+};
+
+/**
+ * \brief Slot of a hash index
+ *
+ *     -hash stores the hash of the key, so slots can be moved without touching the element
+ *     -element is the indexed element, NULL if slot is free
+ *
+ */
+struct dict_index_slot {
+    unsigned int hash;
+    struct dict* element;
+};
+
+/**
+ * \brief Hash index over the keys of one dictonary object
+ *
+ *     Open adressing hash table with linear probing, mapping keys to elements of the linked list.
+ *     It is only an accelerator for lookups, the linked list stays the authoritive storage,
+ *     thus insertion order and output of the dictonary are not affected.
+ *
+ *     -size number of slots, always a power of 2
+ *     -count number of used slots
+ *     -slots the slots
+ *     -arena the arena the index is allocated from, NULL if allocated on the heap
+ *
+ */
+struct dict_index {
+    size_t size;
+    size_t count;
+    struct dict_index_slot* slots;
+    struct dict_arena* arena;
+};
+
 /**
  * \brief Element of a dictonary as double linked list
  *
  *     -next and prev are the pointers to maintain the linked list
  *     -type stores the data-type, stored in value
+ *     -str_mode stores how a string value has to be released, using DICT_STR_* constants
  *     -value stores the data
  *     -key stores the dictonary key, which is always a string in JSON.
+ *     -index stores the hash index of the object, if it has grown beyond DICT_INDEX_THRESHOLD elements.
+ *      Only the first element of an object carries the index, on all other elements it is NULL.
+ *     -tail stores the last element of the object for appending in constant time.
+ *      Like the index, only the first element of an object carries it, on all other elements it is NULL.
+ *     -arena stores the arena the element, its key and string value are allocated from, NULL if allocated on the heap.
+ *      Elements added to the dict are allocated the same way.
  *
  */
 struct dict {
     struct dict* next;
     struct dict* prev;
     __uint8_t type;
+    __uint8_t str_mode; //Use DICT_STR_* constants!
     char* key;
     union json_type value;
+    struct dict_index* index;
+    struct dict* tail;
+    struct dict_arena* arena;
 };
 
 /**
@@ -127,13 +247,103 @@ struct dict {
  *
  *     -next is the pointer to maintain the linked list
  *     -type stores the data-type, stored in value
+ *     -str_mode stores how a string value has to be released, using DICT_STR_* constants
  *     -value stores the data
+ *     -tail stores the last element of the array for appending in constant time.
+ *      Only the first element of an array carries it, on all other elements it is NULL.
+ *     -arena stores the arena the element and its string value are allocated from, NULL if allocated on the heap.
+ *      Elements added to the array are allocated the same way.
  *
  */
 struct array {
     struct array* next;
     __uint8_t type;
+    __uint8_t str_mode; //Use DICT_STR_* constants!
     union json_type value;
+    struct array* tail;
+    struct dict_arena* arena;
+};
+
+/**
+ * \brief Nesting level of a dict or array during serialization
+ *
+ *     -dict next element to serialize, if is_array is false
+ *     -array next element to serialize, if is_array is true
+ *     -is_array type of the nested structure
+ *     -sep a separator has to follow, when the nested structure opened at this level is closed
+ *
+ */
+struct dict_dump_frame {
+    struct dict* dict;
+    struct array* array;
+    bool is_array;
+    bool sep;
+};
+
+/**
+ * \brief Reusable, growable output buffer for dict_dumpbuf(...) and array_dumpbuf(...)
+ *
+ *     A buffer initialized to 0, e.g. static struct dict_buffer output = {0}; is ready to use.
+ *     Memory is kept between dumps and only freed by dict_buffer_free(...).
+ *
+ *     -data resulting JSON string, \0 terminated
+ *     -len length of the resulting JSON string
+ *     -size allocated size of data
+ *     -stack nesting stack used for serialization
+ *     -stack_size allocated number of levels in stack
+ *     -format DICT_FORMAT_JSON (default) or DICT_FORMAT_CBOR, output format of dict_emit_*(...)
+ *
+ */
+struct dict_buffer {
+    char* data;
+    size_t len;
+    size_t size;
+    struct dict_dump_frame* stack;
+    size_t stack_size;
+    __uint8_t format;
+};
+
+/**
+ * \brief Parent path shared by compiled paths
+ *
+ *     Compiled paths with the same parent path, e.g. "TCP","seq" and "TCP","ack", share one struct dict_path_parent,
+ *     so the parent is searched only once per event and all other updates below it skip the search.
+ *
+ *     -next is the pointer to maintain the list of all parent paths
+ *     -refs number of compiled paths sharing this parent path
+ *     -path_len number of keys in keys
+ *     -keys keys of the parent path
+ *     -root dict element has been resolved in
+ *     -generation generation of dicts element has been resolved in, see dict_set_path(...)
+ *     -element resolved element of type JSON_OBJ, NULL if not resolved
+ *
+ */
+struct dict_path_parent {
+    struct dict_path_parent* next;
+    unsigned int refs;
+    unsigned int path_len;
+    char** keys;
+    struct dict* root;
+    unsigned long int generation;
+    struct dict* element;
+};
+
+/**
+ * \brief Path precompiled by dict_path_compile(...) for use with dict_set_path(...)
+ *
+ *     -parent shared parent path, NULL if the path consists of one key only
+ *     -key last key of the path
+ *     -root dict element has been resolved in
+ *     -generation generation of dicts element has been resolved in, see dict_set_path(...)
+ *     -element element updated last time, NULL if not resolved
+ *
+ */
+struct dict_path {
+    struct dict_path_parent* parent;
+    char* key;
+    struct dict* root;
+    unsigned long int generation;
+    struct dict* element;
 };
 
 //Function Declarations
@@ -155,6 +365,9 @@ char* json_typetostr(int json_type);
  *     Not necessary, but useful function to avoid the use of global vars.
  *     To free the static dict of this function and get a new dict set reset to true.
  *     To get the static dict w/o reset, set reset to false.
+ *     If DICT_JSON_DICT_ARENA is enabled, the static dict is allocated from an arena, which is just rewound on reset.
+ *     In this case nested dicts and arrays must be created by dict_new_arena(json_dict(false)->arena), resp.
+ *     array_new_arena(json_dict(false)->arena), and no content of the dict must be used after the next reset.
  *     To free the static dict of this function use:
  *     dict_free(json_dict(false));
  * 
@@ -202,6 +415,72 @@ void array_printelement(FILE* fp, struct array* array);
  */
 struct dict* dict_new();
 
+/**
+ * \brief Initializes a new dictionary of type struct dict allocated from an arena
+ *
+ *     Same as dict_new(), but the dictionary and all elements, keys and strings added to it later on,
+ *     are allocated from arena. If arena is NULL, the heap is used, thus it is equal to dict_new().
+ *     dict_free(...) may be used on such a dictionary, but the memory is only released by dict_arena_reset(...).
+ *
+ * \param arena arena to allocate from, NULL for heap
+ * \return initialized, new dictionary
+ *
+ */
+struct dict* dict_new_arena(struct dict_arena* arena);
+
+/**
+ * \brief Initializes a new array of type struct array allocated from an arena
+ *
+ *     Same as array_new(), but the array and all elements and strings added to it later on,
+ *     are allocated from arena. If arena is NULL, the heap is used, thus it is equal to array_new().
+ *
+ * \param arena arena to allocate from, NULL for heap
+ * \return initialized, new array
+ *
+ */
+struct array* array_new_arena(struct dict_arena* arena);
+
+/**
+ * \brief Creates a new arena
+ *
+ * \param chunk_size size of regular chunks in bytes, e.g. DICT_ARENA_CHUNK_SIZE
+ * \return new arena, NULL in case of an error
+ *
+ */
+struct dict_arena* dict_arena_new(size_t chunk_size);
+
+/**
+ * \brief Allocates memory from an arena
+ *
+ *     Memory is aligned to DICT_ARENA_ALIGN and is valid until the next dict_arena_reset(...).
+ *     If arena is NULL, memory is allocated on the heap and has to be freed by calling function.
+ *
+ * \param arena arena to allocate from, NULL for heap
+ * \param size number of bytes to allocate
+ * \return address of allocated memory, NULL in case of an error
+ *
+ */
+void* dict_arena_alloc(struct dict_arena* arena, size_t size);
+
+/**
+ * \brief Rewinds an arena
+ *
+ *     All memory allocated from the arena is released at once, regular chunks are kept for reuse.
+ *     Any dict or array allocated from the arena must not be used afterwards.
+ *
+ * \param arena arena to rewind
+ *
+ */
+void dict_arena_reset(struct dict_arena* arena);
+
+/**
+ * \brief Frees an arena and all memory allocated from it
+ *
+ * \param arena arena to free
+ *
+ */
+void dict_arena_free(struct dict_arena* arena);
+
 /**
  * \brief Initializes a new array of type struct array
  *
@@ -219,7 +498,10 @@ struct array* array_new();
  *
  *     Adds an element to an array with type as defined by JSON_* defines.
  *     The value is taken from a union json_type.
+ *     Strings are copied, referenced or taken over as given by JSON_STR, JSON_STR_REF or JSON_STR_OWN, see dict_update(...).
  *     Returns the address of the added element
+ *     array has to be the first element of the array, because it keeps track of the last element,
+ *     so appending takes constant time.
  *     
  * \param array struct array to add new element to
  * \param type data type of new element
@@ -236,6 +518,8 @@ struct array* array_add(struct array* array, __uint8_t type, union json_type val
  *     The value is taken from a union json_type.
  *     Returns the address of the added element and NULL in case of an error.
  *     If updating the dict with a string, the string is copied, so it eventually has to be freed in calling function.
+ *     To avoid the copy, use JSON_STR_REF to reference the string, which then must stay valid until the dict has been dumped and reset,
+ *     or JSON_STR_OWN to hand over a malloc'd string, which then must not be freed by calling function, even if updating fails.
  *     If updating the dict with a nested dict or array, you must not free it, but have to deal with it eventually if updating fails.
  * 
  *     If the new element does not exist in path, it will be added, example:
@@ -293,10 +577,65 @@ struct array* array_add(struct array* array, __uint8_t type, union json_type val
  */
 struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type value, unsigned int path_len, ...);
 
+/**
+ * \brief Precompiles a constant path for dict_set_path(...)
+ *
+ *     The keys are copied, so the path does not depend on the memory of the calling function.
+ *     Paths with the same parent path share its cached resolution, thus setting e.g. "TCP","seq"
+ *     and "TCP","ack" searches "TCP" only once per event.
+ *
+ * \param path_len length of variadic list, specifiying the path
+ * \param path variadict list specifiyng the path
+ * \return compiled path, NULL in case of an error
+ *
+ */
+struct dict_path* dict_path_compile(unsigned int path_len, ...);
+
+/**
+ * \brief Updates a dictionary with a new element, using a precompiled path
+ *
+ *     Same as dict_update(...), but the element and its parent resolved by the last call are cached in path.
+ *     As long as no element has been released from any dict since then (e.g. by dict_free(...), dict_del(...)
+ *     or resetting json_dict(...)), the update is done in place without any search.
+ *     Otherwise only the last key is searched in the cached parent, resp. the path is resolved again.
+ *
+ * \param dict struct dict to update with new element
+ * \param path path precompiled by dict_path_compile(...)
+ * \param type data type of new element
+ * \param value value of the new element, given as union json_type
+ * \return Address of added element, NULL in case of an error
+ *
+ */
+struct dict* dict_set_path(struct dict* dict, struct dict_path* path, __uint8_t type, union json_type value);
+
+/**
+ * \brief Frees a path compiled by dict_path_compile(...)
+ *
+ * \param path path to free
+ *
+ */
+void dict_path_free(struct dict_path* path);
+
+/**
+ * \brief Updates a dictionary using a path, which is compiled once per call site
+ *
+ *     Drop-in replacement of dict_update(...) as a statement for paths consisting of constant keys only,
+ *     e.g. DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "TCP", "seq");
+ *     The path is compiled by dict_path_compile(...) on first use and kept in a static variable of the call site.
+ *
+ */
+#define DICT_SET_PATH(dict, type, value, path_len, ...) do { \
+        static struct dict_path* __dict_path = NULL; \
+        if(__dict_path == NULL) __dict_path = dict_path_compile(path_len, __VA_ARGS__); \
+        dict_set_path(dict, __dict_path, type, value); \
+    } while(0)
+
 /**
  * \brief Internal function to add a value to a dictonary
  *
  *     Internal function to add a value to a dictonary without descending in nested dictionaries ("plain")
+ *     dict has to be the first element of the dictonary or an element of type JSON_EMPTY beeing reused,
+ *     because the hash index of the dictonary is maintained by its first element.
  *     
  * \param dict struct dict to add element to
  * \param type data type of new element
@@ -330,6 +669,180 @@ void dict_dump(FILE* fp, struct dict* dict);
  */
 char* dict_dumpstr(struct dict* dict);
 
+/**
+ * \brief Dumps a dictonary as JSON to a reusable buffer
+ *
+ *     Dumps a dictonary, descending in dict/array structures as JSON, into buf.
+ *     The output is the same as of dict_dumpstr(...), but buf is reused and not allocated anew on each call.
+ *     The JSON string is found in buf->data and stays valid until the next dump to buf.
+ *     Example:
+ *          static struct dict_buffer output = {0};
+ *          if(dict_dumpbuf(&output, json_dict(false)) > 2) //do not print empty JSON-Objects
+ *              fprintf(stdout, "%s\n", output.data);
+ *     
+ * \param buf buffer to dump to, previous content is overwritten
+ * \param dict address of struct dict to dump
+ * \return length of the resulting JSON string
+ *
+ */
+size_t dict_dumpbuf(struct dict_buffer* buf, struct dict* dict);
+
+/**
+ * \brief Dumps an array as JSON to a reusable buffer
+ *
+ *     Same as dict_dumpbuf(...), but for a struct array.
+ *     
+ * \param buf buffer to dump to, previous content is overwritten
+ * \param array address of struct array to dump
+ * \return length of the resulting JSON string
+ *
+ */
+size_t array_dumpbuf(struct dict_buffer* buf, struct array* array);
+
+/**
+ * \brief Dumps a dictonary as CBOR to a reusable buffer
+ *
+ *     Same as dict_dumpbuf(...), but the output is binary CBOR (RFC 8949) instead of JSON text,
+ *     thus it is not \0 terminated and may contain \0 bytes, use the returned length.
+ *     Integers and floating point numbers are encoded natively, hex numbers (JSON_HEX) as unsigned integers.
+ *     Objects and arrays are encoded with indefinite length. Concatenated outputs form a CBOR sequence (RFC 8742).
+ *     Example:
+ *          static struct dict_buffer output = {0};
+ *          size_t len = dict_dump_cbor(&output, json_dict(false));
+ *          if(len > 2) //do not print empty objects
+ *              fwrite(output.data, 1, len, stdout);
+ *
+ * \param buf buffer to dump to, previous content is overwritten
+ * \param dict address of struct dict to dump
+ * \return length of the resulting CBOR data
+ *
+ */
+size_t dict_dump_cbor(struct dict_buffer* buf, struct dict* dict);
+
+/**
+ * \brief Frees the memory of a buffer
+ *
+ *     Frees the memory of buf, the struct itself is not freed, but reset to 0 and ready for reuse.
+ *     
+ * \param buf buffer to free
+ *
+ */
+void dict_buffer_free(struct dict_buffer* buf);
+
+/**
+ * \brief Starts writing a JSON object directly to a reusable buffer
+ *
+ *     The dict_emit_* functions write JSON straight into a struct dict_buffer without building a dict first,
+ *     e.g. for events of a fixed structure, which are kept in plain C structs.
+ *     Members are separated automatically. Output is formatted the same way as by dict_dumpbuf(...).
+ *     Example:
+ *          dict_emit_begin(&output);
+ *          dict_emit_str(&output, "origin", "MADCAT");
+ *          dict_emit_object(&output, "FLOW");
+ *          dict_emit_int(&output, "bytes_toserver", 42);
+ *          dict_emit_object_end(&output);
+ *          if(dict_emit_end(&output) > 2) //do not print empty JSON-Objects
+ *              fprintf(stdout, "%s\n", output.data);
+ *     Results in:
+ *     {"origin":"MADCAT", "FLOW":{"bytes_toserver":42}}
+ *
+ *     If buf->format is set to DICT_FORMAT_CBOR, the same calls result in CBOR, see dict_dump_cbor(...).
+ *
+ * \param buf buffer to write to, previous content is overwritten
+ *
+ */
+void dict_emit_begin(struct dict_buffer* buf);
+
+/**
+ * \brief Finishes writing a JSON object started by dict_emit_begin(...)
+ *
+ * \param buf buffer to write to
+ * \return length of the resulting JSON string in buf->data
+ *
+ */
+size_t dict_emit_end(struct dict_buffer* buf);
+
+/**
+ * \brief Opens a nested JSON object with name key, to be closed by dict_emit_object_end(...)
+ *
+ * \param buf buffer to write to
+ * \param key key of the nested object
+ *
+ */
+void dict_emit_object(struct dict_buffer* buf, const char* key);
+
+/**
+ * \brief Closes a nested JSON object opened by dict_emit_object(...)
+ *
+ * \param buf buffer to write to
+ *
+ */
+void dict_emit_object_end(struct dict_buffer* buf);
+
+/**
+ * \brief Writes a member of type JSON_STR, JSON_INT, JSON_FLOAT, JSON_HEX resp. JSON_BOOL
+ *
+ *     The value is written in the same format as by dict_dumpbuf(...), thus the string is not escaped.
+ *
+ * \param buf buffer to write to
+ * \param key key of the member
+ * \param value value of the member, resp. number and format for dict_emit_hex(...)
+ *
+ */
+void dict_emit_str(struct dict_buffer* buf, const char* key, const char* value);
+void dict_emit_int(struct dict_buffer* buf, const char* key, long long int value);
+void dict_emit_float(struct dict_buffer* buf, const char* key, long double value);
+void dict_emit_hex(struct dict_buffer* buf, const char* key, unsigned long int number, __uint8_t format);
+void dict_emit_bool(struct dict_buffer* buf, const char* key, bool value);
+
+/**
+ * \brief Writes binary data as member
+ *
+ *     Binary data is written as byte string in CBOR, resp. as string of lower case hex digits in JSON,
+ *     e.g. "dead00" for the bytes 0xde, 0xad, 0x00.
+ *
+ * \param buf buffer to write to
+ * \param key key of the member
+ * \param data binary data
+ * \param len length of data in bytes
+ *
+ */
+void dict_emit_bytes(struct dict_buffer* buf, const char* key, const unsigned char* data, size_t len);
+
+/**
+ * \brief Writes a dictonary as member of type JSON_OBJ
+ *
+ * \param buf buffer to write to
+ * \param key key of the member
+ * \param dict dictonary to write, e.g. optional sub-objects build dynamicly
+ *
+ */
+void dict_emit_dict(struct dict_buffer* buf, const char* key, struct dict* dict);
+
+/**
+ * \brief Writes all elements of a dictonary as members of the current object
+ *
+ *     Nothing is written, if dict is NULL or empty.
+ *
+ * \param buf buffer to write to
+ * \param dict dictonary, whose elements are written
+ *
+ */
+void dict_emit_members(struct dict_buffer* buf, struct dict* dict);
+
+/**
+ * \brief Writes all members of an already serialized object as members of the current object
+ *
+ *     E.g. for parts of events, which have been written by another process in the same format.
+ *     Nothing is written, if data is NULL or the object is empty.
+ *
+ * \param buf buffer to write to
+ * \param data object, as written by dict_dumpbuf(...), dict_dump_cbor(...) resp. dict_emit_begin(...) and dict_emit_end(...)
+ * \param len length of data in bytes
+ *
+ */
+void dict_emit_raw_members(struct dict_buffer* buf, const char* data, size_t len);
+
 /**
  * \brief Internal function to recursivly print a dict structure
  *
@@ -410,6 +923,8 @@ struct dict* dict_get(struct dict* dict, int path_len, ...);
  *
  *     Internal Function to get an element without descending in nested dict/array structures ("plain search")
  *     Be aware if searching for nested dicts or arrays, you have to descend manually, example:
+ *     If dict is the first element of an object carrying a hash index, the index is used for the lookup.
+ *     In this case prev_dict is not touched, if key is not found.
  *     
  * \param dict struct dict to get element from
  * \param key key to search for
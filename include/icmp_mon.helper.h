@@ -38,6 +38,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "icmp_mon.h"
 #include "madcat.helper.h"
+#include "madcat.events.h"
 #include "udp_ip_port_mon.icmp_mon.helper.h"
 
 //Helper Functions:
@@ -43,7 +43,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 /**
   * \brief Handels incoming ICMP Datagramms
   *
-  *     Handels ICMP Datagramms
+  *     Handels ICMP Datagramms and prints the resulting JSON output to STDOUT
   *
   * \param buffer Pointer to the raw packet data
   * \param recv_len length of raw packet data
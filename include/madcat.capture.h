@@ -0,0 +1,154 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP- and RAW monitor packet capture headerfile.
+ *
+ * Packets are either captured by libpcap or by a native AF_PACKET socket
+ * with a TPACKET_V3 memory mapped RX ring, where the kernel hands over whole blocks of packets,
+ * which are passed to the same pcap_handler callbacks without copying.
+ * Several workers may share one interface by joining a PACKET_FANOUT group.
+ *
+ * BSI 2018-2023
+*/
+
+
+#ifndef MADCAT_CAPTURE_H
+#define MADCAT_CAPTURE_H
+
+#include "madcat.common.h"
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#define CAPTURE_PCAP 0 //Capture by libpcap (default)
+#define CAPTURE_AFPACKET 1 //Capture by AF_PACKET TPACKET_V3 RX ring
+
+#define CAPTURE_BLOCK_SIZE (1 << 20) //Size of one ring block in bytes, a multiple of the page size
+#define CAPTURE_BLOCK_NR 4 //Number of ring blocks, if no buffer size is configured
+#define CAPTURE_FRAME_SIZE 2048 //Nominal frame size of the ring, TPACKET_V3 packs frames of variable size into blocks
+#define CAPTURE_TIMEOUT 100 //Time in ms after which the kernel retires a partially filled block, resp. poll(...) returns
+
+struct capture_conf_t { //Capture settings, read by capture_config(...)
+    int backend; //CAPTURE_PCAP or CAPTURE_AFPACKET
+    int snaplen; //Snapshot length
+    int buffer_size; //Capture buffer size in bytes, 0 for the default of libpcap resp. CAPTURE_BLOCK_NR blocks
+    bool immediate; //Deliver packets as soon as they arrive
+    int fanout; //PACKET_FANOUT group id, 0 for none
+    int workers; //Number of capturing processes sharing the fanout group
+};
+
+struct capture_t { //Capture handle for both backends
+    int backend; //CAPTURE_PCAP or CAPTURE_AFPACKET
+    pcap_t* pcap; //libpcap handle, if backend is CAPTURE_PCAP
+    int fd; //AF_PACKET socket, if backend is CAPTURE_AFPACKET
+    unsigned char* ring; //Memory mapped RX ring
+    unsigned int block_size; //Size of one block in the ring
+    unsigned int block_nr; //Number of blocks in the ring
+    unsigned int block_idx; //Next block to be read
+    struct pcap_stat stats; //Accumulated statistics, the kernel resets its counters on every read
+};
+
+/**
+ * \brief Reads capture configuration
+ *
+ *     Reads the optional capture settings capture_backend ("pcap" or "afpacket"),
+ *     capture_fanout, capture_workers, pcap_snaplen, pcap_buffer_size and pcap_immediate
+ *     from the parsed config file and prints them to STDERR.
+ *     Settings not present in the config file keep the values in conf.
+ *
+ * \param L Lua state of the parsed config file
+ * \param conf Capture settings, initialized with defaults by the caller
+ * \return void
+ *
+ */
+void capture_config(lua_State* L, struct capture_conf_t* conf);
+
+/**
+ * \brief Initializes AF_PACKET capture
+ *
+ *     Opens an AF_PACKET socket on a TPACKET_V3 RX ring for dev.
+ *     filter_exp is compiled by libpcap for Ethernet and attached as socket filter,
+ *     before the socket is bound to dev, so no unfiltered packets reach the ring.
+ *     If conf->fanout is not 0, the socket joins this PACKET_FANOUT group,
+ *     load balanced by flow hash.
+ *     Returns 0 on succes, otherwise returns:
+ *     -1: socket failed
+ *     -2: pcap_compile failed
+ *     -3: attaching the filter failed
+ *     -4: setting up the ring failed
+ *     -5: bind failed, e.g. unknown dev
+ *     -6: joining the fanout group failed
+ *
+ * \param cap Capture handle to be initialized
+ * \param dev Name of the device to capture on
+ * \param filter_exp Filter expression, may be empty
+ * \param conf Capture settings
+ * \return 0 und success, <0 if an error occured
+ *
+ */
+int init_afpacket(struct capture_t* cap, const char* dev, const char* filter_exp, const struct capture_conf_t* conf);
+
+/**
+ * \brief Processes captured packets
+ *
+ *     Same as pcap_dispatch(3PCAP) with cnt = -1 for both backends:
+ *     Waits up to CAPTURE_TIMEOUT ms for packets and calls callback for every
+ *     packet of one pcap buffer resp. one ring block.
+ *     The packet data passed to callback is only valid during the call.
+ *
+ * \param cap Capture handle
+ * \param callback Callback for every packet
+ * \param user Passed to callback
+ * \return Number of processed packets, PCAP_ERROR in case of an error
+ *
+ */
+int capture_dispatch(struct capture_t* cap, pcap_handler callback, u_char* user);
+
+/**
+ * \brief Returns capture statistics
+ *
+ *     Same as pcap_stats(3PCAP) for both backends.
+ *     For AF_PACKET, ps_ifdrop is always 0.
+ *
+ * \param cap Capture handle
+ * \param ps Statistics
+ * \return 0 on success, -1 in case of an error
+ *
+ */
+int capture_stats(struct capture_t* cap, struct pcap_stat* ps);
+
+/**
+ * \brief Closes capture
+ *
+ * \param cap Capture handle
+ * \return void
+ *
+ */
+void capture_close(struct capture_t* cap);
+
+#endif
@@ -109,6 +109,7 @@ Features enabled by compiler options are not overridden by feature test macros
 //pseudo constant empty string e.g. for initialization of json_data_node_t and checks. Not used #define here, because this would lead to several instances of an empty constant string with different addresses.
 extern char EMPTY_STR[1];
 extern int loglevel; //Default Loglevel 0 logging no IPs to stderr, 1: Full logging
+extern __uint8_t output_format; //Format of event output, DICT_FORMAT_JSON (Default) or DICT_FORMAT_CBOR
 extern uint64_t sessionkey; //Sessionkey is used e.g. in UDP Module to mask IDs GDPR conformant if loglevel == 0.
 extern union json_type json_value; //union to fill dictionaries with appropriate values
 
@@ -0,0 +1,242 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-, UDP-, ICMP- and RAW monitor event definitions headerfile.
+ *
+ * Every event type MADCAT emits has a fixed structure, thus it is kept in a plain C struct
+ * and written to JSON by a serializer specialized for exactly this structure,
+ * instead of building a libdict_c tree for every event.
+ * libdict_c is still used for dynamic parts, e.g. the IP-, TCP- or UDP-Headers incl. their options.
+ *
+ * BSI 2018-2023
+*/
+
+
+#ifndef MADCAT_EVENTS_H
+#define MADCAT_EVENTS_H
+
+#include "madcat.common.h"
+
+//TCP-SYN event of the TCP monitor, printed as "HEADER"
+struct tcp_syn_event_t {
+    char* timestamp;
+    long double unixtime;
+    int data_bytes; //eventually exisiting data bytes in SYN
+    struct dict* headers; //IP- and TCP-Header, as parsed by analyze_ip_header(...) and analyze_tcp_header(...)
+};
+
+//TCP flow of the TCP monitor, printed as "CONNECTION"
+struct tcp_flow_event_t {
+    const char* src_ip;
+    int dest_port;
+    const char* timestamp;
+    const char* dest_ip;
+    int src_port;
+    const char* proto;
+    long double unixtime;
+    //FLOW
+    const char* start;
+    const char* end;
+    long double duration;
+    long double min_rtt;
+    const char* state;
+    const char* reason;
+    long long int bytes_toserver;
+    const unsigned char* payload;
+    int payload_len;
+    const unsigned char* payload_sha1; //SHA_DIGEST_LENGTH bytes
+};
+
+//TCP flow handled by the proxy, printed as "CONNECTION"
+struct proxy_flow_event_t {
+    const char* src_ip;
+    int src_port;
+    const char* dest_ip;
+    int dest_port;
+    const char* timestamp;
+    long double unixtime;
+    //FLOW
+    const char* start;
+    const char* end;
+    long double duration;
+    long double min_rtt;
+    long long unsigned int bytes_toserver;
+    long long unsigned int bytes_toclient;
+    const char* proxy_ip;
+    int proxy_port;
+    const char* backend_ip;
+    int backend_port;
+};
+
+//TCP event merged from a SYN and a flow by the correlator of the TCP monitor.
+//event_type is "syn_scan", "no_syn" or, for accepted connections, the one of the flow ("flow" resp. "proxy_flow"), as written by the postprocessor
+struct tcp_merged_event_t {
+    const char* timestamp;
+    const char* src_ip;
+    int src_port;
+    const char* dest_ip;
+    int dest_port;
+    const char* proto;
+    const char* event_type;
+    long double unixtime;
+    const char* flow; //FLOW object as written by emit_*_flow_object(...), NULL for "syn_scan"
+    size_t flow_len;
+    const char* headers; //IP- and TCP-Header as written by dict_dumpbuf(...) resp. dict_dump_cbor(...), NULL for "no_syn"
+    size_t headers_len;
+};
+
+//UDP flow of the UDP monitor, handled by the proxy or not
+struct udp_flow_event_t {
+    bool proxied;
+    const char* src_ip;
+    int src_port;
+    const char* dest_ip;
+    int dest_port;
+    const char* timestamp;
+    long double unixtime;
+    //FLOW
+    const char* start;
+    const char* end;
+    long double duration;
+    long double min_rtt;
+    long long unsigned int bytes_toserver;
+    long long unsigned int bytes_toclient;
+    //only if proxied
+    const char* proxy_ip;
+    int proxy_port;
+    const char* backend_ip;
+    int backend_port;
+    //only if not proxied
+    const unsigned char* payload;
+    int payload_len;
+    const unsigned char* payload_sha1; //SHA_DIGEST_LENGTH bytes
+    struct dict* headers; //IP- and UDP-Header of the first datagram
+};
+
+//ICMP event of the ICMP monitor
+struct icmp_event_t {
+    const char* timestamp;
+    long double unixtime;
+    const char* src_ip;
+    const char* dest_ip;
+    int type;
+    int code;
+    struct dict* headers; //IP-Header, as parsed by analyze_ip_header(...)
+    //ICMP
+    unsigned int checksum;
+    const char* type_str;
+    bool echo; //id and seq are valid (echo, echoreply)
+    unsigned int id;
+    unsigned int seq;
+    bool unreach; //unused, code_str and inner_headers are valid (unreach)
+    unsigned long int unused;
+    const char* code_str;
+    struct dict* inner_headers; //Headers of the inner packet, may be NULL
+    bool tainted;
+    //FLOW
+    const char* start;
+    const char* end;
+    long double duration;
+    long long int bytes_toserver;
+    const unsigned char* payload;
+    int payload_len;
+    const unsigned char* payload_sha1; //SHA_DIGEST_LENGTH bytes
+};
+
+//RAW event of the RAW monitor
+struct raw_event_t {
+    const char* timestamp;
+    const char* src_ip; //NULL, if neither IPv4 nor IPv6 has been detected
+    const char* dest_ip; //NULL, if neither IPv4 nor IPv6 has been detected
+    const char* proto;
+    bool tainted;
+    long double unixtime;
+    //FLOW
+    const char* start;
+    const char* end;
+    long double duration;
+    long long unsigned int bytes_toserver;
+    const unsigned char* payload;
+    int payload_len;
+    const unsigned char* payload_sha1; //SHA_DIGEST_LENGTH bytes
+    //RAW
+    const char* pcap_filter;
+    unsigned int ether_type;
+};
+
+/**
+ * \brief Writes an event as JSON to a reusable buffer
+ *
+ *     The resulting JSON contains the same keys in the same order
+ *     as the former output composed by libdict_c,
+ *     e.g. for TCP flows:
+ *     {"origin":"MADCAT", "src_ip":"...", "dest_port":..., ..., "FLOW":{"start":"...", ...}}
+ *     Strings are not escaped and not copied, they only have to be valid during the call.
+ *     The payload is written as "payload_hd" (hexdump) and "payload_str" (hex string) in JSON.
+ *     If buf->format is DICT_FORMAT_CBOR, the event is written as CBOR instead
+ *     and the payload is written as byte string "payload", omitting the hexdump.
+ *     "payload_sha1" is a hex string in JSON and a byte string in CBOR.
+ *
+ * \param buf buffer to write to, previous content is overwritten
+ * \param event event to write
+ * \return length of the JSON string resp. CBOR data in buf->data
+ *
+ */
+size_t emit_tcp_syn_event(struct dict_buffer* buf, const struct tcp_syn_event_t* event);
+size_t emit_tcp_flow_event(struct dict_buffer* buf, const struct tcp_flow_event_t* event);
+size_t emit_proxy_flow_event(struct dict_buffer* buf, const struct proxy_flow_event_t* event);
+size_t emit_tcp_merged_event(struct dict_buffer* buf, const struct tcp_merged_event_t* event);
+size_t emit_udp_flow_event(struct dict_buffer* buf, const struct udp_flow_event_t* event);
+size_t emit_icmp_event(struct dict_buffer* buf, const struct icmp_event_t* event);
+size_t emit_raw_event(struct dict_buffer* buf, const struct raw_event_t* event);
+
+/**
+ * \brief Writes only the FLOW object of a flow event as JSON resp. CBOR object to a reusable buffer
+ *
+ *     E.g. {"FLOW":{"start":"...", ...}}, to be merged with the headers of the corresponding SYN
+ *     by emit_tcp_merged_event(...).
+ *
+ * \param buf buffer to write to, previous content is overwritten
+ * \param event event to write
+ * \return length of the JSON string resp. CBOR data in buf->data
+ *
+ */
+size_t emit_tcp_flow_object(struct dict_buffer* buf, const struct tcp_flow_event_t* event);
+size_t emit_proxy_flow_object(struct dict_buffer* buf, const struct proxy_flow_event_t* event);
+
+/**
+ * \brief Writes an event from a buffer to output
+ *
+ *     JSON is written as one line, CBOR as is, thus consecutive CBOR events form a CBOR sequence (RFC 8742).
+ *     The output is not flushed.
+ *
+ * \param output File-Pointer to output, e.g. STDOUT or a FIFO
+ * \param buf buffer containing the event, as written by one of the emit_*_event(...) functions
+ *
+ */
+void print_event(FILE* output, const struct dict_buffer* buf);
+
+#endif
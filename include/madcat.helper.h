@@ -58,6 +58,38 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
  */
 long double time_str(char* unix_buf, int unix_size, char* readable_buf, int readable_size);
 
+/**
+ * \brief Returns current time as struct timespec
+ *
+ *     Reads the realtime clock, to be formatted later by time_str_ts(...) if needed.
+ *     The coarse clock is cheaper, but has only a resolution of a few milliseconds,
+ *     thus it is intended for timeouts, not for timestamps of events.
+ *
+ * \param ts struct timespec receiving the current time
+ * \param coarse use the coarse realtime clock
+ * \return void
+ *
+ */
+void time_now(struct timespec* ts, const bool coarse);
+
+/**
+ * \brief Returns given time
+ *
+ *     Same as time_str(...), but for a given time, e.g. from time_now(...)
+ *     or the timestamp of a packet as provided by libpcap or the kernel, instead of the current time.
+ *     Date, time and timezone are formatted only once per second and cached per thread,
+ *     thus only microseconds are formatted for further timestamps in the same second.
+ *
+ * \param ts time to be returned
+ * \param unix_buf String-Buffer, which is used to return Unix-Time as String
+ * \param unix_size Size of unix_buf
+ * \param readable_buf String-Buffer, which is used to return Time in Readable Format
+ * \param readable_size Size of readable_buf
+ * \return Unix Time as double
+ *
+ */
+long double time_str_ts(const struct timespec* ts, char* unix_buf, int unix_size, char* readable_buf, int readable_size);
+
 /**
   * \brief Fetches user IDs
   *
@@ -69,6 +101,32 @@ long double time_str(char* unix_buf, int unix_size, char* readable_buf, int read
   */
 void get_user_ids(struct user_t* user);
 
+/**
+  * \brief Forks worker processes
+  *
+  *     Forks workers - 1 child processes, which are killed when the calling process dies.
+  *     Used e.g. to let several processes capture in one fanout group,
+  *     thus it has to be called before these are opened, so every worker opens its own.
+  *
+  * \param workers Number of workers incl. the calling process
+  * \return Number of the worker, 0 for the calling process
+  *
+  */
+int fork_workers(const int workers);
+
+/**
+  * \brief Pins the calling process to a CPU
+  *
+  *     Pins the calling process to the CPU at position worker (modulo the number of CPUs)
+  *     in the comma separated list cpus, e.g. worker 1 to CPU 3 for "2,3,4,5".
+  *
+  * \param cpus Comma separated list of CPU numbers
+  * \param worker Number of the worker, e.g. as returned by fork_workers(...)
+  * \return Number of the CPU, -1 if cpus is empty or invalid or the affinity could not be set
+  *
+  */
+int set_cpu_affinity(const char* cpus, const int worker);
+
 /**
   * \brief Prints binary data as hex with offset
   *
@@ -83,6 +141,42 @@ void get_user_ids(struct user_t* user);
   */
 void print_hex(FILE* output, const unsigned char* buffer, int buffsize);
 
+//Buffer sizes including \0 termination needed by hex_encode(...) and hex_dump_encode(...) for len Bytes of data.
+//A hexdump line has up to 80 characters: 9 offset, 49 hex code, 19 ASCII-Part, 2 escaped line break.
+#define HEX_STRING_LEN(len) (2 * (size_t) (len) + 1)
+#define HEX_DUMP_LEN(len) (80 * ((size_t) (len) / 16 + 1))
+
+/**
+  * \brief Encodes binary data as hex string into a buffer
+  *
+  *     Encodes binary data as hex string w/o whitspaces or linebreaks, like print_hex_string(...),
+  *     but into a buffer provided by the calling function.
+  *     Vectorized with SSE2, AVX2 or NEON, if enabled for the target.
+  *
+  * \param output Buffer of at least HEX_STRING_LEN(buffsize) Bytes, receiving the \0 terminated string
+  * \param buffer Buffer containing the binary data to be encoded
+  * \param buffsize Size of buffer
+  * \return Length of the string in output
+  *
+  */
+size_t hex_encode(char* output, const unsigned char* buffer, size_t buffsize);
+
+/**
+  * \brief Encodes binary data as hexdump into a buffer
+  *
+  *     Encodes binary data hexdump-style, with ASCII-Part, like hex_dump(...),
+  *     but into a buffer provided by the calling function.
+  *     Vectorized with SSE2 or NEON, if enabled for the target.
+  *
+  * \param output Buffer of at least HEX_DUMP_LEN(buffsize) Bytes, receiving the \0 terminated string
+  * \param buffer Buffer containing the binary data to be encoded
+  * \param buffsize Size of buffer
+  * \param json Toggles escaping of line breaks for use in JSON output
+  * \return Length of the string in output
+  *
+  */
+size_t hex_dump_encode(char* output, const unsigned char* buffer, size_t buffsize, const bool json);
+
 /**
   * \brief Prints binary data as hex string
   *
@@ -0,0 +1,180 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Shared memory event ring headerfile.
+ *
+ * Events of all processes of a module (e.g. sniffer, listners and proxies of the TCP module)
+ * are written to lock free multi producer rings in anonymous shared memory, mapped before forking.
+ * A producer reserves space by a compare-and-swap on the head of the ring, copies the event
+ * and commits it by storing its position into the record header, thus producers never wait for each other.
+ * A single drain thread writes committed events in order to the FIFOs in large batches
+ * and sleeps on a futex in the shared memory while the rings are empty.
+ * A record, which stays uncommitted, is only skipped after its producer has died,
+ * because a slow producer, e.g. descheduled or stopped, would write into the space after it has been reused.
+ * If a ring is full, e.g. because nobody reads the FIFO, events are dropped and counted instead of blocking.
+ *
+ * BSI 2018-2023
+*/
+
+
+#ifndef MADCAT_RING_H
+#define MADCAT_RING_H
+
+#include "madcat.common.h"
+#include <sys/mman.h>
+
+#define EVENT_RING_SIZE (16 << 20) //Default size of each ring in bytes, must be a power of two
+#define EVENT_RING_MAX 4 //Maximum number of rings, i.e. outputs, in one shared memory block
+#define EVENT_RING_ALIGN 8 //Alignment of records, thus of the seq in their headers
+#define EVENT_RING_WAIT 100 //Maximum time in ms the drain thread sleeps, before it checks for stop and stalled records
+#define EVENT_RING_STALL 2000 //Time in ms after which the producer of a reserved but uncommitted record is checked, the record is skipped if it died while writing
+#define EVENT_RING_BUFFER (1 << 20) //Size of the stdio buffer of the outputs, which are flushed once per batch
+
+struct event_ring_record_t { //Header of each record in a ring, followed by the event
+    uint64_t seq; //Position of the record + 1, stored last to commit the record. 0 while not committed.
+    uint32_t len; //Length of record incl. header and alignment
+    uint32_t data_len; //Length of the event, 0 for padding at the end of the ring
+    pid_t pid; //Producer, stored after len and data_len. 0 while not known.
+};
+
+struct event_ring_queue_t { //One ring
+    uint64_t head __attribute__((aligned(64))); //Next position to reserve, advanced by producers
+    uint64_t tail __attribute__((aligned(64))); //Next position to drain, advanced by the drain thread only
+    //Statistics
+    long int events __attribute__((aligned(64))); //Events written to output
+    long int bytes; //Bytes written to output
+    long int dropped; //Events dropped, because the ring was full
+    long int dropped_bytes;
+    long int skipped; //Stalled records of dead producers skipped by the drain thread
+    uint64_t stall_tail; //Position of the record found uncommitted first, drain thread only
+    struct timespec stall_since; //Time it has been found, drain thread only
+};
+
+struct event_ring_t { //Shared memory block, followed by the data of the rings
+    uint32_t doorbell; //Incremented after each commit, the drain thread waits on it as futex
+    uint32_t sleeping; //The drain thread is waiting, thus producers have to wake it
+    int count; //Number of rings
+    uint64_t size; //Size of each ring in bytes
+    struct event_ring_queue_t queue[EVENT_RING_MAX];
+};
+
+struct event_drain_t { //Drain thread, running in the process which has mapped the rings
+    struct event_ring_t* ring;
+    FILE* output[EVENT_RING_MAX]; //Output for each ring, NULL to ignore a ring
+    pthread_t thread;
+    pid_t pid; //Process running the drain thread
+    bool stop; //Set by event_drain_stop(...)
+};
+
+/**
+  * \brief Maps rings into anonymous shared memory
+  *
+  *     Has to be called before forking the producers.
+  *
+  * \param count Number of rings, at most EVENT_RING_MAX
+  * \param size Size of each ring in bytes, rounded up to a power of two
+  * \return Rings, NULL on error
+  *
+  */
+struct event_ring_t* event_ring_init(int count, size_t size);
+
+/**
+  * \brief Writes an event to a ring
+  *
+  *     Lock free, may be called by any process and thread, the event is copied from two parts,
+  *     e.g. a record header and its data. Never blocks, the event is dropped and counted, if the ring is full.
+  *
+  * \param ring Rings
+  * \param id Number of the ring
+  * \param data First part of the event
+  * \param len Length of data
+  * \param data2 Second part of the event, may be NULL
+  * \param len2 Length of data2
+  * \return true on success, false if the event has been dropped
+  *
+  */
+bool event_ring_put(struct event_ring_t* ring, int id, const void* data, size_t len, const void* data2, size_t len2);
+
+/**
+  * \brief Writes an event from a buffer to a ring, like print_event(...) to a FILE*
+  *
+  *     JSON is terminated by a newline, CBOR is written as is.
+  *
+  * \param ring Rings
+  * \param id Number of the ring
+  * \param buf buffer containing the event, as written by one of the emit_*_event(...) functions
+  * \return true on success, false if the event has been dropped
+  *
+  */
+bool event_ring_put_event(struct event_ring_t* ring, int id, const struct dict_buffer* buf);
+
+/**
+  * \brief Writes all committed events of a ring to output and flushes it
+  *
+  *     Must only be called by one thread at a time, usually the drain thread.
+  *
+  * \param ring Rings
+  * \param id Number of the ring
+  * \param output Output, e.g. a FIFO
+  * \return Number of events written
+  *
+  */
+long int event_ring_drain(struct event_ring_t* ring, int id, FILE* output);
+
+/**
+  * \brief Starts the drain thread
+  *
+  *     drain->ring and drain->output have to be set. The outputs are switched to fully buffered.
+  *
+  * \param drain Drain thread
+  * \return 0 on success, else an error number as by pthread_create(...)
+  *
+  */
+int event_drain_start(struct event_drain_t* drain);
+
+/**
+  * \brief Stops the drain thread after all committed events have been written
+  *
+  *     Does nothing, if not called by the process which started the thread, e.g. in a forked child.
+  *     Waits at most EVENT_RING_STALL ms, e.g. if the thread is blocked writing to a FIFO nobody reads.
+  *
+  * \param drain Drain thread
+  * \return void
+  *
+  */
+void event_drain_stop(struct event_drain_t* drain);
+
+/**
+  * \brief Logs the statistics of all rings to stderr, if events have been dropped or skipped since the last call
+  *
+  * \param ring Rings
+  * \param name Names of the rings for the log
+  * \return void
+  *
+  */
+void event_ring_log_stats(struct event_ring_t* ring, const char* const name[]);
+
+#endif
@@ -39,6 +39,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 //Global includes, defines, definitons
 #include "madcat.common.h"
 #include "madcat.helper.h"
+#include "madcat.events.h"
 #include "raw_mon.helper.h"
 
 #define VERSION "MADCAT - Mass Attack Detecion Connection Acceptance Tool\nRAW Monitor v2.3.0\nBSI 2018-2023\n" //Version string
@@ -50,8 +51,6 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 //Variabels for PCAP sniffing
 extern char* filter_exp; //The configured PCAP Filter string
 extern pcap_t *handle; //pcap Session handle
-extern struct pcap_pkthdr header; // The pcap header it gives back
-extern unsigned char* packet; //The Packet from pcap
 
 struct json_data_node_t { //json data list element
     //all variables of json output, except constant string values e.g. "proxy_flow" or "closed"
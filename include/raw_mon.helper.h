@@ -37,6 +37,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #define RAW_MON_HELPER_H
 
 #include "madcat.helper.h"
+#include "madcat.capture.h"
 
 /**
  * \brief Print RAW help message
@@ -90,7 +91,7 @@ void drop_root_privs(struct user_t user, const char* entity);
  *     Initializes PCAP sniffing, using configured filter
  *     Returns 0 on succes, otherwise returns:
  *     -1: pcap_lookupnet failed
- *     -2: pcap_open_live failed
+ *     -2: pcap_create or pcap_activate failed
  *
  *     Aborts, if pcap_compile failed or pcap_setfilter failed
  *
@@ -100,9 +101,25 @@ void drop_root_privs(struct user_t user, const char* entity);
  * \param dev  Name of the device to start PCAP-Sniffing on
  * \param handle PCAP Handle to be initialized
  * \param filter_exp Configured filter
+ * \param conf Capture settings
  * \return 0 und success, <0 if an error occured
  *
  */
-int init_pcap(char* dev, pcap_t **handle, const char* filter_exp);
+int init_pcap(char* dev, pcap_t **handle, const char* filter_exp, const struct capture_conf_t* conf);
+
+/**
+ * \brief Handels captured packets
+ *
+ *     Callback for capture_dispatch(...).
+ *     Parses the Ethernet- and IP-Header of a captured packet and
+ *     prints the result in JSON-Format to STDOUT.
+ *
+ * \param user Pointer to the int max_file_size, the maximum size of payloads in output
+ * \param header PCAP header of the captured packet
+ * \param packet Captured packet
+ * \return void
+ *
+ */
+void worker_raw(u_char* user, const struct pcap_pkthdr* header, const u_char* packet);
 
 #endif
\ No newline at end of file
@@ -63,16 +63,40 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "tcp_ip_port_mon.h"
 
+#define CONNECTION_SPLICE_PIPE 65536 //MADCAT: Bytes held by the pipe of a connection, the default capacity of a Linux pipe
+#define CONNECTION_SLAB_SIZE 16384 //MADCAT: Data bytes of a pooled write buffer slab
+#define CONNECTION_WRITE_MAX 262144 //MADCAT: Bytes buffered for a connection, before reading from its peer is paused
+#define CONNECTION_SLAB_POOL 256 //MADCAT: Free slabs kept for reuse by a proxy process
+
+struct write_slab_t;
+
 struct connection_closure {
-    void (*on_read)(void* closure, char* buffer, int len);
+    void (*on_read)(void* closure, char* buffer, int len); //MADCAT: buffer is NULL, if len bytes have been spliced to the peer
     void* on_read_closure;
 
     void (*on_close)(void* closure);
     void* on_close_closure;
 
-    struct data_buffer_entry* write_buffer;
+    //MADCAT: data not yet written, in pooled slabs, appended at the tail
+    struct write_slab_t* write_head;
+    struct write_slab_t* write_tail;
+    size_t write_pending; //bytes in the slabs, reading from the peer is paused above CONNECTION_WRITE_MAX
+    bool close_pending; //connection_close(...) has been called, the connection is closed after all data has been written
+
+    //MADCAT: non-blocking connect to the backend
+    bool connecting; //connect(...) in progress, data written meanwhile is buffered
+    void (*on_connect)(void* closure, int error); //called when the connect has completed, error is 0 or an errno value
+    void* on_connect_closure;
+
+    //MADCAT: forwarding between client and backend, see connection_pair(...)
+    struct epoll_event_handler* peer; //connection data read is forwarded to, NULL if none or the peer has been closed
+    bool paused; //EPOLLIN is disabled, because the write buffer or pipe of the peer is full
+    int splice_pipe[2]; //data spliced from the peer, which has not yet been written to this connection, -1 if data is copied
+    size_t splice_pending; //bytes in splice_pipe
 };
 
+extern bool connection_splice; //MADCAT: forward data between client and backend by splice(2) instead of read(2) and write(2), set by configuration
+
 /**
  * \brief RSP Proxy function
  *
@@ -89,6 +113,33 @@ extern void connection_write(struct epoll_event_handler* self, char* data, int l
   */
 extern void connection_close(struct epoll_event_handler* self);
 
+/**
+ * \brief Closes a connection immediately, discarding buffered data
+ *
+ *     Calls on_close first, like a close by the peer. Used if the connect to the backend failed or timed out.
+ *
+ * \param self epoll event handler of the connection
+ * \return void
+ *
+ */
+extern void connection_abort(struct epoll_event_handler* self);
+
+/**
+ * \brief Pairs two connections, which forward data to each other
+ *
+ *     Reading from a connection is paused, while the data buffered for its peer exceeds
+ *     CONNECTION_WRITE_MAX, and resumed when the peer has written it.
+ *     If connection_splice is set, a pipe is created for each connection. Data read from one connection
+ *     is spliced into the pipe of the other one and from there to its socket, without copying it to user space.
+ *     on_read is still called for every chunk, with buffer set to NULL, e.g. for counting bytes.
+ *
+ * \param a first connection, e.g. the client
+ * \param b second connection, e.g. the backend
+ * \return 0 on success, -1 if the pipes could not be created. Data is copied then, as without splicing.
+ *
+ */
+extern int connection_pair(struct epoll_event_handler* a, struct epoll_event_handler* b);
+
 /**
   * \brief RSP Proxy function
   *
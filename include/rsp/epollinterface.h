@@ -53,8 +53,21 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #ifndef EPOLLINTERFACE_H
 #define EPOLLINTERFACE_H
 
+#include "tcp_ip_port_mon.timer.h"
+
+struct epoll_timer_t { //Timer of the reactor loop, to be embedded into the structure it belongs to
+    struct timer_entry_t timer; //Entry in epoll_timers, has to be the first member
+    void (*expire)(struct epoll_timer_t*); //Called when the timer has expired, before the free list is processed
+};
+
+//included after struct epoll_timer_t, which is embedded into struct proxy_data of rsp.h
 #include "tcp_ip_port_mon.h"
 
+#define EPOLL_EVENTS_DEFAULT 64 //Default maximum number of events fetched by one call to epoll_wait(...)
+#define EPOLL_EVENTS_MAX 4096 //Upper limit for epoll_max_events
+#define EPOLL_STATS_INTERVAL 60 //Interval for logging reactor statistics in seconds
+#define EPOLL_TIMER_TICK 100 //Resolution in ms of the timers of the reactor loop, e.g. backend connect timeouts
+
 struct epoll_event_handler {
     int fd;
     void (*handle)(struct epoll_event_handler*, uint32_t);
@@ -68,6 +81,18 @@ struct free_list_entry {
 
 extern struct free_list_entry* free_list;
 
+struct epoll_stats_t { //Statistics of the reactor loop, e.g. to tune epoll_max_events
+    long int iterations; //Calls to epoll_wait(...) returning events
+    long int events; //Events dispatched
+    long int full; //Iterations returning epoll_max_events events, i.e. more may have been ready
+    int last; //Events of the last iteration
+    int max; //Maximum events of one iteration
+};
+
+extern int epoll_max_events; //Maximum number of events fetched by one call to epoll_wait(...), set by configuration
+extern struct epoll_stats_t epoll_stats; //Statistics of the reactor loop
+extern struct timer_wheel_t epoll_timers; //Timers of the reactor loop, initialized by epoll_init()
+
 extern struct epoll_event_handler* epoll_server_hdl; //global epoll event handler epoll server socket
 
 /**
@@ -94,6 +119,50 @@ extern void epoll_add_handler(struct epoll_event_handler* handler, uint32_t even
   */
 extern void epoll_remove_handler(struct epoll_event_handler* handler);
 
+/**
+  * \brief Changes the events a handler is registered for
+  *
+  *     E.g. removes EPOLLIN, while a connection does not read because of backpressure.
+  *
+  * \param handler registered handler
+  * \param event_mask new events
+  * \return void
+  *
+  */
+extern void epoll_modify_handler(struct epoll_event_handler* handler, uint32_t event_mask);
+
+/**
+  * \brief Logs the statistics of the reactor loop
+  *
+  *     Logs number of epoll_wait(...) calls, dispatched events, average and maximum events per call
+  *     and calls which returned a full batch of epoll_max_events.
+  *
+  * \return void
+  *
+  */
+extern void epoll_log_stats();
+
+/**
+  * \brief Starts or restarts a timer of the reactor loop
+  *
+  * \param t Timer, t->expire has to be set
+  * \param timeout Timeout in ms
+  * \return void
+  *
+  */
+extern void epoll_timer_add(struct epoll_timer_t* t, long int timeout);
+
+/**
+  * \brief Stops a timer of the reactor loop, if it is pending
+  *
+  *     Has to be called before the structure containing the timer is freed.
+  *
+  * \param t Timer
+  * \return void
+  *
+  */
+extern void epoll_timer_del(struct epoll_timer_t* t);
+
 /**
   * \brief RSP Proxy function
   *
@@ -105,6 +174,11 @@ extern void epoll_add_to_free_list(void* block);
 /**
   * \brief RSP Proxy function
   *
+  *     Fetches up to epoll_max_events events per call to epoll_wait(...) and dispatches them,
+  *     blocks in the free list are freed once per batch, thus handlers closed while handling
+  *     an event stay valid for the remaining events of the batch and are skipped (fd is -1).
+  *     The entries of the free list are kept for reuse.
+  *
   * Documentation: http://www.gilesthomas.com/2013/08/writing-a-reverse-proxyloadbalancer-from-the-ground-up-in-c-part-0/
   *
   */
@@ -64,11 +64,28 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 extern void make_socket_non_blocking(int socket_fd);
 
 /**
-  * \brief RSP Proxy function
+  * \brief Resolves the address of a backend
   *
-  * Documentation: http://www.gilesthomas.com/2013/08/writing-a-reverse-proxyloadbalancer-from-the-ground-up-in-c-part-0/
+  *     Blocks while resolving, thus called at startup and by a refresh timer only, not for each connection.
+  *
+  * \param backend_host Hostname or IP of the backend
+  * \param backend_port_str Port of the backend
+  * \param backend_addr Resolved address, the first one returned
+  * \param backend_addr_len Length of backend_addr
+  * \return 0 on success, -1 on error
+  *
+  */
+extern int resolve_backend(char* backend_host, char* backend_port_str, struct sockaddr_storage* backend_addr, socklen_t* backend_addr_len);
+
+/**
+  * \brief Starts a non-blocking connect to a backend
+  *
+  * \param backend_addr Address of the backend, see resolve_backend(...)
+  * \param backend_addr_len Length of backend_addr
+  * \param connecting Set to true, if the connect is still in progress and completes when the socket becomes writeable
+  * \return Socket, -1 on error
   *
   */
-extern int connect_to_backend(char* backend_host, char* backend_port_str);
+extern int connect_to_backend(const struct sockaddr_storage* backend_addr, socklen_t backend_addr_len, bool* connecting);
 
 #endif
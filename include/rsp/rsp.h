@@ -60,6 +60,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #include "connection.h"
 
 struct proxy_data {
+    struct epoll_timer_t connect_timer; //MADCAT: timeout of the connect to the backend, has to be the first member
     struct epoll_event_handler* client;
     struct epoll_event_handler* backend;
     long long int bytes_toclient; //MADCAT
@@ -96,4 +97,26 @@ extern struct proxy_socket_t proxy_sock;
  */
 int rsp(struct proxy_conf_tcp_node_t* pcn, char* server_addr);
 
+/**
+ * \brief Starts one instance of RSP-Proxy serving all configured ports
+ *
+ *     Registers a listening socket for each port of the proxy configuration in one epoll set,
+ *     connections are proxied to the backend configured for their port in pc->portconf[...].
+ *     Does only return in case of an error.
+ *
+ * \param pc proxy configuration
+ * \param server_addr local proxy-server address ("hostaddr")
+ * \return 0 on succesfull exit.
+ *
+ */
+int rsp_multi(struct proxy_conf_tcp_t* pc, char* server_addr);
+
+/**
+ * \brief Drops root priviliges of the proxy, after all listening sockets have been bound
+ *
+ * \return void
+ *
+ */
+void rsp_drop_privs();
+
 #endif
\ No newline at end of file
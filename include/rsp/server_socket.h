@@ -55,9 +55,27 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "tcp_ip_port_mon.h"
 
+/**
+ * \brief Creates a listening socket for a proxied port and registers it in the epoll set
+ *
+ *     Connections accepted on it are proxied to the backend configured in pcn.
+ *     The backend is resolved once before, then again in a resolver thread, whose result is read by the reactor.
+ *     Does not drop priviliges, thus further sockets can be bound to privileged ports.
+ *
+ * \param server_addr local proxy-server address ("hostaddr")
+ * \param pcn proxy configuration list element of the port, has to stay valid while the proxy is running
+ * \return epoll event handler of the socket
+ *
+ */
 extern struct epoll_event_handler* create_server_socket_handler(char* server_addr,
-        char* server_port_str,
-        char* backend_addr,
-        char* backend_port_str);
+        struct proxy_conf_tcp_node_t* pcn);
+
+/**
+ * \brief Frees all epoll event handlers created by create_server_socket_handler(...) in this process
+ *
+ * \return void
+ *
+ */
+extern void free_server_socket_handlers();
 
 #endif
\ No newline at end of file
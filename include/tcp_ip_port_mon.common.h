@@ -36,6 +36,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #define TCP_IP_PORT_MON_COMMON_TCP_H
 
 #include "madcat.common.h"
+#include "madcat.ring.h"
 
 //#define CT_ENABLED //Enable compiling of conntrack functions
 #ifdef CT_ENABLED
@@ -49,11 +50,16 @@ extern char hostaddr[INET6_ADDRSTRLEN]; //Hostaddress to bind to. Globally defin
 //Global Variables and definitions
 extern int pcap_pid; //PID of the Child doing the PCAP-Sniffing. Globally defined, cause it's used in CHECK-Makro.
 extern int listner_pid; //PID of the Child doing the TCP Connection handling. Globally defined, cause it's used in CHECK-Makro.
-//semaphores for output globally defined for easy access inside functions
-extern sem_t *hdrsem; //Semaphore for named pipe containing TCP/IP data
-extern sem_t *consem; //Semaphore for named pipe containing connection data
+//shared memory rings for output of all processes, drained to the FIFOs by a thread of the parent
+#define TCP_RING_HDR 0 //Ring for TCP/IP data, drained to hdrfifo
+#define TCP_RING_CON 1 //Ring for connection data, drained to confifo
+extern struct event_ring_t* event_ring; //Mapped before forking, thus reachable for all childs
+extern struct event_drain_t event_drain; //Drain thread of the parent, stopped by the watchdog on shutdown
+#define PARENT_STOP_WAIT 5 //Seconds the watchdog waits for the childs to exit on shutdown, before killing them
+extern volatile sig_atomic_t parent_stop; //Set by the signal handler of the parent to the signal number, the watchdog shuts down
 extern FILE* confifo; //FILE* confifo is globally defined to be reachabel for proxy-childs and listner-childs and signal handlers
 extern FILE* hdrfifo; //FILE* confifo is globally defined to be reachabel for pcap-childs and signal handlers
+extern bool tcp_correlation; //SYNs and flows are sent as records to the correlator process instead of JSON to the FIFOs
 extern int openfd; //Socket FD is globally defined to be reachabel for listner-childs and signal handlers
 extern pcap_t *handle; //pcap Session handle
 
@@ -63,7 +69,7 @@ struct con_status_t {   //Connection status
     char end[64];       //Time string: End of connection
     long double timeasdouble;  //Unix timestamp: Start of connection
     char state[16];     //State is either "closed\0", "open\0" or "n/a\0"
-    char reason[16];    //Reason is either "timeout\0", "size exceeded\0" or "n/a\0". Usefull states like "FIN send\0" and "FIN recv\0" are not detectable.
+    char reason[16];    //Reason is either "timeout\0", "size exceeded\0", "max duration\0", "shutdown\0", "file error\0", "reset\0", "recv error\0" or "n/a\0". Usefull states like "FIN send\0" and "FIN recv\0" are not detectable.
     long int data_bytes;//received bytes
 };
 
@@ -0,0 +1,218 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-IP port monitor SYN-to-connection correlator headerfile.
+ *
+ * Optional replacement for the join done by tcp_ip_port_mon_postprocessor.py:
+ * The sniffer and the connection handling processes (listner and proxies) send
+ * SYNs resp. flows as binary records through pipes to a dedicated correlator process.
+ * The correlator keeps them in hash tables keyed by (src_ip, src_port, dest_port),
+ * thus a SYN and its flow are matched in O(1) regardless of the number of pending ones.
+ * Unmatched entries expire in a timing wheel. Accepted connections, "syn_scan"
+ * and "no_syn" events are written to CONNECT_FIFO directly, in the same structure
+ * the postprocessor writes them (without "ct_status", as conntrack is not queried).
+ *
+ * BSI 2018-2023
+*/
+
+
+#ifndef TCP_IP_PORT_MON_CORRELATOR_H
+#define TCP_IP_PORT_MON_CORRELATOR_H
+
+#include "tcp_ip_port_mon.common.h"
+#include "tcp_ip_port_mon.timer.h"
+#include "madcat.events.h"
+#include "madcat.helper.h"
+
+#define TCP_CORR_MAGIC 0x524f434d //"MCOR", marks the beginning of each record, used to resynchronize after garbled input
+#define TCP_CORR_SYN 1 //Record contains IP- and TCP-Header of a SYN
+#define TCP_CORR_FLOW 2 //Record contains the FLOW object of a connection
+#define TCP_CORR_BUCKETS (1 << 16) //Number of hash buckets per table, must be a power of two
+#define TCP_CORR_TICK 100 //Resolution of the expiry in ms
+#define TCP_CORR_READ 65536 //Initial size of the input buffers, grown for larger records
+#define TCP_CORR_MAX_RECORD (64 << 20) //Records claiming to be larger are considered garbled
+#define TCP_CORR_PIPE (1 << 20) //Requested size of the pipes to the correlator
+#define TCP_CORR_STATS_INTERVAL 60 //Interval for logging statistics in seconds
+#define TCP_CORR_STOP_WAIT 5 //Seconds to wait for the end of both pipes after tcp_corr_stop has been set
+
+extern volatile sig_atomic_t tcp_corr_stop; //Set by signal handler of the correlator process to read the pipes to their end and exit
+
+struct tcp_corr_record_t { //Header of a record sent to the correlator, followed by len bytes of data
+    uint32_t magic; //TCP_CORR_MAGIC
+    uint32_t len; //Length of data following the header: For SYNs the serialized header dict, for flows the FLOW object
+    int type; //TCP_CORR_SYN or TCP_CORR_FLOW
+    int src_port;
+    int dest_port;
+    char src_ip[INET_ADDRSTRLEN];
+    char dest_ip[INET_ADDRSTRLEN];
+    char timestamp[64]; //Human readable time of SYN resp. start of connection
+    char proto[8]; //Only for flows
+    char event_type[16]; //Only for flows, "flow" resp. "proxy_flow"
+    long double unixtime; //Unix timestamp of SYN resp. start of connection
+};
+
+struct tcp_corr_conf_t { //Settings of the correlator
+    long double con_wait; //Time in seconds to wait for the SYN of a flow, in addition to syn_timeout
+    long double syn_timeout; //Time in seconds to wait for the flow of a SYN
+    long double syn_wait_proxy; //Time in seconds to wait for the flow of a SYN to a proxied port
+    const bool* portmap; //Map of proxied ports, may be NULL
+    FILE* output; //Output for merged events, e.g. CONNECT_FIFO
+};
+
+struct tcp_corr_entry_t { //Pending SYN or flow
+    struct timer_entry_t timer; //Expiry, has to be the first member
+    struct tcp_corr_entry_t* next; //Next entry in the same hash bucket
+    struct tcp_corr_record_t rec; //Header as received
+    char data[]; //Data as received
+};
+
+struct tcp_corr_t { //State of the correlator
+    const struct tcp_corr_conf_t* conf;
+    struct timer_wheel_t timers; //Expiry of pending SYNs and flows
+    struct tcp_corr_entry_t* syns[TCP_CORR_BUCKETS]; //Pending SYNs
+    struct tcp_corr_entry_t* flows[TCP_CORR_BUCKETS]; //Pending flows
+    struct dict_buffer output; //Reused for every merged event
+    //Statistics
+    long int pending; //Number of pending SYNs and flows
+    long int accept; //Merged events
+    long int syn_scan;
+    long int no_syn;
+    long int duplicates; //SYNs replaced by a retransmission resp. flows output early because of a newer one with the same key
+    long int garbled; //Bytes skipped while resynchronizing
+};
+
+/**
+  * \brief Initializes a record header
+  *
+  *     Strings are truncated to the size of the respective fields.
+  *
+  * \param rec Record header
+  * \param type TCP_CORR_SYN or TCP_CORR_FLOW
+  * \param src_ip Source IP
+  * \param src_port Source Port
+  * \param dest_ip Destination IP
+  * \param dest_port Destination Port
+  * \param timestamp Human readable time of SYN resp. start of connection
+  * \param unixtime Unix timestamp of SYN resp. start of connection
+  * \param proto Protocol of flow, NULL for SYNs
+  * \param event_type Event type of flow, NULL for SYNs
+  * \return void
+  *
+  */
+void tcp_corr_record(struct tcp_corr_record_t* rec, int type, const char* src_ip, int src_port, const char* dest_ip, int dest_port,
+                     const char* timestamp, long double unixtime, const char* proto, const char* event_type);
+
+/**
+  * \brief Sends a record to the correlator
+  *
+  *     Sets magic and len of the record and writes it along with its data as one event to the ring,
+  *     which is drained to the pipe like any other output, so records of different processes do not interleave.
+  *
+  * \param ring Rings of the module
+  * \param id Ring drained to the pipe to the correlator, i.e. TCP_RING_HDR for SYNs resp. TCP_RING_CON for flows
+  * \param rec Record header, type and key fields have to be set
+  * \param data Serialized IP- and TCP-Header resp. FLOW object, see struct tcp_corr_record_t
+  * \return true on success, false if the record has been dropped, because the ring was full
+  *
+  */
+bool tcp_corr_send(struct event_ring_t* ring, int id, struct tcp_corr_record_t* rec, const struct dict_buffer* data);
+
+/**
+  * \brief Creates a pipe to the correlator
+  *
+  *     The pipe is enlarged to TCP_CORR_PIPE if permitted, so producers rarely block while the correlator is busy.
+  *
+  * \param fds Reading and writing end, as by pipe(2)
+  * \return 0 on success, -1 on error
+  *
+  */
+int tcp_corr_pipe(int fds[2]);
+
+/**
+  * \brief Allocates and initializes the correlator state
+  *
+  * \param conf Settings, must stay valid for the lifetime of the correlator
+  * \param now Current time of CLOCK_MONOTONIC_COARSE
+  * \return Correlator, to be freed by tcp_corr_free(...)
+  *
+  */
+struct tcp_corr_t* tcp_corr_init(const struct tcp_corr_conf_t* conf, const struct timespec* now);
+
+/**
+  * \brief Adds a received record
+  *
+  *     If the counterpart with the same key is pending, the merged "accept" event is written at once,
+  *     else the record is kept until the counterpart arrives or it expires.
+  *     O(1) on average.
+  *
+  * \param corr Correlator
+  * \param rec Record header
+  * \param data rec->len bytes of data
+  * \return void
+  *
+  */
+void tcp_corr_add(struct tcp_corr_t* corr, const struct tcp_corr_record_t* rec, const char* data);
+
+/**
+  * \brief Writes "syn_scan" resp. "no_syn" events for all expired entries
+  *
+  * \param corr Correlator
+  * \param now Current time of CLOCK_MONOTONIC_COARSE
+  * \return Number of expired entries
+  *
+  */
+long int tcp_corr_expire(struct tcp_corr_t* corr, const struct timespec* now);
+
+/**
+  * \brief Frees the correlator
+  *
+  *     Pending entries are discarded without writing "syn_scan" resp. "no_syn" events,
+  *     as tcp_ip_port_mon_postprocessor.py does on shutdown, because their counterparts
+  *     may just not have been received yet.
+  *
+  * \param corr Correlator
+  * \return void
+  *
+  */
+void tcp_corr_free(struct tcp_corr_t* corr);
+
+/**
+  * \brief Main loop of the correlator process
+  *
+  *     Reads records from both pipes, adds them and expires pending entries.
+  *     Returns, when both pipes have been closed. After tcp_corr_stop has been set,
+  *     records still in the pipes are read for at most TCP_CORR_STOP_WAIT seconds,
+  *     so the events of a shutdown are merged, then pending entries are discarded, see tcp_corr_free(...).
+  *
+  * \param synfd Reading end of the pipe for SYNs
+  * \param flowfd Reading end of the pipe for flows
+  * \param conf Settings
+  * \return void
+  *
+  */
+void worker_corr(int synfd, int flowfd, const struct tcp_corr_conf_t* conf);
+
+#endif
@@ -41,6 +41,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #include "tcp_ip_port_mon.helper.h"
 #include "tcp_ip_port_mon.parser.h"
 #include "tcp_ip_port_mon.worker.h"
+#include "tcp_ip_port_mon.correlator.h"
 #include "rsp.h"
 
 #define VERSION "MADCAT - Mass Attack Detecion Connection Acceptance Tool\nTCP-IP Port Monitor v2.3.1\nBSI 2018-2023\n" //Version string
@@ -168,9 +169,8 @@ extern char hostaddr[INET6_ADDRSTRLEN]; //Hostaddress to bind to. Globally defin
 //Global Variables and definitions
 extern pid_t pcap_pid; //PID of the Child doing the PCAP-Sniffing. Globally defined, cause it's used in CHECK-Makro.
 extern pid_t listner_pid; //PID of the Child doing the TCP Connection handling. Globally defined, cause it's used in CHECK-Makro.
-//semaphores for output globally defined for easy access inside functions
-extern sem_t *hdrsem; //Semaphore for named pipe containing TCP/IP data
-extern sem_t *consem; //Semaphore for named pipe containing connection data
+//shared memory rings for output globally defined for easy access inside functions
+extern struct event_ring_t* event_ring; //Rings for TCP/IP and connection data, see TCP_RING_HDR and TCP_RING_CON
 extern FILE* confifo; //FILE* confifo is globally defined to be reachabel for both proxy-childs and accept-childs
 
 #endif
@@ -38,6 +38,8 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "tcp_ip_port_mon.common.h"
 #include "madcat.helper.h"
+#include "madcat.events.h"
+#include "madcat.capture.h"
 
 //Capture only TCP-SYN's, for some sytems (Linux Kernel >= 5?) own host IPv4 or IPv6 has to be appended,
 //thus the final filter string looks like "tcp[tcpflags] & (tcp-syn) != 0 and tcp[tcpflags] & (tcp-ack) == 0 & dst host 1.2.3.4"
@@ -53,6 +55,14 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #define HEADER_FIFO_v6 "/tmp/header_json_v6.tpm"
 #define CONNECT_FIFO_v6 "/tmp/connect_json_v6.tpm"
 
+//Defaults of the TCP-SYN sniffer, overridable by the optional config options pcap_snaplen, pcap_buffer_size and pcap_immediate, see capture_config(...)
+#define PCAP_SNAPLEN BUFSIZ //Snapshot length, enough for all IP-, TCP-Headers and options
+#define PCAP_BUFFER_SIZE 0 //Capture buffer size in bytes, 0 keeps the default of libpcap
+#define PCAP_TIMEOUT CAPTURE_TIMEOUT //Packet buffer timeout in ms, unused in immediate mode
+#define PCAP_STATS_INTERVAL 60 //Interval in seconds between logging of pcap drop counters by the sniffer
+#define TCP_LISTEN_BACKLOG SOMAXCONN //Default backlog of the listening socket(s) of the TCP Port Monitor, configurable by "tcp_listening_backlog"
+#define TCP_LISTEN_RESTART_WAIT 1 //Seconds a restarted listner waits, before it opens its socket again
+
 #define PCN_STRLEN 6 //listen- and backport string length in proxy_conf_tcp_node_t
 #define STR_BUFFER_SIZE 65536 //Generic string buffer size
 
@@ -71,6 +81,8 @@ struct proxy_conf_tcp_node_t { //linked list element to hold proxy configuration
 struct proxy_conf_tcp_t { //proxy configuration
     struct proxy_conf_tcp_node_t* portlist; //head pointer to linked list with proxy configuration items
     bool portmap[65536]; //map of ports used to proxy network traffic
+    struct proxy_conf_tcp_node_t* portconf[65536]; //configuration of each proxied port, NULL if not proxied
+    pid_t pid; //Process ID of the proxy serving all ports, if proxy_single_process is set, else 0
     int num_elements;
 };
 extern struct proxy_conf_tcp_t *pc; //globally defined to be easly accesible by functions
@@ -127,20 +139,37 @@ void print_help_tcp(char* progname); //print TCP help message
  *     Initializes PCAP sniffing of TCP-SYNs.
  *     Returns 0 on succes, otherwise returns:
  *     -1: pcap_lookupnet failed
- *     -2: pcap_open_live failed
+ *     -2: pcap_create or pcap_activate failed
  *     -3: pcap_compile failed
  *     -4: pcap_setfilter failed
  *
+ *     The handle is created non-promiscuous with snaplen, buffer size
+ *     and immediate mode taken from conf.
  *     See documentation of libpcap for further infomation.
  *
  * \param dev Name of the device to start PCAP-Sniffing on
  * \param dev_addr IP Address of this interface
  * \param handle PCAP Handle to be initialized
  * \param pcap_filter_str Filter-Rules for sniffing
+ * \param conf Capture settings
  * \return 0 und success, <0 if an error occured
  *
  */
-int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str);
+int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str, const struct capture_conf_t* conf);
+
+/**
+ * \brief Logs capture statistics
+ *
+ *     Prints the packet counters of capture_stats(...), i.e. received
+ *     packets and packets dropped by libpcap resp. the kernel and by the interface,
+ *     together with the number of logged TCP-SYNs to STDERR.
+ *
+ * \param cap Active capture handle
+ * \param syn_count Number of TCP-SYNs processed so far
+ * \return void
+ *
+ */
+void log_capture_stats(struct capture_t* cap, const long int syn_count);
 
 /**
  * \brief Drops root priviliges
@@ -155,6 +184,79 @@ int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str)
  *
  */
 void drop_root_privs(struct user_t user, const char* entity, bool silent);
+
+/**
+ * \brief Forks and supervises listner workers
+ *
+ *     Forks workers listner processes, which return immediately with their number
+ *     to open their own SO_REUSEPORT socket, and supervises them in the calling process:
+ *     A worker, which has exited, is forked again with the same number, after
+ *     TCP_LISTEN_RESTART_WAIT seconds. When tcp_worker_stop has been set,
+ *     e.g. by sig_handler_listnerchild(...), SIGTERM is sent to all workers,
+ *     so they write the events of their open connections, and the supervisor
+ *     returns after all of them have exited.
+ *
+ * \param workers Number of listner workers
+ * \return Number of the worker in forked workers, -1 in the supervisor after shutdown
+ *
+ */
+int supervise_listners(const int workers);
+
+/**
+ * \brief Detaches a child from the FIFOs
+ *
+ *     Only the drain thread of the parent writes to hdrfifo and confifo,
+ *     resp. to the pipes to the correlator. To be called in childs right after fork(),
+ *     so they do not hold the writing ends of the pipes, which would delay the
+ *     end of the pipes for the correlator until all childs have exited.
+ *     The descriptors are replaced by /dev/null and both FILEs are set to NULL.
+ *
+ * \return void
+ *
+ */
+void detach_fifos();
+
+/**
+ * \brief Forks a Reverse Proxy child process
+ *
+ *     Starts the proxy for all ports (rsp_multi), if pcn is NULL, else the proxy for the port of pcn (rsp),
+ *     at startup and for restarts by the watchdog. The child detaches from the FIFOs,
+ *     registers its signal handlers and waits restart_wait seconds before starting the proxy.
+ *     The PID of the child is saved in pc->pid resp. pcn->pid for the parent watchdog.
+ *
+ * \param pc Proxy configuration
+ * \param hostaddr Address the proxy listens on
+ * \param pcn Port to start the proxy for, NULL for one proxy serving all ports
+ * \param restart_wait Seconds to wait in the child before starting the proxy, 0 at startup
+ * \return PID of the child
+ *
+ */
+pid_t start_proxies(struct proxy_conf_tcp_t* pc, char* hostaddr, struct proxy_conf_tcp_node_t* pcn, double restart_wait);
+
+typedef size_t (*tcp_emit_t)(struct dict_buffer* buf, const void* event); //Writes an event resp. a part of it, like the emit_*(...) functions of madcat.events.h
+struct tcp_corr_record_t;
+
+/**
+ * \brief Writes a SYN or flow event
+ *
+ *     Output of all producers of the TCP Port Monitor:
+ *     If tcp_correlation is set, emit_object writes the part of the event needed by the correlator,
+ *     which is sent as record rec to it. Else emit_event writes the complete event to the ring for the FIFO.
+ *     In JSON format the complete event is always printed to STDOUT for logging,
+ *     as {"HEADER": ...} for SYNs resp. {"CONNECTION": ...} for flows.
+ *     Uses one buffer for all events, thus it must not be called concurrently.
+ *
+ * \param ring Rings of the module
+ * \param kind TCP_CORR_SYN, written to ring TCP_RING_HDR, or TCP_CORR_FLOW, written to ring TCP_RING_CON
+ * \param rec Record header for the correlator, key fields have to be set, only used if tcp_correlation is set
+ * \param emit_object Writes the part of the event for the correlator, e.g. the FLOW object
+ * \param emit_event Writes the complete event
+ * \param event Event, passed to emit_object and emit_event
+ * \return void
+ *
+ */
+void tcp_output_event(struct event_ring_t* ring, int kind, struct tcp_corr_record_t* rec, tcp_emit_t emit_object, tcp_emit_t emit_event, const void* event);
+
 //Signal Handler:
 
 /**
@@ -171,13 +273,28 @@ void sig_handler_common();
 /**
  * \brief Signal Handler for parent watchdog
  *
- *     Signal Handler for parent watchdog
+ *     Signal Handler for parent watchdog. Only sets parent_stop, the watchdog
+ *     shuts down by parent_shutdown(...). On SIGUSR1, i.e. a failed CHECK,
+ *     the childs are sent SIGTERM and the parent exits immediately.
  *
  * \return void
  *
  */
 void sig_handler_parent(int signo);
 
+/**
+ * \brief Shuts down the parent watchdog
+ *
+ *     Sends SIGTERM to all childs, waits up to PARENT_STOP_WAIT seconds for sniffer
+ *     and listner, writes the remaining events by stopping the drain thread and exits.
+ *     Called by the watchdog, not from a signal handler.
+ *
+ * \param signo Signal, which caused the shutdown, used as exit status
+ * \return void
+ *
+ */
+void parent_shutdown(int signo);
+
 /**
   * \brief Signal Handler for listner Thread
   *
@@ -201,7 +318,9 @@ void sig_handler_pcapchild(int signo);
 /**
   * \brief Signal Handler for listner thread childs
   *
-  *     Signal Handler for listner thread childs
+  *     Signal Handler for listner thread childs.
+  *     The first SIGTERM or SIGINT only sets tcp_worker_stop, so worker_tcp(...) closes
+  *     all open connections and returns, a second one kills the child immediately.
   *
   * \return void
   *
@@ -218,6 +337,16 @@ void sig_handler_listnerchild(int signo);
   */
 void sig_handler_proxychild(int signo);
 
+/**
+  * \brief Signal Handler for the correlator child
+  *
+  *     Lets worker_corr(...) read the remaining records from the pipes and return
+  *
+  * \return void
+  *
+  */
+void sig_handler_corrchild(int signo);
+
 /**
   * \brief Debug Signal Handler
   *
@@ -273,7 +402,7 @@ void pctcp_push(struct proxy_conf_tcp_t* pc, int listenport, char* backendaddr,
 /**
   * \brief Gets proxy config from linked List
   *
-  *     Gets proxy configuration for a specific port
+  *     Gets proxy configuration for a specific port from pc->portconf, NULL if the port is not proxied
   *
   * \param pc Linked List containing proxy configuration
   * \param listenport Port to listen on
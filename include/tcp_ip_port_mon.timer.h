@@ -0,0 +1,157 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-IP port monitor timer headerfile.
+ *
+ * Hierarchical timing wheel for the connection timeouts of the TCP worker:
+ * TIMER_LEVELS wheels of TIMER_SLOTS slots each, the slots of a wheel spanning
+ * one revolution of the next finer wheel. Timers are inserted into and removed from
+ * their slot in O(1) and are cascaded to finer wheels when their slot comes due,
+ * so each timer is touched at most TIMER_LEVELS times before it expires.
+ * Occupied slots are tracked in bitmaps, so the time until the next timer
+ * (or cascade) is due can be handed to epoll_wait(...) and idle workers sleep.
+ *
+ * BSI 2018-2023
+*/
+
+
+#ifndef TCP_IP_PORT_MON_TIMER_H
+#define TCP_IP_PORT_MON_TIMER_H
+
+#include "madcat.common.h"
+#include <stdint.h>
+#include <limits.h>
+
+#define TIMER_BITS 6 //log2 of the number of slots per wheel
+#define TIMER_SLOTS (1 << TIMER_BITS) //Number of slots per wheel, must match the bits of uint64_t for the bitmaps
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define TIMER_LEVELS 4 //Number of wheels, timeouts are limited to TIMER_SLOTS^TIMER_LEVELS - 1 ticks
+#define TIMER_MAX (((uint64_t) 1 << (TIMER_BITS * TIMER_LEVELS)) - 1) //Maximum timeout in ticks, longer ones are truncated
+
+struct timer_entry_t { //Timer, to be embedded into the structure it belongs to
+    uint64_t expires; //Tick, at which the timer expires
+    struct timer_entry_t* prev; //List of timers in the same slot, prev == NULL if the timer is not pending
+    struct timer_entry_t* next;
+    struct timer_entry_t* slot; //Head of the slot the timer is in
+};
+
+struct timer_wheel_t { //Timing wheel
+    struct timespec base; //Time of tick 0
+    long int tick; //Duration of a tick in ms
+    uint64_t now; //Current tick, i.e. the last one processed
+    long int count; //Number of pending timers
+    uint64_t occupied[TIMER_LEVELS]; //Bitmaps of non empty slots
+    struct timer_entry_t slots[TIMER_LEVELS][TIMER_SLOTS]; //List heads of the slots
+};
+
+/**
+  * \brief Initializes a timing wheel
+  *
+  * \param tw Timing wheel
+  * \param now Current time, i.e. tick 0, of a monotonic clock, e.g. CLOCK_MONOTONIC_COARSE
+  * \param tick Duration of a tick in ms, which is the resolution of all timers
+  * \return void
+  *
+  */
+void timer_init(struct timer_wheel_t* tw, const struct timespec* now, const long int tick);
+
+/**
+  * \brief Starts or restarts a timer
+  *
+  *     The timer is removed first, if it is already pending.
+  *     O(1).
+  *
+  * \param tw Timing wheel
+  * \param t Timer
+  * \param timeout Timeout in ms relative to the current tick of the wheel, rounded up to whole ticks, at least one
+  * \return void
+  *
+  */
+void timer_add(struct timer_wheel_t* tw, struct timer_entry_t* t, const long int timeout);
+
+/**
+  * \brief Stops a timer, if it is pending
+  *
+  *     O(1).
+  *
+  * \param tw Timing wheel
+  * \param t Timer
+  * \return void
+  *
+  */
+void timer_del(struct timer_wheel_t* tw, struct timer_entry_t* t);
+
+/**
+  * \brief Tests if a timer is pending
+  *
+  * \param t Timer
+  * \return true if pending
+  *
+  */
+bool timer_pending(const struct timer_entry_t* t);
+
+/**
+  * \brief Advances the wheel to the given time and expires all timers due until then
+  *
+  *     The callback is invoked for each expired timer after it has been removed,
+  *     it may restart this or other timers.
+  *
+  * \param tw Timing wheel
+  * \param now Current time of the same clock as given to timer_init(...)
+  * \param expire Callback for expired timers
+  * \param user Passed to callback
+  * \return Number of expired timers
+  *
+  */
+long int timer_expire(struct timer_wheel_t* tw, const struct timespec* now, void (*expire)(struct timer_entry_t* t, void* user), void* user);
+
+/**
+  * \brief Removes all pending timers, regardless of their expiry, and invokes the callback for each
+  *
+  *     E.g. to close all connections on shutdown. The callback must not restart timers.
+  *
+  * \param tw Timing wheel
+  * \param expire Callback for the removed timers
+  * \param user Passed to callback
+  * \return Number of removed timers
+  *
+  */
+long int timer_drain(struct timer_wheel_t* tw, void (*expire)(struct timer_entry_t* t, void* user), void* user);
+
+/**
+  * \brief Computes the time until the wheel has to be advanced next
+  *
+  *     That is until the next timer expires or until timers have to be cascaded to a finer wheel.
+  *     O(TIMER_LEVELS).
+  *
+  * \param tw Timing wheel
+  * \param now Current time of the same clock as given to timer_init(...)
+  * \return Time in ms, suitable as timeout for epoll_wait(2), -1 if no timer is pending
+  *
+  */
+int timer_next(const struct timer_wheel_t* tw, const struct timespec* now);
+
+#endif
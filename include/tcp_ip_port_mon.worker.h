@@ -38,38 +38,96 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "madcat.common.h"
 #include "tcp_ip_port_mon.h"
+#include "tcp_ip_port_mon.timer.h"
+#include <sys/epoll.h>
+#include <openssl/evp.h>
 
 //Connection worker:
 
+#define TCP_WORKER_EVENTS 256 //Maximum number of events returned by one call to epoll_wait(...)
+#define TCP_WORKER_TICK 10 //Resolution in ms of the connection timeouts, i.e. the tick of the timing wheel
+#define TCP_WORKER_DRAIN 65536 //Bytes discarded per call to recv(...) after max_stream_size has been exceeded
+#define TCP_WORKER_FLUSH 65536 //Payload is written to the stream file in batches of at least this size, the rest when complete or closed
+#define TCP_WORKER_FLUSH_DELAY 1000 //ms, smaller batches are written at latest this long after they have been received
+#define TCP_WORKER_PIPE (1 << 20) //Requested size of the pipe for splicing data beyond max_file_size to stream files
+
+struct tcp_worker_conf_t { //Settings of the connection worker, identical for all connections
+    long double timeout; //Connection timeout in seconds without received data
+    const char* data_path; //Path to save payload data to
+    int max_file_size; //Maximum size of payload-files
+    struct event_ring_t* ring; //Rings to write JSON-output to, ring TCP_RING_CON is drained to the connection FiFo
+    char* proto_str; //String to put in JSON output proto-field
+    long double max_duration; //Maximum duration of a connection in seconds, 0 for unlimited
+    bool close_size_exceeded; //Close connection as soon as max_file_size (resp. max_stream_size) has been exceeded, instead of waiting for timeout
+    long int max_stream_size; //Maximum size of stream files, data beyond max_file_size is spliced to them without copying. -1 for unlimited.
+};
+
+extern volatile sig_atomic_t tcp_worker_stop; //Set by a signal handler to the signal number, worker_tcp(...) closes all connections and returns
+
+struct tcp_con_t { //State of an accepted connection, handled by worker_tcp(...)
+    struct timer_entry_t timer; //Timer for timeout, max_duration and max_file_size, closes the connection when expired
+    int fd; //Socket of connection
+    const struct tcp_worker_conf_t* conf; //Settings of the worker
+    char dst_addr[INET_ADDRSTRLEN]; //Destination IP of connection
+    int dest_port; //Destination Port of connection
+    char src_addr[INET_ADDRSTRLEN]; //Source IP of connection
+    int src_port; //Source Port of connection
+    char log_time[64]; //Human readable start time
+    char log_time_unix[64]; //Unix timestamp of start time
+    struct con_status_t con_status; //Connection status for flow output
+    unsigned char* payload; //Received payload, up to max_file_size
+    size_t payload_len; //Bytes in payload
+    size_t payload_size; //Allocated size of payload, grown geometrically
+    EVP_MD_CTX* sha1; //SHA1 of payload, updated as data arrives
+    int file_fd; //Stream file, opened with the first received data, -1 before
+    size_t file_len; //Bytes written to stream file, the payload beyond is not yet written
+    char* file_name; //Name of payload file
+    long double duration; //Time between start and last received data
+    long double min_rtt; //Minimum time between received data
+    struct timespec begin; //Time of last received data (monotonic coarse clock), begin of timeout
+    struct timespec start; //Time of acceptance (monotonic coarse clock), begin of max_duration
+    bool firstpacket; //No data received yet
+    bool size_exceeded; //max_file_size exceeded
+    bool closed; //Closed by peer, waiting for timeout
+    bool file_error; //Stream file could not be written, the connection is closed with the next tick
+};
+
 /**
   * \brief Handels incoming TCP connections
   *
-  *     Handels a TCP connection, which is not proxied and
-  *     writes out payloads and results in JSON-Format to a FiFo.
+  *     Accepts all TCP connections on the listening socket and handles
+  *     them in one epoll event loop, each with its own struct tcp_con_t.
+  *     Payloads are written to files and results in JSON-Format to a FiFo,
+  *     after a connection has been idle for conf->timeout, has lasted conf->max_duration
+  *     or, if conf->close_size_exceeded, has exceeded conf->max_file_size.
+  *     Like before, connections closed by the peer are also held until their timeout.
+  *     Timeouts are tracked in a timing wheel, so idle connections cost no CPU.
+  *     Returns after tcp_worker_stop has been set by a signal handler for SIGTERM or SIGINT,
+  *     all open connections are closed before, writing their payloads and flow events (reason "shutdown").
+  *
+  * \param listenfd Listening socket
+  * \param conf Settings for all connections
+  * \return void
+  *
+  */
+void worker_tcp(const int listenfd, const struct tcp_worker_conf_t* conf);
+
+//Sniffer callback:
+
+/**
+  * \brief Handels captured TCP-SYNs
+  *
+  *     Callback for pcap_dispatch(3PCAP) in the sniffer child.
+  *     Parses IP- and TCP-Header of a captured TCP-SYN and
+  *     writes results in JSON-Format to the header FiFo.
   *
-  * \param dst_addr Destination IP of connection
-  * \param dest_port Destination Port of connection
-  * \param src_addr Source IP of connection
-  * \param src_port Source Port of connection
-  * \param timeout Desired connection timeout
-  * \param data_path Path to save payload data to
-  * \param max_file_size Maximum size of payload-files
-  * \param s Socket of connection
-  * \param confifo FiFo to write JSON-output to
-  * \param proto_str String to put in JSON output proto-field
-  * \return number of received bytes in case of success, <0 in case of an error.
+  * \param user Pointer to a long int counting received TCP-SYNs
+  * \param header PCAP header of the captured packet
+  * \param packet Captured packet
+  * \return void
   *
   */
-long int worker_tcp(const char* dst_addr, \
-                    const int dest_port, \
-                    const char* src_addr, \
-                    const int src_port, \
-                    const long double timeout, \
-                    const char* data_path, \
-                    const int max_file_size, \
-                    const int s,\
-                    FILE* confifo,\
-                    char* proto_str);
+void worker_syn(u_char* user, const struct pcap_pkthdr* header, const u_char* packet);
 
 #endif
 
@@ -18,6 +18,8 @@
 // Gratefully adopted and modified for MADCAT by BSI 2020-2021
 
 #include "libdict_c.h"
+#include <math.h>
+#include <float.h>
 
 //Constant globals
 
@@ -35,6 +37,588 @@ const char* const __json_hex_format[] = {
     "\"0x%08lx\"" //HEX_FORMAT_08
 };
 
+//Arena helper functions
+
+//Releases memory allocated by dict_arena_alloc(...); memory taken from an arena is released by dict_arena_reset(...) only
+static void __dict_release(struct dict_arena* arena, void* ptr) {
+    if(arena == 0) free(ptr);
+    return;
+}
+
+//Copies string str to memory allocated from arena
+static char* __dict_strdup(struct dict_arena* arena, const char* str) {
+    size_t len = strlen(str);
+    char* copy = (char*) dict_arena_alloc(arena, len+1); //+1 for \0
+    memcpy(copy, str, len+1);
+    return copy;
+}
+
+//Hands a malloc'd string over to arena, so it is freed by dict_arena_reset(...). Returns false, if arena could not keep track of it.
+static bool __dict_arena_own(struct dict_arena* arena, void* ptr) {
+    if(arena->owned_count == arena->owned_size) { //grow list of owned strings geometrically
+        size_t owned_size = arena->owned_size ? 2 * arena->owned_size : 16;
+        void** owned = (void**) realloc(arena->owned, owned_size * sizeof(void*));
+        if(owned == 0) return false;
+        arena->owned = owned;
+        arena->owned_size = owned_size;
+    }
+    arena->owned[arena->owned_count++] = ptr;
+    return true;
+}
+
+//Stores a string given as JSON_STR, JSON_STR_REF or JSON_STR_OWN in an element allocated from arena and sets its str_mode
+static char* __dict_setstr(struct dict_arena* arena, __uint8_t type, char* str, __uint8_t* str_mode) {
+    switch(type) {
+        case JSON_STR_REF:
+            *str_mode = DICT_STR_REF;
+            return str;
+        case JSON_STR_OWN:
+            if(arena == 0 || __dict_arena_own(arena, str)) {
+                *str_mode = DICT_STR_OWN;
+                return str;
+            } else { //arena cannot take it over, fall back to copy, ownership has been transfered anyway
+                char* copy = __dict_strdup(arena, str);
+                free(str);
+                *str_mode = DICT_STR_COPY;
+                return copy;
+            }
+        default:
+            *str_mode = DICT_STR_COPY;
+            return __dict_strdup(arena, str);
+    }
+}
+
+//Releases a string stored in an element allocated from arena according to its str_mode
+static void __dict_freestr(struct dict_arena* arena, __uint8_t str_mode, char* str) {
+    switch(str_mode) {
+        case DICT_STR_COPY: __dict_release(arena, str); break;
+        case DICT_STR_OWN: if(arena == 0) free(str); break; //taken over by arena otherwise, thus freed on reset
+        default: break; //DICT_STR_REF: string belongs to calling function
+    }
+    return;
+}
+
+//Usable memory of a chunk starts after its header, aligned to DICT_ARENA_ALIGN
+#define __DICT_ARENA_CHUNK_HDR ((sizeof(struct dict_arena_chunk) + DICT_ARENA_ALIGN - 1) & ~((size_t) DICT_ARENA_ALIGN - 1))
+#define __DICT_ARENA_CHUNK_DATA(chunk) ((char*)(chunk) + __DICT_ARENA_CHUNK_HDR)
+
+static struct dict_arena_chunk* __dict_arena_chunk_new(size_t size) {
+    struct dict_arena_chunk* chunk = (struct dict_arena_chunk*) aligned_alloc(DICT_ARENA_ALIGN, __DICT_ARENA_CHUNK_HDR + size);
+    if(chunk == 0) return NULL;
+    chunk->next = 0;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+//Hash index helper functions
+
+//FNV-1a hash of a key
+static unsigned int __dict_hash(const char* key) {
+    unsigned int hash = 2166136261u;
+    while(*key) {
+        hash ^= (unsigned char) *key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//Check if dict is the first element of an object, thus the one carrying its hash index
+static bool __dict_is_first(struct dict* dict) {
+    return dict->prev == 0 || (dict->prev->type == JSON_OBJ && dict->prev->value.object == dict);
+}
+
+static void __dict_index_free(struct dict_index* index) {
+    if(index == 0) return;
+    __dict_release(index->arena, index->slots);
+    __dict_release(index->arena, index);
+    return;
+}
+
+static void __dict_index_place(struct dict_index* index, unsigned int hash, struct dict* element) {
+    size_t mask = index->size - 1;
+    size_t i = hash & mask;
+    while(index->slots[i].element != 0) i = (i + 1) & mask;
+    index->slots[i].hash = hash;
+    index->slots[i].element = element;
+    index->count++;
+    return;
+}
+
+//Inserts element into index, growing it to keep the load factor below 1/2
+static void __dict_index_insert(struct dict_index* index, struct dict* element) {
+    if(element->key == 0) return;
+    if((index->count + 1) * 2 > index->size) {
+        struct dict_index_slot* old_slots = index->slots;
+        size_t old_size = index->size;
+        index->size *= 2;
+        index->slots = (struct dict_index_slot*) dict_arena_alloc(index->arena, index->size * sizeof(struct dict_index_slot));
+        memset(index->slots, 0, index->size * sizeof(struct dict_index_slot));
+        index->count = 0;
+        for(size_t i = 0; i < old_size; i++)
+            if(old_slots[i].element != 0) __dict_index_place(index, old_slots[i].hash, old_slots[i].element);
+        __dict_release(index->arena, old_slots);
+    }
+    __dict_index_place(index, __dict_hash(element->key), element);
+    return;
+}
+
+static struct dict* __dict_index_lookup(struct dict_index* index, const char* key) {
+    unsigned int hash = __dict_hash(key);
+    size_t mask = index->size - 1;
+    for(size_t i = hash & mask; index->slots[i].element != 0; i = (i + 1) & mask) {
+        if(index->slots[i].hash == hash && index->slots[i].element->key != 0 && strcmp(key, index->slots[i].element->key) == 0)
+            return index->slots[i].element;
+    }
+    return NULL;
+}
+
+//Removes element from index, closing the gap by shifting back following slots of the probe sequence
+static void __dict_index_remove(struct dict_index* index, struct dict* element) {
+    if(element->key == 0) return;
+    size_t mask = index->size - 1;
+    size_t i = __dict_hash(element->key) & mask;
+    while(index->slots[i].element != element) {
+        if(index->slots[i].element == 0) return; //not indexed
+        i = (i + 1) & mask;
+    }
+    for(size_t j = (i + 1) & mask; index->slots[j].element != 0; j = (j + 1) & mask) {
+        size_t home = index->slots[j].hash & mask;
+        //move slot j to gap i, if its home slot is not cyclically in (i, j]
+        if((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i].element = 0;
+    index->count--;
+    return;
+}
+
+//Builds the hash index for the object starting with first element dict
+static void __dict_index_build(struct dict* dict) {
+    struct dict_index* index = (struct dict_index*) dict_arena_alloc(dict->arena, sizeof(struct dict_index));
+    index->size = DICT_INDEX_MIN_SIZE;
+    index->count = 0;
+    index->arena = dict->arena;
+    index->slots = (struct dict_index_slot*) dict_arena_alloc(index->arena, index->size * sizeof(struct dict_index_slot));
+    memset(index->slots, 0, index->size * sizeof(struct dict_index_slot));
+    for(struct dict* element = dict; element != 0; element = element->next)
+        __dict_index_insert(index, element);
+    dict->index = index;
+    return;
+}
+
+//Serializer helper functions
+
+//Field width of hexadecimal numbers, in order of HEX_FORMAT_* constants
+static const int __json_hex_width[] = { 0, 2, 4, 5, 8 };
+
+//Ensures space for n more bytes and \0 in buf
+static void __buf_reserve(struct dict_buffer* buf, size_t n) {
+    if(buf->len + n + 1 <= buf->size) return;
+    size_t size = buf->size ? buf->size : DICT_BUFFER_MIN_SIZE;
+    while(size < buf->len + n + 1) size *= 2;
+    char* data = (char*) realloc(buf->data, size);
+    if(data == NULL) {
+        fprintf(stderr, "ERROR: Buffer could not be allocated for JSON output\n");
+        abort();
+    }
+    buf->data = data;
+    buf->size = size;
+    return;
+}
+
+static inline void __buf_put(struct dict_buffer* buf, const char* str, size_t len) {
+    __buf_reserve(buf, len);
+    memcpy(buf->data + buf->len, str, len);
+    buf->len += len;
+    return;
+}
+
+static inline void __buf_putc(struct dict_buffer* buf, char c) {
+    __buf_reserve(buf, 1);
+    buf->data[buf->len++] = c;
+    return;
+}
+
+//Same as "%s", including "(null)" for NULL-Pointers
+static inline void __buf_puts(struct dict_buffer* buf, const char* str) {
+    if(str == 0) str = "(null)";
+    __buf_put(buf, str, strlen(str));
+    return;
+}
+
+//Same as "%llu", but zero padded to at least width digits
+static void __buf_put_uint(struct dict_buffer* buf, unsigned long long number, int width) {
+    char digits[24];
+    int pos = sizeof(digits);
+    do {
+        digits[--pos] = '0' + number % 10;
+        number /= 10;
+    } while(number != 0 || (int) sizeof(digits) - pos < width);
+    __buf_put(buf, digits + pos, sizeof(digits) - pos);
+    return;
+}
+
+//Same as "%lld"
+static void __buf_put_int(struct dict_buffer* buf, long long int number) {
+    if(number < 0) {
+        __buf_putc(buf, '-');
+        __buf_put_uint(buf, -(unsigned long long) number, 0);
+    } else {
+        __buf_put_uint(buf, number, 0);
+    }
+    return;
+}
+
+//Same as __json_hex_format[format]
+static void __buf_put_hex(struct dict_buffer* buf, unsigned long int number, __uint8_t format) {
+    static const char hex_digits[] = "0123456789abcdef";
+    char digits[2 * sizeof(number)];
+    int width = format <= HEX_FORMAT_08 ? __json_hex_width[format] : 0;
+    int pos = sizeof(digits);
+    do {
+        digits[--pos] = hex_digits[number & 0xf];
+        number >>= 4;
+    } while(number != 0);
+    __buf_put(buf, "\"0x", 3);
+    for(int i = sizeof(digits) - pos; i < width; i++) __buf_putc(buf, '0');
+    __buf_put(buf, digits + pos, sizeof(digits) - pos);
+    __buf_putc(buf, '"');
+    return;
+}
+
+//Same as "%Lf"
+static void __buf_put_float(struct dict_buffer* buf, long double number) {
+    //Fast path for common magnitudes, if the rounding of the 6th decimal place can be decided exactly, despite the error of scaling.
+    if(number > -1e13L && number < 1e13L) { //also false for NaN
+        bool negative = signbit(number);
+        long double scaled = (negative ? -number : number) * 1e6L;
+        unsigned long long int_part = (unsigned long long) scaled;
+        long double frac = scaled - (long double) int_part;
+        long double frac_dist = frac > 0.5L ? frac - 0.5L : 0.5L - frac;
+        if(frac_dist > scaled * LDBL_EPSILON * 2) {
+            if(frac > 0.5L) int_part++;
+            if(negative) __buf_putc(buf, '-');
+            __buf_put_uint(buf, int_part / 1000000, 0);
+            __buf_putc(buf, '.');
+            __buf_put_uint(buf, int_part % 1000000, 6);
+            return;
+        }
+    }
+    int len = snprintf(NULL, 0, "%Lf", number);
+    __buf_reserve(buf, len);
+    snprintf(buf->data + buf->len, len + 1, "%Lf", number);
+    buf->len += len;
+    return;
+}
+
+//Writes key of a member, preceded by a separator, if it is not the first member of the current object
+static inline void __buf_put_key(struct dict_buffer* buf, const char* key) {
+    if(buf->len > 0 && buf->data[buf->len - 1] != '{') __buf_put(buf, ", ", 2);
+    __buf_putc(buf, '"');
+    __buf_puts(buf, key);
+    __buf_put(buf, "\":", 2);
+    return;
+}
+
+//Puts a dict or array on the nesting stack of buf
+static void __buf_push_frame(struct dict_buffer* buf, size_t* depth, struct dict* dict, struct array* array, bool is_array) {
+    if(*depth == buf->stack_size) {
+        size_t stack_size = buf->stack_size ? buf->stack_size * 2 : DICT_BUFFER_MIN_DEPTH;
+        struct dict_dump_frame* stack = (struct dict_dump_frame*) realloc(buf->stack, stack_size * sizeof(struct dict_dump_frame));
+        if(stack == NULL) {
+            fprintf(stderr, "ERROR: Buffer could not be allocated for JSON output\n");
+            abort();
+        }
+        buf->stack = stack;
+        buf->stack_size = stack_size;
+    }
+    buf->stack[*depth].dict = dict;
+    buf->stack[*depth].array = array;
+    buf->stack[*depth].is_array = is_array;
+    buf->stack[*depth].sep = false;
+    (*depth)++;
+    return;
+}
+
+//Opens a nested dict or array, to be continued by the loop in __dict_dumpbuf(...)
+static void __buf_push(struct dict_buffer* buf, size_t* depth, struct dict* dict, struct array* array, bool is_array) {
+    __buf_push_frame(buf, depth, dict, array, is_array);
+    __buf_putc(buf, is_array ? '[' : '{');
+    return;
+}
+
+//Iterative serialization of dict resp. array, with the same output as __dict_print(...) and __array_print(...).
+//Appends to the content of buf.
+static size_t __dict_dumpbuf(struct dict_buffer* buf, struct dict* dict, struct array* array, bool is_array) {
+    size_t depth = 0;
+    __buf_push(buf, &depth, dict, array, is_array);
+    while(depth > 0) {
+        struct dict_dump_frame* frame = &buf->stack[depth - 1];
+        bool next = false;
+        if(frame->is_array) {
+            struct array* element = frame->array;
+            if(element == 0) { //end of array
+                __buf_putc(buf, ']');
+                if(--depth > 0 && buf->stack[depth - 1].sep) __buf_put(buf, ", ", 2);
+                continue;
+            }
+            frame->array = element->next;
+            frame->sep = next = element->next != 0;
+            switch(element->type) {
+                case JSON_EMPTY: break;
+                case JSON_NULL: __buf_put(buf, "null ", 5); break;
+                case JSON_BOOL: if(element->value.boolean) __buf_put(buf, "true", 4); else __buf_put(buf, "false", 5); break;
+                case JSON_HEX: __buf_put_hex(buf, element->value.hex.number, element->value.hex.format); break;
+                case JSON_INT: __buf_put_int(buf, element->value.integer); break;
+                case JSON_FLOAT: __buf_put_float(buf, element->value.floating); break;
+                case JSON_STR: __buf_putc(buf, '"'); __buf_puts(buf, element->value.string); __buf_putc(buf, '"'); break;
+                case JSON_ARRAY: __buf_push(buf, &depth, 0, element->value.array, true); continue;
+                case JSON_OBJ: __buf_push(buf, &depth, element->value.object, 0, false); continue;
+                default: break;
+            }
+        } else {
+            struct dict* element = frame->dict;
+            if(element == 0) { //end of dict
+                __buf_putc(buf, '}');
+                if(--depth > 0 && buf->stack[depth - 1].sep) __buf_put(buf, ", ", 2);
+                continue;
+            }
+            if(element->next == element || element->prev == element || (element->type == JSON_OBJ && element->value.object == element) ) {
+                fprintf(stderr, "ERROR: Loop in dict %p\n", element);
+                dict_printelement(stderr,element);
+                fprintf(stderr, "Aborting... %p\n", element);
+                abort();
+            }
+            frame->dict = element->next;
+            frame->sep = next = element->next != 0;
+            if(element->type != JSON_EMPTY) {
+                __buf_putc(buf, '"');
+                __buf_puts(buf, element->key);
+                __buf_put(buf, "\":", 2);
+            }
+            switch(element->type) {
+                case JSON_EMPTY: break;
+                case JSON_NULL: __buf_put(buf, "null", 4); break;
+                case JSON_BOOL: if(element->value.boolean) __buf_put(buf, "true", 4); else __buf_put(buf, "false", 5); break;
+                case JSON_HEX: __buf_put_hex(buf, element->value.hex.number, element->value.hex.format); break;
+                case JSON_INT: __buf_put_int(buf, element->value.integer); break;
+                case JSON_FLOAT: __buf_put_float(buf, element->value.floating); break;
+                case JSON_STR: __buf_putc(buf, '"'); __buf_puts(buf, element->value.string); __buf_putc(buf, '"'); break;
+                case JSON_ARRAY: __buf_push(buf, &depth, 0, element->value.array, true); continue;
+                case JSON_OBJ: __buf_push(buf, &depth, element->value.object, 0, false); continue;
+                default: break;
+            }
+        }
+        if(next) __buf_put(buf, ", ", 2);
+    }
+    buf->data[buf->len] = 0;
+    return buf->len;
+}
+
+//CBOR helper functions, see RFC 8949
+
+#define CBOR_UINT 0x00
+#define CBOR_NEGINT 0x20
+#define CBOR_BYTES 0x40
+#define CBOR_TEXT 0x60
+#define CBOR_ARRAY_INDEF 0x9f
+#define CBOR_MAP_INDEF 0xbf
+#define CBOR_FALSE 0xf4
+#define CBOR_TRUE 0xf5
+#define CBOR_NULL 0xf6
+#define CBOR_FLOAT64 0xfb
+#define CBOR_BREAK 0xff
+
+//Writes the initial byte of a data item with major type major and its argument in the shortest form
+static void __cbor_put_head(struct dict_buffer* buf, __uint8_t major, unsigned long long argument) {
+    char head[9];
+    int len = 1;
+    if(argument < 24) {
+        head[0] = major | argument;
+    } else if(argument <= 0xff) {
+        head[0] = major | 24;
+        len += 1;
+    } else if(argument <= 0xffff) {
+        head[0] = major | 25;
+        len += 2;
+    } else if(argument <= 0xffffffff) {
+        head[0] = major | 26;
+        len += 4;
+    } else {
+        head[0] = major | 27;
+        len += 8;
+    }
+    for(int i = len - 1; i > 0; i--) { //big endian
+        head[i] = argument & 0xff;
+        argument >>= 8;
+    }
+    __buf_put(buf, head, len);
+    return;
+}
+
+static inline void __cbor_put_int(struct dict_buffer* buf, long long int number) {
+    if(number < 0)
+        __cbor_put_head(buf, CBOR_NEGINT, -1 - number);
+    else
+        __cbor_put_head(buf, CBOR_UINT, number);
+    return;
+}
+
+static inline void __cbor_put_float(struct dict_buffer* buf, long double number) {
+    double value = (double) number;
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    __buf_putc(buf, CBOR_FLOAT64);
+    for(int i = 7; i >= 0; i--) __buf_putc(buf, (bits >> (8 * i)) & 0xff);
+    return;
+}
+
+//Writes a text string, resp. null for NULL-Pointers
+static inline void __cbor_put_text(struct dict_buffer* buf, const char* str) {
+    if(str == 0) {
+        __buf_putc(buf, CBOR_NULL);
+        return;
+    }
+    size_t len = strlen(str);
+    __cbor_put_head(buf, CBOR_TEXT, len);
+    __buf_put(buf, str, len);
+    return;
+}
+
+//Writes the value of an element, except for objects and arrays
+static inline void __cbor_put_value(struct dict_buffer* buf, __uint8_t type, union json_type value) {
+    switch(type) {
+        case JSON_NULL: __buf_putc(buf, CBOR_NULL); break;
+        case JSON_BOOL: __buf_putc(buf, value.boolean ? CBOR_TRUE : CBOR_FALSE); break;
+        case JSON_HEX: __cbor_put_head(buf, CBOR_UINT, value.hex.number); break;
+        case JSON_INT: __cbor_put_int(buf, value.integer); break;
+        case JSON_FLOAT: __cbor_put_float(buf, value.floating); break;
+        case JSON_STR: __cbor_put_text(buf, value.string); break;
+        default: break;
+    }
+    return;
+}
+
+//Iterative serialization of dict resp. array as CBOR. Appends to the content of buf.
+//If members is true, only the elements of the outermost dict are written, not the enclosing map itself.
+static size_t __dict_dumpcbor(struct dict_buffer* buf, struct dict* dict, struct array* array, bool is_array, bool members) {
+    size_t depth = 0;
+    __buf_push_frame(buf, &depth, dict, array, is_array);
+    if(!members) __buf_putc(buf, is_array ? CBOR_ARRAY_INDEF : CBOR_MAP_INDEF);
+    while(depth > 0) {
+        struct dict_dump_frame* frame = &buf->stack[depth - 1];
+        if(frame->is_array) {
+            struct array* element = frame->array;
+            if(element == 0) { //end of array
+                __buf_putc(buf, CBOR_BREAK);
+                depth--;
+                continue;
+            }
+            frame->array = element->next;
+            switch(element->type) {
+                case JSON_EMPTY: break;
+                case JSON_ARRAY: __buf_push_frame(buf, &depth, 0, element->value.array, true); __buf_putc(buf, CBOR_ARRAY_INDEF); break;
+                case JSON_OBJ: __buf_push_frame(buf, &depth, element->value.object, 0, false); __buf_putc(buf, CBOR_MAP_INDEF); break;
+                default: __cbor_put_value(buf, element->type, element->value); break;
+            }
+        } else {
+            struct dict* element = frame->dict;
+            if(element == 0) { //end of dict
+                if(depth > 1 || !members) __buf_putc(buf, CBOR_BREAK);
+                depth--;
+                continue;
+            }
+            if(element->next == element || element->prev == element || (element->type == JSON_OBJ && element->value.object == element) ) {
+                fprintf(stderr, "ERROR: Loop in dict %p\n", element);
+                dict_printelement(stderr,element);
+                fprintf(stderr, "Aborting... %p\n", element);
+                abort();
+            }
+            frame->dict = element->next;
+            if(element->type == JSON_EMPTY) continue;
+            __cbor_put_text(buf, element->key);
+            switch(element->type) {
+                case JSON_ARRAY: __buf_push_frame(buf, &depth, 0, element->value.array, true); __buf_putc(buf, CBOR_ARRAY_INDEF); break;
+                case JSON_OBJ: __buf_push_frame(buf, &depth, element->value.object, 0, false); __buf_putc(buf, CBOR_MAP_INDEF); break;
+                default: __cbor_put_value(buf, element->type, element->value); break;
+            }
+        }
+    }
+    return buf->len;
+}
+
+//Writes key of a member in the format of buf
+static inline void __emit_key(struct dict_buffer* buf, const char* key) {
+    if(buf->format == DICT_FORMAT_CBOR)
+        __cbor_put_text(buf, key);
+    else
+        __buf_put_key(buf, key);
+    return;
+}
+
+//Compiled path helper functions
+
+//Generation of all dicts, increased whenever elements may have been released, thus invalidating elements cached by compiled paths
+static unsigned long int __dict_generation = 0;
+
+//List of parent paths shared by compiled paths
+static struct dict_path_parent* __dict_path_parents = NULL;
+
+//Returns the shared parent path consisting of path_len keys, creating it if not existing yet
+static struct dict_path_parent* __dict_path_parent_get(unsigned int path_len, char** keys) {
+    struct dict_path_parent* parent = __dict_path_parents;
+    for(; parent != 0; parent = parent->next) {
+        if(parent->path_len != path_len) continue;
+        unsigned int i = 0;
+        while(i < path_len && strcmp(parent->keys[i], keys[i]) == 0) i++;
+        if(i == path_len) {
+            parent->refs++;
+            return parent;
+        }
+    }
+    parent = (struct dict_path_parent*) calloc(1, sizeof(struct dict_path_parent));
+    if(parent == 0) return NULL;
+    parent->keys = (char**) calloc(path_len, sizeof(char*));
+    if(parent->keys == 0) {
+        free(parent);
+        return NULL;
+    }
+    for(unsigned int i = 0; i < path_len; i++) parent->keys[i] = strdup(keys[i]);
+    parent->path_len = path_len;
+    parent->refs = 1;
+    parent->next = __dict_path_parents;
+    __dict_path_parents = parent;
+    return parent;
+}
+
+//Searches the element of type JSON_OBJ at the end of path keys in dict, creating missing objects if DICT_DYN_PATH_UPDATES is enabled.
+//Returns NULL, if the path is blocked by a non-JSON Object.
+static struct dict* __dict_path_resolve(struct dict* dict, unsigned int path_len, char** keys) {
+    struct dict* parent = 0; //element of type JSON_OBJ holding object
+    struct dict* object = dict; //first element of the object to search in
+    struct dict* prev_dict = 0;
+    for(unsigned int i = 0; i < path_len; i++) {
+        struct dict* element = __dict_plainsearch(object, keys[i], &prev_dict);
+        if(element == 0) { //Check if path is existing
+            #if DICT_DYN_PATH_UPDATES > 0
+                element = __dict_add(object, JSON_OBJ, (union json_type) dict_new_arena(dict->arena), keys[i]); //if not make it existing
+                if(parent != 0 && parent->value.object == element) //first one in a nested dict,...
+                    element->prev = parent; //...thus link it back to parent
+                element->value.object->prev = element; //Link inserted nested dict with parent dict
+            #else
+                return NULL;
+            #endif
+        }
+        if(element->type != JSON_OBJ) return NULL; //non-JSON Object on path
+        parent = element;
+        object = element->value.object;
+    }
+    return parent;
+}
+
 //Function Definitions
 
 char* json_typetostr(int json_type) {
@@ -55,11 +639,21 @@ char* json_typetostr(int json_type) {
 
 struct dict* json_dict(bool reset) {
     static struct dict* dict = NULL;
+#if DICT_JSON_DICT_ARENA > 0
+    static struct dict_arena* arena = NULL;
+    if(arena == NULL) arena = dict_arena_new(DICT_ARENA_CHUNK_SIZE);
+    if(dict == NULL) return dict = dict_new_arena(arena);
+    if(reset) { //no need to walk the dict, everything is released at once
+        dict_arena_reset(arena);
+        return dict = dict_new_arena(arena);
+    }
+#else
     if(dict == NULL) return dict = dict_new();
     if(reset) {
         dict_free(dict);
         return dict = dict_new();
     } 
+#endif
     return dict;
 }
 
@@ -149,41 +743,128 @@ struct array* array_new(){
     return (struct array *)calloc(1,sizeof(struct array)); //sets array->type = JSON_EMPTY and all other vars to 0;
 }
 
-struct array* array_add(struct array* array, __uint8_t type, union json_type value) {
-    struct array* new = array;
-    if(array->next == 0) {
-        if(new->type != JSON_EMPTY) new = array_new();
-        array->next = new;
-        new->next = 0;
-        new->type = type;
-        switch(type) {
-            case JSON_NULL: break;
-            case JSON_BOOL: new->value.boolean = value.boolean; break;
-            case JSON_HEX: 
-                new->value.hex.number = value.hex.number;
-                new->value.hex.format = value.hex.format;
-                break;
-            case JSON_INT: new->value.integer = value.integer; break;
-            case JSON_FLOAT: new->value.floating = value.floating; break;
-            case JSON_STR:
-                new->value.string = malloc(strlen(value.string)+1);
-                memset(new->value.string, 0, strlen(value.string)+1);
-                strncpy(new->value.string, value.string, strlen(value.string));
-                break;
-            case JSON_ARRAY: new->value.array = value.array; break;
-            case JSON_OBJ: new->value.object = value.object; break;
-            default: new->type = JSON_NULL; break;
+struct dict* dict_new_arena(struct dict_arena* arena){
+    if(arena == 0) return dict_new();
+    struct dict* dict = (struct dict*)dict_arena_alloc(arena, sizeof(struct dict));
+    if(dict == 0) return NULL;
+    memset(dict, 0, sizeof(struct dict)); //sets dict->type = JSON_EMPTY and all other vars to 0;
+    dict->arena = arena;
+    return dict;
+}
+
+struct array* array_new_arena(struct dict_arena* arena){
+    if(arena == 0) return array_new();
+    struct array* array = (struct array*)dict_arena_alloc(arena, sizeof(struct array));
+    if(array == 0) return NULL;
+    memset(array, 0, sizeof(struct array)); //sets array->type = JSON_EMPTY and all other vars to 0;
+    array->arena = arena;
+    return array;
+}
+
+struct dict_arena* dict_arena_new(size_t chunk_size) {
+    struct dict_arena* arena = (struct dict_arena*)calloc(1, sizeof(struct dict_arena));
+    if(arena == 0) return NULL;
+    arena->chunk_size = (chunk_size + DICT_ARENA_ALIGN - 1) & ~((size_t) DICT_ARENA_ALIGN - 1);
+    arena->chunks = arena->current = __dict_arena_chunk_new(arena->chunk_size);
+    if(arena->chunks == 0) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void* dict_arena_alloc(struct dict_arena* arena, size_t size) {
+    if(arena == 0) return malloc(size);
+    struct dict_arena_chunk* chunk = arena->current;
+    size = (size + DICT_ARENA_ALIGN - 1) & ~((size_t) DICT_ARENA_ALIGN - 1);
+    if(size > arena->chunk_size) { //too large for regular chunks, give it a chunk of its own
+        chunk = __dict_arena_chunk_new(size);
+        if(chunk == 0) return NULL;
+        chunk->next = arena->large;
+        arena->large = chunk;
+        chunk->used = size;
+        return __DICT_ARENA_CHUNK_DATA(chunk);
+    }
+    if(chunk->size - chunk->used < size) { //current chunk exhausted, continue with next one kept from before or a new one
+        if(chunk->next == 0) {
+            chunk->next = __dict_arena_chunk_new(arena->chunk_size);
+            if(chunk->next == 0) return NULL;
         }
-        new->next = 0;
-        return new;
-    } else {
-        array_add(array->next, type, value);
+        chunk = arena->current = chunk->next;
+        chunk->used = 0;
     }
-    return NULL;
+    void* ptr = __DICT_ARENA_CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void dict_arena_reset(struct dict_arena* arena) {
+    if(arena == 0) return;
+    while(arena->large != 0) {
+        struct dict_arena_chunk* next = arena->large->next;
+        free(arena->large);
+        arena->large = next;
+    }
+    __dict_generation++; //elements are released
+    for(size_t i = 0; i < arena->owned_count; i++) free(arena->owned[i]);
+    arena->owned_count = 0;
+    arena->current = arena->chunks;
+    arena->current->used = 0;
+    return;
+}
+
+void dict_arena_free(struct dict_arena* arena) {
+    if(arena == 0) return;
+    dict_arena_reset(arena);
+    while(arena->chunks != 0) {
+        struct dict_arena_chunk* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena->owned);
+    free(arena);
+    return;
+}
+
+struct array* array_add(struct array* array, __uint8_t type, union json_type value) {
+    struct array* new = array->tail != 0 ? array->tail : array; //start at the last element, if known
+    while(new->next != 0) new = new->next;
+    if(new->type != JSON_EMPTY) { //end of list reached, new element needed
+        struct array* last = new;
+        new = array_new_arena(array->arena);
+        last->next = new;
+    }
+    array->tail = new;
+    new->next = 0;
+    new->type = type;
+    new->str_mode = DICT_STR_COPY;
+    switch(type) {
+        case JSON_NULL: break;
+        case JSON_BOOL: new->value.boolean = value.boolean; break;
+        case JSON_HEX: 
+            new->value.hex.number = value.hex.number;
+            new->value.hex.format = value.hex.format;
+            break;
+        case JSON_INT: new->value.integer = value.integer; break;
+        case JSON_FLOAT: new->value.floating = value.floating; break;
+        case JSON_STR:
+        case JSON_STR_REF:
+        case JSON_STR_OWN:
+            new->type = JSON_STR;
+            new->value.string = __dict_setstr(new->arena, type, value.string, &new->str_mode);
+            break;
+        case JSON_ARRAY: new->value.array = value.array; break;
+        case JSON_OBJ: new->value.object = value.object; break;
+        default: new->type = JSON_NULL; break;
+    }
+    return new;
 }
 
 struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type value, unsigned int path_len, ...) {
-    if(path_len < 1 || dict == 0) return NULL;
+    if(path_len < 1 || dict == 0) {
+        if(type == JSON_STR_OWN) free(value.string); //ownership is transfered, even if updating fails
+        return NULL;
+    }
     va_list valist;
     char* next_key = 0;
     struct dict* next_dict = dict;
@@ -219,10 +900,10 @@ struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type valu
             #if DICT_DYN_PATH_UPDATES > 0
                 if(i==0) {
                     //next_dict = __dict_add(dict, JSON_OBJ, (union json_type) dict_new(), next_key); //if not make it existing
-                    next_dict = dict_update(dict, JSON_OBJ, (union json_type) dict_new(), 1, next_key);
+                    next_dict = dict_update(dict, JSON_OBJ, (union json_type) dict_new_arena(dict->arena), 1, next_key);
                 } else {
                     //next_dict = __dict_add(old_next_dict->value.object, JSON_OBJ, (union json_type) dict_new(), next_key); //if not make it existing
-                    next_dict = dict_update(old_next_dict->value.object, JSON_OBJ, (union json_type) dict_new(), 1, next_key);
+                    next_dict = dict_update(old_next_dict->value.object, JSON_OBJ, (union json_type) dict_new_arena(dict->arena), 1, next_key);
                 }
 
                 if(old_next_dict->value.object == next_dict) //Check if parent dict is linked with last dict, if so it is the first one in a nested dict,...
@@ -233,12 +914,14 @@ struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type valu
 
             #else
                 va_end(valist); //destroy valist
+                if(type == JSON_STR_OWN) free(value.string); //ownership is transfered, even if updating fails
                 return NULL;
             #endif
         }
         if(next_dict->type != JSON_OBJ){ //Check if a non-JSON Object is on path
             //fprintf(stderr, "non-JSON Obj on path %s\n", next_key);
             va_end(valist); //destroy valist
+            if(type == JSON_STR_OWN) free(value.string); //ownership is transfered, even if updating fails
             return NULL;
         }
         next_key = va_arg(valist, char *);
@@ -249,13 +932,12 @@ struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type valu
     //get last key of path by descending in next_dict
     last_dict = __dict_plainsearch(next_dict->value.object, next_key, &prev_dict);
 
-    if(last_dict != 0){ //if update is exisiting in dict, make it empty first, thus possible included string(s), arrays or dicts must be freed
-        dict_empty(last_dict);
+    if(last_dict != 0){ //if update is exisiting in dict, make it empty first, thus possible included string(s), arrays or dicts must be freed,...
+        last_dict = __dict_add(dict_empty(last_dict), type, value, next_key); //...and reuse it in place
+    } else { //inserting *in* last nested dict in path
+        last_dict = __dict_add(next_dict->value.object, type, value, next_key);
     }
 
-    //inserting *in* last nested dict in path
-    last_dict = __dict_add(next_dict->value.object, type, value, next_key);
-
     if(next_dict->value.object == last_dict) //Check if parent dict is linked with last dict, if so it is the first one in a nested dict,...
         last_dict->prev = next_dict; //...thus link it back to parent
 
@@ -267,42 +949,141 @@ struct dict* dict_update(struct dict* dict, __uint8_t type, union json_type valu
 
 struct dict* __dict_add(struct dict* dict, __uint8_t type, union json_type value, char* key) {
     struct dict* new = dict;
-    if(dict->next == 0 || dict->type == JSON_EMPTY) { //Last element in list or Empty Element
-        //fprintf(stderr, "INSERT POINT FOUND!\n");
-        if(dict->type != JSON_EMPTY) { //Implicit ... && dict->next == 0, thus end of linked list and new dict-element needed.
-            new = dict_new();
-            new->next = 0;
-            new->prev = dict;
-            dict->next = new;
-        }
-        new->key = malloc(strlen(key)+1); //+1 for \0
-        memset(new->key, 0, strlen(key)+1);
-        strncpy(new->key, key, strlen(key));
-        new->type = type;
-        switch(type) {
-            case JSON_NULL: break;
-            case JSON_BOOL: new->value.boolean = value.boolean; break;
-            case JSON_HEX:
-                new->value.hex.number = value.hex.number;
-                new->value.hex.format = value.hex.format;
-                break;
-            case JSON_INT: new->value.integer = value.integer; break;
-            case JSON_FLOAT: new->value.floating = value.floating; break;
-            case JSON_STR:
-                new->value.string = malloc(strlen(value.string)+1);
-                memset(new->value.string, 0, strlen(value.string)+1);
-                strncpy(new->value.string, value.string, strlen(value.string));
-                break;
-            case JSON_ARRAY: new->value.array = value.array; break;
-            case JSON_OBJ: new->value.object = value.object; break;
-            default: new->type = JSON_NULL; break;
+    size_t len = 1;
+    bool appended = false;
+    bool first = __dict_is_first(dict);
+    if(first && dict->index != 0 && dict->tail != 0 && dict->type != JSON_EMPTY) new = dict->tail; //Large object, continue at its last element. Smaller ones are walked to count their length.
+    while(new->next != 0 && new->type != JSON_EMPTY) { //Search last element in list or Empty Element
+        new = new->next;
+        len++;
+    }
+    //fprintf(stderr, "INSERT POINT FOUND!\n");
+    if(new->type != JSON_EMPTY) { //Implicit ... && new->next == 0, thus end of linked list and new dict-element needed.
+        struct dict* last = new;
+        new = dict_new_arena(dict->arena);
+        new->next = 0;
+        new->prev = last;
+        last->next = new;
+        appended = true;
+        len++;
+    }
+    if(first && new->next == 0) dict->tail = new;
+    new->key = __dict_strdup(new->arena, key);
+    new->type = type;
+    new->str_mode = DICT_STR_COPY;
+    switch(type) {
+        case JSON_NULL: break;
+        case JSON_BOOL: new->value.boolean = value.boolean; break;
+        case JSON_HEX:
+            new->value.hex.number = value.hex.number;
+            new->value.hex.format = value.hex.format;
+            break;
+        case JSON_INT: new->value.integer = value.integer; break;
+        case JSON_FLOAT: new->value.floating = value.floating; break;
+        case JSON_STR:
+        case JSON_STR_REF:
+        case JSON_STR_OWN:
+            new->type = JSON_STR;
+            new->value.string = __dict_setstr(new->arena, type, value.string, &new->str_mode);
+            break;
+        case JSON_ARRAY: new->value.array = value.array; break;
+        case JSON_OBJ: new->value.object = value.object; break;
+        default: new->type = JSON_NULL; break;
+    }
+    //Maintain hash index of the object. Reused elements keep their key, thus are indexed allready.
+    if(appended && __dict_is_first(dict)) {
+        if(dict->index != 0)
+            __dict_index_insert(dict->index, new);
+        else if(len > DICT_INDEX_THRESHOLD)
+            __dict_index_build(dict);
+    }
+    return new;
+}
+
+struct dict_path* dict_path_compile(unsigned int path_len, ...) {
+    if(path_len < 1) return NULL;
+    struct dict_path* path = (struct dict_path*) calloc(1, sizeof(struct dict_path));
+    char** keys = (char**) calloc(path_len, sizeof(char*));
+    if(path == 0 || keys == 0) {
+        free(path);
+        free(keys);
+        return NULL;
+    }
+    va_list valist;
+    va_start(valist, path_len);
+    for(unsigned int i = 0; i < path_len; i++) keys[i] = va_arg(valist, char *);
+    va_end(valist);
+
+    path->key = strdup(keys[path_len-1]);
+    if(path_len > 1) {
+        path->parent = __dict_path_parent_get(path_len-1, keys);
+        if(path->parent == 0) {
+            free(path->key);
+            free(path);
+            path = NULL;
         }
-        return new;
+    }
+    free(keys);
+    return path;
+}
+
+struct dict* dict_set_path(struct dict* dict, struct dict_path* path, __uint8_t type, union json_type value) {
+    if(dict == 0 || path == 0) {
+        if(type == JSON_STR_OWN) free(value.string); //ownership is transfered, even if updating fails
+        return NULL;
+    }
+    struct dict* element = 0;
+    if(path->element != 0 && path->root == dict && path->generation == __dict_generation) { //Element still in place, reuse it without any search
+        element = __dict_add(dict_empty(path->element), type, value, path->key);
     } else {
-        new = __dict_add(dict->next, type, value, key);
-        return new;
+        struct dict* parent = 0; //element of type JSON_OBJ holding the element
+        struct dict* object = dict; //first element of the object holding the element
+        struct dict* prev_dict = 0;
+        if(path->parent != 0) {
+            struct dict_path_parent* cache = path->parent;
+            if(cache->element == 0 || cache->root != dict || cache->generation != __dict_generation) { //resolve parent path once per generation
+                cache->element = __dict_path_resolve(dict, cache->path_len, cache->keys);
+                cache->root = dict;
+                cache->generation = __dict_generation;
+            }
+            parent = cache->element;
+            if(parent == 0) {
+                if(type == JSON_STR_OWN) free(value.string); //ownership is transfered, even if updating fails
+                return NULL;
+            }
+            object = parent->value.object;
+        }
+        element = __dict_plainsearch(object, path->key, &prev_dict);
+        if(element != 0) //if update is exisiting in dict, make it empty first and reuse it in place
+            element = __dict_add(dict_empty(element), type, value, path->key);
+        else
+            element = __dict_add(object, type, value, path->key);
+        if(parent != 0 && parent->value.object == element) //Check if parent dict is linked with element, if so it is the first one in a nested dict,...
+            element->prev = parent; //...thus link it back to parent
     }
-    return new;
+    if(type == JSON_OBJ) //Link an inserted nested dict with parent dict
+        element->value.object->prev = element;
+    //dict_empty(...) may have released a nested dict, so the generation is taken afterwards
+    path->root = dict;
+    path->generation = __dict_generation;
+    path->element = element;
+    return element;
+}
+
+void dict_path_free(struct dict_path* path) {
+    if(path == 0) return;
+    struct dict_path_parent* parent = path->parent;
+    if(parent != 0 && --parent->refs == 0) { //last user of the parent path, unlink and free it
+        struct dict_path_parent** link = &__dict_path_parents;
+        while(*link != parent) link = &(*link)->next;
+        *link = parent->next;
+        for(unsigned int i = 0; i < parent->path_len; i++) free(parent->keys[i]);
+        free(parent->keys);
+        free(parent);
+    }
+    free(path->key);
+    free(path);
+    return;
 }
 
 void dict_dump(FILE* fp, struct dict* dict) {
@@ -314,67 +1095,223 @@ void dict_dump(FILE* fp, struct dict* dict) {
 
 //unterschied zu dict_dump Wer kümmert sich hier um das free
 char* dict_dumpstr(struct dict* dict){
-    char *buf = 0;
-    size_t len = 0;
-    FILE* stream = open_memstream(&buf, &len);
-    if (stream == NULL) {
-        fprintf(stderr, "ERROR: Stream could not be opened by open_memstrem\n");
-        abort();
+    struct dict_buffer buf = {0};
+    dict_dumpbuf(&buf, dict);
+    free(buf.stack);
+    return buf.data; //has to be freed by calling function
+}
+
+size_t dict_dumpbuf(struct dict_buffer* buf, struct dict* dict) {
+    buf->len = 0;
+    return __dict_dumpbuf(buf, dict, 0, false);
+}
+
+size_t array_dumpbuf(struct dict_buffer* buf, struct array* array) {
+    buf->len = 0;
+    return __dict_dumpbuf(buf, 0, array, true);
+}
+
+size_t dict_dump_cbor(struct dict_buffer* buf, struct dict* dict) {
+    buf->len = 0;
+    return __dict_dumpcbor(buf, dict, 0, false, false);
+}
+
+void dict_buffer_free(struct dict_buffer* buf) {
+    __uint8_t format = buf->format;
+    free(buf->data);
+    free(buf->stack);
+    memset(buf, 0, sizeof(struct dict_buffer));
+    buf->format = format;
+    return;
+}
+
+void dict_emit_begin(struct dict_buffer* buf) {
+    buf->len = 0;
+    if(buf->format == DICT_FORMAT_CBOR)
+        __buf_putc(buf, CBOR_MAP_INDEF);
+    else
+        __buf_putc(buf, '{');
+    return;
+}
+
+size_t dict_emit_end(struct dict_buffer* buf) {
+    dict_emit_object_end(buf);
+    buf->data[buf->len] = 0;
+    return buf->len;
+}
+
+void dict_emit_object(struct dict_buffer* buf, const char* key) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __buf_putc(buf, CBOR_MAP_INDEF);
+    else
+        __buf_putc(buf, '{');
+    return;
+}
+
+void dict_emit_object_end(struct dict_buffer* buf) {
+    if(buf->format == DICT_FORMAT_CBOR)
+        __buf_putc(buf, CBOR_BREAK);
+    else
+        __buf_putc(buf, '}');
+    return;
+}
+
+void dict_emit_str(struct dict_buffer* buf, const char* key, const char* value) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR) {
+        __cbor_put_text(buf, value);
+        return;
+    }
+    __buf_putc(buf, '"');
+    __buf_puts(buf, value);
+    __buf_putc(buf, '"');
+    return;
+}
+
+void dict_emit_int(struct dict_buffer* buf, const char* key, long long int value) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __cbor_put_int(buf, value);
+    else
+        __buf_put_int(buf, value);
+    return;
+}
+
+void dict_emit_float(struct dict_buffer* buf, const char* key, long double value) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __cbor_put_float(buf, value);
+    else
+        __buf_put_float(buf, value);
+    return;
+}
+
+void dict_emit_hex(struct dict_buffer* buf, const char* key, unsigned long int number, __uint8_t format) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __cbor_put_head(buf, CBOR_UINT, number);
+    else
+        __buf_put_hex(buf, number, format);
+    return;
+}
+
+void dict_emit_bool(struct dict_buffer* buf, const char* key, bool value) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __buf_putc(buf, value ? CBOR_TRUE : CBOR_FALSE);
+    else if(value)
+        __buf_put(buf, "true", 4);
+    else
+        __buf_put(buf, "false", 5);
+    return;
+}
+
+void dict_emit_bytes(struct dict_buffer* buf, const char* key, const unsigned char* data, size_t len) {
+    static const char hex_digits[] = "0123456789abcdef";
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR) {
+        __cbor_put_head(buf, CBOR_BYTES, len);
+        if(len > 0) __buf_put(buf, (const char*) data, len);
+        return;
+    }
+    __buf_reserve(buf, 2 * len + 2);
+    char* out = buf->data + buf->len;
+    *out++ = '"';
+    for(size_t i = 0; i < len; i++) {
+        *out++ = hex_digits[data[i] >> 4];
+        *out++ = hex_digits[data[i] & 0xf];
     }
-    fprintf(stream, "{");
-    if(dict != 0) __dict_print(stream, dict);
-    fprintf(stream, "}");
-    fflush(stream);
-    fclose(stream);
-    return buf;
+    *out++ = '"';
+    buf->len = out - buf->data;
+    return;
 }
 
-void __dict_print(FILE* fp, struct dict* dict) {
+void dict_emit_dict(struct dict_buffer* buf, const char* key, struct dict* dict) {
+    __emit_key(buf, key);
+    if(buf->format == DICT_FORMAT_CBOR)
+        __dict_dumpcbor(buf, dict, 0, false, false);
+    else
+        __dict_dumpbuf(buf, dict, 0, false);
+    return;
+}
+
+void dict_emit_members(struct dict_buffer* buf, struct dict* dict) {
     if(dict == 0) return;
-    //fprintf(stdout,"\n##### %s ##### dict->next %s dict->prev %s\n", dict->key, dict->next ? dict->next->key : "NONE", dict->prev ? dict->prev->key : "NONE");
-    //fprintf(fp, "\"<%s>\\", dict->prev ? dict->prev->key ? dict->prev->key : "key nil" : "prev nil");
-    //dict_printelement(stderr, dict);
-
-    if(dict->next == dict || dict->prev == dict || (dict->type == JSON_OBJ && dict->value.object == dict) ) {
-        fprintf(stderr, "ERROR: Loop in dict %p\n", dict);
-        dict_printelement(stderr,dict);
-        fprintf(stderr, "Aborting... %p\n", dict);
-        abort();
+    if(buf->format == DICT_FORMAT_CBOR) { //maps are of indefinite length, thus members are just appended
+        __dict_dumpcbor(buf, dict, 0, false, true);
+        return;
+    }
+    size_t start = buf->len;
+    if(buf->len > 0 && buf->data[buf->len - 1] != '{') __buf_put(buf, ", ", 2);
+    size_t begin = buf->len;
+    __dict_dumpbuf(buf, dict, 0, false);
+    //strip braces of the dumped object, as its elements become members of the current one
+    size_t len = buf->len - begin - 2;
+    if(len == 0) { //empty dict, also remove separator
+        buf->len = start;
+        return;
     }
+    memmove(buf->data + begin, buf->data + begin + 1, len);
+    buf->len = begin + len;
+    return;
+}
 
-    if(dict->type != JSON_EMPTY) {
-        switch(dict->type) {
-            case JSON_NULL: fprintf(fp, "\"%s\":null", dict->key); break;
-            case JSON_BOOL: fprintf(fp, "\"%s\":%s", dict->key, dict->value.boolean ? "true" : "false"); break;
-            case JSON_HEX:
-                fprintf(fp, "\"%s\":", dict->key);
-                switch (dict->value.hex.format)
-                {
-                case HEX_FORMAT_STD:
-                case HEX_FORMAT_02:
-                case HEX_FORMAT_04:
-                case HEX_FORMAT_05:
-                case HEX_FORMAT_08:
-                    fprintf(fp, __json_hex_format[dict->value.hex.format], dict->value.hex.number); break;
-                    break;
-                default:
-                    fprintf(fp, __json_hex_format[HEX_FORMAT_STD], dict->value.hex); break;
+void dict_emit_raw_members(struct dict_buffer* buf, const char* data, size_t len) {
+    //strip braces resp. CBOR_MAP_INDEF and CBOR_BREAK of the object, as its members become members of the current one
+    if(data == 0 || len <= 2) return;
+    if(buf->format == DICT_FORMAT_CBOR) { //maps are of indefinite length, thus members are just appended
+        __buf_put(buf, data + 1, len - 2);
+        return;
+    }
+    if(buf->len > 0 && buf->data[buf->len - 1] != '{') __buf_put(buf, ", ", 2);
+    __buf_put(buf, data + 1, len - 2);
+    return;
+}
+
+void __dict_print(FILE* fp, struct dict* dict) {
+    for(; dict != 0; dict = dict->next) {
+        //fprintf(stdout,"\n##### %s ##### dict->next %s dict->prev %s\n", dict->key, dict->next ? dict->next->key : "NONE", dict->prev ? dict->prev->key : "NONE");
+        //fprintf(fp, "\"<%s>\\", dict->prev ? dict->prev->key ? dict->prev->key : "key nil" : "prev nil");
+        //dict_printelement(stderr, dict);
+
+        if(dict->next == dict || dict->prev == dict || (dict->type == JSON_OBJ && dict->value.object == dict) ) {
+            fprintf(stderr, "ERROR: Loop in dict %p\n", dict);
+            dict_printelement(stderr,dict);
+            fprintf(stderr, "Aborting... %p\n", dict);
+            abort();
+        }
+
+        if(dict->type != JSON_EMPTY) {
+            switch(dict->type) {
+                case JSON_NULL: fprintf(fp, "\"%s\":null", dict->key); break;
+                case JSON_BOOL: fprintf(fp, "\"%s\":%s", dict->key, dict->value.boolean ? "true" : "false"); break;
+                case JSON_HEX:
+                    fprintf(fp, "\"%s\":", dict->key);
+                    switch (dict->value.hex.format)
+                    {
+                    case HEX_FORMAT_STD:
+                    case HEX_FORMAT_02:
+                    case HEX_FORMAT_04:
+                    case HEX_FORMAT_05:
+                    case HEX_FORMAT_08:
+                        fprintf(fp, __json_hex_format[dict->value.hex.format], dict->value.hex.number); break;
+                        break;
+                    default:
+                        fprintf(fp, __json_hex_format[HEX_FORMAT_STD], dict->value.hex); break;
+                        break;
+                    }
                     break;
-                }
-                break;
-            case JSON_INT: fprintf(fp, "\"%s\":%lld", dict->key, dict->value.integer); break;
-            case JSON_FLOAT: fprintf(fp, "\"%s\":%Lf", dict->key, dict->value.floating); break;
-            case JSON_STR: fprintf(fp, "\"%s\":\"%s\"", dict->key, dict->value.string); break;
-            case JSON_ARRAY: fprintf(fp, "\"%s\":", dict->key); array_dump(fp, dict->value.array); break;
-            case JSON_OBJ: fprintf(fp, "\"%s\":", dict->key); dict_dump(fp, dict->value.object); break;
-            default: break;
+                case JSON_INT: fprintf(fp, "\"%s\":%lld", dict->key, dict->value.integer); break;
+                case JSON_FLOAT: fprintf(fp, "\"%s\":%Lf", dict->key, dict->value.floating); break;
+                case JSON_STR: fprintf(fp, "\"%s\":\"%s\"", dict->key, dict->value.string); break;
+                case JSON_ARRAY: fprintf(fp, "\"%s\":", dict->key); array_dump(fp, dict->value.array); break;
+                case JSON_OBJ: fprintf(fp, "\"%s\":", dict->key); dict_dump(fp, dict->value.object); break;
+                default: break;
+            }
         }
+        if(dict->next != 0) fprintf(fp, ", ");
     }
-    if(dict->next != 0) {
-        fprintf(fp, ", ");
-        __dict_print(fp, dict->next);
-    }
-
     return;
 }
 
@@ -387,52 +1324,41 @@ void array_dump(FILE* fp, struct array* array) {
 
 //unterschied zu dict_dump Wer kümmert sich hier um das free
 char* array_dumpstr(struct array* array){
-    char *buf = 0;
-    size_t len = 0;
-    FILE* stream = open_memstream(&buf, &len);
-    if (stream == NULL) {
-        fprintf(stderr, "ERROR: Stream could not be opened by open_memstrem\n");
-        abort();
-    }
-    fprintf(stream, "[");
-    if(array != 0) __array_print(stream, array);
-    fprintf(stream, "]");
-    fflush(stream);
-    fclose(stream);
-    return buf;
+    struct dict_buffer buf = {0};
+    array_dumpbuf(&buf, array);
+    free(buf.stack);
+    return buf.data; //has to be freed by calling function
 }
 
 void __array_print(FILE* fp, struct array* array) {
-    if(array == 0) return;
-    if(array->type != JSON_EMPTY)
-        switch(array->type) {
-            case JSON_NULL: fprintf(fp, "null "); break;
-            case JSON_BOOL: fprintf(fp, "%s", array->value.boolean ? "true" : "false"); break;
-            case JSON_HEX:
-                switch (array->value.hex.format)
-                {
-                case HEX_FORMAT_STD:
-                case HEX_FORMAT_02:
-                case HEX_FORMAT_04:
-                case HEX_FORMAT_05:
-                case HEX_FORMAT_08:
-                    fprintf(fp, __json_hex_format[array->value.hex.format], array->value.hex.number); break;
+    for(; array != 0; array = array->next) {
+        if(array->type != JSON_EMPTY)
+            switch(array->type) {
+                case JSON_NULL: fprintf(fp, "null "); break;
+                case JSON_BOOL: fprintf(fp, "%s", array->value.boolean ? "true" : "false"); break;
+                case JSON_HEX:
+                    switch (array->value.hex.format)
+                    {
+                    case HEX_FORMAT_STD:
+                    case HEX_FORMAT_02:
+                    case HEX_FORMAT_04:
+                    case HEX_FORMAT_05:
+                    case HEX_FORMAT_08:
+                        fprintf(fp, __json_hex_format[array->value.hex.format], array->value.hex.number); break;
+                        break;
+                    default:
+                        fprintf(fp, __json_hex_format[HEX_FORMAT_STD], array->value.array); break;
+                        break;
+                    }
                     break;
-                default:
-                    fprintf(fp, __json_hex_format[HEX_FORMAT_STD], array->value.array); break;
-                    break;
-                }
-                break;
-            case JSON_INT: fprintf(fp, "%lld", array->value.integer); break;
-            case JSON_FLOAT: fprintf(fp, "%Lf", array->value.floating); break;
-            case JSON_STR: fprintf(fp, "\"%s\"", array->value.string); break;
-            case JSON_ARRAY: array_dump(fp, array->value.array); break;
-            case JSON_OBJ: dict_dump(fp, array->value.object); break;
-            default: break;
-        }
-    if(array->next != 0) {
-        fprintf(fp, ", ");
-        __array_print(fp, array->next);
+                case JSON_INT: fprintf(fp, "%lld", array->value.integer); break;
+                case JSON_FLOAT: fprintf(fp, "%Lf", array->value.floating); break;
+                case JSON_STR: fprintf(fp, "\"%s\"", array->value.string); break;
+                case JSON_ARRAY: array_dump(fp, array->value.array); break;
+                case JSON_OBJ: dict_dump(fp, array->value.object); break;
+                default: break;
+            }
+        if(array->next != 0) fprintf(fp, ", ");
     }
     return;
 }
@@ -451,14 +1377,21 @@ struct dict* dict_get(struct dict* dict, int path_len, ...) {
     key = va_arg(valist, char *);
     while(path_len > 0 && dict != NULL) {
         //fprintf(stderr, "Searching for key %s...", key);
+        if(dict->index != 0) { //Object is indexed, jump directly to key
+            dict = __dict_index_lookup(dict->index, key);
+            if(dict == NULL) break;
+        }
         if(dict->key != NULL && strcmp(key, dict->key) == 0) { //found actuall part of path
             if(path_len == 1) { //Object found
                 //fprintf(stderr, "Object found!\n");
+                va_end(valist); //destroy valist
                 return dict;
             } else if(dict->type == JSON_OBJ) { //Point to descent found
                 dict = dict->value.object;
                 key = va_arg(valist, char *);
                 path_len--;
+            } else { //Non-JSON Object on path
+                dict = NULL;
             }
         } else { //Iterate through list, till key ist found
             dict = dict->next;
@@ -477,8 +1410,19 @@ struct dict* __dict_plainsearch(struct dict* dict, char* key, struct dict** prev
     if(strcmp(key, dict->key) == 0) { //found key, do not touch prev_dict
         return dict;
     }
+    if(dict->index != 0) { //Object is indexed, no need to walk the list
+        struct dict* found = __dict_index_lookup(dict->index, key);
+        if(found != 0) *prev_dict = found->prev;
+        return found;
+    }
+    for(; dict->next != 0 && dict->next->key != 0; dict = dict->next) { //walk the list up to its end or an uninitialized element
+        if(strcmp(key, dict->next->key) == 0) {
+            *prev_dict = dict;
+            return dict->next;
+        }
+    }
     *prev_dict = dict;
-    return __dict_plainsearch(dict->next, key, prev_dict);
+    return NULL;
 }
 
 
@@ -486,46 +1430,60 @@ struct dict* dict_empty(struct dict* dict) {
     if(dict == NULL) return NULL;
     if(dict->type != JSON_EMPTY) {
         switch(dict->type) {
-            case JSON_STR: free(dict->value.string); dict->value.string = NULL; break;
+            case JSON_STR: __dict_freestr(dict->arena, dict->str_mode, dict->value.string); dict->value.string = NULL; break;
             case JSON_ARRAY: array_free(dict->value.array); dict->value.array = NULL; break;
             case JSON_OBJ: dict_free(dict->value.object); dict->value.object = NULL; break;
             default: break;
         }
         dict->type = JSON_EMPTY;
+        dict->str_mode = DICT_STR_COPY;
     }
     if(dict->key) {
-        free(dict->key);
+        __dict_release(dict->arena, dict->key);
         dict->key = NULL;
     }
     return dict;
 }
 
 void dict_free(struct dict* dict) {
-    if(dict->next != 0) {
-        dict_free(dict->next);
+    __dict_generation++; //elements are released
+    while(dict != 0) {
+        struct dict* next = dict->next;
+        dict_empty(dict);
+        __dict_index_free(dict->index);
+        __dict_release(dict->arena, dict);
+        dict = next;
     }
-    dict_empty(dict);
-    free(dict);
     return;
 }
 
-struct array* array_empty(struct array* array){
-    if(array == 0) return NULL;
-    if(array->next != 0) {
-        array_free(array->next);
-    }
+//Releases the value of a single array element
+static void __array_empty_value(struct array* array) {
     switch(array->type) {
-        case JSON_STR: free(array->value.string); break;
+        case JSON_STR: __dict_freestr(array->arena, array->str_mode, array->value.string); break;
         case JSON_ARRAY: array_free(array->value.array); break;
         case JSON_OBJ: dict_free(array->value.object); break;
         default: break;
     }
+    return;
+}
+
+struct array* array_empty(struct array* array){
+    if(array == 0) return NULL;
+    struct array* next = array->next;
+    while(next != 0) {
+        struct array* element = next;
+        next = element->next;
+        __array_empty_value(element);
+        __dict_release(element->arena, element);
+    }
+    __array_empty_value(array);
     return array;
 }
 
 void array_free(struct array* array){
     array_empty(array);
-    free(array);
+    __dict_release(array->arena, array);
     return;
 }
 
@@ -534,54 +1492,68 @@ struct dict* __dict_delrec(struct dict* dict, int path_len, char* next_key, va_l
     
     //fprintf(stderr, "__dict_delrec: path_len %d next_key: %s\n", path_len, next_key);
 
-    //fprintf(stderr, "__dict_delrec: path_len %d type: %d key: %s next_key: \n", path_len, dict->type, dict->key);//, next_key);
+    struct dict* first = dict; //first element of the object, carrying its index
+    struct dict* prev_dict = 0;
+    dict = __dict_plainsearch(first, next_key, &prev_dict);
+    if(dict == 0) return NULL;
 
-    bool found = strcmp(next_key, dict->key) == 0 ? true : false;
+    if(path_len > 1) {
+        if(dict->type != JSON_OBJ) return NULL;
+        next_key = va_arg(keys, char *);
+        return __dict_delrec(dict->value.object, path_len - 1, next_key, keys);
+    }
 
-    if(path_len == 1 && found) {
     //fprintf(stderr, "DELETE: type: %d key: %s dict->next: %p\n", dict->type, dict->key, dict->next);
-        switch(dict->type) { //update exisiting in dict, handle appropriate
-            case JSON_OBJ:
-                dict_free(dict->value.object);
-                break;
-            case JSON_ARRAY:
-                array_free(dict->value.array);
-                break;
-            case JSON_STR:
-                free(dict->value.string);
-                break;
-            default:
-                break;
-        }
-        //fprintf(stderr, "dict->prev: %s dict->next: %s\n", dict->prev->key, dict->next->key);
-        //fprintf(stderr, "dict->prev %p\n", dict->prev);
-        if(dict->prev) {
-            if(dict->prev->type == JSON_OBJ && dict->prev->value.object == dict) { //check if dict is first element in a nested object
-                //fprintf(stderr, "Is nested!\n");
-                if(!dict->next){ //check if dict is also last element in the nested object
-                    dict->prev->value.object = dict_new(); //if so, make new empty dict, so parent element is not left without (empty) content
-                } else
-                    dict->prev->value.object = dict->next;
-            } else {
-                //fprintf(stderr, "Is *NOT* nested!\n");
-                dict->prev->next = dict->next;
-            }
-        }
-        if(dict->next) {
-            dict->next->prev = dict->prev;
+    __dict_generation++; //element is released
+    switch(dict->type) { //update exisiting in dict, handle appropriate
+        case JSON_OBJ:
+            dict_free(dict->value.object);
+            break;
+        case JSON_ARRAY:
+            array_free(dict->value.array);
+            break;
+        case JSON_STR:
+            __dict_freestr(dict->arena, dict->str_mode, dict->value.string);
+            break;
+        default:
+            break;
+    }
+    if(first->index != 0) { //Remove from index and hand it over, if the first element is deleted
+        __dict_index_remove(first->index, dict);
+        if(dict == first) {
+            if(dict->next)
+                dict->next->index = dict->index;
+            else
+                __dict_index_free(dict->index);
+            dict->index = 0;
         }
-        //fprintf(stderr, "next->prev: %s prev->next: %s\n", dict->next->prev->key, dict->prev->next->key);
-        free(dict->key);
-        free(dict);
-        return dict;
-    } else {
-        if(dict->type == JSON_OBJ && found) {
-            next_key = va_arg(keys, char *);
-            return __dict_delrec(dict->value.object, path_len - 1, next_key, keys);
+    }
+    if(first->tail == dict) //last element of the object is deleted
+        first->tail = dict == first ? 0 : dict->prev;
+    if(dict == first && dict->next) //hand over the last element, if the first element is deleted
+        dict->next->tail = dict->tail;
+    dict->tail = 0;
+    //fprintf(stderr, "dict->prev: %s dict->next: %s\n", dict->prev->key, dict->next->key);
+    //fprintf(stderr, "dict->prev %p\n", dict->prev);
+    if(dict->prev) {
+        if(dict->prev->type == JSON_OBJ && dict->prev->value.object == dict) { //check if dict is first element in a nested object
+            //fprintf(stderr, "Is nested!\n");
+            if(!dict->next){ //check if dict is also last element in the nested object
+                dict->prev->value.object = dict_new_arena(dict->arena); //if so, make new empty dict, so parent element is not left without (empty) content
+            } else
+                dict->prev->value.object = dict->next;
         } else {
-            return __dict_delrec(dict->next, path_len, next_key, keys);
+            //fprintf(stderr, "Is *NOT* nested!\n");
+            dict->prev->next = dict->next;
         }
     }
+    if(dict->next) {
+        dict->next->prev = dict->prev;
+    }
+    //fprintf(stderr, "next->prev: %s prev->next: %s\n", dict->next->prev->key, dict->prev->next->key);
+    __dict_release(dict->arena, dict->key);
+    __dict_release(dict->arena, dict);
+    return dict;
 }
 
 bool dict_del(struct dict** dict_ptr, int path_len, ...) {
@@ -589,6 +1561,7 @@ bool dict_del(struct dict** dict_ptr, int path_len, ...) {
     //fprintf(stderr, "************** dict_del %s\n", (*dict_ptr)->key ? (*dict_ptr)->key : "(nil)");
     struct dict* dict_delrec = 0;
     struct dict* next_dict = (*dict_ptr)->next;
+    struct dict_arena* arena = (*dict_ptr)->arena;
     va_list keys;
     va_start(keys, path_len);
     char* next_key = va_arg(keys, char *);
@@ -598,7 +1571,7 @@ bool dict_del(struct dict** dict_ptr, int path_len, ...) {
     if(dict_delrec == *dict_ptr) { //if first element in dict has been deleted...
         if(next_dict == NULL) { //...and it has been also the last element in dict...
             //fprintf(stderr, "Last element deleted!\n");
-            *dict_ptr = dict_new();  //...create new dict with JSON_EMPTY-type. Contents of "old" dict were allready freed here by __dict_delrec(...)
+            *dict_ptr = dict_new_arena(arena);  //...create new dict with JSON_EMPTY-type. Contents of "old" dict were allready freed here by __dict_delrec(...)
             /*
             fprintf(stderr,"Exit now set to true, dict_del breakpoint reached\n");
             exit_now = true; //For Fuzzer
@@ -613,16 +1586,10 @@ bool dict_del(struct dict** dict_ptr, int path_len, ...) {
 }
 
 long unsigned int array_len(struct array* array) {
-    if(array->next == 0) {
-        if(array->type == JSON_EMPTY)
-            return 0;
-        else
-            return 1;
-    }
-    if(array->type != JSON_EMPTY)
-        return array_len(array->next) + 1;
-    else
-        return array_len(array->next);
+    long unsigned int len = 0;
+    for(; array != 0; array = array->next)
+        if(array->type != JSON_EMPTY) len++;
+    return len;
 }
 
 struct array* array_get(struct array* array, long int pos) {
@@ -649,20 +1616,24 @@ bool array_del(struct array* array, long int pos) {
     if(pos == 0) {
         switch(array->type) {
             case JSON_EMPTY: return false;
-            case JSON_STR: free(array->value.string); break;
+            case JSON_STR: __dict_freestr(array->arena, array->str_mode, array->value.string); break;
             case JSON_OBJ: dict_free(array->value.object); break;
             case JSON_ARRAY: array_free(array->value.array); break;
             default: break;
         }
         if(array->next == NULL) { //last element in array, make (or leave it) JSON_EMPTY
+            struct dict_arena* arena = array->arena; //keep the way the element has been allocated
             memset(array, 0 , sizeof(struct array));
+            array->arena = arena;
             //fprintf(stderr,"DELTED LAST! %s (%d)!\n", json_typetostr(array->type), array->type);
         } else {
             array_next = array->next; //Copy array to not touch given array pointer, because there may be other references to it.
             array->type = array_next->type;
+            array->str_mode = array_next->str_mode;
             array->value = array_next->value;
             array->next = array_next->next;
-            free(array_next); //do not use array free, because values like Strings must be still in place for copy in array!
+            if(array->tail == array_next) array->tail = array; //keep track of the last element
+            __dict_release(array_next->arena, array_next); //do not use array free, because values like Strings must be still in place for copy in array!
             //fprintf(stderr," DELTED Middle!\n");
 
         }
@@ -674,6 +1645,7 @@ bool array_del(struct array* array, long int pos) {
         array_next = array_before->next;
         array_before->next = array_next->next;
         array_next->next = 0;
+        if(array->tail == array_next) array->tail = array_before; //keep track of the last element
         array_free(array_next);
         //fprintf(stderr,"DELTED Array!\n");
         return true;
@@ -685,12 +1657,35 @@ bool array_del(struct array* array, long int pos) {
 bool dict_append(struct dict* source_dict, struct dict* dest_dict) {
     if(source_dict == 0  || dest_dict == 0) return false;
 
-    if(dest_dict->next == 0) {
-        dest_dict->next = source_dict;
-        source_dict->prev = dest_dict;
-        //TODO: Doublicate elment detection or merge?
-        return true;
+    struct dict* last = dest_dict;
+    size_t len = 1;
+    bool first = __dict_is_first(dest_dict);
+    if(first && dest_dict->index != 0 && dest_dict->tail != 0) last = dest_dict->tail; //indexed, thus no need to count the length
+    while(last->next != 0) {
+        last = last->next;
+        len++;
     }
+    last->next = source_dict;
+    source_dict->prev = last;
+    //TODO: Doublicate elment detection or merge?
 
-    return dict_append(source_dict, dest_dict->next);
+    //source_dict is no longer the first element of an object, thus its elements are indexed by dest_dict from now on
+    __dict_index_free(source_dict->index);
+    source_dict->index = 0;
+    if(first) {
+        last = source_dict->tail != 0 ? source_dict->tail : source_dict;
+        while(last->next != 0) last = last->next;
+        dest_dict->tail = last;
+    }
+    source_dict->tail = 0;
+    if(first) {
+        if(dest_dict->index != 0) {
+            for(struct dict* element = source_dict; element != 0; element = element->next)
+                __dict_index_insert(dest_dict->index, element);
+        } else {
+            for(struct dict* element = source_dict; element != 0; element = element->next) len++;
+            if(len > DICT_INDEX_THRESHOLD) __dict_index_build(dest_dict);
+        }
+    }
+    return true;
 }
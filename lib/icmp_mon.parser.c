@@ -72,31 +72,31 @@ bool analyze_ip_header(const unsigned char* packet, int recv_len, struct dict**
     char* ip_daddr = inttoa(iphdr->daddr); //Must be freed!
 
     json_value.integer = iphdr->ihl*4;
-    dict_update(*json, JSON_INT, json_value, 2, "IP", "hdr_len");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "IP", "hdr_len");
     json_value.integer = iphdr->version;
-    dict_update(*json, JSON_INT, json_value, 2, "IP", "version");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "IP", "version");
     json_value.hex.number = iphdr->tos;
     json_value.hex.format = HEX_FORMAT_02;
-    dict_update(*json, JSON_HEX, json_value, 2, "IP", "tos");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "IP", "tos");
     json_value.integer = ntohs(iphdr->tot_len);
-    dict_update(*json, JSON_INT, json_value, 2, "IP", "tot_len");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "IP", "tot_len");
     json_value.hex.number = ntohs(iphdr->id);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(*json, JSON_HEX, json_value, 2, "IP", "id");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "IP", "id");
     json_value.hex.number = ntohs(iphdr->frag_off);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(*json, JSON_HEX, json_value, 2, "IP", "flags");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "IP", "flags");
     json_value.integer = iphdr->ttl;
-    dict_update(*json, JSON_INT, json_value, 2, "IP", "ttl");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "IP", "ttl");
     json_value.integer = iphdr->protocol;
-    dict_update(*json, JSON_INT, json_value, 2, "IP", "protocol");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "IP", "protocol");
     json_value.hex.number = ntohs(iphdr->check);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(*json, JSON_HEX, json_value, 2, "IP", "checksum");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "IP", "checksum");
     json_value.string = ip_saddr;
-    dict_update(*json, JSON_STR, json_value, 2, "IP", "src_addr");
+    DICT_SET_PATH(*json, JSON_STR, json_value, 2, "IP", "src_addr");
     json_value.string = ip_daddr;
-    dict_update(*json, JSON_STR, json_value, 2, "IP", "dest_addr");
+    DICT_SET_PATH(*json, JSON_STR, json_value, 2, "IP", "dest_addr");
 
     //Parse IP options
     if (iphdr->ihl > 5) { //If Options/Padding present (IP Header longer than 5*4 = 20Byte)
@@ -115,13 +115,13 @@ bool analyze_ip_header(const unsigned char* packet, int recv_len, struct dict**
             switch(*opt_ptr) {
             case MY_IPOPT_EOOL: //EOL is only one byte, so this is hopefully going to be easy.
                 json_value.string = "";
-                dict_update(*json, JSON_STR, json_value, 3, "IP", "ip_options", "eol");
+                DICT_SET_PATH(*json, JSON_STR, json_value, 3, "IP", "ip_options", "eol");
                 opt_ptr++;
                 eol = true;
                 break;
             case MY_IPOPT_NOP: //NOP is only one byte, so this is going to be easy, too
                 json_value.string = "";
-                dict_update(*json, JSON_STR, json_value, 3, "IP", "ip_options", "nop");
+                DICT_SET_PATH(*json, JSON_STR, json_value, 3, "IP", "ip_options", "nop");
                 opt_ptr++;
                 break;
             case MY_IPOPT_SEC:
@@ -208,9 +208,9 @@ bool analyze_ip_header(const unsigned char* packet, int recv_len, struct dict**
         //output tainted status, hex output (even if not tainted, cause padding might be usefull too) and close json
         char* hex_string = print_hex_string(opt_ptr, endofoptions_addr-opt_ptr);
         json_value.boolean = tainted;
-        dict_update(*json, JSON_BOOL, json_value, 3, "IP", "ip_options", "tained");
+        DICT_SET_PATH(*json, JSON_BOOL, json_value, 3, "IP", "ip_options", "tained");
         json_value.string = hex_string;
-        dict_update(*json, JSON_STR, json_value, 3, "IP", "ip_options", "padding_hex");
+        DICT_SET_PATH(*json, JSON_STR, json_value, 3, "IP", "ip_options", "padding_hex");
         free(hex_string);
     } //End of if
     //free
@@ -241,34 +241,30 @@ int analyze_udp_header(const unsigned char* packet, int recv_len, struct dict**
     }
 
     json_value.integer = ntohs(udphdr->source);
-    dict_update(*json, JSON_INT, json_value, 2, "UDP", "src_port");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "UDP", "src_port");
     json_value.integer = ntohs(udphdr->dest);
-    dict_update(*json, JSON_INT, json_value, 2, "UDP", "dest_port");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "UDP", "dest_port");
     json_value.integer = ntohs(udphdr->len);
-    dict_update(*json, JSON_INT, json_value, 2, "UDP", "len");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "UDP", "len");
     json_value.integer = ntohs(udphdr->check);
-    dict_update(*json, JSON_INT, json_value, 2, "UDP", "checksum");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "UDP", "checksum");
 
     json_value.integer = data_len;
-    dict_update(*json, JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
 
     //Compute SHA1 of payload
     SHA1(data, data_len, payload_sha1);
     payload_sha1_str = print_hex_string(payload_sha1, SHA_DIGEST_LENGTH);
     //Make HexDump output out of binary payload
-    payload_hd_str = hex_dump(data, data_len, true);  //must be freed
-    payload_str = print_hex_string(data, data_len); //must be freed
+    payload_hd_str = hex_dump(data, data_len, true);  //taken over by JSON output
+    payload_str = print_hex_string(data, data_len); //taken over by JSON output
 
     json_value.string = payload_hd_str;
-    dict_update(*json, JSON_STR, json_value, 2, "FLOW", "payload_hd");
+    DICT_SET_PATH(*json, JSON_STR_OWN, json_value, 2, "FLOW", "payload_hd");
     json_value.string = payload_str;
-    dict_update(*json, JSON_STR, json_value, 2, "FLOW", "payload_str");
+    DICT_SET_PATH(*json, JSON_STR_OWN, json_value, 2, "FLOW", "payload_str");
     json_value.string = payload_sha1_str;
-    dict_update(*json, JSON_STR, json_value, 2, "FLOW", "payload_sha1");
-
-    free(payload_hd_str);
-    free(payload_sha1_str);
-    free(payload_str);
+    DICT_SET_PATH(*json, JSON_STR_OWN, json_value, 2, "FLOW", "payload_sha1");
 
     return data_len; //return number of data bytes after header in buffer
 }
@@ -309,44 +305,44 @@ int analyze_tcp_header(const unsigned char* packet, int recv_len, struct dict**
 
     //Append header JSON
     json_value.integer = ntohs(tcphdr->source);
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "src_port");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "src_port");
     json_value.integer = ntohs(tcphdr->dest);
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "dest_port");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "dest_port");
     json_value.integer = (unsigned int) ntohl(tcphdr->seq);
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "seq");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "seq");
     json_value.integer = (unsigned int) ntohl(tcphdr->ack_seq);
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "ack_seq");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "ack_seq");
     json_value.integer = tcphdr->doff*4;
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "hdr_len");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "hdr_len");
     json_value.integer = tcphdr->res1 & 0b1111;
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "res1");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "res1");
     json_value.boolean = tcphdr->res2 & 0b01;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "ecn");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "ecn");
     json_value.boolean = tcphdr->res2 & 0b10;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "cwr");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "cwr");
     json_value.boolean = tcphdr->urg;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "urg");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "urg");
     json_value.boolean = tcphdr->ack;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "ack");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "ack");
     json_value.boolean = tcphdr->psh;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "psh");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "psh");
     json_value.boolean = tcphdr->rst;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "rst");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "rst");
     json_value.boolean = tcphdr->syn;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "syn");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "syn");
     json_value.boolean = tcphdr->fin;
-    dict_update(*json, JSON_BOOL, json_value, 2, "TCP", "fin");
+    DICT_SET_PATH(*json, JSON_BOOL, json_value, 2, "TCP", "fin");
     json_value.hex.number = tcphdr->res1 << 11 | tcphdr->res2 << 7 | tcphdr->urg << 5 | tcphdr->ack << 4 | tcphdr->psh << 3 | tcphdr->rst << 2 | tcphdr->syn << 1 | tcphdr->fin;
     json_value.hex.format = HEX_FORMAT_STD;
-    dict_update(*json, JSON_HEX, json_value, 2, "TCP", "tcp_flags");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "TCP", "tcp_flags");
     json_value.integer = ntohs(tcphdr->window);
-    dict_update(*json, JSON_INT, json_value, 2, "TCP", "window");
+    DICT_SET_PATH(*json, JSON_INT, json_value, 2, "TCP", "window");
     json_value.hex.number = ntohs(tcphdr->check);
     json_value.hex.format = HEX_FORMAT_02;
-    dict_update(*json, JSON_HEX, json_value, 2, "TCP", "checksum");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "TCP", "checksum");
     json_value.hex.number = ntohs(tcphdr->urg_ptr);
     json_value.hex.format = HEX_FORMAT_02;
-    dict_update(*json, JSON_HEX, json_value, 2, "TCP", "urg_ptr");
+    DICT_SET_PATH(*json, JSON_HEX, json_value, 2, "TCP", "urg_ptr");
 
 
     //Parse TCP options
@@ -367,12 +363,12 @@ int analyze_tcp_header(const unsigned char* packet, int recv_len, struct dict**
             switch(*opt_ptr) {
             case MY_TCPOPT_NOP: //NOP is only one byte, so this is hopefully going to be easy.
                 json_value.string = "";
-                dict_update(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "nop");
+                DICT_SET_PATH(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "nop");
                 opt_ptr++;
                 break;
             case MY_TCPOPT_EOL: //EOL is only one byte, so this is going to be easy, too
                 json_value.string = "";
-                dict_update(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "eol");
+                DICT_SET_PATH(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "eol");
                 opt_ptr++;
                 eol = true;
                 break;
@@ -433,9 +429,9 @@ int analyze_tcp_header(const unsigned char* packet, int recv_len, struct dict**
         //output tainted status, hex output (even if not tainted, cause padding might be usefull too) and close json
         char* hex_string = print_hex_string(opt_ptr, endofoptions_addr-opt_ptr);
         json_value.boolean = tainted;
-        dict_update(*json, JSON_BOOL, json_value, 3, "TCP", "tcp_options", "tained");
+        DICT_SET_PATH(*json, JSON_BOOL, json_value, 3, "TCP", "tcp_options", "tained");
         json_value.string = hex_string;
-        dict_update(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "padding_hex");
+        DICT_SET_PATH(*json, JSON_STR, json_value, 3, "TCP", "tcp_options", "padding_hex");
         free(hex_string);
     } //End of "tcp options present"
     
@@ -44,10 +44,7 @@ int worker_icmp(unsigned char* buffer, int recv_len, char* hostaddress, char* da
     struct ipv4icmp_t ipv4icmp; //struct to save IP-Header contents of intrest
 
     FILE *file = 0;
-    char* payload_hd_str = 0; //Payload as string in HexDump Format
-    char* payload_str = 0; //Payload as string
     unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
-    char * payload_sha1_str = 0;
     char file_name[2*PATH_LEN] = ""; //double path length for concatination purposes. PATH_LEN *MUST* be enforced when combinating path and filename!
     char log_time[64] = "";
     char stop_time[64] = "";
@@ -110,28 +107,14 @@ int worker_icmp(unsigned char* buffer, int recv_len, char* hostaddress, char* da
 
 
 
-    //Open new JSON and log connection to STDOUT in json-format (Suricata-alike)
-    json_value.string = "MADCAT";
-    dict_update(json_dict(true), JSON_STR, json_value, 1, "origin");
-    json_value.string = log_time;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-    json_value.floating = atof(unix_time);
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
-    json_value.string = ipv4icmp.src_ip_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-    json_value.string = ipv4icmp.dest_ip_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-    
-    //Move to [ICMP][type] / [ICMP][code]?
-    json_value.integer = ipv4icmp.type;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "icmp_type");
-    json_value.integer = ipv4icmp.code;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "icmp_code");
-
-    json_value.string = "ICMP";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "proto");
-    json_value.string = "flow";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "event_type");
+    //Log connection to STDOUT in json-format (Suricata-alike)
+    struct icmp_event_t event = {0};
+    event.timestamp = log_time;
+    event.unixtime = atof(unix_time);
+    event.src_ip = ipv4icmp.src_ip_str;
+    event.dest_ip = ipv4icmp.dest_ip_str;
+    event.type = ipv4icmp.type;
+    event.code = ipv4icmp.code;
 
     //Analyze Headers in ICMP-Payload
     /******************************************
@@ -147,119 +130,88 @@ int worker_icmp(unsigned char* buffer, int recv_len, char* hostaddress, char* da
     ******************************************/
 
     //Analyze IP Header
+    event.headers = json_dict(true);
     analyze_ip_header(buffer, recv_len, NULL);
     //Analyze ICMP Header
-    json_value.integer = ipv4icmp.type;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "ICMP", "type");
-    json_value.integer = ipv4icmp.code;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "ICMP", "code");
-    json_value.hex.number = ipv4icmp.icmp_check;
-    json_value.hex.format = HEX_FORMAT_04;
-    dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "checksum");
+    event.checksum = ipv4icmp.icmp_check;
 
     switch(ipv4icmp.type) {
         case MY_ICMP_ECHOREPLY: //print type_str, identifier and sequence
-            json_value.string = "echoreply";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
-            json_value.hex.number = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t)));
-            json_value.hex.format = HEX_FORMAT_04;
-            dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "id");
-            json_value.integer = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 3*sizeof(uint16_t)));
-            dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "seq");
+            event.type_str = "echoreply";
+            event.echo = true;
+            event.id = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t)));
+            event.seq = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 3*sizeof(uint16_t)));
             break;
         case MY_ICMP_ECHO:  //print type_str, identifier and sequence
-            json_value.string = "echo";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
-            json_value.hex.number = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t)));
-            json_value.hex.format = HEX_FORMAT_04;
-            dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "id");
-            json_value.integer = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 3*sizeof(uint16_t)));
-            dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "seq");
+            event.type_str = "echo";
+            event.echo = true;
+            event.id = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t)));
+            event.seq = ntohs(*(uint16_t*) (ipv4icmp.icmp_hdr + 3*sizeof(uint16_t)));
             break;
         case MY_ICMP_UNREACH:
-            json_value.string = "unreach";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
-            json_value.hex.number = *(uint32_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t));
-            json_value.hex.format = HEX_FORMAT_08;
-            dict_update(json_dict(false), JSON_HEX, json_value, 2, "ICMP", "unused");
+            event.type_str = "unreach";
+            event.unreach = true;
+            event.unused = *(uint32_t*) (ipv4icmp.icmp_hdr + 2*sizeof(uint16_t));
 
             switch(ipv4icmp.code) {
                 case MY_ICMP_NET_UNREACH:
-                    json_value.string = "net_unreach";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "net_unreach";
                     break;
                 case MY_ICMP_HOST_UNREACH:
-                    json_value.string = "host_unreach";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "host_unreach";
                     break;
                 case MY_ICMP_PROT_UNREACH:
-                    json_value.string = "prot_unreach";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "prot_unreach";
                     break;
                 case MY_ICMP_PORT_UNREACH:
-                    json_value.string = "port_unreach";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "port_unreach";
                     break;
                 case MY_ICMP_FRAG_NEEDED:
-                    json_value.string = "frag_needed";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "frag_needed";
                     break;
                 case MY_ICMP_SR_FAILED:
-                    json_value.string = "sr_failed";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "sr_failed";
                     break;
                 case MY_ICMP_NET_UNKNOWN:
-                    json_value.string = "net_unknown";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "net_unknown";
                     break;
                 case MY_ICMP_HOST_UNKNOWN:
-                    json_value.string = "host_unknown";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "host_unknown";
                     break;
                 case MY_ICMP_HOST_ISOLATED:
-                    json_value.string = "host_isolated";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "host_isolated";
                     break;
                 case MY_ICMP_NET_ANO:
-                    json_value.string = "net_ano";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "net_ano";
                     break;
                 case MY_ICMP_HOST_ANO:
-                    json_value.string = "host_ano";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "host_ano";
                     break;
                 case MY_ICMP_NET_UNR_TOS:
-                    json_value.string = "net_unr_tos";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "net_unr_tos";
                     break;
                 case MY_ICMP_HOST_UNR_TOS:
-                    json_value.string = "host_unr_tos";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "host_unr_tos";
                     break;
                 case MY_ICMP_PKT_FILTERED:
-                    json_value.string = "pkt_filtered";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "pkt_filtered";
                     break;
                 case MY_ICMP_PREC_VIOLATION:
-                    json_value.string = "prec_vioalation";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "prec_vioalation";
                     break;
                 case MY_ICMP_PREC_CUTOFF:
-                    json_value.string = "prec_cutoff";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "prec_cutoff";
                     break;
                 default:
-                    json_value.string = "tainted/unkown";
-                    dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "code_str");
+                    event.code_str = "tainted/unkown";
                     tainted = true;
                     break;
             } //End of switch(ipv4icmp.code)
             //Analyze inner IP-Header
-            struct dict* json_unreach = dict_new();
+            struct dict* json_unreach = dict_new_arena(json_dict(false)->arena); //same allocation as json_dict, thus released with it
+            event.inner_headers = json_unreach;
             tainted = analyze_ip_header(ipv4icmp.data, recv_len, &json_unreach);
             if(tainted) { //if inner IP-Header is tainted (e.g. < 20Bytes), also set tainted = true and break
-                if(!dict_append(json_unreach, dict_get(json_dict(false), 1, "ICMP")->value.object))
-                    dict_free(json_unreach);
                 tainted = true;
                 break;
             }
@@ -288,77 +240,57 @@ int worker_icmp(unsigned char* buffer, int recv_len, char* hostaddress, char* da
                     tainted = true;
                     break;
             }
-            json_value.object = json_unreach;
-            if(!dict_append(json_unreach, dict_get(json_dict(false), 1, "ICMP")->value.object))
-                dict_free(json_unreach);
             break;
         case MY_ICMP_SOURCEQUENCH:
-            json_value.string = "sourcequench";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "sourcequench";
             break;
         case MY_ICMP_REDIRECT:
-            json_value.string = "redirect";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "redirect";
             break;
         case MY_ICMP_ALTHOST:
-            json_value.string = "althost";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "althost";
             break;
         case MY_ICMP_RTRADVERT:
-            json_value.string = "rtradvert";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "rtradvert";
             break;
         case MY_ICMP_RTRSOLICIT:
-            json_value.string = "rtrsolicit";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "rtrsolicit";
             break;
         case MY_ICMP_TIMXCEED:
-            json_value.string = "timxceed";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "timxceed";
             break;
         case MY_ICMP_PARAMPROB:
-            json_value.string = "paramprob";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "paramprob";
             break;
         case MY_ICMP_TSTAMP:
-            json_value.string = "tstamp";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "tstamp";
             break;
         case MY_ICMP_TSTAMPREPLY:
-            json_value.string = "tstampreply";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "tstampreply";
             break;
         case MY_ICMP_IREQ:
-            json_value.string = "ireq";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "ireq";
             break;
         case MY_ICMP_IREQREPLY:
-            json_value.string = "ireqreply";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "ireqreply";
             break;
         case MY_ICMP_MASKREQ:
-            json_value.string = "maskreq";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "maskreq";
             break;
         case MY_ICMP_MASKREPLY:
-            json_value.string = "maskreply";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "maskreply";
             break;
         case MY_ICMP_PHOTURIS:
-            json_value.string = "photuris";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "photuris";
             break;
         case MY_ICMP_EXTECHO:
-            json_value.string = "extecho";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "extecho";
             break;
         case MY_ICMP_EXTECHOREPLY:
-            json_value.string = "extechoreply";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "extechoreply";
             break;
         default:
-            json_value.string = "tainted/unknown";
-            dict_update(json_dict(false), JSON_STR, json_value, 2, "ICMP", "type_str");
+            event.type_str = "tainted/unknown";
             tainted = true;
             break;
     } //End of switch(ipv4icmp.type)
@@ -398,35 +330,28 @@ int worker_icmp(unsigned char* buffer, int recv_len, char* hostaddress, char* da
 
     //Compute SHA1 of payload
     SHA1(ipv4icmp.data, ipv4icmp.data_len, payload_sha1);
-    payload_sha1_str = print_hex_string(payload_sha1, SHA_DIGEST_LENGTH);
-    //Make HexDump output out of binary payload
-    payload_hd_str = hex_dump(ipv4icmp.data, ipv4icmp.data_len, true);  //must be freed
-    payload_str = print_hex_string(ipv4icmp.data, ipv4icmp.data_len); //must be freed
 
     //Close ICMP JSON object with tainted status and "flow" part.
-    json_value.boolean = tainted;
-    dict_update(json_dict(false), JSON_BOOL, json_value, 2, "ICMP", "tainted");
-    json_value.string = log_time;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "start");
-    json_value.string = stop_time;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "end");
-    json_value.floating = duration;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "duration");
-    json_value.integer = ipv4icmp.data_len;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
-    json_value.string = payload_hd_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_hd");
-    json_value.string = payload_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_str");
-    json_value.string = payload_sha1_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_sha1");
+    event.tainted = tainted;
+    event.start = log_time;
+    event.end = stop_time;
+    event.duration = duration;
+    event.bytes_toserver = ipv4icmp.data_len;
+    event.payload = ipv4icmp.data;
+    event.payload_len = ipv4icmp.data_len;
+    event.payload_sha1 = payload_sha1;
+
+    //print JSON output for logging and further analysis
+    static struct dict_buffer output = {0}; //reused for every event
+    output.format = output_format;
+    if(emit_icmp_event(&output, &event) > 2) { //do not print empty JSON-Objects
+        print_event(stdout, &output);
+        fflush(stdout);
+    }
 
     //free str allocated by strndup() in function char *inttoa(uint32_t) and char *print_hex_string(const unsigned char*, unsigned int)
     free(ipv4icmp.src_ip_str);
     free(ipv4icmp.dest_ip_str);
-    free(payload_hd_str);
-    free(payload_str);
-    free(payload_sha1_str);
     if(hex_string) free(hex_string);
     return ipv4icmp.data_len;
 }
@@ -0,0 +1,206 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP- and RAW monitor packet capture.
+ *
+ * BSI 2018-2023
+*/
+
+#include "madcat.capture.h"
+#include "madcat.helper.h"
+
+void capture_config(lua_State* L, struct capture_conf_t* conf)
+{
+    if(strcmp(get_config_opt(L, "capture_backend"), "afpacket") == 0) { //if optional parameter is given, set it.
+        conf->backend = CAPTURE_AFPACKET;
+    }
+    fprintf(stderr, "\tcapture_backend: %s\n", conf->backend == CAPTURE_AFPACKET ? "afpacket" : "pcap");
+    if(get_config_opt(L, "pcap_snaplen") != EMPTY_STR) { //if optional parameter is given, set it.
+        conf->snaplen = atoi(get_config_opt(L, "pcap_snaplen"));
+    }
+    fprintf(stderr, "\tpcap_snaplen: %d\n", conf->snaplen);
+    if(get_config_opt(L, "pcap_buffer_size") != EMPTY_STR) { //if optional parameter is given, set it.
+        conf->buffer_size = atoi(get_config_opt(L, "pcap_buffer_size"));
+    }
+    fprintf(stderr, "\tpcap_buffer_size: %d%s\n", conf->buffer_size, conf->buffer_size > 0 ? "" : " (default)");
+    if(strcmp(get_config_opt(L, "pcap_immediate"), "true") == 0) { //if optional parameter is given, set it.
+        conf->immediate = true;
+    }
+    fprintf(stderr, "\tpcap_immediate: %s\n", conf->immediate ? "true" : "false");
+    if(get_config_opt(L, "capture_workers") != EMPTY_STR) { //if optional parameter is given, set it.
+        conf->workers = atoi(get_config_opt(L, "capture_workers"));
+    }
+    if(conf->workers < 1 || conf->backend != CAPTURE_AFPACKET) //several workers need a fanout group, which is only supported by the AF_PACKET backend
+        conf->workers = 1;
+    fprintf(stderr, "\tcapture_workers: %d\n", conf->workers);
+    if(get_config_opt(L, "capture_fanout") != EMPTY_STR) { //if optional parameter is given, set it.
+        conf->fanout = atoi(get_config_opt(L, "capture_fanout")) & 0xffff;
+    }
+    if(conf->fanout == 0 && conf->workers > 1) //use a group id unique to this instance, if none is configured
+        conf->fanout = (getpid() & 0xffff) | 1;
+    fprintf(stderr, "\tcapture_fanout: %d\n", conf->backend == CAPTURE_AFPACKET ? conf->fanout : 0);
+    return;
+}
+
+int init_afpacket(struct capture_t* cap, const char* dev, const char* filter_exp, const struct capture_conf_t* conf)
+{
+    memset(cap, 0, sizeof(struct capture_t));
+    cap->backend = CAPTURE_AFPACKET;
+    //Protocol 0 receives nothing until bind(...), thus the filter and the ring are in place before the first packet arrives
+    cap->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (cap->fd < 0)
+        return -1;
+
+    // Compile the filter for Ethernet, which is also used by Linux for loopback devices, and attach it to the socket.
+    // The filter returns the snaplen for matching packets, so the kernel truncates them accordingly.
+    if (strlen(filter_exp) > 0) {
+        struct bpf_program fp;
+        pcap_t* dead = pcap_open_dead(DLT_EN10MB, conf->snaplen);
+        if (dead == NULL || pcap_compile(dead, &fp, filter_exp, 1, PCAP_NETMASK_UNKNOWN) == -1) {
+            if (dead != NULL) pcap_close(dead);
+            return -2;
+        }
+        struct sock_fprog prog = { fp.bf_len, (struct sock_filter*) fp.bf_insns }; //struct bpf_insn and struct sock_filter are identical
+        int ret = setsockopt(cap->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+        pcap_freecode(&fp);
+        pcap_close(dead);
+        if (ret != 0)
+            return -3;
+    }
+
+    // Set up the TPACKET_V3 RX ring, the kernel retires a block when it is full or after CAPTURE_TIMEOUT
+    int version = TPACKET_V3;
+    if (setsockopt(cap->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0)
+        return -4;
+    cap->block_size = CAPTURE_BLOCK_SIZE;
+    cap->block_nr = conf->buffer_size > 0 ? (conf->buffer_size + CAPTURE_BLOCK_SIZE - 1) / CAPTURE_BLOCK_SIZE : CAPTURE_BLOCK_NR;
+    if (cap->block_nr < 2) cap->block_nr = 2; //the kernel fills one block, while the other one is read
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = cap->block_size;
+    req.tp_block_nr = cap->block_nr;
+    req.tp_frame_size = CAPTURE_FRAME_SIZE;
+    req.tp_frame_nr = (cap->block_size / CAPTURE_FRAME_SIZE) * cap->block_nr;
+    req.tp_retire_blk_tov = conf->immediate ? 1 : CAPTURE_TIMEOUT; //in ms
+    if (setsockopt(cap->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0)
+        return -4;
+    cap->ring = mmap(NULL, (size_t) cap->block_size * cap->block_nr, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, 0);
+    if (cap->ring == MAP_FAILED) {
+        cap->ring = NULL;
+        return -4;
+    }
+
+    // Bind to the device, all protocols
+    struct ifreq ifr; //net/if.h with if_nametoindex(...) conflicts with linux/if.h included by madcat.common.h
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name) - 1);
+    if (ioctl(cap->fd, SIOCGIFINDEX, &ifr) != 0)
+        return -5;
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = ifr.ifr_ifindex;
+    if (bind(cap->fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+        return -5;
+
+    // Join the fanout group, packets of one flow always go to the same worker
+    if (conf->fanout != 0) {
+        int fanout_arg = (conf->fanout & 0xffff) | (PACKET_FANOUT_HASH << 16);
+        if (setsockopt(cap->fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) != 0)
+            return -6;
+    }
+
+    return 0;
+}
+
+int capture_dispatch(struct capture_t* cap, pcap_handler callback, u_char* user)
+{
+    if (cap->backend == CAPTURE_PCAP)
+        return pcap_dispatch(cap->pcap, -1, callback, user);
+
+    struct tpacket_block_desc* block = (struct tpacket_block_desc*) (cap->ring + (size_t) cap->block_idx * cap->block_size);
+    if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) { //block still owned by the kernel, wait for it
+        struct pollfd pfd = { cap->fd, POLLIN | POLLERR, 0 };
+        if (poll(&pfd, 1, CAPTURE_TIMEOUT) < 0 && errno != EINTR)
+            return PCAP_ERROR;
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+            return 0;
+    }
+
+    //Hand over every packet of the block directly from the ring
+    int count = block->hdr.bh1.num_pkts;
+    struct tpacket3_hdr* ppd = (struct tpacket3_hdr*) ((unsigned char*) block + block->hdr.bh1.offset_to_first_pkt);
+    for (int i = 0; i < count; i++) {
+        struct pcap_pkthdr header;
+        header.ts.tv_sec = ppd->tp_sec;
+        header.ts.tv_usec = ppd->tp_nsec / 1000;
+        header.caplen = ppd->tp_snaplen;
+        header.len = ppd->tp_len;
+        callback(user, &header, (const u_char*) ppd + ppd->tp_mac);
+        ppd = (struct tpacket3_hdr*) ((unsigned char*) ppd + ppd->tp_next_offset);
+    }
+
+    //Return the block to the kernel
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    cap->block_idx = (cap->block_idx + 1) % cap->block_nr;
+    return count;
+}
+
+int capture_stats(struct capture_t* cap, struct pcap_stat* ps)
+{
+    if (cap->backend == CAPTURE_PCAP)
+        return pcap_stats(cap->pcap, ps);
+
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if (getsockopt(cap->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) != 0)
+        return -1;
+    cap->stats.ps_recv += st.tp_packets; //tp_packets includes dropped packets, like ps_recv of libpcap on Linux
+    cap->stats.ps_drop += st.tp_drops;
+    *ps = cap->stats;
+    return 0;
+}
+
+void capture_close(struct capture_t* cap)
+{
+    if (cap->backend == CAPTURE_PCAP) {
+        if (cap->pcap != NULL) pcap_close(cap->pcap);
+        cap->pcap = NULL;
+        return;
+    }
+    if (cap->ring != NULL) munmap(cap->ring, (size_t) cap->block_size * cap->block_nr);
+    if (cap->fd > 0) close(cap->fd);
+    cap->ring = NULL;
+    cap->fd = -1;
+    return;
+}
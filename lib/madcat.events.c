@@ -0,0 +1,281 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-, UDP-, ICMP- and RAW monitor event serializers.
+ *
+ * BSI 2018-2023
+*/
+
+#include "madcat.events.h"
+#include "madcat.helper.h"
+
+//Writes payload and its SHA1 hash as hexdump and hex strings, resp. as byte strings in binary formats
+static void emit_payload(struct dict_buffer* buf, const unsigned char* payload, int payload_len, const unsigned char* payload_sha1)
+{
+    if(payload_len < 0) payload_len = 0;
+    if(buf->format == DICT_FORMAT_CBOR) { //no need for human readable output
+        dict_emit_bytes(buf, "payload", payload, payload_len);
+    } else {
+        char* payload_hd_str = hex_dump(payload, payload_len, true);
+        dict_emit_str(buf, "payload_hd", payload_hd_str);
+        free(payload_hd_str);
+        dict_emit_bytes(buf, "payload_str", payload, payload_len);
+    }
+    dict_emit_bytes(buf, "payload_sha1", payload_sha1, SHA_DIGEST_LENGTH);
+    return;
+}
+
+//Writes the FLOW object of a TCP flow
+static void emit_tcp_flow(struct dict_buffer* buf, const struct tcp_flow_event_t* event)
+{
+    dict_emit_object(buf, "FLOW");
+    dict_emit_str(buf, "start", event->start);
+    dict_emit_str(buf, "end", event->end);
+    dict_emit_float(buf, "duration", event->duration);
+    dict_emit_float(buf, "min_rtt", event->min_rtt);
+    dict_emit_str(buf, "state", event->state);
+    dict_emit_str(buf, "reason", event->reason);
+    dict_emit_int(buf, "bytes_toserver", event->bytes_toserver);
+    emit_payload(buf, event->payload, event->payload_len, event->payload_sha1);
+    dict_emit_object_end(buf);
+    return;
+}
+
+//Writes the FLOW object of a proxied TCP flow
+static void emit_proxy_flow(struct dict_buffer* buf, const struct proxy_flow_event_t* event)
+{
+    dict_emit_object(buf, "FLOW");
+    dict_emit_str(buf, "start", event->start);
+    dict_emit_str(buf, "end", event->end);
+    dict_emit_float(buf, "duration", event->duration);
+    dict_emit_float(buf, "min_rtt", event->min_rtt);
+    dict_emit_int(buf, "bytes_toserver", event->bytes_toserver);
+    dict_emit_int(buf, "bytes_toclient", event->bytes_toclient);
+    dict_emit_str(buf, "state", "closed");
+    dict_emit_str(buf, "reason", "closed");
+    dict_emit_str(buf, "proxy_ip", event->proxy_ip);
+    dict_emit_int(buf, "proxy_port", event->proxy_port);
+    dict_emit_str(buf, "backend_ip", event->backend_ip);
+    dict_emit_int(buf, "backend_port", event->backend_port);
+    dict_emit_object_end(buf);
+    return;
+}
+
+size_t emit_tcp_syn_event(struct dict_buffer* buf, const struct tcp_syn_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_members(buf, event->headers);
+    dict_emit_int(buf, "data_bytes", event->data_bytes);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    return dict_emit_end(buf);
+}
+
+size_t emit_tcp_flow_event(struct dict_buffer* buf, const struct tcp_flow_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "src_ip", event->src_ip);
+    dict_emit_int(buf, "dest_port", event->dest_port);
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_str(buf, "dest_ip", event->dest_ip);
+    dict_emit_int(buf, "src_port", event->src_port);
+    dict_emit_str(buf, "proto", event->proto);
+    dict_emit_str(buf, "event_type", "flow");
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    emit_tcp_flow(buf, event);
+    return dict_emit_end(buf);
+}
+
+size_t emit_tcp_flow_object(struct dict_buffer* buf, const struct tcp_flow_event_t* event)
+{
+    dict_emit_begin(buf);
+    emit_tcp_flow(buf, event);
+    return dict_emit_end(buf);
+}
+
+size_t emit_proxy_flow_event(struct dict_buffer* buf, const struct proxy_flow_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "src_ip", event->src_ip);
+    dict_emit_int(buf, "src_port", event->src_port);
+    dict_emit_str(buf, "dest_ip", event->dest_ip);
+    dict_emit_int(buf, "dest_port", event->dest_port);
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    dict_emit_str(buf, "proto", "TCP");
+    dict_emit_str(buf, "event_type", "proxy_flow");
+    emit_proxy_flow(buf, event);
+    return dict_emit_end(buf);
+}
+
+size_t emit_proxy_flow_object(struct dict_buffer* buf, const struct proxy_flow_event_t* event)
+{
+    dict_emit_begin(buf);
+    emit_proxy_flow(buf, event);
+    return dict_emit_end(buf);
+}
+
+size_t emit_tcp_merged_event(struct dict_buffer* buf, const struct tcp_merged_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_str(buf, "src_ip", event->src_ip);
+    dict_emit_int(buf, "src_port", event->src_port);
+    dict_emit_str(buf, "dest_ip", event->dest_ip);
+    dict_emit_int(buf, "dest_port", event->dest_port);
+    dict_emit_str(buf, "proto", event->proto);
+    dict_emit_str(buf, "event_type", event->event_type);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    dict_emit_raw_members(buf, event->flow, event->flow_len);
+    if(event->headers != 0) {
+        dict_emit_raw_members(buf, event->headers, event->headers_len);
+    } else { //preserve addresses for enrichment, as the postprocessor does
+        dict_emit_object(buf, "IP");
+        dict_emit_str(buf, "src_addr", event->src_ip);
+        dict_emit_str(buf, "dest_addr", event->dest_ip);
+        dict_emit_object_end(buf);
+    }
+    return dict_emit_end(buf);
+}
+
+size_t emit_udp_flow_event(struct dict_buffer* buf, const struct udp_flow_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "src_ip", event->src_ip);
+    dict_emit_int(buf, "src_port", event->src_port);
+    dict_emit_str(buf, "dest_ip", event->dest_ip);
+    dict_emit_int(buf, "dest_port", event->dest_port);
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    dict_emit_str(buf, "proto", "UDP");
+    dict_emit_str(buf, "event_type", event->proxied ? "proxy_flow" : "flow");
+    dict_emit_object(buf, "FLOW");
+    dict_emit_str(buf, "start", event->start);
+    dict_emit_str(buf, "end", event->end);
+    dict_emit_float(buf, "duration", event->duration);
+    dict_emit_float(buf, "min_rtt", event->min_rtt);
+    dict_emit_int(buf, "bytes_toserver", event->bytes_toserver);
+    dict_emit_int(buf, "bytes_toclient", event->bytes_toclient);
+    if(event->proxied) { //Proxy specific output
+        dict_emit_str(buf, "proxy_ip", event->proxy_ip);
+        dict_emit_int(buf, "proxy_port", event->proxy_port);
+        dict_emit_str(buf, "backend_ip", event->backend_ip);
+        dict_emit_int(buf, "backend_port", event->backend_port);
+    } else {
+        emit_payload(buf, event->payload, event->payload_len, event->payload_sha1);
+    }
+    dict_emit_object_end(buf);
+    dict_emit_members(buf, event->headers);
+    return dict_emit_end(buf);
+}
+
+size_t emit_icmp_event(struct dict_buffer* buf, const struct icmp_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    dict_emit_str(buf, "src_ip", event->src_ip);
+    dict_emit_str(buf, "dest_ip", event->dest_ip);
+    dict_emit_int(buf, "icmp_type", event->type);
+    dict_emit_int(buf, "icmp_code", event->code);
+    dict_emit_str(buf, "proto", "ICMP");
+    dict_emit_str(buf, "event_type", "flow");
+    dict_emit_members(buf, event->headers);
+    dict_emit_object(buf, "ICMP");
+    dict_emit_int(buf, "type", event->type);
+    dict_emit_int(buf, "code", event->code);
+    dict_emit_hex(buf, "checksum", event->checksum, HEX_FORMAT_04);
+    dict_emit_str(buf, "type_str", event->type_str);
+    if(event->echo) {
+        dict_emit_hex(buf, "id", event->id, HEX_FORMAT_04);
+        dict_emit_hex(buf, "seq", event->seq, HEX_FORMAT_04);
+    }
+    if(event->unreach) {
+        dict_emit_hex(buf, "unused", event->unused, HEX_FORMAT_08);
+        dict_emit_str(buf, "code_str", event->code_str);
+        dict_emit_members(buf, event->inner_headers);
+    }
+    dict_emit_bool(buf, "tainted", event->tainted);
+    dict_emit_object_end(buf);
+    dict_emit_object(buf, "FLOW");
+    dict_emit_str(buf, "start", event->start);
+    dict_emit_str(buf, "end", event->end);
+    dict_emit_float(buf, "duration", event->duration);
+    dict_emit_int(buf, "bytes_toserver", event->bytes_toserver);
+    emit_payload(buf, event->payload, event->payload_len, event->payload_sha1);
+    dict_emit_object_end(buf);
+    return dict_emit_end(buf);
+}
+
+size_t emit_raw_event(struct dict_buffer* buf, const struct raw_event_t* event)
+{
+    dict_emit_begin(buf);
+    dict_emit_str(buf, "origin", "MADCAT");
+    dict_emit_str(buf, "timestamp", event->timestamp);
+    if(event->src_ip != 0 && event->dest_ip != 0) { //Include IP Information only if IPv4/v6 has been detected
+        dict_emit_str(buf, "src_ip", event->src_ip);
+        dict_emit_str(buf, "dest_ip", event->dest_ip);
+    }
+    dict_emit_str(buf, "proto", event->proto);
+    dict_emit_str(buf, "event_type", "RAW");
+    dict_emit_bool(buf, "tainted", event->tainted);
+    dict_emit_float(buf, "unixtime", event->unixtime);
+    dict_emit_object(buf, "FLOW");
+    dict_emit_str(buf, "start", event->start);
+    dict_emit_str(buf, "end", event->end);
+    dict_emit_float(buf, "duration", event->duration);
+    dict_emit_str(buf, "state", "closed");
+    dict_emit_str(buf, "reason", "closed");
+    dict_emit_int(buf, "bytes_toserver", event->bytes_toserver);
+    emit_payload(buf, event->payload, event->payload_len, event->payload_sha1);
+    dict_emit_object_end(buf);
+    dict_emit_object(buf, "RAW");
+    dict_emit_str(buf, "pcap_filter", event->pcap_filter);
+    dict_emit_hex(buf, "ether_type", event->ether_type, HEX_FORMAT_04);
+    dict_emit_object_end(buf);
+    return dict_emit_end(buf);
+}
+
+void print_event(FILE* output, const struct dict_buffer* buf)
+{
+    if(buf->format == DICT_FORMAT_CBOR)
+        fwrite(buf->data, 1, buf->len, output);
+    else
+        fprintf(output, "%s\n", buf->data);
+    return;
+}
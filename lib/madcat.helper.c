@@ -38,11 +38,19 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
  * BSI 2018-2023
 */
 
+#define _GNU_SOURCE //CPU_SET(...) and sched_setaffinity(...)
+#include <sched.h>
 #include "madcat.helper.h"
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 //pseudo constant empty string e.g. for initialization of json_data_node_t and checks. Not used #define here, because this would lead to several instances of an empty constant string with different addresses.
 char EMPTY_STR[1];
 int loglevel; //Default Loglevel 0 logging no IPs to stderr, 1: Full logging
+__uint8_t output_format; //Format of event output, DICT_FORMAT_JSON (Default) or DICT_FORMAT_CBOR
 uint64_t sessionkey; //Sessionkey is used e.g. in UDP Module to mask IDs GDPR conformant if loglevel == 0.
 union json_type json_value; //union to fill dictionaries with appropriate values
 
@@ -50,28 +58,77 @@ union json_type json_value; //union to fill dictionaries with appropriate values
 //struct holding user UID and PID to drop priviliges to.
 struct user_t user; //globally defined, used to drop priviliges in arbitrarry functions. May become local, if not needed.
 
-long double time_str(char* unix_buf, int unix_size, char* readable_buf, int readable_size)
+//Cache of date, time and timezone of the second last formatted by time_str_ts(...), per thread
+static __thread time_t time_cache_sec = -1;
+static __thread char time_cache_prefix[32]; //e.g. "2018-08-17T05:51:53"
+static __thread size_t time_cache_prefix_len = 0;
+static __thread char time_cache_tz[6]; //e.g. "+0100\0" is max. 6 chars
+
+//Writes decimal digits of value right-aligned in front of end, zero padded to width digits. Returns pointer to the first digit.
+static char* time_put_digits(char* end, unsigned long int value, int width)
+{
+    do {
+        *--end = '0' + value % 10;
+        value /= 10;
+        width--;
+    } while (value != 0 || width > 0);
+    return end;
+}
+
+//Copies len characters of str to buf of size buf_size, truncating and null terminating it like snprintf(...)
+static void time_copy(char* buf, int buf_size, const char* str, size_t len)
 {
-    struct timeval tv;
-    char tmzone[6]; //e.g. "+0100\0" is max. 6 chars
+    if (len > (size_t) buf_size - 1) len = buf_size - 1;
+    memcpy(buf, str, len);
+    buf[len] = 0;
+    return;
+}
 
-    gettimeofday(&tv, NULL); //fetch struct timeval with actuall time and convert it to string...
+void time_now(struct timespec* ts, const bool coarse)
+{
+    clock_gettime(coarse ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME, ts);
+    return;
+}
 
-    if (unix_buf != NULL && unix_size > 0) {
-        snprintf(unix_buf, unix_size, "%lu.%lu", tv.tv_sec, tv.tv_usec);
-        unix_buf[unix_size-1] = 0; //Unix time incl. usec
+long double time_str_ts(const struct timespec* ts, char* unix_buf, int unix_size, char* readable_buf, int readable_size)
+{
+    long int usec = ts->tv_nsec / 1000;
+    char str[64];
+    char* ptr = 0;
+
+    if (unix_buf != NULL && unix_size > 0) { //Unix time incl. usec, e.g. "1534477913.835934". usec are not padded, as ever.
+        ptr = time_put_digits(str + sizeof(str), usec, 1);
+        *--ptr = '.';
+        ptr = time_put_digits(ptr, ts->tv_sec, 1);
+        time_copy(unix_buf, unix_size, ptr, str + sizeof(str) - ptr);
     }
 
-    if (readable_buf != NULL && readable_size > 0) {
-        char tmbuf[readable_size];
-        strftime(tmbuf, readable_size, "%Y-%m-%dT%H:%M:%S", localtime(&tv.tv_sec)); //Target format: "2018-08-17T05:51:53.835934", therefore...
-        strftime(tmzone, 6, "%z", localtime(&tv.tv_sec)); //...get timezone...
-        //...and finally print time and ms to string, append timezone and ensure it is null terminated.
-        snprintf(readable_buf, readable_size, "%s.%06ld%s", tmbuf, tv.tv_usec, tmzone);
-        readable_buf[readable_size-1] = 0; //Human readable string
+    if (readable_buf != NULL && readable_size > 0) { //Target format: "2018-08-17T05:51:53.835934+0200"
+        if (ts->tv_sec != time_cache_sec) { //Format date, time and timezone only once per second
+            struct tm tm;
+            localtime_r(&ts->tv_sec, &tm);
+            time_cache_prefix_len = strftime(time_cache_prefix, sizeof(time_cache_prefix), "%Y-%m-%dT%H:%M:%S", &tm);
+            strftime(time_cache_tz, sizeof(time_cache_tz), "%z", &tm);
+            time_cache_sec = ts->tv_sec;
+        }
+        ptr = str;
+        memcpy(ptr, time_cache_prefix, time_cache_prefix_len);
+        ptr += time_cache_prefix_len;
+        *ptr++ = '.';
+        time_put_digits(ptr + 6, usec, 6);
+        ptr += 6;
+        ptr = stpcpy(ptr, time_cache_tz);
+        time_copy(readable_buf, readable_size, str, ptr - str);
     }
 
-    return (long double) tv.tv_sec + (long double) tv.tv_usec * 1e-6; //Return unixtime as double value in any case, even if no pointer given
+    return (long double) ts->tv_sec + (long double) usec * 1e-6; //Return unixtime as double value in any case, even if no pointer given
+}
+
+long double time_str(char* unix_buf, int unix_size, char* readable_buf, int readable_size)
+{
+    struct timespec ts;
+    time_now(&ts, false);
+    return time_str_ts(&ts, unix_buf, unix_size, readable_buf, readable_size);
 }
 
 void get_user_ids(struct user_t* user) //adapted example code from manpage getpwnam(3)
@@ -103,6 +160,46 @@ void get_user_ids(struct user_t* user) //adapted example code from manpage getpw
     return;
 }
 
+int fork_workers(const int workers)
+{
+    for (int worker = 1; worker < workers; worker++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGKILL); //request SIGKILL if parent dies.
+            return worker;
+        }
+        if (pid < 0)
+            break;
+    }
+    return 0;
+}
+
+int set_cpu_affinity(const char* cpus, const int worker)
+{
+    int cpu_list[CPU_SETSIZE];
+    int cpu_count = 0;
+    const char* pos = cpus;
+    while (*pos != 0 && cpu_count < CPU_SETSIZE) { //parse list, e.g. "2,3,4,5"
+        char* end;
+        long int cpu = strtol(pos, &end, 10);
+        if (end == pos || cpu < 0 || cpu >= CPU_SETSIZE)
+            return -1;
+        cpu_list[cpu_count++] = cpu;
+        pos = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != 0)
+            return -1;
+    }
+    if (cpu_count == 0)
+        return -1;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_list[worker % cpu_count], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -1;
+    return cpu_list[worker % cpu_count];
+}
+
 void print_hex(FILE* output, const unsigned char* buffer, int buffsize)
 {
     int i, offset = 16; //The offset of the offset is 16. X-D
@@ -120,103 +217,197 @@ void print_hex(FILE* output, const unsigned char* buffer, int buffsize)
     return;
 }
 
-char *print_hex_string(const unsigned char* buffer, unsigned int buffsize) //must be freed
+//Hex encoding of 16 bytes at once, as far as the instruction set of the target allows.
+//hi and lo are the high and low nibbles of each byte, converted to ASCII: n + '0', plus 'a' - '0' - 10 if n > 9.
+#if defined(__AVX2__)
+static inline void hex_encode_32(char* out, const unsigned char* in)
 {
-    char* output = malloc(2*buffsize+1); //output has to be min. 2*buffsize + 1 for 2 characters per byte and null-termination.
-    if(buffsize<=0) {
-        output[0] = 0;
-        return output;
-    }; //return proper empty string
-    int i = 0;
-    for(i=0; i<buffsize; i++)
-        sprintf(output+2*i, "%02x", (unsigned char) buffer[i]);
-    output[2*i] = 0; //Terminate string with \0
-    return output;
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i v = _mm256_loadu_si256((const __m256i*) in);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+    __m256i lo = _mm256_and_si256(v, mask);
+    hi = _mm256_add_epi8(_mm256_add_epi8(hi, _mm256_set1_epi8('0')), _mm256_and_si256(_mm256_cmpgt_epi8(hi, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10)));
+    lo = _mm256_add_epi8(_mm256_add_epi8(lo, _mm256_set1_epi8('0')), _mm256_and_si256(_mm256_cmpgt_epi8(lo, _mm256_set1_epi8(9)), _mm256_set1_epi8('a' - '0' - 10)));
+    //unpack works on 128 bit lanes, thus bytes 0-7 and 16-23 resp. 8-15 and 24-31 are interleaved together
+    __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    __m256i b = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*) out, _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i*) (out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    return;
 }
-// is it nessesary?
-//Put HexDump like output to string: must be freed
-char* hex_dump(const void *addr, int len, const bool json)
+#endif
+
+#if defined(__SSE2__)
+static inline void hex_encode_16(char* out, const unsigned char* in)
 {
-    char* output = 0;
-    
-    if(len <= 0) { //return empty string
-        output = malloc(1);
-        memset(output, 0, 1);
-        return output;
-    }
-  
-    int i =0;
-    unsigned char ascii_buff[17]; //size is 16 character + \0
-    const unsigned char *pc = (const unsigned char*)addr;
-    //Hex output is 3 characters per Byte e.g. "ff " for 16 Bytes per row plus offset, ascii and padding with spaces. Number of rows is len div 16 plus first row.
-    int out_len = (16 * 3 + 32) * (len / 16 + 1);
-    output = malloc(out_len); //must be freed
-    char* out_ptr = output;
-    memset(output, 0, out_len);
-
-    if (len == 0) {
-        return output;
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i v = _mm_loadu_si128((const __m128i*) in);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i lo = _mm_and_si128(v, mask);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, _mm_set1_epi8('0')), _mm_and_si128(_mm_cmpgt_epi8(hi, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10)));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, _mm_set1_epi8('0')), _mm_and_si128(_mm_cmpgt_epi8(lo, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10)));
+    _mm_storeu_si128((__m128i*) out, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*) (out + 16), _mm_unpackhi_epi8(hi, lo));
+    return;
+}
+
+//Printable ASCII characters of 16 bytes for hexdumps, other characters replaced by '.'
+static inline void hex_dump_ascii_16(char* out, const unsigned char* in, const bool json)
+{
+    __m128i v = _mm_loadu_si128((const __m128i*) in);
+    //signed compare: 0x80-0xff are negative, thus not greater than 0x1f
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+    v = _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+    if(json) { //Do not insert " and \ in JSON!
+        __m128i quote = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+        __m128i backslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'));
+        v = _mm_xor_si128(v, _mm_and_si128(quote, _mm_set1_epi8('"' ^ '\'')));
+        v = _mm_xor_si128(v, _mm_and_si128(backslash, _mm_set1_epi8('\\' ^ '/')));
     }
-    if (len < 0) {
-        return output;
+    _mm_storeu_si128((__m128i*) out, v);
+    return;
+}
+#elif defined(__ARM_NEON)
+static inline void hex_encode_16(char* out, const unsigned char* in)
+{
+    uint8x16_t v = vld1q_u8(in);
+    uint8x16x2_t hex;
+    hex.val[0] = vshrq_n_u8(v, 4);
+    hex.val[1] = vandq_u8(v, vdupq_n_u8(0x0f));
+    hex.val[0] = vaddq_u8(vaddq_u8(hex.val[0], vdupq_n_u8('0')), vandq_u8(vcgtq_u8(hex.val[0], vdupq_n_u8(9)), vdupq_n_u8('a' - '0' - 10)));
+    hex.val[1] = vaddq_u8(vaddq_u8(hex.val[1], vdupq_n_u8('0')), vandq_u8(vcgtq_u8(hex.val[1], vdupq_n_u8(9)), vdupq_n_u8('a' - '0' - 10)));
+    vst2q_u8((uint8_t*) out, hex); //interleaving store
+    return;
+}
+
+//Printable ASCII characters of 16 bytes for hexdumps, other characters replaced by '.'
+static inline void hex_dump_ascii_16(char* out, const unsigned char* in, const bool json)
+{
+    uint8x16_t v = vld1q_u8(in);
+    uint8x16_t printable = vandq_u8(vcgeq_u8(v, vdupq_n_u8(0x20)), vcleq_u8(v, vdupq_n_u8(0x7e)));
+    v = vbslq_u8(printable, v, vdupq_n_u8('.'));
+    if(json) { //Do not insert " and \ in JSON!
+        v = vbslq_u8(vceqq_u8(v, vdupq_n_u8('"')), vdupq_n_u8('\''), v);
+        v = vbslq_u8(vceqq_u8(v, vdupq_n_u8('\\')), vdupq_n_u8('/'), v);
     }
-    //Cap length to prevent possible overflow in output.
-    //Okay. It's at 4GB...
-    if (len > 0xFFFFFFFF) {
-        len = 0xFFFFFFFF;
+    vst1q_u8((uint8_t*) out, v);
+    return;
+}
+#endif
+
+static const char hex_digits[] = "0123456789abcdef";
+
+//Scalar fallback and remainder of the vectorized loops
+static inline void hex_encode_scalar(char* out, const unsigned char* in, size_t len)
+{
+    for(size_t i = 0; i < len; i++) {
+        out[2*i] = hex_digits[in[i] >> 4];
+        out[2*i+1] = hex_digits[in[i] & 0x0f];
     }
+    return;
+}
 
-    // Process every byte in the data.
-    for (i = 0; i < len; i++) {
-        // Multiple of 16 means new line (with line offset).
+static inline char hex_dump_ascii(const unsigned char c, const bool json)
+{
+    if ((c < 0x20) || (c > 0x7e))
+        return '.';
+    else if (json && c == 0x22) //Do not insert " in JSON!
+        return '\'';
+    else if (json && c == 0x5c) //Do not insert \ in JSON!
+        return '/';
+    return c;
+}
 
-        if ((i % 16) == 0) {
-            // Just don't print ASCII for the zeroth line.
-            if (i != 0) {
-                out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"  |%s|", ascii_buff);
+size_t hex_encode(char* output, const unsigned char* buffer, size_t buffsize)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for(; i + 32 <= buffsize; i += 32)
+        hex_encode_32(output + 2*i, buffer + i);
+#endif
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    for(; i + 16 <= buffsize; i += 16)
+        hex_encode_16(output + 2*i, buffer + i);
+#endif
+    hex_encode_scalar(output + 2*i, buffer + i, buffsize - i);
+    output[2*buffsize] = 0; //Terminate string with \0
+    return 2*buffsize;
+}
 
-                if (json)
-                    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"\\n");
-                else
-                    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"\n");
+size_t hex_dump_encode(char* output, const unsigned char* buffer, size_t buffsize, const bool json)
+{
+    char* out = output;
+    char hex[32];
+
+    //Lines of 16 Bytes: offset, hex code in two groups of 8 Bytes, ASCII-Part. Lines are separated by line breaks, escaped in JSON.
+    for(size_t line = 0; line < buffsize; line += 16) {
+        size_t n = buffsize - line < 16 ? buffsize - line : 16;
+        size_t i = 0;
+
+        // Output the offset.
+        const unsigned char offset[4] = { line >> 24, line >> 16, line >> 8, line };
+        hex_encode_scalar(out, offset, 4);
+        out[8] = ' ';
+        out += 9;
+
+        // Now the hex code, with an additional space after 8 Bytes. Missing Bytes of the last line are padded with spaces.
+        memset(out, ' ', 49);
+        if(n == 16) {
+#if defined(__SSE2__) || defined(__ARM_NEON)
+            hex_encode_16(hex, buffer + line);
+#else
+            hex_encode_scalar(hex, buffer + line, 16);
+#endif
+            for(i = 0; i < 8; i++) { //fixed positions, so the compiler is able to unroll
+                memcpy(out + 1 + 3*i, hex + 2*i, 2);
+                memcpy(out + 26 + 3*i, hex + 16 + 2*i, 2);
             }
-
-            // Output the offset.
-            out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"%08x ", i);
-        } else if ((i % 8) == 0) {
-            if (i != 0)
-                out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," ");
+        } else {
+            hex_encode_scalar(hex, buffer + line, n);
+            for(i = 0; i < n; i++)
+                memcpy(out + 1 + 3*i + (i >= 8), hex + 2*i, 2);
         }
-
-
-        // Now the hex code for the specific character.
-        out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," %02x", pc[i]);
-
-        // And store a printable ASCII character for later.
-        if ((pc[i] < 0x20) || (pc[i] > 0x7e))
-            ascii_buff[i % 16] = '.';
-        else if (json && pc[i] == 0x22) //Do not insert " in JSON!
-            ascii_buff[i % 16] = '\'';
-        else if (json && pc[i] == 0x5c) //Do not insert \ in JSON!
-            ascii_buff[i % 16] = '/';
+        out += 49;
+
+        // And the ASCII part.
+        memcpy(out, "  |", 3);
+        out += 3;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+        if(n == 16)
+            hex_dump_ascii_16(out, buffer + line, json);
         else
-            ascii_buff[i % 16] = pc[i];
-        ascii_buff[(i % 16) + 1] = '\0';
-    }
-
-    // Pad out last line if not exactly 16 characters.
-    while ((i % 16) != 0) {
-        out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"   ");
-        if ((i % 8) == 0)
-            out_ptr += snprintf(out_ptr, out_len - (out_ptr - output)," ");
-
-        i++;
+#endif
+            for(i = 0; i < n; i++)
+                out[i] = hex_dump_ascii(buffer[line + i], json);
+        out += n;
+        *out++ = '|';
+
+        if(line + 16 < buffsize) {
+            if (json) {
+                memcpy(out, "\\n", 2);
+                out += 2;
+            } else {
+                *out++ = '\n';
+            }
+        }
     }
+    *out = 0;
+    return out - output;
+}
 
-    // And print the final ASCII bit.
-    out_ptr += snprintf(out_ptr, out_len - (out_ptr - output),"  |%s|", ascii_buff);
-    out_ptr = 0;
+char *print_hex_string(const unsigned char* buffer, unsigned int buffsize) //must be freed
+{
+    char* output = malloc(HEX_STRING_LEN(buffsize)); //output has to be min. 2*buffsize + 1 for 2 characters per byte and null-termination.
+    hex_encode(output, buffer, buffsize);
+    return output;
+}
 
+//Put HexDump like output to string: must be freed
+char* hex_dump(const void *addr, int len, const bool json)
+{
+    if(len <= 0) len = 0; //return empty string
+    char* output = malloc(HEX_DUMP_LEN(len)); //must be freed
+    hex_dump_encode(output, (const unsigned char*) addr, len, json);
     return output;
 }
 
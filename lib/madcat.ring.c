@@ -0,0 +1,269 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * Shared memory event ring.
+ *
+ * BSI 2018-2023
+*/
+
+#define _GNU_SOURCE //pthread_timedjoin_np(...)
+#include "madcat.ring.h"
+#include "madcat.helper.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+//Data of ring id, following the shared memory block
+static inline char* event_ring_data(struct event_ring_t* ring, int id)
+{
+    return (char*) ring + sizeof(struct event_ring_t) + id * ring->size;
+}
+
+//PID of this process, stored in each record by event_ring_put(...), cached because getpid() is a system call
+static pid_t event_ring_pid = 0;
+
+static void event_ring_pid_reset(void)
+{
+    event_ring_pid = 0;
+}
+
+static void event_ring_pid_atfork(void)
+{
+    pthread_atfork(NULL, NULL, event_ring_pid_reset); //the producers are forked after the rings have been mapped
+}
+
+struct event_ring_t* event_ring_init(int count, size_t size)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, event_ring_pid_atfork);
+    if (count < 1 || count > EVENT_RING_MAX) return NULL;
+    uint64_t ring_size = 4096;
+    while (ring_size < size) ring_size <<= 1;
+    struct event_ring_t* ring = mmap(NULL, sizeof(struct event_ring_t) + count * ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return NULL;
+    //anonymous mappings are zeroed, thus all records are uncommitted
+    ring->count = count;
+    ring->size = ring_size;
+    return ring;
+}
+
+bool event_ring_put(struct event_ring_t* ring, int id, const void* data, size_t len, const void* data2, size_t len2)
+{
+    struct event_ring_queue_t* q = &ring->queue[id];
+    uint64_t rec_len = (sizeof(struct event_ring_record_t) + len + len2 + EVENT_RING_ALIGN - 1) & ~((uint64_t) EVENT_RING_ALIGN - 1);
+    uint64_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    uint64_t pad = 0;
+    do { //reserve space for the record, which never wraps around the end of the ring, but is preceded by padding
+        uint64_t offset = head & (ring->size - 1);
+        pad = offset + rec_len > ring->size ? ring->size - offset : 0;
+        if (head + pad + rec_len - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) > ring->size) {
+            __atomic_add_fetch(&q->dropped, 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&q->dropped_bytes, len + len2, __ATOMIC_RELAXED);
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&q->head, &head, head + pad + rec_len, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    if (event_ring_pid == 0) event_ring_pid = getpid();
+    char* base = event_ring_data(ring, id);
+    struct event_ring_record_t* rec;
+    if (pad > 0) {
+        rec = (struct event_ring_record_t*) (base + (head & (ring->size - 1)));
+        rec->len = pad;
+        rec->data_len = 0;
+        __atomic_store_n(&rec->pid, event_ring_pid, __ATOMIC_RELEASE);
+        __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+        head += pad;
+    }
+    rec = (struct event_ring_record_t*) (base + (head & (ring->size - 1)));
+    rec->len = rec_len;
+    rec->data_len = len + len2;
+    __atomic_store_n(&rec->pid, event_ring_pid, __ATOMIC_RELEASE); //owner, so the drain thread never skips the record while this process lives
+    memcpy((char*) (rec + 1), data, len);
+    if (len2 > 0) memcpy((char*) (rec + 1) + len, data2, len2);
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE); //commit
+
+    //Wake drain thread, if it sleeps. Sequentially consistent, so either this producer sees it sleeping or it sees the record.
+    __atomic_add_fetch(&ring->doorbell, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->sleeping, __ATOMIC_SEQ_CST))
+        syscall(SYS_futex, &ring->doorbell, FUTEX_WAKE, 1, NULL, NULL, 0);
+    return true;
+}
+
+bool event_ring_put_event(struct event_ring_t* ring, int id, const struct dict_buffer* buf)
+{
+    if (buf->format == DICT_FORMAT_JSON)
+        return event_ring_put(ring, id, buf->data, buf->len, "\n", 1); //one line per event
+    return event_ring_put(ring, id, buf->data, buf->len, NULL, 0);
+}
+
+//Tests if the record at the tail of a ring is committed
+static bool event_ring_ready(struct event_ring_t* ring, int id)
+{
+    struct event_ring_queue_t* q = &ring->queue[id];
+    uint64_t tail = q->tail;
+    if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) return false;
+    struct event_ring_record_t* rec = (struct event_ring_record_t*) (event_ring_data(ring, id) + (tail & (ring->size - 1)));
+    return __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == tail + 1;
+}
+
+//Skips the record at the tail, if it has not been committed for EVENT_RING_STALL ms and its producer died, returns the new tail
+static uint64_t event_ring_skip_stalled(struct event_ring_t* ring, int id, uint64_t tail)
+{
+    struct event_ring_queue_t* q = &ring->queue[id];
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    if (q->stall_tail != tail + 1) { //first seen, +1 as the initial value 0 would match tail 0
+        q->stall_tail = tail + 1;
+        q->stall_since = now;
+        return tail;
+    }
+    if ((now.tv_sec - q->stall_since.tv_sec) * 1000 + (now.tv_nsec - q->stall_since.tv_nsec) / 1000000 < EVENT_RING_STALL)
+        return tail;
+    //A producer, which is only slow, e.g. descheduled or stopped, would commit into the space after it has been reused,
+    //thus skip only records of dead producers. Without PID the header is incomplete, i.e. neither owner nor length are known, so the record is kept.
+    struct event_ring_record_t* rec = (struct event_ring_record_t*) (event_ring_data(ring, id) + (tail & (ring->size - 1)));
+    pid_t pid = __atomic_load_n(&rec->pid, __ATOMIC_ACQUIRE);
+    if (pid <= 0 || kill(pid, 0) == 0 || errno != ESRCH)
+        return tail;
+    uint64_t len = rec->len;
+    memset(rec, 0, len);
+    __atomic_add_fetch(&q->skipped, 1, __ATOMIC_RELAXED);
+    q->stall_tail = 0;
+    return tail + len;
+}
+
+long int event_ring_drain(struct event_ring_t* ring, int id, FILE* output)
+{
+    struct event_ring_queue_t* q = &ring->queue[id];
+    char* base = event_ring_data(ring, id);
+    uint64_t tail = q->tail;
+    long int events = 0, bytes = 0;
+    while (true) {
+        uint64_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        if (tail == head) break;
+        struct event_ring_record_t* rec = (struct event_ring_record_t*) (base + (tail & (ring->size - 1)));
+        if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) { //producer still writing
+            uint64_t skipped = event_ring_skip_stalled(ring, id, tail);
+            if (skipped == tail) break;
+            tail = skipped;
+            __atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+            continue;
+        }
+        uint64_t len = rec->len;
+        if (rec->data_len > 0) {
+            fwrite(rec + 1, 1, rec->data_len, output);
+            events++;
+            bytes += rec->data_len;
+        }
+        //Clear the record, so stale data is never taken for a committed record in the next round of the ring
+        memset(rec, 0, len);
+        tail += len;
+        __atomic_store_n(&q->tail, tail, __ATOMIC_RELEASE);
+    }
+    if (events > 0) {
+        fflush(output);
+        __atomic_add_fetch(&q->events, events, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&q->bytes, bytes, __ATOMIC_RELAXED);
+    }
+    return events;
+}
+
+static void* event_drain_thread(void* arg)
+{
+    struct event_drain_t* drain = (struct event_drain_t*) arg;
+    struct event_ring_t* ring = drain->ring;
+    struct timespec timeout = { EVENT_RING_WAIT / 1000, (EVENT_RING_WAIT % 1000) * 1000000 };
+    while (!__atomic_load_n(&drain->stop, __ATOMIC_ACQUIRE)) {
+        uint32_t doorbell = __atomic_load_n(&ring->doorbell, __ATOMIC_SEQ_CST);
+        long int events = 0;
+        for (int id = 0; id < ring->count; id++)
+            if (drain->output[id] != 0) events += event_ring_drain(ring, id, drain->output[id]);
+        if (events > 0) continue;
+
+        //Sleep until a producer rings the doorbell, checking for records committed meanwhile first
+        __atomic_store_n(&ring->sleeping, 1, __ATOMIC_SEQ_CST);
+        bool ready = false;
+        for (int id = 0; id < ring->count; id++)
+            ready |= drain->output[id] != 0 && event_ring_ready(ring, id);
+        if (!ready)
+            syscall(SYS_futex, &ring->doorbell, FUTEX_WAIT, doorbell, &timeout, NULL, 0);
+        __atomic_store_n(&ring->sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+    for (int id = 0; id < ring->count; id++)
+        if (drain->output[id] != 0) event_ring_drain(ring, id, drain->output[id]);
+    return NULL;
+}
+
+int event_drain_start(struct event_drain_t* drain)
+{
+    for (int id = 0; id < drain->ring->count; id++)
+        if (drain->output[id] != 0) setvbuf(drain->output[id], NULL, _IOFBF, EVENT_RING_BUFFER);
+    drain->pid = getpid();
+    drain->stop = false;
+    //signals are handled by the other threads only, thus their handlers may stop the drain thread
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int ret = pthread_create(&drain->thread, NULL, event_drain_thread, drain);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return ret;
+}
+
+void event_drain_stop(struct event_drain_t* drain)
+{
+    if (drain == 0 || drain->pid != getpid()) return;
+    __atomic_store_n(&drain->stop, true, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &drain->ring->doorbell, FUTEX_WAKE, 1, NULL, NULL, 0);
+    //the thread may be blocked writing to a FIFO nobody reads, thus do not wait forever
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += EVENT_RING_STALL / 1000;
+    pthread_timedjoin_np(drain->thread, NULL, &timeout);
+    drain->pid = 0;
+    return;
+}
+
+void event_ring_log_stats(struct event_ring_t* ring, const char* const name[])
+{
+    static long int last[EVENT_RING_MAX] = { 0 }; //dropped + skipped at the last call
+    for (int id = 0; id < ring->count; id++) {
+        struct event_ring_queue_t* q = &ring->queue[id];
+        long int lost = __atomic_load_n(&q->dropped, __ATOMIC_RELAXED) + __atomic_load_n(&q->skipped, __ATOMIC_RELAXED);
+        if (lost == last[id]) continue;
+        last[id] = lost;
+        char log_time[64] = "";
+        time_str(NULL, 0, log_time, sizeof(log_time));
+        fprintf(stderr, "%s [PID %d] Event ring %s: %ld events written, %ld events (%ld bytes) dropped because the ring was full, %ld stalled records skipped\n",
+                log_time, getpid(), name[id], __atomic_load_n(&q->events, __ATOMIC_RELAXED), __atomic_load_n(&q->dropped, __ATOMIC_RELAXED),
+                __atomic_load_n(&q->dropped_bytes, __ATOMIC_RELAXED), __atomic_load_n(&q->skipped, __ATOMIC_RELAXED));
+    }
+    return;
+}
@@ -54,7 +54,8 @@ void print_help_raw(char* progname) //print help message
             \tmax_file_size = \"1024\" --optional: Max. size of payloads in JSON-Output\n\
             \t--Optional filter expresion for RAW module, defaults to none (empty string).\n\
             \t--Syntax: https://www.tcpdump.org/manpages/pcap-filter.7.html\n\
-            \traw_pcap_filter_exp = \"(not ip6 multicast) and inbound and ip6\"\n"\
+            \traw_pcap_filter_exp = \"(not ip6 multicast) and inbound and ip6\"\n\
+            \t--capture_backend = \"afpacket\" --optional: \"pcap\" (default) or \"afpacket\"\n"\
             , progname);
 
     return;
@@ -67,9 +68,8 @@ void sig_handler_raw(int signo)
     time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
     fprintf(stderr, "\n%s [PID %d] Received Signal %s, shutting down...\n", stop_time, getpid(), strsignal(signo));
     //Free pcap data structures
-    pcap_close(handle); //Close PCAP Session handle
+    if (handle != NULL) pcap_close(handle); //Close PCAP Session handle, not opened by AF_PACKET backend
     free(filter_exp); //The configured PCAP Filter string
-    free(packet); //The Packet from pcap
     //free json object
     dict_free(json_dict(false));
     //exit parent process
@@ -93,7 +93,7 @@ void drop_root_privs(struct user_t user, const char* entity) // if process is ru
     return;
 }
 
-int init_pcap(char* dev, pcap_t **handle, const char* filter_exp)
+int init_pcap(char* dev, pcap_t **handle, const char* filter_exp, const struct capture_conf_t* conf)
 {
     char log_time[64] = ""; //Human readable start time (actual time zone)
     //char log_time_unix[64] = ""; //Unix timestamp (UTC) no need
@@ -112,9 +112,17 @@ int init_pcap(char* dev, pcap_t **handle, const char* filter_exp)
     // Find the properties for the device
     if (pcap_lookupnet(dev, &net, &mask, errbuf) == -1)
         return -1;
-    // Open the session in non-promiscuous mode
-    *handle = pcap_open_live(dev, BUFSIZ, 0, 100, errbuf);
-    if (handle == NULL)
+    // Create the session in non-promiscuous mode and apply capture settings before activating it
+    *handle = pcap_create(dev, errbuf);
+    if (*handle == NULL)
+        return -2;
+    pcap_set_snaplen(*handle, conf->snaplen);
+    pcap_set_promisc(*handle, 0);
+    pcap_set_timeout(*handle, CAPTURE_TIMEOUT);
+    if (conf->buffer_size > 0)
+        pcap_set_buffer_size(*handle, conf->buffer_size);
+    pcap_set_immediate_mode(*handle, conf->immediate);
+    if (pcap_activate(*handle) < 0) //warnings (>0) are not fatal
         return -2;
     // Compile and apply the filter
     if(strlen(filter_exp) > 0) {
@@ -136,3 +144,126 @@ int init_pcap(char* dev, pcap_t **handle, const char* filter_exp)
 
     return 0;
 }
+
+void worker_raw(u_char* user, const struct pcap_pkthdr* header, const u_char* packet)
+{
+    int max_file_size = *(int*) user;
+    char log_time[64] = ""; //Human readable capture time (actual time zone)
+    char log_time_unix[64] = ""; //Unix timestamp of capture (UTC)
+    struct json_data_node_t json_data; //JSON Data structure for output generation
+    unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
+    bool size_exceeded = false; //max file size exceeded?
+
+    //Test if something went wrong
+    if (!(header->len > ETHERNET_HEADER_LEN)) return;
+
+    //Preserve actuall time of Connection attempt as captured by the kernel, linked to timestamps in json_data
+    struct timespec packet_time = { header->ts.tv_sec, header->ts.tv_usec * 1000 };
+    json_data.timeasdouble = time_str_ts(&packet_time, log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
+    json_data.unixtime = log_time_unix;
+    json_data.timestamp = log_time;
+    json_data.start = log_time;
+    fprintf(stderr, "%s [PID %d] RAW Packet received\n", log_time, getpid());
+
+    //Set pointer and length to address layer 3 directly in received data
+    int packet_len = header->len - ETHERNET_HEADER_LEN;
+    unsigned char* packet_layer3 = (unsigned char*) packet + ETHERNET_HEADER_LEN;
+
+    if (packet_len > max_file_size && max_file_size > 0)
+        size_exceeded = true;
+    else
+        size_exceeded = false;
+
+#if DEBUG >= 2
+    fprintf(stdout, "\n%s\n", hex_dump(packet_layer3, packet_len, false));
+#endif
+
+    json_data.bytes_toserver = packet_len; //Len is defined here as layer 3 protokoll data + encapsulated protocols and their payload
+
+    //Process packet data
+    //Compute SHA1 of packet
+    SHA1(packet_layer3, (size_exceeded ? max_file_size : packet_len), payload_sha1);
+
+    //Begin new global JSON output and open JSON object
+    json_data.duration = time_str(NULL, 0, log_time, sizeof(log_time)) - json_data.timeasdouble;
+    json_data.end = log_time;
+
+    struct raw_event_t event = {0}; //begin new JSON Output
+    event.timestamp = json_data.timestamp;
+
+    //Assumption of IP (v4 or v6) to determine version
+    struct ether_header * ethhdr = (struct ether_header *) packet; //Ethernet Header 
+    uint16_t ether_type =  ntohs(ethhdr->ether_type);
+    struct iphdr *iphdr = (struct iphdr *)(packet + ETHERNET_HEADER_LEN); //IPv4 header structure
+    struct ipv6hdr *ip6hdr = (struct ipv6hdr *) iphdr; //Interpretation of the header as IPv6 Header
+    char* proto_str = EMPTY_STR;
+    char* dest_ip = malloc(INET6_ADDRSTRLEN); dest_ip[0] = 0;
+    char* src_ip = malloc(INET6_ADDRSTRLEN); src_ip[0] = 0;
+    bool tainted = false;
+    //Source: https://www.iana.org/assignments/ieee-802-numbers/ieee-802-numbers.xhtml
+    switch(ether_type) { //Determine protocol type by ethertype
+        case 0x0800: json_data.proto = 4; break;
+        case 0x86DD: json_data.proto = 6; break;
+        default: json_data.proto = -1*ether_type; break;
+    }
+    //Check packet length for detected IP version.
+    //For IPv4 minimum ist 20bytes
+    //For IPv6 the Headerlength is fixed 40bytes
+    if ((json_data.proto == 4 && packet_len < IPV4_HEADER_MIN_LEN) ||
+        (json_data.proto == 6 && packet_len < IPV6_HEADER_LEN )) {
+            proto_str = malloc(10);
+            snprintf(proto_str, 10, "MALFORMED");
+            tainted = true;
+         }
+    else {
+        //Try to determine IPv4/IPv6 transport protocol
+        switch(json_data.proto) {
+            case 4: //If IPv4 has been detected, no suffix is used (tcpdump-style)
+                proto_str = itoprotostr(iphdr->protocol, "");
+                inet_ntop(AF_INET, &(iphdr->saddr), src_ip, INET6_ADDRSTRLEN);
+                inet_ntop(AF_INET, &(iphdr->daddr), dest_ip, INET6_ADDRSTRLEN);
+                //Include IP Information only if IPv4/v6 has been detected
+                event.src_ip = src_ip;
+                event.dest_ip = dest_ip;
+                break;
+            case 6: //If IPv6 has been detected, the suffix "v6" is used
+                proto_str = itoprotostr(ip6hdr->nexthdr, "v6");
+                inet_ntop(AF_INET6, &(ip6hdr->saddr), src_ip, INET6_ADDRSTRLEN);
+                inet_ntop(AF_INET6, &(ip6hdr->daddr), dest_ip, INET6_ADDRSTRLEN);
+                //Include IP Information only if IPv4/v6 has been detected
+                event.src_ip = src_ip;
+                event.dest_ip = dest_ip;
+                break;
+            default: //If neither IPv4 nor IPv6 could be detected, raw ethertype is used
+                proto_str = malloc(20);
+                snprintf(proto_str, 20, "0x%04X", ether_type); break;
+                break;
+        }
+    }
+    
+    event.proto = proto_str;
+    event.tainted = tainted;
+    event.unixtime = atof(json_data.unixtime);
+    event.start = json_data.start;
+    event.end = json_data.end;
+    event.duration = json_data.duration;
+    event.bytes_toserver = json_data.bytes_toserver;
+    event.payload = packet_layer3;
+    event.payload_len = (size_exceeded ? max_file_size : packet_len);
+    event.payload_sha1 = payload_sha1;
+    event.pcap_filter = filter_exp;
+    event.ether_type = ether_type;
+
+    //print JSON Object to stdout for logging
+    static struct dict_buffer output = {0}; //reused for every event
+    output.format = output_format;
+    if(emit_raw_event(&output, &event) > 2) { //do not print empty JSON-Objects
+        print_event(stdout, &output);
+        fflush(stdout);
+    }
+
+    free(proto_str);
+    free(src_ip);
+    free(dest_ip);
+    return;
+}
@@ -50,6 +50,7 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
     Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
 *******************************************************************************/
 
+#define _GNU_SOURCE //splice(...) and pipe2(...)
 #include <unistd.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -58,6 +59,8 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #include <sys/epoll.h>
 #include <netdb.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/uio.h>
 
 
 #include "epollinterface.h"
@@ -67,31 +70,82 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 
 #define BUFFER_SIZE 4096
-
-struct data_buffer_entry {
-    int is_close_message;
-    char* data;
-    int current_offset;
-    int len;
-    struct data_buffer_entry* next;
+#define CONNECTION_IOV 16 //MADCAT: Slabs written by one call to writev(...)
+
+//MADCAT: data not yet written to a connection, replaces the list of malloc'ed data_buffer_entry
+struct write_slab_t {
+    struct write_slab_t* next;
+    int start; //first byte not yet written
+    int end; //behind the last byte
+    char data[CONNECTION_SLAB_SIZE];
 };
 
+bool connection_splice = false; //MADCAT
+
+//MADCAT: free slabs of this process, handlers are single threaded
+static struct write_slab_t* slab_pool = NULL;
+static int slab_pool_len = 0;
+
+
+static struct write_slab_t* write_slab_get()
+{
+    struct write_slab_t* slab = slab_pool;
+    if (slab != NULL) {
+        slab_pool = slab->next;
+        slab_pool_len--;
+    } else {
+        slab = malloc(sizeof(struct write_slab_t));
+    }
+    slab->next = NULL;
+    slab->start = 0;
+    slab->end = 0;
+    return slab;
+}
+
+
+static void write_slab_put(struct write_slab_t* slab)
+{
+    if (slab_pool_len >= CONNECTION_SLAB_POOL) {
+        free(slab);
+        return;
+    }
+    slab->next = slab_pool;
+    slab_pool = slab;
+    slab_pool_len++;
+}
+
+
+//MADCAT: true, if reading from the peer of this connection has to be paused
+static bool connection_full(struct connection_closure* closure)
+{
+    return closure->write_pending >= CONNECTION_WRITE_MAX || closure->splice_pending >= CONNECTION_SPLICE_PIPE;
+}
+
 
 void connection_really_close(struct epoll_event_handler* self)
 {
     struct connection_closure* closure = (struct connection_closure* ) self->closure;
-    struct data_buffer_entry* next;
-    while (closure->write_buffer != NULL) {
-        next = closure->write_buffer->next;
-        if (!closure->write_buffer->is_close_message) {
-            epoll_add_to_free_list(closure->write_buffer->data);
-        }
-        epoll_add_to_free_list(closure->write_buffer);
-        closure->write_buffer = next;
+    struct write_slab_t* next;
+    while (closure->write_head != NULL) { //MADCAT: no other references, back to the pool instead of the free list
+        next = closure->write_head->next;
+        write_slab_put(closure->write_head);
+        closure->write_head = next;
+    }
+    closure->write_tail = NULL;
+    closure->write_pending = 0;
+
+    //MADCAT: data spliced from the peer and not yet written is discarded
+    if (closure->peer != NULL) {
+        ((struct connection_closure*) closure->peer->closure)->peer = NULL;
+    }
+    if (closure->splice_pipe[0] != -1) {
+        close(closure->splice_pipe[0]);
+        close(closure->splice_pipe[1]);
     }
 
-    epoll_remove_handler(self);
-    close(self->fd);
+    int fd = self->fd;
+    epoll_remove_handler(self); //sets self->fd to -1
+    close(fd);
     epoll_add_to_free_list(self->closure);
     epoll_add_to_free_list(self);
     rsp_log("Freed connection %p", self);
@@ -108,40 +162,202 @@ void connection_on_close_event(struct epoll_event_handler* self)
 }
 
 
+void connection_abort(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    if (closure->on_close != NULL) {
+        closure->on_close(closure->on_close_closure);
+    }
+    closure->on_read = NULL;
+    closure->on_close = NULL;
+    connection_really_close(self);
+}
+
+
+//MADCAT
+void connection_on_connect_event(struct epoll_event_handler* self, uint32_t events)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    int error = 0;
+    socklen_t error_len = sizeof(error);
+    if (getsockopt(self->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) == -1) {
+        error = errno;
+    }
+    if (error == 0 && (events & (EPOLLERR | EPOLLHUP))) {
+        error = ECONNREFUSED;
+    }
+
+    closure->connecting = false;
+    if (closure->on_connect != NULL) {
+        closure->on_connect(closure->on_connect_closure, error);
+    }
+    if (error != 0) {
+        connection_abort(self);
+    }
+}
+
+
+void connection_on_in_event(struct epoll_event_handler* self);
+
+
+//MADCAT: stop reading, until the peer has written its buffered data
+static void connection_pause(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    if (closure->paused) return;
+    closure->paused = true;
+    epoll_modify_handler(self, EPOLLRDHUP | EPOLLET | EPOLLOUT);
+}
+
+
+//MADCAT: read again, data which has arrived meanwhile is not signalled by another edge
+static void connection_resume(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    closure->paused = false;
+    epoll_modify_handler(self, EPOLLIN | EPOLLRDHUP | EPOLLET | EPOLLOUT);
+    connection_on_in_event(self);
+}
+
+
+//MADCAT: write data spliced from the peer.
+//Returns -1, if the connection has been closed or the pipe could not be drained completely.
+static int connection_splice_out(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    ssize_t written;
+    while (closure->splice_pending > 0) {
+        written = splice(closure->splice_pipe[0], NULL, self->fd, NULL, closure->splice_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (written == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return -1;
+            }
+            if (errno == ECONNRESET || errno == EPIPE) {
+                rsp_log_error("On out event splice error");
+                closure->splice_pending = 0; //discard, so the connection is not kept open for data, which can not be written anymore
+                connection_on_close_event(self);
+                return -1;
+            }
+            rsp_log_error("Error splicing to client");
+            exit(-1);
+        }
+        closure->splice_pending -= written;
+    }
+    return 0;
+}
+
+
+//MADCAT: write buffered slabs, several at once.
+//Returns -1, if the connection has been closed or the slabs could not be written completely.
+static int connection_flush(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    struct iovec iov[CONNECTION_IOV];
+    struct write_slab_t* slab;
+    ssize_t written;
+    int iovcnt;
+    while (closure->write_head != NULL) {
+        iovcnt = 0;
+        for (slab = closure->write_head; slab != NULL && iovcnt < CONNECTION_IOV; slab = slab->next) {
+            iov[iovcnt].iov_base = slab->data + slab->start;
+            iov[iovcnt].iov_len = slab->end - slab->start;
+            iovcnt++;
+        }
+
+        written = writev(self->fd, iov, iovcnt);
+        if (written == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return -1;
+            }
+            if (errno == ECONNRESET || errno == EPIPE) {
+                rsp_log_error("On out event write error");
+                connection_on_close_event(self);
+                return -1;
+            }
+            rsp_log_error("Error writing to client");
+            exit(-1);
+        }
+
+        closure->write_pending -= written;
+        while (written > 0) {
+            slab = closure->write_head;
+            if (written < slab->end - slab->start) {
+                slab->start += written;
+                return -1; //socket buffer full
+            }
+            written -= slab->end - slab->start;
+            closure->write_head = slab->next;
+            write_slab_put(slab);
+        }
+        if (closure->write_head == NULL) {
+            closure->write_tail = NULL;
+        }
+    }
+    return 0;
+}
+
+
 void connection_on_out_event(struct epoll_event_handler* self)
 {
     struct connection_closure* closure = (struct connection_closure*) self->closure;
-    int written;
-    int to_write;
-    struct data_buffer_entry* temp;
-    while (closure->write_buffer != NULL) {
-        if (closure->write_buffer->is_close_message) {
-            connection_really_close(self);
+
+    if (closure->splice_pending > 0 && connection_splice_out(self) == -1) { //MADCAT
+        return;
+    }
+    if (closure->write_head != NULL && connection_flush(self) == -1) {
+        return;
+    }
+
+    //MADCAT: all data written
+    if (closure->close_pending) {
+        connection_really_close(self);
+        return;
+    }
+    if (closure->peer != NULL && ((struct connection_closure*) closure->peer->closure)->paused) {
+        connection_resume(closure->peer);
+    }
+}
+
+
+//MADCAT: splice data read into the pipe of the peer and on to the peer.
+//Reading is paused, if the pipe is full, and resumed by connection_on_out_event(...) of the peer.
+static void connection_splice_in(struct epoll_event_handler* self)
+{
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    struct epoll_event_handler* peer;
+    struct connection_closure* peer_closure;
+    ssize_t bytes_read;
+
+    while ((peer = closure->peer) != NULL) {
+        peer_closure = (struct connection_closure*) peer->closure;
+        if (connection_full(peer_closure)) {
+            connection_pause(self);
             return;
         }
 
-        to_write = closure->write_buffer->len - closure->write_buffer->current_offset;
-        written = write(self->fd, closure->write_buffer->data + closure->write_buffer->current_offset, to_write);
-        if (written != to_write) {
-            if (written == -1) {
-                if (errno == ECONNRESET || errno == EPIPE) {
-                    rsp_log_error("On out event write error");
-                    connection_on_close_event(self);
-                    return;
-                }
-                if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    rsp_log_error("Error writing to client");
-                    exit(-1);
-                }
-                written = 0;
+        bytes_read = splice(self->fd, NULL, peer_closure->splice_pipe[1], NULL,
+                            CONNECTION_SPLICE_PIPE - peer_closure->splice_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            //Either nothing to read or the pipe is full, as it holds fewer bytes if they are spread over many pages.
+            //Pause until the peer has drained its pipe, which is harmless in the first case.
+            if (peer_closure->splice_pending > 0) {
+                connection_pause(self);
             }
-            closure->write_buffer->current_offset += written;
-            break;
-        } else {
-            temp = closure->write_buffer;
-            closure->write_buffer = closure->write_buffer->next;
-            epoll_add_to_free_list(temp->data);
-            epoll_add_to_free_list(temp);
+            return;
+        }
+        if (bytes_read == 0 || bytes_read == -1) {
+            connection_on_close_event(self);
+            return;
+        }
+
+        peer_closure->splice_pending += bytes_read;
+        if (closure->on_read != NULL) {
+            closure->on_read(closure->on_read_closure, NULL, bytes_read);
+        }
+
+        if (!peer_closure->connecting) {
+            connection_on_out_event(peer);
+            if (self->fd < 0) return; //closed by the peer
         }
     }
 }
@@ -153,7 +369,19 @@ void connection_on_in_event(struct epoll_event_handler* self)
     char read_buffer[BUFFER_SIZE];
     int bytes_read;
 
-    while ((bytes_read = read(self->fd, read_buffer, BUFFER_SIZE)) != -1 && bytes_read != 0) {
+    if (closure->peer != NULL && ((struct connection_closure*) closure->peer->closure)->splice_pipe[0] != -1) { //MADCAT
+        connection_splice_in(self);
+        return;
+    }
+
+    while (1) {
+        //MADCAT: backpressure, the peer's buffer is bounded, a fast sender is throttled by TCP flow control
+        if (closure->peer != NULL && connection_full((struct connection_closure*) closure->peer->closure)) {
+            connection_pause(self);
+            return;
+        }
+
+        bytes_read = read(self->fd, read_buffer, BUFFER_SIZE);
         if (bytes_read == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             return;
         }
@@ -165,6 +393,7 @@ void connection_on_in_event(struct epoll_event_handler* self)
 
         if (closure->on_read != NULL) {
             closure->on_read(closure->on_read_closure, read_buffer, bytes_read);
+            if (self->fd < 0) return; //MADCAT: closed while writing to the peer
         }
     }
 }
@@ -172,14 +401,32 @@ void connection_on_in_event(struct epoll_event_handler* self)
 
 void connection_handle_event(struct epoll_event_handler* self, uint32_t events)
 {
+    struct connection_closure* closure = (struct connection_closure*) self->closure;
+    if (closure->connecting) { //MADCAT
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            return;
+        }
+        connection_on_connect_event(self, events);
+        if (self->fd < 0) return; //connect failed
+        events |= EPOLLOUT; //write data buffered while connecting
+    }
+
     if (events & EPOLLOUT) {
         connection_on_out_event(self);
     }
 
+    if (self->fd < 0) return; //closed while writing
+
+    if (closure->paused) { //MADCAT: data and EOF are read after resuming
+        events &= ~(EPOLLIN | EPOLLRDHUP);
+    }
+
     if (events & EPOLLIN) {
         connection_on_in_event(self);
     }
 
+    if (self->fd < 0) return; //closed while reading
+
     if ((events & EPOLLERR) | (events & EPOLLHUP) | (events & EPOLLRDHUP)) {
         connection_on_close_event(self);
     }
@@ -187,15 +434,28 @@ void connection_handle_event(struct epoll_event_handler* self, uint32_t events)
 }
 
 
-void add_write_buffer_entry(struct connection_closure* closure, struct data_buffer_entry* new_entry)
+//MADCAT: append data to the slabs, filling the last one first
+static void connection_buffer(struct connection_closure* closure, char* data, int len)
 {
-    struct data_buffer_entry* last_buffer_entry;
-    if (closure->write_buffer == NULL) {
-        closure->write_buffer = new_entry;
-    } else {
-        for (last_buffer_entry=closure->write_buffer; last_buffer_entry->next != NULL; last_buffer_entry=last_buffer_entry->next)
-            ;
-        last_buffer_entry->next = new_entry;
+    struct write_slab_t* slab;
+    int n;
+    while (len > 0) {
+        slab = closure->write_tail;
+        if (slab == NULL || slab->end == CONNECTION_SLAB_SIZE) {
+            slab = write_slab_get();
+            if (closure->write_tail == NULL) {
+                closure->write_head = slab;
+            } else {
+                closure->write_tail->next = slab;
+            }
+            closure->write_tail = slab;
+        }
+        n = CONNECTION_SLAB_SIZE - slab->end < len ? CONNECTION_SLAB_SIZE - slab->end : len;
+        memcpy(slab->data + slab->end, data, n);
+        slab->end += n;
+        data += n;
+        len -= n;
+        closure->write_pending += n;
     }
 }
 
@@ -205,7 +465,7 @@ void connection_write(struct epoll_event_handler* self, char* data, int len)
     struct connection_closure* closure = (struct connection_closure* ) self->closure;
 
     int written = 0;
-    if (closure->write_buffer == NULL) {
+    if (closure->write_head == NULL && !closure->connecting) {
         written = write(self->fd, data, len);
         if (written == len) {
             return;
@@ -224,16 +484,7 @@ void connection_write(struct epoll_event_handler* self, char* data, int len)
         written = 0;
     }
 
-    int unwritten = len - written;
-    struct data_buffer_entry* new_entry = malloc(sizeof(struct data_buffer_entry));
-    new_entry->is_close_message = 0;
-    new_entry->data = malloc(unwritten);
-    memcpy(new_entry->data, data + written, unwritten);
-    new_entry->current_offset = 0;
-    new_entry->len = unwritten;
-    new_entry->next = NULL;
-
-    add_write_buffer_entry(closure, new_entry);
+    connection_buffer(closure, data + written, len - written);
 }
 
 
@@ -242,15 +493,39 @@ void connection_close(struct epoll_event_handler* self)
     struct connection_closure* closure = (struct connection_closure* ) self->closure;
     closure->on_read = NULL;
     closure->on_close = NULL;
-    if (closure->write_buffer == NULL) {
+    closure->on_connect = NULL; //MADCAT: a pending connect still completes, if data has been buffered, which is written before closing
+    if (closure->write_head == NULL && closure->splice_pending == 0) { //MADCAT: spliced data is written before closing, too
         connection_really_close(self);
     } else {
-        struct data_buffer_entry* new_entry = malloc(sizeof(struct data_buffer_entry));
-        new_entry->is_close_message = 1;
-        new_entry->next = NULL;
+        closure->close_pending = true; //MADCAT: replaces the close message in the write buffer
+    }
+}
+
 
-        add_write_buffer_entry(closure, new_entry);
+//MADCAT
+int connection_pair(struct epoll_event_handler* a, struct epoll_event_handler* b)
+{
+    struct connection_closure* a_closure = (struct connection_closure*) a->closure;
+    struct connection_closure* b_closure = (struct connection_closure*) b->closure;
+    a_closure->peer = b;
+    b_closure->peer = a;
+    if (!connection_splice) {
+        return 0;
+    }
+
+    if (pipe2(a_closure->splice_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        a_closure->splice_pipe[0] = -1;
+        return -1;
+    }
+    if (pipe2(b_closure->splice_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        close(a_closure->splice_pipe[0]);
+        close(a_closure->splice_pipe[1]);
+        a_closure->splice_pipe[0] = -1;
+        a_closure->splice_pipe[1] = -1;
+        b_closure->splice_pipe[0] = -1;
+        return -1;
     }
+    return 0;
 }
 
 
@@ -259,7 +534,18 @@ struct epoll_event_handler* create_connection(int client_socket_fd)
     make_socket_non_blocking(client_socket_fd);
 
     struct connection_closure* closure = malloc(sizeof(struct connection_closure));
-    closure->write_buffer = NULL;
+    closure->write_head = NULL; //MADCAT
+    closure->write_tail = NULL;
+    closure->write_pending = 0;
+    closure->close_pending = false;
+    closure->connecting = false;
+    closure->on_connect = NULL;
+    closure->on_connect_closure = NULL;
+    closure->peer = NULL;
+    closure->paused = false;
+    closure->splice_pipe[0] = -1;
+    closure->splice_pipe[1] = -1;
+    closure->splice_pending = 0;
 
     struct epoll_event_handler* result = malloc(sizeof(struct epoll_event_handler));
     rsp_log("Created connection epoll handler %p", result);
@@ -62,6 +62,10 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 struct free_list_entry* free_list;
 struct epoll_event_handler* epoll_server_hdl; //global epoll event handler epoll server socket
 int epoll_fd;
+int epoll_max_events = EPOLL_EVENTS_DEFAULT; //Maximum number of events fetched by one call to epoll_wait(...)
+struct epoll_stats_t epoll_stats; //Statistics of the reactor loop
+struct timer_wheel_t epoll_timers; //Timers of the reactor loop
+static struct free_list_entry* free_list_spare = NULL; //Entries of the free list for reuse, saves a malloc(...) per freed block
 
 
 void epoll_init()
@@ -71,6 +75,28 @@ void epoll_init()
         rsp_log_error("Couldn't create epoll FD");
         exit(1);
     }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    timer_init(&epoll_timers, &now, EPOLL_TIMER_TICK);
+}
+
+
+void epoll_timer_add(struct epoll_timer_t* t, long int timeout)
+{
+    timer_add(&epoll_timers, &t->timer, timeout);
+}
+
+
+void epoll_timer_del(struct epoll_timer_t* t)
+{
+    timer_del(&epoll_timers, &t->timer);
+}
+
+
+static void epoll_timer_expire(struct timer_entry_t* timer, void* user)
+{
+    struct epoll_timer_t* t = (struct epoll_timer_t*) timer; //timer is the first member
+    t->expire(t);
 }
 
 
@@ -91,36 +117,98 @@ void epoll_add_handler(struct epoll_event_handler* handler, uint32_t event_mask)
 void epoll_remove_handler(struct epoll_event_handler* handler)
 {
     epoll_ctl(epoll_fd, EPOLL_CTL_DEL, handler->fd, NULL);
+    handler->fd = -1; //mark as removed, further events of the current batch are skipped
+}
+
+
+void epoll_modify_handler(struct epoll_event_handler* handler, uint32_t event_mask)
+{
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(struct epoll_event));
+    event.data.ptr = handler;
+    event.events = event_mask;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, handler->fd, &event) == -1) {
+        rsp_log_error("Couldn't modify handler with epoll");
+        exit(-1);
+    }
 }
 
 
 void epoll_add_to_free_list(void* block)
 {
-    struct free_list_entry* entry = malloc(sizeof(struct free_list_entry));
+    struct free_list_entry* entry = free_list_spare;
+    if (entry != NULL) {
+        free_list_spare = entry->next;
+    } else {
+        entry = malloc(sizeof(struct free_list_entry));
+    }
     entry->block = block;
     entry->next = free_list;
     free_list = entry;
 }
 
 
+void epoll_log_stats()
+{
+    rsp_log("Reactor: %ld events in %ld calls of epoll_wait, %.1f on average, max. %d, %ld full batches of %d",
+            epoll_stats.events, epoll_stats.iterations,
+            epoll_stats.iterations > 0 ? (double) epoll_stats.events / epoll_stats.iterations : 0.0,
+            epoll_stats.max, epoll_stats.full, epoll_max_events);
+}
+
+
 void epoll_do_reactor_loop()
 {
-    struct epoll_event current_epoll_event;
+    if (epoll_max_events < 1) epoll_max_events = 1;
+    if (epoll_max_events > EPOLL_EVENTS_MAX) epoll_max_events = EPOLL_EVENTS_MAX;
+    struct epoll_event* events = malloc(epoll_max_events * sizeof(struct epoll_event));
+    if (events == NULL) {
+        rsp_log_error("Couldn't allocate epoll events");
+        exit(1);
+    }
+    struct timespec now, last_stats;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    last_stats = now;
+    long int last_events = 0;
 
     while (1) {
         struct epoll_event_handler* handler;
 
-        epoll_wait(epoll_fd, &current_epoll_event, 1, -1);
-        handler = (struct epoll_event_handler*) current_epoll_event.data.ptr;
-        handler->handle(handler, current_epoll_event.events);
+        int n = epoll_wait(epoll_fd, events, epoll_max_events, timer_next(&epoll_timers, &now));
+        if (n < 0) n = 0; //EINTR
+
+        for (int i = 0; i < n; i++) {
+            handler = (struct epoll_event_handler*) events[i].data.ptr;
+            if (handler->fd < 0) continue; //removed by a previous event of this batch, e.g. the other side of a proxied connection
+            handler->handle(handler, events[i].events);
+        }
+
+        //Expire timers, e.g. backend connect timeouts, before the blocks of closed handlers are freed
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        timer_expire(&epoll_timers, &now, epoll_timer_expire, NULL);
 
+        //Free blocks of all handlers closed in this batch
         struct free_list_entry* temp;
         while (free_list != NULL) {
             free(free_list->block);
             temp = free_list->next;
-            free(free_list);
+            free_list->next = free_list_spare;
+            free_list_spare = free_list;
             free_list = temp;
         }
+
+        if (n == 0) continue; //timeout
+        epoll_stats.iterations++;
+        epoll_stats.events += n;
+        epoll_stats.last = n;
+        if (n > epoll_stats.max) epoll_stats.max = n;
+        if (n == epoll_max_events) epoll_stats.full++;
+        if (now.tv_sec - last_stats.tv_sec >= EPOLL_STATS_INTERVAL && epoll_stats.events != last_events) {
+            epoll_log_stats();
+            last_stats = now;
+            last_events = epoll_stats.events;
+        }
     }
 
 }
@@ -76,6 +76,17 @@ void rsp_log_error(char* message)
     rsp_log("%s (%s)", message, error);
 }
 
+//Emitters for tcp_output_event(...)
+static size_t json_emit_object(struct dict_buffer* buf, const void* event)
+{
+    return emit_proxy_flow_object(buf, (const struct proxy_flow_event_t*) event);
+}
+
+static size_t json_emit_event(struct dict_buffer* buf, const void* event)
+{
+    return emit_proxy_flow_event(buf, (const struct proxy_flow_event_t*) event);
+}
+
 void json_out(struct json_data_t* jd, uintptr_t id)
 {
     char end_time[64] = ""; //Human readable start time (actual time zone)
@@ -91,71 +102,30 @@ void json_out(struct json_data_t* jd, uintptr_t id)
     jd_print_list(jd);
 #endif
 
-    //using libdict_c for composing of the json output
-
-    json_value.string = "MADCAT";
-    dict_update(json_dict(true), JSON_STR, json_value, 1, "origin");
-    json_value.string = jd_get(jd, id)->src_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-    json_value.integer = jd_get(jd, id)->src_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "src_port");
-    json_value.string = jd_get(jd, id)->dest_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-    json_value.integer = atoi(jd_get(jd, id)->dest_port);
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "dest_port");
-    json_value.string = jd_get(jd, id)->timestamp;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-    json_value.floating = jd_get(jd, id)->timeasdouble;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
-    json_value.string = "TCP";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "proto");
-    json_value.string = "proxy_flow";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "event_type");
-    json_value.string = jd_get(jd, id)->start;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "start");
-    json_value.string = jd_get(jd, id)->end;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "end");
-    json_value.floating = jd_get(jd, id)->duration;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "duration");
-    json_value.floating = jd_get(jd, id)->min_rtt;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "min_rtt");
-    json_value.integer = jd_get(jd, id)->bytes_toserver;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
-    json_value.integer = jd_get(jd, id)->bytes_toclient;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toclient");
-    json_value.string = "closed";
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "state");
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "reason");
-    
-
-    json_value.string = jd_get(jd, id)->proxy_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "proxy_ip");
-    json_value.integer = jd_get(jd, id)->proxy_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "proxy_port");
-    json_value.string = jd_get(jd, id)->backend_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "backend_ip");
-    json_value.integer = atoi(jd_get(jd, id)->backend_port);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "backend_port");
-
-#if DEBUG >= 2
-    int consem_val = -127;
-    CHECK(sem_getvalue(consem, &consem_val), != -1); //Ceck
-    fprintf(stderr, "*** DEBUG [PID %d] Acquire lock for output.\n", getpid());
-    rsp_log("Value of connection semaphore: %d.\n", consem_val);
-#endif
-    struct timespec sem_timeout; //time to wait in sem_timedwait() call
-    clock_gettime(CLOCK_REALTIME, &sem_timeout);
-    sem_timeout.tv_sec += 1;
-    char* output = dict_dumpstr(json_dict(false));
-    if(strlen(output) > 2) { //do not print empty JSON-Objects
-        sem_timedwait(consem, &sem_timeout); //Acquire lock for output
-        fprintf(confifo, "%s\n", output); //print json output for further analysis
-        fflush(confifo);
-        sem_post(consem); //release lock
-        fprintf(stdout,"{\"CONNECTION\": %s}\n", output); //print json output for logging
-        fflush(stdout);
-    }
-    free(output);
+    //composing of the json output
+    struct json_data_node_t* jd_node = jd_get(jd, id);
+    struct proxy_flow_event_t event;
+    event.src_ip = jd_node->src_ip;
+    event.src_port = jd_node->src_port;
+    event.dest_ip = jd_node->dest_ip;
+    event.dest_port = atoi(jd_node->dest_port);
+    event.timestamp = jd_node->timestamp;
+    event.unixtime = jd_node->timeasdouble;
+    event.start = jd_node->start;
+    event.end = jd_node->end;
+    event.duration = jd_node->duration;
+    event.min_rtt = jd_node->min_rtt;
+    event.bytes_toserver = jd_node->bytes_toserver;
+    event.bytes_toclient = jd_node->bytes_toclient;
+    event.proxy_ip = jd_node->proxy_ip;
+    event.proxy_port = jd_node->proxy_port;
+    event.backend_ip = jd_node->backend_ip;
+    event.backend_port = atoi(jd_node->backend_port);
+
+    struct tcp_corr_record_t rec; //the correlator needs only the FLOW object
+    if(tcp_correlation)
+        tcp_corr_record(&rec, TCP_CORR_FLOW, event.src_ip, event.src_port, event.dest_ip, event.dest_port, event.timestamp, event.unixtime, "TCP", "proxy_flow");
+    tcp_output_event(event_ring, TCP_CORR_FLOW, &rec, json_emit_object, json_emit_event, &event);
     //Remove and thereby free list element with id "id"
     jd_del(jd, id);
     return;
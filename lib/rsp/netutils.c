@@ -81,8 +81,11 @@ void make_socket_non_blocking(int socket_fd)
 }
 
 
-int connect_to_backend(char* backend_host,
-                       char* backend_port_str)
+//MADCAT: resolution and blocking connect split, thus the reactor loop neither waits for DNS nor for the backend
+int resolve_backend(char* backend_host,
+                    char* backend_port_str,
+                    struct sockaddr_storage* backend_addr,
+                    socklen_t* backend_addr_len)
 {
     struct addrinfo hints;
     memset(&hints, 0, sizeof(struct addrinfo));
@@ -96,40 +99,40 @@ int connect_to_backend(char* backend_host,
         if (getaddrinfo_error == EAI_SYSTEM) {
             rsp_log_error("Couldn't find backend (EAI_SYSTEM)");
         } else {
-            rsp_log("Couldn't find backend: %s (%d)", gai_strerror(getaddrinfo_error), getaddrinfo_error);
+            rsp_log("Couldn't find backend %s: %s (%d)", backend_host, gai_strerror(getaddrinfo_error), getaddrinfo_error);
         }
-        exit(1);
+        return -1;
     }
 
-    int backend_socket_fd;
-    struct addrinfo* addrs_iter;
-    for (addrs_iter = addrs;
-            addrs_iter != NULL;
-            addrs_iter = addrs_iter->ai_next) {
-        backend_socket_fd = socket(addrs_iter->ai_family,
-                                   addrs_iter->ai_socktype,
-                                   addrs_iter->ai_protocol);
-        if (backend_socket_fd == -1) {
-            continue;
-        }
+    //first address returned, like the first one connect(...) succeeded on before
+    memcpy(backend_addr, addrs->ai_addr, addrs->ai_addrlen);
+    *backend_addr_len = addrs->ai_addrlen;
+    freeaddrinfo(addrs);
 
-        if (connect(backend_socket_fd,
-                    addrs_iter->ai_addr,
-                    addrs_iter->ai_addrlen) != -1) {
-            break;
-        }
+    return 0;
+}
 
 
-        close(backend_socket_fd);
+int connect_to_backend(const struct sockaddr_storage* backend_addr,
+                       socklen_t backend_addr_len,
+                       bool* connecting)
+{
+    int backend_socket_fd = socket(backend_addr->ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (backend_socket_fd == -1) {
+        rsp_log_error("Couldn't create backend socket");
+        return -1;
     }
 
-    if (addrs_iter == NULL) {
-        rsp_log("Couldn't connect to backend");
-        exit(1);
+    *connecting = false;
+    if (connect(backend_socket_fd, (const struct sockaddr*) backend_addr, backend_addr_len) == -1) {
+        if (errno != EINPROGRESS) {
+            rsp_log_error("Couldn't connect to backend");
+            close(backend_socket_fd);
+            return -1;
+        }
+        *connecting = true; //completed, when the socket becomes writeable
     }
 
-    freeaddrinfo(addrs);
-
     return backend_socket_fd;
 }
 
@@ -74,17 +74,57 @@ int rsp(struct proxy_conf_tcp_node_t *pcn, char* server_addr)
 
     epoll_init();
 
-    epoll_server_hdl = create_server_socket_handler(proxy_sock.server_addr,
-                       proxy_sock.server_port_str,
-                       proxy_sock.backend_addr,
-                       proxy_sock.backend_port_str);
+    epoll_server_hdl = create_server_socket_handler(proxy_sock.server_addr, pcn);
+    rsp_drop_privs();
 
+    epoll_do_reactor_loop();
+
+    return 0;
+}
+
+int rsp_multi(struct proxy_conf_tcp_t* pc, char* server_addr)
+{
+    proxy_sock.server_addr = server_addr;
+    //no single backend, see configuration of each port in pc->portconf[...]
+    proxy_sock.server_port_str = EMPTY_STR;
+    proxy_sock.backend_addr = EMPTY_STR;
+    proxy_sock.backend_port_str = EMPTY_STR;
+
+    //Initialze JSON data struct for logging
+    jd = jd_init();
+
+    signal(SIGPIPE, SIG_IGN);
+
+    free_list = NULL;
+
+    epoll_init();
+
+    //one listening socket per port in a shared epoll set
+    int ports = 0;
+    for (struct proxy_conf_tcp_node_t* pcn = pc->portlist; pcn != NULL; pcn = pcn->next) {
+        rsp_log("Starting. Local: %s:%s -> Remote: %s:%s", server_addr, pcn->listenport_str, pcn->backendaddr, pcn->backendport_str);
+        epoll_server_hdl = create_server_socket_handler(server_addr, pcn);
+        ports++;
+    }
+    rsp_log("Serving %d ports in one process.", ports);
+    rsp_drop_privs();
 
     epoll_do_reactor_loop();
 
     return 0;
 }
 
+void rsp_drop_privs()
+{
+    char log_time[64] = ""; //Human readable log time (actual time zone)
+    time_str(NULL, 0, log_time, sizeof(log_time)); //Get Human readable string only
+
+    //Drop Priviliges
+    fprintf(stderr, "%s [PID %d] ", log_time, getpid());
+    drop_root_privs(user, "Proxy", false);
+    return;
+}
+
 /* Original main
 int main(int argc, char* argv[])
 {
@@ -54,13 +54,33 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 #include <sys/epoll.h>
 
 #define MAX_LISTEN_BACKLOG 4096
+#define BACKEND_CONNECT_TIMEOUT 5000 //MADCAT: Timeout in ms for connecting to the backend, the client is closed afterwards
+#define BACKEND_RESOLVE_INTERVAL 300 //MADCAT: Interval in seconds for resolving the backend address again
+#define BACKEND_RESOLVE_RETRY 5 //MADCAT: Interval in seconds for retrying, if the backend could not be resolved
 
 
 struct server_socket_event_data {
-    char* backend_addr;
-    char* backend_port_str;
+    struct epoll_timer_t resolve_timer; //MADCAT: resolves the backend address periodically, has to be the first member
+    struct proxy_conf_tcp_node_t* pcn; //MADCAT: configuration of this listen port, incl. backend
+    struct epoll_event_handler* next; //MADCAT: next server socket handler of this process, see free_server_socket_handlers()
+    struct sockaddr_storage backend_addr; //MADCAT: resolved address of the backend
+    socklen_t backend_addr_len; //MADCAT: 0, as long as the backend has not been resolved
+    char* server_addr; //MADCAT: local proxy-server address, logged if the address of a connection can not be determined
 };
 
+struct server_socket_resolve_t { //MADCAT: request for and result of a resolver thread
+    struct server_socket_event_data* server; //server socket, whose backend is resolved
+    char* host; //copies of the backend address and port, the configuration may be freed by the signal handler
+    char* port;
+    int result; //result of resolve_backend(...)
+    struct sockaddr_storage backend_addr;
+    socklen_t backend_addr_len;
+};
+
+static struct epoll_event_handler* server_socket_handlers = NULL; //MADCAT: all server socket handlers of this process
+static struct epoll_event_handler resolve_handler = { -1, NULL, NULL }; //MADCAT: reading end of the pipe from the resolver threads
+static int resolve_pipe = -1; //MADCAT: writing end of the pipe from the resolver threads
+
 /*//MADCAT: modified and moved to rsp.h
 struct proxy_data {
     struct epoll_event_handler* client;
@@ -75,7 +95,9 @@ void on_client_read(void* closure, char* buffer, int len)
     if (data->backend == NULL) {
         return;
     }
-    connection_write(data->backend, buffer, len);
+    if (buffer != NULL) { //MADCAT: NULL, if the data has already been spliced to the backend
+        connection_write(data->backend, buffer, len);
+    }
     //MADCAT
     //log, using data->client as id, which also contains the struct epoll_event_handler*
     long double unix_timeasdouble = time_str(NULL, 0, NULL, 0);
@@ -101,6 +123,7 @@ void on_client_close(void* closure)
 
     json_out(jd, (uintptr_t ) data->client); //MADCAT
 
+    epoll_timer_del(&data->connect_timer); //MADCAT
     connection_close(data->backend);
     data->client = NULL;
     data->backend = NULL;
@@ -114,7 +137,9 @@ void on_backend_read(void* closure, char* buffer, int len)
     if (data->client == NULL) {
         return;
     }
-    connection_write(data->client, buffer, len);
+    if (buffer != NULL) { //MADCAT: NULL, if the data has already been spliced to the client
+        connection_write(data->client, buffer, len);
+    }
 
     //MADCAT
     //log, using data->client as id, which also contains the struct epoll_event_handler*
@@ -133,6 +158,7 @@ void on_backend_close(void* closure)
     //MADCAT
     json_out(jd, (uintptr_t ) data->client); //MADCAT
 
+    epoll_timer_del(&data->connect_timer); //MADCAT
     connection_close(data->client);
     data->client = NULL;
     data->backend = NULL;
@@ -140,25 +166,49 @@ void on_backend_close(void* closure)
 }
 
 
+//MADCAT
+void on_backend_connect(void* closure, int error)
+{
+    struct proxy_data* data = (struct proxy_data*) closure;
+    epoll_timer_del(&data->connect_timer);
+    if (error != 0) {
+        rsp_log("Couldn't connect to backend (%s)", strerror(error)); //connection_abort(...) closes both sides
+    }
+}
+
+
+//MADCAT
+void on_backend_connect_timeout(struct epoll_timer_t* timer)
+{
+    struct proxy_data* data = (struct proxy_data*) timer; //connect_timer is the first member
+    if (data->backend == NULL) {
+        return;
+    }
+    rsp_log("Couldn't connect to backend (timeout after %d ms)", BACKEND_CONNECT_TIMEOUT);
+    connection_abort(data->backend); //on_backend_close(...) logs the connection and closes the client
+}
+
+
 struct proxy_data*  handle_client_connection(int client_socket_fd,
-        char* backend_host,
-        char* backend_port_str)
+        struct server_socket_event_data* server,
+        struct sockaddr_in* claddr)
 {
     struct epoll_event_handler* client_connection;
     rsp_log("Creating connection object for incoming connection...");
     client_connection = create_connection(client_socket_fd);
 
-    int backend_socket_fd = connect_to_backend(backend_host, backend_port_str);
-    struct epoll_event_handler* backend_connection;
-    rsp_log("Creating connection object for backend connection...");
-    backend_connection = create_connection(backend_socket_fd);
-
-    struct proxy_data* proxy = malloc(sizeof(struct proxy_data));
+    struct proxy_data* proxy = calloc(1, sizeof(struct proxy_data)); //MADCAT: connect_timer not pending
     proxy->client = client_connection;
-    proxy->backend = backend_connection;
+    proxy->backend = NULL;
+    proxy->connect_timer.expire = on_backend_connect_timeout;
 
 
     //MADCAT start
+    //Log first part of connection in json data list, using struct epoll_event_handler* client as id.
+    char start_time[64] = ""; //Human readable start time (actual time zone)
+    char start_time_unix[64] = ""; //Unix timestamp (UTC)
+    long double unix_timeasdouble = time_str(start_time_unix, sizeof(start_time_unix), start_time, sizeof(start_time));
+
     if ( !jd_get(jd, (uintptr_t ) proxy->client)) jd_push(jd, (uintptr_t ) proxy->client);
     struct json_data_node_t* jd_node = jd_get(jd, (uintptr_t ) proxy->client);
 
@@ -168,8 +218,41 @@ struct proxy_data*  handle_client_connection(int client_socket_fd,
     //proxy->bytes_toclient = 0; //MADCAT
     //proxy->bytes_toserver = 0; //MADCAT
 
+    jd_node->src_ip = strncpy(malloc(strlen(inet_ntoa(claddr->sin_addr)) +1 ), inet_ntoa(claddr->sin_addr), strlen(inet_ntoa(claddr->sin_addr)) +1 );
+    jd_node->dest_port = strncpy(malloc(strlen(server->pcn->listenport_str) +1 ), server->pcn->listenport_str, strlen(server->pcn->listenport_str) +1 );
+    jd_node->timestamp = strncpy(malloc(strlen(start_time) +1 ), start_time, strlen(start_time) +1 );
+    jd_node->start = strncpy(malloc(strlen(start_time) +1 ), start_time, strlen(start_time) +1 );
+    //Address the client has connected to, the global proxy_sock holds only the one of the last proxy started
+    char dest_ip[INET6_ADDRSTRLEN] = "";
+    struct sockaddr_in dest_addr;
+    socklen_t dest_addr_len = sizeof(dest_addr);
+    if (getsockname(client_socket_fd, (struct sockaddr*) &dest_addr, &dest_addr_len) != 0 || inet_ntop(AF_INET, &dest_addr.sin_addr, dest_ip, sizeof(dest_ip)) == NULL) {
+        snprintf(dest_ip, sizeof(dest_ip), "%s", server->server_addr);
+    }
+    jd_node->dest_ip = strncpy(malloc(strlen(dest_ip) +1 ), dest_ip, strlen(dest_ip) +1 );
+    jd_node->src_port = ntohs(claddr->sin_port);
+    jd_node->unixtime = strncpy(malloc(strlen(start_time_unix) +1 ), start_time_unix, strlen(start_time_unix) +1 );
+    jd_node->timeasdouble = unix_timeasdouble;
+    jd_node->last_recv = unix_timeasdouble;
+    jd_node->backend_ip = strncpy(malloc(strlen(server->pcn->backendaddr) +1 ), server->pcn->backendaddr, strlen(server->pcn->backendaddr) +1 );
+    jd_node->backend_port = strncpy(malloc(strlen(server->pcn->backendport_str) +1 ), server->pcn->backendport_str, strlen(server->pcn->backendport_str) +1 );
+
+    //Non-blocking connect to the backend, data of the client is buffered until it has completed
+    bool connecting = false;
+    int backend_socket_fd = -1;
+    if (server->backend_addr_len == 0) {
+        rsp_log("Backend %s:%s has not been resolved", server->pcn->backendaddr, server->pcn->backendport_str);
+    } else {
+        backend_socket_fd = connect_to_backend(&server->backend_addr, server->backend_addr_len, &connecting);
+    }
+    if (backend_socket_fd == -1) { //log the connection and close the client, instead of exiting
+        json_out(jd, (uintptr_t ) proxy->client);
+        connection_close(client_connection);
+        free(proxy);
+        return NULL;
+    }
 
-    //Get local client address and port
+    //Get local client address and port, assigned by connect(...)
     struct sockaddr local_address;
     socklen_t addr_size = sizeof(local_address);
     getsockname(backend_socket_fd, &local_address, &addr_size);
@@ -181,11 +264,14 @@ struct proxy_data*  handle_client_connection(int client_socket_fd,
 
     jd_node->proxy_ip = inttoa(*(uint32_t*)ip_ptr);
     jd_node->proxy_port = proxy_sock.client_port;
-    jd_node->backend_ip = strncpy(malloc(strlen(proxy_sock.backend_addr) +1 ), proxy_sock.backend_addr, strlen(proxy_sock.backend_addr) +1 );
-    jd_node->backend_port = strncpy(malloc(strlen(proxy_sock.backend_port_str) +1 ), proxy_sock.backend_port_str, strlen(proxy_sock.backend_port_str) +1 );
 
     //MADCAT end
 
+    struct epoll_event_handler* backend_connection;
+    rsp_log("Creating connection object for backend connection...");
+    backend_connection = create_connection(backend_socket_fd);
+    proxy->backend = backend_connection;
+
     struct connection_closure* client_closure = (struct connection_closure*) client_connection->closure;
     client_closure->on_read = on_client_read;
     client_closure->on_read_closure = proxy;
@@ -197,6 +283,13 @@ struct proxy_data*  handle_client_connection(int client_socket_fd,
     backend_closure->on_read_closure = proxy;
     backend_closure->on_close = on_backend_close;
     backend_closure->on_close_closure = proxy;
+    backend_closure->connecting = connecting; //MADCAT
+    backend_closure->on_connect = on_backend_connect;
+    backend_closure->on_connect_closure = proxy;
+    if (connection_pair(client_connection, backend_connection) == -1) { //MADCAT: backpressure and optional splicing
+        rsp_log_error("Could not create pipes, copying data instead of splicing");
+    }
+    if (connecting) epoll_timer_add(&proxy->connect_timer, BACKEND_CONNECT_TIMEOUT);
 
     return proxy; //MADCAT
 }
@@ -210,12 +303,6 @@ void handle_server_socket_event(struct epoll_event_handler* self, uint32_t event
     //MADCAT start
     struct sockaddr_in claddr; //Clientaddress
     socklen_t claddr_len = sizeof(claddr);
-
-    char start_time[64] = ""; //Human readable start time (actual time zone)
-    char start_time_unix[64] = ""; //Unix timestamp (UTC)
-    long double unix_timeasdouble = time_str(start_time_unix, sizeof(start_time_unix), start_time, sizeof(start_time));
-
-    struct proxy_data* proxy;
     //MADCAT end
 
     int client_socket_fd;
@@ -225,6 +312,9 @@ void handle_server_socket_event(struct epoll_event_handler* self, uint32_t event
         if (client_socket_fd == -1) {
             if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
                 break;
+            } else if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                rsp_log_error("Could not accept"); //MADCAT: transient, try again with the next event
+                break;
             } else {
                 rsp_log_error("Could not accept");
                 exit(1);
@@ -232,29 +322,99 @@ void handle_server_socket_event(struct epoll_event_handler* self, uint32_t event
         }
 
         //MADCAT
-        proxy = handle_client_connection(client_socket_fd,
-                                         closure->backend_addr,
-                                         closure->backend_port_str);
+        handle_client_connection(client_socket_fd, closure, &claddr);
+        claddr_len = sizeof(claddr);
     }
 
-    //MADCAT start
-    //Log first part of connection in json data list, using struct epoll_event_handler* client as id.
-    if ( !jd_get(jd, (uintptr_t ) proxy->client)) jd_push(jd, (uintptr_t ) proxy->client);
-    struct json_data_node_t* jd_node = jd_get(jd, (uintptr_t ) proxy->client);
+    return;
+}
 
-    jd_node->src_ip = strncpy(malloc(strlen(inet_ntoa(claddr.sin_addr)) +1 ), inet_ntoa(claddr.sin_addr), strlen(inet_ntoa(claddr.sin_addr)) +1 );
-    jd_node->dest_port = strncpy(malloc(strlen(proxy_sock.server_port_str) +1 ), proxy_sock.server_port_str, strlen(proxy_sock.server_port_str) +1 );
-    jd_node->timestamp = strncpy(malloc(strlen(start_time) +1 ), start_time, strlen(start_time) +1 );
-    jd_node->start = strncpy(malloc(strlen(start_time) +1 ), start_time, strlen(start_time) +1 );
-    jd_node->dest_ip = strncpy(malloc(strlen(proxy_sock.server_addr) +1 ), proxy_sock.server_addr, strlen(proxy_sock.server_addr) +1 );
-    jd_node->src_port = ntohs(claddr.sin_port);
-    jd_node->unixtime = strncpy(malloc(strlen(start_time_unix) +1 ), start_time_unix, strlen(start_time_unix) +1 );
-    jd_node->timeasdouble = unix_timeasdouble;
-    jd_node->last_recv = unix_timeasdouble;
 
-    //MADCAT end
+//MADCAT
+//Stores the result of resolving the backend and schedules the next resolution
+void server_socket_resolved(struct server_socket_event_data* closure, int result,
+        const struct sockaddr_storage* backend_addr, socklen_t backend_addr_len)
+{
+    if (result == 0) {
+        closure->backend_addr = *backend_addr;
+        closure->backend_addr_len = backend_addr_len;
+        epoll_timer_add(&closure->resolve_timer, BACKEND_RESOLVE_INTERVAL * 1000);
+    } else { //keep the last address, if any
+        epoll_timer_add(&closure->resolve_timer, BACKEND_RESOLVE_RETRY * 1000);
+    }
+}
 
-    return;
+
+//MADCAT
+//Resolver thread, getaddrinfo(...) may block for seconds, e.g. if a DNS server does not answer
+void* server_socket_resolve_thread(void* arg)
+{
+    struct server_socket_resolve_t* req = (struct server_socket_resolve_t*) arg;
+    req->result = resolve_backend(req->host, req->port, &req->backend_addr, &req->backend_addr_len);
+    //hand the request back to the reactor, a pointer is written atomically to the pipe
+    if (write(resolve_pipe, &req, sizeof(req)) != sizeof(req)) {
+        rsp_log_error("Couldn't hand over resolved backend");
+    }
+    return NULL;
+}
+
+
+//MADCAT
+//Reads the results of the resolver threads in the reactor
+void handle_resolve_event(struct epoll_event_handler* self, uint32_t events)
+{
+    struct server_socket_resolve_t* req;
+    while (read(self->fd, &req, sizeof(req)) == sizeof(req)) {
+        server_socket_resolved(req->server, req->result, &req->backend_addr, req->backend_addr_len);
+        free(req->host);
+        free(req->port);
+        free(req);
+    }
+}
+
+
+//MADCAT
+//Resolves the backend again in a resolver thread, thus the reactor does not block
+void server_socket_resolve(struct epoll_timer_t* timer)
+{
+    struct server_socket_event_data* closure = (struct server_socket_event_data*) timer; //resolve_timer is the first member
+    if (resolve_handler.fd == -1) { //first resolution of this process
+        int fds[2];
+        if (pipe(fds) != 0) {
+            rsp_log_error("Couldn't create pipe for resolver threads");
+            epoll_timer_add(timer, BACKEND_RESOLVE_RETRY * 1000);
+            return;
+        }
+        make_socket_non_blocking(fds[0]);
+        resolve_pipe = fds[1];
+        resolve_handler.fd = fds[0];
+        resolve_handler.handle = handle_resolve_event;
+        epoll_add_handler(&resolve_handler, EPOLLIN);
+    }
+
+    struct server_socket_resolve_t* req = calloc(1, sizeof(struct server_socket_resolve_t));
+    req->server = closure;
+    req->host = strdup(closure->pcn->backendaddr);
+    req->port = strdup(closure->pcn->backendport_str);
+
+    //Signals are handled by the reactor thread only
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int error = pthread_create(&thread, &attr, server_socket_resolve_thread, req);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (error != 0) {
+        rsp_log("Couldn't start resolver thread (%s)", strerror(error));
+        free(req->host);
+        free(req->port);
+        free(req);
+        epoll_timer_add(timer, BACKEND_RESOLVE_RETRY * 1000);
+    }
 }
 
 
@@ -283,15 +443,7 @@ int create_and_bind(char* hostaddr, char* server_port_str)
 
     //Bind socket and begin listening
     CHECK(bind(server_socket_fd, (struct sockaddr*)&addr, sizeof(addr)), != -1);
-
-    //MADCAT start
-    char log_time[64] = ""; //Human readable log time (actual time zone)
-    time_str(NULL, 0, log_time, sizeof(log_time)); //Get Human readable string only
-
-    //Drop Priviliges
-    fprintf(stderr, "%s [PID %d] ", log_time, getpid());
-    drop_root_privs(user, "Proxy", false);
-    //MADCAT end */
+    //Priviliges are dropped by the caller, after all sockets have been bound
 
     return server_socket_fd;
 }
@@ -350,25 +502,32 @@ int create_and_bind(char* server_port_str)
 */
 
 struct epoll_event_handler* create_server_socket_handler(char* server_addr,
-        char* server_port_str,
-        char* backend_addr,
-        char* backend_port_str)
+        struct proxy_conf_tcp_node_t* pcn)
 {
 
     int server_socket_fd;
-    server_socket_fd = create_and_bind(server_addr, server_port_str);
+    server_socket_fd = create_and_bind(server_addr, pcn->listenport_str);
     make_socket_non_blocking(server_socket_fd);
 
     listen(server_socket_fd, MAX_LISTEN_BACKLOG);
 
-    struct server_socket_event_data* closure = malloc(sizeof(struct server_socket_event_data));
-    closure->backend_addr = backend_addr;
-    closure->backend_port_str = backend_port_str;
+    struct server_socket_event_data* closure = calloc(1, sizeof(struct server_socket_event_data)); //MADCAT: backend not resolved, timer not pending
+    closure->pcn = pcn;
+    closure->next = server_socket_handlers;
+    closure->server_addr = server_addr;
+    closure->resolve_timer.expire = server_socket_resolve; //resolves again in a resolver thread
+
+    //Resolve once at startup before accepting connections, then periodically without blocking the reactor
+    struct sockaddr_storage backend_addr;
+    socklen_t backend_addr_len = 0;
+    int resolved = resolve_backend(pcn->backendaddr, pcn->backendport_str, &backend_addr, &backend_addr_len);
+    server_socket_resolved(closure, resolved, &backend_addr, backend_addr_len);
 
     struct epoll_event_handler* result = malloc(sizeof(struct epoll_event_handler));
     result->fd = server_socket_fd;
     result->handle = handle_server_socket_event;
     result->closure = closure;
+    server_socket_handlers = result;
 
     epoll_add_handler(result, EPOLLIN | EPOLLET);
 
@@ -376,3 +535,16 @@ struct epoll_event_handler* create_server_socket_handler(char* server_addr,
 }
 
 
+//MADCAT
+void free_server_socket_handlers()
+{
+    struct epoll_event_handler* next;
+    while (server_socket_handlers != NULL) {
+        next = ((struct server_socket_event_data*) server_socket_handlers->closure)->next;
+        free(server_socket_handlers->closure);
+        free(server_socket_handlers);
+        server_socket_handlers = next;
+    }
+}
+
+
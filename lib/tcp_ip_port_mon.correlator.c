@@ -0,0 +1,352 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-IP port monitor.
+ *
+ *
+ * BSI 2018-2023
+*/
+
+#define _GNU_SOURCE //memmem(...), ppoll(...) and F_SETPIPE_SZ
+#include "tcp_ip_port_mon.correlator.h"
+#include <poll.h>
+
+volatile sig_atomic_t tcp_corr_stop = 0;
+
+struct tcp_corr_input_t { //Buffered input from one of the pipes
+    int fd;
+    char* data;
+    size_t len; //bytes in buffer
+    size_t size; //size of buffer
+};
+
+void tcp_corr_record(struct tcp_corr_record_t* rec, int type, const char* src_ip, int src_port, const char* dest_ip, int dest_port,
+                     const char* timestamp, long double unixtime, const char* proto, const char* event_type)
+{
+    memset(rec, 0, sizeof(struct tcp_corr_record_t)); //no uninitialized padding in the pipe
+    rec->type = type;
+    rec->src_port = src_port;
+    rec->dest_port = dest_port;
+    snprintf(rec->src_ip, sizeof(rec->src_ip), "%s", src_ip);
+    snprintf(rec->dest_ip, sizeof(rec->dest_ip), "%s", dest_ip);
+    snprintf(rec->timestamp, sizeof(rec->timestamp), "%s", timestamp);
+    if (proto != 0) snprintf(rec->proto, sizeof(rec->proto), "%s", proto);
+    if (event_type != 0) snprintf(rec->event_type, sizeof(rec->event_type), "%s", event_type);
+    rec->unixtime = unixtime;
+    return;
+}
+
+bool tcp_corr_send(struct event_ring_t* ring, int id, struct tcp_corr_record_t* rec, const struct dict_buffer* data)
+{
+    rec->magic = TCP_CORR_MAGIC;
+    rec->len = data->len;
+    return event_ring_put(ring, id, rec, sizeof(struct tcp_corr_record_t), data->data, data->len);
+}
+
+int tcp_corr_pipe(int fds[2])
+{
+    if (pipe(fds) != 0) return -1;
+    fcntl(fds[1], F_SETPIPE_SZ, TCP_CORR_PIPE); //best effort, limited by /proc/sys/fs/pipe-max-size for unprivileged users
+    return 0;
+}
+
+//FNV-1a hash of (src_ip, src_port, dest_port)
+static uint32_t tcp_corr_hash(const struct tcp_corr_record_t* rec)
+{
+    uint32_t hash = 2166136261u;
+    for (const char* c = rec->src_ip; *c != 0; c++)
+        hash = (hash ^ (unsigned char) *c) * 16777619u;
+    hash = (hash ^ (uint32_t) rec->src_port) * 16777619u;
+    hash = (hash ^ (uint32_t) rec->dest_port) * 16777619u;
+    return hash & (TCP_CORR_BUCKETS - 1);
+}
+
+//Returns the link pointing to the entry with the same key as rec, resp. to NULL at the end of the bucket
+static struct tcp_corr_entry_t** tcp_corr_find(struct tcp_corr_entry_t** link, const struct tcp_corr_record_t* rec)
+{
+    while (*link != 0 && ((*link)->rec.src_port != rec->src_port || (*link)->rec.dest_port != rec->dest_port || strcmp((*link)->rec.src_ip, rec->src_ip) != 0))
+        link = &(*link)->next;
+    return link;
+}
+
+//Timeout in ms from now until unixtime of rec + wait, at least min seconds
+static long int tcp_corr_timeout(const struct tcp_corr_record_t* rec, long double wait, long double min)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long double remaining = rec->unixtime + wait - (now.tv_sec + now.tv_nsec / 1e9L);
+    if (remaining < min) remaining = min;
+    return (long int) (remaining * 1000);
+}
+
+//Writes a merged event, syn or flow may be NULL
+static void tcp_corr_emit(struct tcp_corr_t* corr, const char* event_type, const struct tcp_corr_record_t* syn, const char* syn_data, const struct tcp_corr_record_t* flow, const char* flow_data)
+{
+    //Connection data takes precedence, except for the source port, which is the true one in the SYN (cf. DNAT)
+    const struct tcp_corr_record_t* rec = flow != 0 ? flow : syn;
+    struct tcp_merged_event_t event;
+    event.timestamp = rec->timestamp;
+    event.src_ip = rec->src_ip;
+    event.src_port = syn != 0 ? syn->src_port : rec->src_port;
+    event.dest_ip = rec->dest_ip;
+    event.dest_port = rec->dest_port;
+    event.proto = flow != 0 ? flow->proto : "TCP";
+    event.event_type = event_type;
+    event.unixtime = rec->unixtime;
+    event.flow = flow_data;
+    event.flow_len = flow != 0 ? flow->len : 0;
+    event.headers = syn_data;
+    event.headers_len = syn != 0 ? syn->len : 0;
+    if (emit_tcp_merged_event(&corr->output, &event) > 2) //do not print empty JSON-Objects
+        print_event(corr->conf->output, &corr->output);
+    return;
+}
+
+//Writes an unmatched entry as "syn_scan" resp. "no_syn"
+static void tcp_corr_emit_unmatched(struct tcp_corr_t* corr, const struct tcp_corr_entry_t* e)
+{
+    if (e->rec.type == TCP_CORR_SYN) {
+        tcp_corr_emit(corr, "syn_scan", &e->rec, e->data, NULL, NULL);
+        corr->syn_scan++;
+    } else {
+        tcp_corr_emit(corr, "no_syn", NULL, NULL, &e->rec, e->data);
+        corr->no_syn++;
+    }
+    return;
+}
+
+//Removes an entry from its hash table and the timing wheel, the entry has to be freed by the caller
+static void tcp_corr_unlink(struct tcp_corr_t* corr, struct tcp_corr_entry_t** link)
+{
+    struct tcp_corr_entry_t* e = *link;
+    *link = e->next;
+    timer_del(&corr->timers, &e->timer);
+    corr->pending--;
+    return;
+}
+
+struct tcp_corr_t* tcp_corr_init(const struct tcp_corr_conf_t* conf, const struct timespec* now)
+{
+    struct tcp_corr_t* corr = CHECK(calloc(1, sizeof(struct tcp_corr_t)), != 0);
+    corr->conf = conf;
+    corr->output.format = output_format;
+    timer_init(&corr->timers, now, TCP_CORR_TICK);
+    return corr;
+}
+
+void tcp_corr_add(struct tcp_corr_t* corr, const struct tcp_corr_record_t* rec, const char* data)
+{
+    uint32_t hash = tcp_corr_hash(rec);
+    bool syn = rec->type == TCP_CORR_SYN;
+
+    //Counterpart pending: Merge both, the event type of accepted connections is the one of the flow, as in the postprocessor
+    struct tcp_corr_entry_t** link = tcp_corr_find(syn ? &corr->flows[hash] : &corr->syns[hash], rec);
+    if (*link != 0) {
+        struct tcp_corr_entry_t* e = *link;
+        tcp_corr_unlink(corr, link);
+        if (syn)
+            tcp_corr_emit(corr, e->rec.event_type, rec, data, &e->rec, e->data);
+        else
+            tcp_corr_emit(corr, rec->event_type, &e->rec, e->data, rec, data);
+        corr->accept++;
+        free(e);
+        return;
+    }
+
+    //Same key pending: A retransmitted SYN replaces the former one, a flow on a reused source port pushes out the former one
+    struct tcp_corr_entry_t** table = syn ? corr->syns : corr->flows;
+    link = tcp_corr_find(&table[hash], rec);
+    if (*link != 0) {
+        struct tcp_corr_entry_t* e = *link;
+        tcp_corr_unlink(corr, link);
+        if (!syn) tcp_corr_emit_unmatched(corr, e);
+        corr->duplicates++;
+        free(e);
+    }
+
+    struct tcp_corr_entry_t* e = CHECK(malloc(sizeof(struct tcp_corr_entry_t) + rec->len), != 0);
+    e->timer.prev = NULL;
+    e->rec = *rec;
+    memcpy(e->data, data, rec->len);
+    e->next = table[hash];
+    table[hash] = e;
+    corr->pending++;
+    if (syn) { //Wait for the flow, which is written when the connection has been closed
+        bool proxied = corr->conf->portmap != 0 && rec->dest_port > 0 && rec->dest_port < 65536 && corr->conf->portmap[rec->dest_port];
+        timer_add(&corr->timers, &e->timer, tcp_corr_timeout(rec, proxied ? corr->conf->syn_wait_proxy : corr->conf->syn_timeout, 0));
+    } else { //Wait for the SYN, which normally has arrived long before, but at least con_wait for records still in the other pipe
+        timer_add(&corr->timers, &e->timer, tcp_corr_timeout(rec, corr->conf->con_wait + corr->conf->syn_timeout, corr->conf->con_wait));
+    }
+    return;
+}
+
+//Callback for expired entries
+static void tcp_corr_expired(struct timer_entry_t* t, void* user)
+{
+    struct tcp_corr_t* corr = (struct tcp_corr_t*) user;
+    struct tcp_corr_entry_t* e = (struct tcp_corr_entry_t*) t; //timer is the first member
+    struct tcp_corr_entry_t** table = e->rec.type == TCP_CORR_SYN ? corr->syns : corr->flows;
+    struct tcp_corr_entry_t** link = &table[tcp_corr_hash(&e->rec)];
+    while (*link != e) link = &(*link)->next;
+    tcp_corr_unlink(corr, link);
+    tcp_corr_emit_unmatched(corr, e);
+    free(e);
+    return;
+}
+
+long int tcp_corr_expire(struct tcp_corr_t* corr, const struct timespec* now)
+{
+    return timer_expire(&corr->timers, now, tcp_corr_expired, corr);
+}
+
+void tcp_corr_free(struct tcp_corr_t* corr)
+{
+    struct tcp_corr_entry_t** tables[2] = { corr->syns, corr->flows };
+    for (int i = 0; i < 2; i++) {
+        for (int hash = 0; hash < TCP_CORR_BUCKETS; hash++) {
+            while (tables[i][hash] != 0) { //discard, like the postprocessor
+                struct tcp_corr_entry_t* e = tables[i][hash];
+                tcp_corr_unlink(corr, &tables[i][hash]);
+                free(e);
+            }
+        }
+    }
+    dict_buffer_free(&corr->output);
+    free(corr);
+    return;
+}
+
+//Reads from a pipe and adds all complete records, returns false if the pipe has been closed
+static bool tcp_corr_read(struct tcp_corr_t* corr, struct tcp_corr_input_t* in)
+{
+    if (in->size - in->len < TCP_CORR_READ / 2) {
+        in->size *= 2;
+        in->data = CHECK(realloc(in->data, in->size), != 0);
+    }
+    ssize_t n = read(in->fd, in->data + in->len, in->size - in->len);
+    if (n <= 0) return n < 0 && (errno == EINTR || errno == EAGAIN);
+    in->len += n;
+
+    const uint32_t magic = TCP_CORR_MAGIC;
+    struct tcp_corr_record_t rec;
+    size_t pos = 0;
+    while (in->len - pos >= sizeof(rec)) {
+        memcpy(&rec, in->data + pos, sizeof(rec)); //data is not aligned
+        if (rec.magic != magic || rec.len > TCP_CORR_MAX_RECORD || (rec.type != TCP_CORR_SYN && rec.type != TCP_CORR_FLOW)) {
+            //Garbled, which should not happen, because only the drain thread of the parent writes whole records. Skip to the next magic.
+            char* next = memmem(in->data + pos + 1, in->len - pos - 1, &magic, sizeof(magic));
+            size_t skip = next != 0 ? (size_t) (next - (in->data + pos)) : in->len - pos - (sizeof(magic) - 1);
+            corr->garbled += skip;
+            pos += skip;
+            continue;
+        }
+        if (in->len - pos - sizeof(rec) < rec.len) { //incomplete, make sure it fits into the buffer
+            while (in->size < sizeof(rec) + rec.len + TCP_CORR_READ / 2) in->size *= 2;
+            in->data = CHECK(realloc(in->data, in->size), != 0);
+            break;
+        }
+        rec.src_ip[sizeof(rec.src_ip) - 1] = 0;
+        rec.dest_ip[sizeof(rec.dest_ip) - 1] = 0;
+        rec.timestamp[sizeof(rec.timestamp) - 1] = 0;
+        rec.proto[sizeof(rec.proto) - 1] = 0;
+        rec.event_type[sizeof(rec.event_type) - 1] = 0;
+        tcp_corr_add(corr, &rec, in->data + pos + sizeof(rec));
+        pos += sizeof(rec) + rec.len;
+    }
+    in->len -= pos;
+    memmove(in->data, in->data + pos, in->len);
+    return true;
+}
+
+static void tcp_corr_log_stats(const struct tcp_corr_t* corr)
+{
+    char log_time[64] = "";
+    time_str(NULL, 0, log_time, sizeof(log_time));
+    fprintf(stderr, "%s [PID %d] Correlator: %ld pending, %ld accepted, %ld syn_scan, %ld no_syn, %ld duplicates, %ld bytes garbled\n",
+            log_time, getpid(), corr->pending, corr->accept, corr->syn_scan, corr->no_syn, corr->duplicates, corr->garbled);
+    return;
+}
+
+void worker_corr(int synfd, int flowfd, const struct tcp_corr_conf_t* conf)
+{
+    struct timespec now, last_stats;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    last_stats = now;
+    struct tcp_corr_t* corr = tcp_corr_init(conf, &now);
+
+    struct tcp_corr_input_t input[2] = { { synfd, CHECK(malloc(TCP_CORR_READ), != 0), 0, TCP_CORR_READ },
+                                         { flowfd, CHECK(malloc(TCP_CORR_READ), != 0), 0, TCP_CORR_READ } };
+    struct pollfd fds[2] = { { synfd, POLLIN, 0 }, { flowfd, POLLIN, 0 } };
+    int open = 2;
+
+    //SIGTERM and SIGINT are only delivered while waiting, so tcp_corr_stop can not be set after it has been tested
+    sigset_t stop_signals, wait_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &stop_signals, &wait_mask);
+    struct timespec stop = { 0, 0 }; //Time tcp_corr_stop has been seen
+
+    while (open > 0) {
+        //Stopping: the producers are stopping, too, read until they have closed the pipes, but do not wait for a hanging one
+        if (tcp_corr_stop && stop.tv_sec == 0) stop = now;
+        if (tcp_corr_stop && now.tv_sec - stop.tv_sec >= TCP_CORR_STOP_WAIT) break;
+        int timeout = timer_next(&corr->timers, &now);
+        if (timeout < 0 || timeout > TCP_CORR_STATS_INTERVAL * 1000) timeout = TCP_CORR_STATS_INTERVAL * 1000;
+        if (tcp_corr_stop && timeout > 1000) timeout = 1000;
+        struct timespec poll_timeout = { timeout / 1000, (timeout % 1000) * 1000000L };
+        int ready = ppoll(fds, 2, &poll_timeout, &wait_mask);
+        if (ready < 0 && errno != EINTR) CHECK(ready, >= 0);
+        for (int i = 0; i < 2 && ready > 0; i++) {
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && !tcp_corr_read(corr, &input[i])) {
+                fds[i].fd = -1; //closed, ignored by poll(...) from now on
+                open--;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        tcp_corr_expire(corr, &now);
+        fflush(conf->output); //once per batch of events
+        if (now.tv_sec - last_stats.tv_sec >= TCP_CORR_STATS_INTERVAL) {
+            tcp_corr_log_stats(corr);
+            last_stats = now;
+        }
+    }
+
+    //Pending entries are discarded
+    tcp_corr_log_stats(corr);
+    tcp_corr_free(corr);
+    fflush(conf->output);
+    free(input[0].data);
+    free(input[1].data);
+    sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+    return;
+}
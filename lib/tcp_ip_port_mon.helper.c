@@ -38,17 +38,22 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
 
 #include "tcp_ip_port_mon.helper.h"
 #include "epollinterface.h" //struct free list and epoll_server_hdl for proxy signal handler
+#include "tcp_ip_port_mon.worker.h" //tcp_worker_stop for listner signal handler
+#include "tcp_ip_port_mon.correlator.h" //tcp_corr_send(...) for tcp_output_event(...)
+#include "rsp.h" //rsp(...) and rsp_multi(...) for start_proxies(...)
 
 // Global Variables and Definitions
 char hostaddr[INET6_ADDRSTRLEN]; //Hostaddress to bind to. Globally defined to make it visible to functions for filtering.
 //Global Variables and definitions
 int pcap_pid; //PID of the Child doing the PCAP-Sniffing. Globally defined, cause it's used in CHECK-Makro.
 int listner_pid; //PID of the Child doing the TCP Connection handling. Globally defined, cause it's used in CHECK-Makro.
-//semaphores for output globally defined for easy access inside functions
-sem_t *hdrsem; //Semaphore for named pipe containing TCP/IP data
-sem_t *consem; //Semaphore for named pipe containing connection data
+//shared memory rings for output globally defined for easy access inside functions
+struct event_ring_t* event_ring; //Mapped before forking, thus reachable for all childs
+struct event_drain_t event_drain; //Drain thread of the parent, stopped by the watchdog on shutdown
+volatile sig_atomic_t parent_stop = 0; //Set by the signal handler of the parent to the signal number, the watchdog shuts down
 FILE* confifo; //FILE* confifo is globally defined to be reachabel for proxy-childs and listner-childs and signal handlers
 FILE* hdrfifo; //FILE* confifo is globally defined to be reachabel for pcap-childs and signal handlers
+bool tcp_correlation = false; //SYNs and flows are sent as records to the correlator process instead of JSON to the FIFOs
 int openfd; //Socket FD is globally defined to be reachabel for listner-childs and signal handlers
 pcap_t *handle; //pcap Session handle
 
@@ -72,7 +77,11 @@ void print_help_tcp(char* progname) //print help message
             \tloglevel = 0 --optional: loglevel (0: Standard, 1: Debug)\n\
             \tpath_to_save_tcp_streams = \"./tpm/\" --Must end with trailing \"/\", will be handled as prefix otherwise\n\
             \t--max_file_size = \"1024\" --optional\n\
+            \t--pcap_buffer_size = \"16777216\" --optional, capture buffer of the SYN sniffer in bytes\n\
+            \t--tcp_correlation = \"true\" --optional, match SYNs and connections in process instead of tcp_ip_port_mon_postprocessor.py\n\
             \t--TCP Proxy configuration\n\
+            \t--proxy_single_process = \"true\" --optional, one proxy process serves all ports instead of one process per port\n\
+            \t--proxy_splice = \"true\" --optional, proxies forward data by splice(2) instead of copying it\n\
             \ttcpproxy = {\n\
             \t-- [<listen port>] = { \"<backend IP>\", <backend Port> },\n\
             \t\t[22]  = { \"192.168.10.222\", 22 },\n\
@@ -94,7 +103,7 @@ void print_help_tcp(char* progname) //print help message
     return;
 }
 
-int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str)
+int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str, const struct capture_conf_t* conf)
 {
     char errbuf[PCAP_ERRBUF_SIZE];// Error string
     struct bpf_program fp;    // The compiled ct_filter, global to get freed. Free here?
@@ -114,9 +123,17 @@ int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str)
     // Find the properties for the device
     if (pcap_lookupnet(dev, &net, &mask, errbuf) == -1)
         return -1;
-    // Open the session in non-promiscuous mode
-    *handle = pcap_open_live(dev, BUFSIZ, 0, 100, errbuf);
-    if (handle == NULL)
+    // Create the session in non-promiscuous mode and apply capture settings before activating it
+    *handle = pcap_create(dev, errbuf);
+    if (*handle == NULL)
+        return -2;
+    pcap_set_snaplen(*handle, conf->snaplen);
+    pcap_set_promisc(*handle, 0);
+    pcap_set_timeout(*handle, PCAP_TIMEOUT);
+    if (conf->buffer_size > 0)
+        pcap_set_buffer_size(*handle, conf->buffer_size);
+    pcap_set_immediate_mode(*handle, conf->immediate);
+    if (pcap_activate(*handle) < 0) //warnings (>0) are not fatal
         return -2;
     // Compile and apply the ct_filter
     if (pcap_compile(*handle, &fp, filter_exp, 0, net) == -1)
@@ -129,6 +146,20 @@ int init_pcap(char* dev, char* dev_addr, pcap_t **handle, char* pcap_filter_str)
     return 0;
 }
 
+void log_capture_stats(struct capture_t* cap, const long int syn_count)
+{
+    char log_time[64] = ""; //Human readable time (actual time zone)
+    time_str(NULL, 0, log_time, sizeof(log_time)); //Get Human readable string only
+    struct pcap_stat ps;
+    if (capture_stats(cap, &ps) == -1) {
+        fprintf(stderr, "%s [PID %d] Sniffer: capture_stats: %s\n", log_time, getpid(), cap->backend == CAPTURE_PCAP ? pcap_geterr(cap->pcap) : strerror(errno));
+        return;
+    }
+    fprintf(stderr, "%s [PID %d] Sniffer: %ld TCP-SYNs logged, capture: %u received, %u dropped, %u dropped by interface\n", \
+            log_time, getpid(), syn_count, ps.ps_recv, ps.ps_drop, ps.ps_ifdrop);
+    fflush(stderr);
+}
+
 void drop_root_privs(struct user_t user, const char* entity, bool silent) // if process is running as root, drop privileges
 {
     if (getuid() == 0) {
@@ -145,6 +176,129 @@ void drop_root_privs(struct user_t user, const char* entity, bool silent) // if
     return;
 }
 
+void tcp_output_event(struct event_ring_t* ring, int kind, struct tcp_corr_record_t* rec, tcp_emit_t emit_object, tcp_emit_t emit_event, const void* event)
+{
+    static struct dict_buffer output = {0}; //reused for every event
+    int ring_id = kind == TCP_CORR_SYN ? TCP_RING_HDR : TCP_RING_CON;
+    output.format = output_format;
+    if(tcp_correlation) { //the correlator writes the merged event, thus it needs only a part of it
+        emit_object(&output, event);
+        tcp_corr_send(ring, ring_id, rec, &output);
+    }
+    if((!tcp_correlation || output.format == DICT_FORMAT_JSON) && emit_event(&output, event) > 2) { //do not print empty JSON-Objects
+        if(!tcp_correlation)
+            event_ring_put_event(ring, ring_id, &output); //output for further analysis, dropped if nobody reads the FIFO
+        if(output.format == DICT_FORMAT_JSON) {
+            fprintf(stdout,"{\"%s\": %s}\n", kind == TCP_CORR_SYN ? "HEADER" : "CONNECTION", output.data); //print json output for logging
+            fflush(stdout);
+        }
+    }
+    return;
+}
+
+//Signal Handler for SIGCHLD of the listner supervisor, only interrupts sigsuspend(...)
+static void sig_handler_listnersupervisor(int signo)
+{
+    return;
+}
+
+int supervise_listners(const int workers)
+{
+    pid_t pids[workers];
+    char log_time[64] = "";
+    int status = 0;
+
+    //SIGCHLD, SIGTERM and SIGINT are only delivered while waiting, so none is missed
+    sigset_t supervised_signals, wait_mask;
+    sigemptyset(&supervised_signals);
+    sigaddset(&supervised_signals, SIGCHLD);
+    sigaddset(&supervised_signals, SIGTERM);
+    sigaddset(&supervised_signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &supervised_signals, &wait_mask);
+    CHECK(signal(SIGCHLD, sig_handler_listnersupervisor), != SIG_ERR); //statuses are collected below, instead of sig_handler_sigchld(...)
+
+    for (int worker = 0; worker < workers; worker++) {
+        if ( !(pids[worker] = fork()) ) {
+            prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if supervisor dies.
+            CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR);
+            sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+            return worker;
+        }
+    }
+
+    while (!tcp_worker_stop) {
+        sigsuspend(&wait_mask);
+        pid_t pid;
+        while (!tcp_worker_stop && (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            int worker = 0;
+            while (worker < workers && pids[worker] != pid) worker++;
+            if (worker == workers) continue;
+            if ( !(pids[worker] = fork()) ) { //Re-create listner with the same number, thus the same CPU
+                sleep(TCP_LISTEN_RESTART_WAIT);
+                prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if supervisor dies.
+                CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR);
+                sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+                return worker;
+            }
+            time_str(NULL, 0, log_time, sizeof(log_time));
+            fprintf(stderr, "%s [PID %d] Listner %d of %d with PID %d exited, restarting in %d seconds with PID %d...\n",\
+                    log_time, getpid(), worker + 1, workers, pid, TCP_LISTEN_RESTART_WAIT, pids[worker]);
+        }
+    }
+
+    //Stopped by a signal: let the listners write the events of their open connections and wait for them
+    for (int worker = 0; worker < workers; worker++)
+        if (pids[worker] > 0) kill(pids[worker], SIGTERM);
+    sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+    while (waitpid(-1, &status, 0) > 0 || errno == EINTR);
+    return -1;
+}
+
+void detach_fifos()
+{
+    //fileno(...) and dup2(...) do not lock the FILEs, which may have been held by the drain thread while forking
+    int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devnull < 0) return;
+    if (hdrfifo != NULL) dup2(devnull, fileno(hdrfifo));
+    if (confifo != NULL) dup2(devnull, fileno(confifo));
+    close(devnull);
+    hdrfifo = NULL;
+    confifo = NULL;
+    return;
+}
+
+pid_t start_proxies(struct proxy_conf_tcp_t* pc, char* hostaddr, struct proxy_conf_tcp_node_t* pcn, double restart_wait)
+{
+    pid_t pid = fork();
+    if (pid == 0) { //Reverse Proxy child process
+        if (restart_wait > 0) sleep(restart_wait);
+        if (pcn == NULL)
+            pc->pid = getpid();
+        else
+            pcn->pid = getpid(); //update copy of listelemnt in this (forked) copy with own PID, to be able to find own config.
+#if DEBUG >= 2
+        char log_time[64] = "";
+        time_str(NULL, 0, log_time, sizeof(log_time));
+        if (pcn != NULL) fprintf(stderr, "%s [PID %d] Starting Proxy on Port %d...\n", log_time, getpid(), pcn->listenport);
+#endif
+        prctl(PR_SET_PDEATHSIG, SIGTERM); //request SIGTERM if parent dies.
+        detach_fifos(); //events are written by the drain thread of the parent
+        CHECK(signal(SIGTERM, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGTERM for child process
+        CHECK(signal(SIGINT, sig_handler_proxychild), != SIG_ERR); //re-register handler for SIGINT for child process
+        CHECK(signal(SIGCHLD, sig_handler_sigchld), != SIG_ERR); //register handler for parents to prevent childs becoming Zombies
+        if (pcn == NULL)
+            CHECK(rsp_multi(pc, hostaddr), != 0); //start proxy for all ports
+        else
+            CHECK(rsp(pcn, hostaddr), != 0); //start proxy
+    }
+    if (pcn == NULL) //save PID for parent watchdog
+        pc->pid = pid;
+    else
+        pcn->pid = pid;
+    usleep(10000); //sleep 10ms, so output is not mangled between forks
+    return pid;
+}
+
 //Handler
 
 //Signal handler helper functioin with common frees, etc. for parents and childs
@@ -157,9 +311,6 @@ void sig_handler_common()
         free(pc);
         //free JSON output
         dict_free(json_dict(false));
-        //release locks
-        sem_post(hdrsem);
-        sem_post(consem);
     }
     firstrun = false;
     return;
@@ -168,36 +319,53 @@ void sig_handler_common()
 //Signal Handler for parent watchdog
 void sig_handler_parent(int signo)
 {
-    static bool firstrun = true;
-    if (firstrun) {
-        char stop_time[64] = ""; //Human readable stop time (actual time zone)
-        time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
-        fprintf(stderr, "\n%s [PID %d] Parent Watchdog received Signal %s, shutting down...\n", stop_time, getpid(), strsignal(signo));
-
-        int stat_accept = 0;
-
-        for (int listenport = 1; listenport <65536; listenport++) {
-            if ( pc->portmap[listenport] && !waitpid(pctcp_get_lport(pc, listenport)->pid, &stat_accept, WNOHANG) )
-                kill(pctcp_get_lport(pc, listenport)->pid, SIGTERM);
-        }
-
-        //Check if forked childs are still alive
-        //Give childs a chance to exit gracefull by sending SIGTERM
-        if ( !waitpid(listner_pid, &stat_accept, WNOHANG) )
-            kill(listner_pid, SIGTERM);
+    if (signo == SIGUSR1) { //CHECK failed, the parent can not continue: only tell the childs and exit
+        for (struct proxy_conf_tcp_node_t* pcn = pc->portlist; pcn != NULL; pcn = pcn->next)
+            if ( pcn->pid > 0 ) kill(pcn->pid, SIGTERM);
+        if ( pc->pid > 0 ) kill(pc->pid, SIGTERM);
+        if ( listner_pid > 0 ) kill(listner_pid, SIGTERM);
+        if ( pcap_pid > 0 ) kill(pcap_pid, SIGTERM);
+        _exit(-1); //exit() somtimes hangs, see man _exit and man exit
+    }
+    parent_stop = signo; //checked by the watchdog, which calls parent_shutdown(...)
+    return;
+}
 
-        if ( !waitpid(pcap_pid, &stat_accept, WNOHANG) )
-            kill(pcap_pid, SIGTERM);
+//Shutdown of parent watchdog
+void parent_shutdown(int signo)
+{
+    char stop_time[64] = ""; //Human readable stop time (actual time zone)
+    time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
+    fprintf(stderr, "\n%s [PID %d] Parent Watchdog received Signal %s, shutting down...\n", stop_time, getpid(), strsignal(signo));
 
-        sleep(1); //Childs sometimes hanging while exit() or _exit() call, thus send SIGKILL
-        if ( !waitpid(listner_pid, &stat_accept, WNOHANG) )
-            kill(listner_pid, SIGKILL);
-        if ( !waitpid(pcap_pid, &stat_accept, WNOHANG) )
-            kill(pcap_pid, SIGKILL);
+    int stat_accept = 0;
 
-        sig_handler_common();
+    for (struct proxy_conf_tcp_node_t* pcn = pc->portlist; pcn != NULL; pcn = pcn->next) {
+        if ( pcn->pid > 0 && !waitpid(pcn->pid, &stat_accept, WNOHANG) )
+            kill(pcn->pid, SIGTERM);
+    }
+    if ( pc->pid > 0 && !waitpid(pc->pid, &stat_accept, WNOHANG) ) //proxy serving all ports
+        kill(pc->pid, SIGTERM);
+
+    //Check if forked childs are still alive
+    //Give childs a chance to exit gracefull by sending SIGTERM, the listner writes the events of all open connections
+    bool listner_alive = listner_pid > 0 && !waitpid(listner_pid, &stat_accept, WNOHANG);
+    bool pcap_alive = pcap_pid > 0 && !waitpid(pcap_pid, &stat_accept, WNOHANG);
+    if (listner_alive) kill(listner_pid, SIGTERM);
+    if (pcap_alive) kill(pcap_pid, SIGTERM);
+
+    for (int wait = 0; wait < PARENT_STOP_WAIT * 10 && (listner_alive || pcap_alive); wait++) {
+        usleep(100000);
+        if (listner_alive) listner_alive = !waitpid(listner_pid, &stat_accept, WNOHANG);
+        if (pcap_alive) pcap_alive = !waitpid(pcap_pid, &stat_accept, WNOHANG);
     }
-    firstrun = true;
+    //Childs sometimes hanging while exit() or _exit() call, thus send SIGKILL
+    if (listner_alive) kill(listner_pid, SIGKILL);
+    if (pcap_alive) kill(pcap_pid, SIGKILL);
+
+    //write remaining events of the childs to the FIFOs
+    event_drain_stop(&event_drain);
+    sig_handler_common();
     //exit parent process
     exit(signo);
     return;
@@ -246,22 +414,20 @@ void sig_handler_listnerchild(int signo)
     pid_t kidpid = 0;
     int status = 0;
     if (firstrun) {
-        char stop_time[64] = ""; //Human readable stop time (actual time zone)
-        time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
-        sig_handler_common();
         if (signo == SIGUSR2) { //Gracefull shutdown of Listern Accept childs
+            char stop_time[64] = ""; //Human readable stop time (actual time zone)
+            time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
+            sig_handler_common();
             if (loglevel > 0)
                 fprintf(stderr, "%s [PID %d] Listner: Accept-Child is done. Bye.\n", stop_time, getpid());
             kill(getpid(), SIGKILL); //kill child process //exit may hang when used in forged child processes, thus using SIGKILL instead.; //exit(signo); //hangs sometimes under  high load>
-        } else {
-            fprintf(stderr, "\n%s [PID %d] Listner-Child received Signal %s, shutting down...\n", stop_time, getpid(), strsignal(signo));
-#if DEBUG >= 2
-            fprintf(stderr, "*** DEBUG [PID %d] Parent died, aborting.\n", getpid());
-#endif
-            return; //exit(signo); //hangs sometimes under high load
         }
+        //Only tell worker_tcp(...) to stop, it closes all open connections, so their payloads and events are written, and returns.
+        tcp_worker_stop = signo;
+        firstrun = false;
+        return;
     }
-    firstrun = false;
+    //Second signal: do not wait for the connections to be closed
     do
     {
         kidpid = waitpid(-1, &status, WNOHANG); //Check if childs have returned
@@ -278,6 +444,7 @@ void sig_handler_proxychild(int signo)
         char stop_time[64] = ""; //Human readable stop time (actual time zone)
         time_str(NULL, 0, stop_time, sizeof(stop_time)); //Get Human readable string only
         fprintf(stderr, "\n%s [PID %d] Proxy received Signal %s, shutting down...\n", stop_time, getpid(), strsignal(signo));
+        epoll_log_stats();
         jd_free_list(jd->list);
         free(jd);
 
@@ -289,9 +456,8 @@ void sig_handler_proxychild(int signo)
             free(free_list);
             free_list = temp;
         }
-        //free global epoll server socket handler
-        free(epoll_server_hdl->closure);
-        free(epoll_server_hdl);
+        //free epoll server socket handler(s)
+        free_server_socket_handlers();
 
 #if DEBUG >= 2
         fprintf(stderr, "*** DEBUG [PID %d] Parent died, aborting.\n", getpid());
@@ -303,6 +469,12 @@ void sig_handler_proxychild(int signo)
     return;
 }
 
+void sig_handler_corrchild(int signo)
+{
+    tcp_corr_stop = 1; //checked by worker_corr(...), whose poll(...) is interrupted by this signal
+    return;
+}
+
 //Signal Handler for SIGUSR1 to initiate gracefull shutdown, e.g. by CHECK-Macro
 void sig_handler_shutdown(int signo)
 {
@@ -361,9 +533,7 @@ int get_config_table(lua_State* L, char* name, struct proxy_conf_tcp_t* pc) //re
 
 struct proxy_conf_tcp_t* pctcp_init() //initialize proxy configuration
 {
-    struct proxy_conf_tcp_t* pc = malloc (sizeof(struct proxy_conf_tcp_t));
-    pc->portlist = 0; //set headpointer to 0
-    for (int listenport = 0; listenport<65536; listenport++) pc->portmap[listenport] = false; //initilze map of ports used to proxy network traffic
+    struct proxy_conf_tcp_t* pc = calloc(1, sizeof(struct proxy_conf_tcp_t)); //headpointer, map of ports used to proxy network traffic and configuration of each port are initialized to 0
     return pc;
 }
 
@@ -382,18 +552,15 @@ void pctcp_push(struct proxy_conf_tcp_t* pc, int listenport, char* backendaddr,
 
     pctcp_node->next = pc->portlist;
     pc->portlist = pctcp_node;
+    pc->portconf[listenport] = pctcp_node;
     pc->num_elements++;
     return;
 }
 
 struct proxy_conf_tcp_node_t* pctcp_get_lport(struct proxy_conf_tcp_t* pc, int listenport) //get proxy configuration for listenport
 {
-    struct proxy_conf_tcp_node_t* result = pc->portlist;
-    while ( result != 0) {
-        if(result->listenport == listenport) return result;
-        result = result->next;
-    }
-    return 0;
+    if (listenport < 0 || listenport > 65535) return 0;
+    return pc->portconf[listenport];
 }
 
 struct proxy_conf_tcp_node_t* pctcp_get_pid(struct proxy_conf_tcp_t* pc, pid_t pid) //get proxy configuration for proxy with Process ID "pid"
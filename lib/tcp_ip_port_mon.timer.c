@@ -0,0 +1,230 @@
+/*******************************************************************************
+This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
+
+    MADCAT is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MADCAT is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MADCAT.  If not, see <http://www.gnu.org/licenses/>.
+
+ Diese Datei ist Teil von MADCAT, dem Mass Attack Detection Acceptance Tool.
+
+    MADCAT ist Freie Software: Sie können es unter den Bedingungen
+    der GNU General Public License, wie von der Free Software Foundation,
+    Version 3 der Lizenz oder (nach Ihrer Wahl) jeder neueren
+    veröffentlichten Version, weiter verteilen und/oder modifizieren.
+
+    MADCAT wird in der Hoffnung, dass es nützlich sein wird, aber
+    OHNE JEDE GEWÄHRLEISTUNG, bereitgestellt; sogar ohne die implizite
+    Gewährleistung der MARKTFÄHIGKEIT oder EIGNUNG FÜR EINEN BESTIMMTEN ZWECK.
+    Siehe die GNU General Public License für weitere Details.
+
+    Sie sollten eine Kopie der GNU General Public License zusammen mit diesem
+    Programm erhalten haben. Wenn nicht, siehe <https://www.gnu.org/licenses/>.
+*******************************************************************************/
+/* MADCAT - Mass Attack Detecion Connection Acceptance Tool
+ * TCP-IP port monitor.
+ *
+ *
+ * BSI 2018-2023
+*/
+
+#include "tcp_ip_port_mon.timer.h"
+
+//Milliseconds elapsed since tick 0 of the wheel
+static uint64_t timer_elapsed(const struct timer_wheel_t* tw, const struct timespec* now)
+{
+    long long int ms = (long long int) (now->tv_sec - tw->base.tv_sec) * 1000 + (now->tv_nsec - tw->base.tv_nsec) / 1000000;
+    return ms > 0 ? (uint64_t) ms : 0;
+}
+
+//Inserts a timer into the slot of the finest wheel covering its expiry
+static void timer_insert(struct timer_wheel_t* tw, struct timer_entry_t* t)
+{
+    uint64_t expires = t->expires; //never before tw->now, which is only possible while cascading and then inserted into the slot to be processed next
+    uint64_t delta = expires - tw->now;
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 && delta >= ((uint64_t) 1 << (TIMER_BITS * (level + 1))))
+        level++;
+    int slot = (expires >> (TIMER_BITS * level)) & TIMER_MASK;
+
+    struct timer_entry_t* head = &tw->slots[level][slot];
+    t->slot = head;
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+    tw->occupied[level] |= (uint64_t) 1 << slot;
+}
+
+//Unlinks a timer from its slot
+static void timer_unlink(struct timer_wheel_t* tw, struct timer_entry_t* t)
+{
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    if (t->slot->next == t->slot) { //slot is empty now
+        int index = t->slot - &tw->slots[0][0];
+        tw->occupied[index / TIMER_SLOTS] &= ~((uint64_t) 1 << (index % TIMER_SLOTS));
+    }
+    t->prev = NULL;
+    t->next = NULL;
+}
+
+//Moves all timers of a slot to the list head, which must not be in the wheel
+static void timer_take(struct timer_wheel_t* tw, const int level, const int slot, struct timer_entry_t* list)
+{
+    struct timer_entry_t* head = &tw->slots[level][slot];
+    if (head->next == head) {
+        list->next = list;
+        list->prev = list;
+    } else {
+        list->next = head->next;
+        list->prev = head->prev;
+        list->next->prev = list;
+        list->prev->next = list;
+        head->next = head;
+        head->prev = head;
+    }
+    tw->occupied[level] &= ~((uint64_t) 1 << slot);
+}
+
+//Ticks from tw->now until the next tick, at which timers expire or have to be cascaded (at least 1). UINT64_MAX if none.
+static uint64_t timer_due(const struct timer_wheel_t* tw)
+{
+    uint64_t due = UINT64_MAX;
+    if (tw->count == 0)
+        return due;
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        if (tw->occupied[level] == 0)
+            continue;
+        int shift = TIMER_BITS * level;
+        //Slots of the finest wheel expire at their tick, slots of coarser wheels are cascaded when they are reached.
+        //The current slots have been processed already, so search from the following ones on.
+        int index = ((tw->now >> shift) + 1) & TIMER_MASK;
+        uint64_t rotated = index == 0 ? tw->occupied[level] : (tw->occupied[level] >> index) | (tw->occupied[level] << (TIMER_SLOTS - index));
+        uint64_t distance = __builtin_ctzll(rotated) + 1;
+        uint64_t ticks = (((tw->now >> shift) + distance) << shift) - tw->now;
+        if (ticks < due)
+            due = ticks;
+    }
+    return due;
+}
+
+void timer_init(struct timer_wheel_t* tw, const struct timespec* now, const long int tick)
+{
+    tw->base = *now;
+    tw->tick = tick > 0 ? tick : 1;
+    tw->now = 0;
+    tw->count = 0;
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        tw->occupied[level] = 0;
+        for (int slot = 0; slot < TIMER_SLOTS; slot++) {
+            tw->slots[level][slot].next = &tw->slots[level][slot];
+            tw->slots[level][slot].prev = &tw->slots[level][slot];
+        }
+    }
+    return;
+}
+
+void timer_add(struct timer_wheel_t* tw, struct timer_entry_t* t, const long int timeout)
+{
+    if (timer_pending(t))
+        timer_unlink(tw, t);
+    else
+        tw->count++;
+    uint64_t ticks = timeout > 0 ? ((uint64_t) timeout + tw->tick - 1) / tw->tick : 1; //expired timers expire with the next tick
+    t->expires = tw->now + (ticks < TIMER_MAX ? ticks : TIMER_MAX);
+    timer_insert(tw, t);
+    return;
+}
+
+void timer_del(struct timer_wheel_t* tw, struct timer_entry_t* t)
+{
+    if (!timer_pending(t))
+        return;
+    timer_unlink(tw, t);
+    tw->count--;
+    return;
+}
+
+bool timer_pending(const struct timer_entry_t* t)
+{
+    return t->prev != NULL;
+}
+
+long int timer_expire(struct timer_wheel_t* tw, const struct timespec* now, void (*expire)(struct timer_entry_t* t, void* user), void* user)
+{
+    uint64_t target = timer_elapsed(tw, now) / tw->tick; //last tick to be processed
+    long int expired = 0;
+    struct timer_entry_t list;
+
+    while (tw->now < target) {
+        uint64_t due = timer_due(tw);
+        if (due > target - tw->now) { //nothing to do until target, skip idle ticks at once
+            tw->now = target;
+            break;
+        }
+        tw->now += due;
+
+        //Cascade timers of coarser wheels, whose slot has been reached, to finer wheels
+        for (int level = 1; level < TIMER_LEVELS && (tw->now & (((uint64_t) 1 << (TIMER_BITS * level)) - 1)) == 0; level++) {
+            timer_take(tw, level, (tw->now >> (TIMER_BITS * level)) & TIMER_MASK, &list);
+            while (list.next != &list) {
+                struct timer_entry_t* t = list.next;
+                list.next = t->next;
+                t->next->prev = &list;
+                timer_insert(tw, t);
+            }
+        }
+
+        //Expire timers of the current tick. Timers restarted by the callback are due with the next tick at the earliest.
+        timer_take(tw, 0, tw->now & TIMER_MASK, &list);
+        while (list.next != &list) {
+            struct timer_entry_t* t = list.next;
+            timer_unlink(tw, t); //the slot in the wheel has been emptied by timer_take(...), so timer_unlink(...) works on the local list, too.
+            tw->count--;
+            expired++;
+            expire(t, user);
+        }
+    }
+    return expired;
+}
+
+long int timer_drain(struct timer_wheel_t* tw, void (*expire)(struct timer_entry_t* t, void* user), void* user)
+{
+    long int drained = 0;
+    struct timer_entry_t list;
+
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        while (tw->occupied[level] != 0) {
+            timer_take(tw, level, __builtin_ctzll(tw->occupied[level]), &list);
+            while (list.next != &list) {
+                struct timer_entry_t* t = list.next;
+                timer_unlink(tw, t); //works on the local list, see timer_expire(...)
+                tw->count--;
+                drained++;
+                expire(t, user);
+            }
+        }
+    }
+    return drained;
+}
+
+int timer_next(const struct timer_wheel_t* tw, const struct timespec* now)
+{
+    uint64_t due = timer_due(tw);
+    if (due == UINT64_MAX)
+        return -1;
+    uint64_t at = (tw->now + due) * tw->tick; //ms since tick 0, at which the wheel has to be advanced
+    uint64_t elapsed = timer_elapsed(tw, now);
+    if (at <= elapsed)
+        return 0;
+    return at - elapsed < INT_MAX ? (int) (at - elapsed) : INT_MAX;
+}
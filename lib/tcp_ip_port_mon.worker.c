@@ -36,221 +36,538 @@ This file is part of MADCAT, the Mass Attack Detection Acceptance Tool.
  * BSI 2018-2023
 */
 
+#define _GNU_SOURCE //splice(...), pipe2(...) and F_SETPIPE_SZ
 #include "tcp_ip_port_mon.worker.h"
 #include "tcp_ip_port_mon.helper.h"
 
-//Listner thread
+//Connection worker
 
-long int worker_tcp(const char* dst_addr, const int dest_port, const char* src_addr, const int src_port, const long double timeout, \
-                    const char* data_path, const int max_file_size, const int s, FILE* confifo, char* proto_str)
+volatile sig_atomic_t tcp_worker_stop = 0;
+
+//Initializes the state of an accepted connection and logs it, returns NULL if the connection is to be ignored
+static struct tcp_con_t* tcp_con_open(const int s, const char* dst_addr, const int dest_port, const char* src_addr, const int src_port, \
+                                      const struct tcp_worker_conf_t* conf)
 {
     //on some systems, e.g. VMs, binding to a specific address does not work as expected.
     if(strcmp(dst_addr, hostaddr) != 0 && strcmp("0.0.0.0", hostaddr) !=0) //char hostaddr[INET6_ADDRSTRLEN] globally defined.
-        return -1; //Filter packtes not matching hostaddress by returning from child
+        return NULL; //Filter packtes not matching hostaddress
 
-    int size_recv;
-    char chunk[CHUNK_SIZE];
-    unsigned char* payload = malloc(CHUNK_SIZE); //Paylaod (Binary)
-    char* payload_hd_str = 0; //Payload as string in HexDump Format
-    char* payload_str = 0; //Payload as string
-    unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
-    char * payload_sha1_str = 0;
-    long double timediff;
-    struct con_status_t con_status;
-    bool size_exceeded = false;
-    char log_time[64] = "";
-    char log_time_unix[64] = "";
-    long double unix_timeasdouble = time_str(log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
-    long double duration = 0;
-    long double min_rtt = 0;
+    struct tcp_con_t* con = calloc(1, sizeof(struct tcp_con_t));
+    con->fd = s;
+    con->conf = conf;
+    snprintf(con->dst_addr, sizeof(con->dst_addr), "%s", dst_addr);
+    snprintf(con->src_addr, sizeof(con->src_addr), "%s", src_addr);
+    con->dest_port = dest_port;
+    con->src_port = src_port;
+    con->payload = malloc(CHUNK_SIZE); //Paylaod (Binary)
+    con->payload_size = CHUNK_SIZE;
+    con->file_fd = -1;
+    con->sha1 = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(con->sha1, EVP_sha1(), NULL);
+    long double unix_timeasdouble = time_str(con->log_time_unix, sizeof(con->log_time_unix), con->log_time, sizeof(con->log_time));
 
-    FILE *file = 0;
-    char file_name[2*PATH_LEN] = ""; //double path length for concatination purposes. PATH_LEN *MUST* be enforced when combinating path and filename!
+    //Log connection to STDERR in readeable format
+    if(loglevel>0) {
+        fprintf(stderr, "%s [PID %d] CONNECTION from %s:%d to %s:%d\n", con->log_time, getpid(), src_addr, src_port, dst_addr, dest_port);
+    } else {
+        fprintf(stderr, "%s [PID %d] CONNECTION from %s:%d to %s:%d\n", con->log_time, getpid(), "<Masked by default loglevel>", src_port, dst_addr, dest_port);
+    }
+
+    //Generate connection tag to identify connection. Maximum is 28 Bytes, e.g. "123.456.789.012_43210_98765\0"
+    snprintf(con->con_status.tag, 28, "%s_%d_%d", src_addr, dest_port, src_port);
+    //initialize connection state for connection con_status by postprocessor
+    snprintf(con->con_status.state, 16, "%s", "open");
+    snprintf(con->con_status.reason, 16, "%s", "n/a");
+    snprintf(con->con_status.start, 64, "%s", con->log_time);
+    snprintf(con->con_status.end, 64, "%s", con->log_time);
+    con->con_status.timeasdouble = unix_timeasdouble;
+    con->con_status.data_bytes = 0;
+
+    //initialize beginning time for idle timeout and max_duration
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &con->begin);
+    con->start = con->begin;
+    con->firstpacket = true;
+    return con;
+}
+
+//Pipe for moving stream data from sockets to files by splice(2), shared by all connections of the worker
+static int tcp_pipe[2] = { -1, -1 };
+static int tcp_pipe_size = 0;
+
+//Marks a connection, whose stream file could not be written, to be closed with the next tick.
+//Only this connection is affected, the worker keeps serving all others.
+static void tcp_con_file_error(struct tcp_con_t* con)
+{
     char now_time[64] = "";
-    char lastrecv_time[64] = "";
+    int error = errno;
+    time_str(NULL, 0, now_time, sizeof(now_time)); //Get Human readable string only
+    fprintf(stderr, "%s [PID %d] ERROR: Could not write to file %s: %s\n", now_time, getpid(), con->file_name, strerror(error));
+    snprintf(con->con_status.reason, 16, "%s", "file error");
+    con->file_error = true;
+    return;
+}
 
-    //structures for timeout measurment
-    struct timeval begin, now;
+//Opens the stream file of a connection, if not already done. Returns false on failure, see tcp_con_file_error(...)
+static bool tcp_con_file(struct tcp_con_t* con)
+{
+    const struct tcp_worker_conf_t* conf = con->conf;
 
-    //Log connection to STDERR in readeable format
+    if (con->file_fd >= 0)
+        return true;
+    if (con->file_error)
+        return false;
+    //generate filename LinuxTimeStamp-milisecends_destinationAddress-destinationPort_sourceAddress-sourcePort.tpm
+    char file_name[2*PATH_LEN] = ""; //double path length for concatination purposes. PATH_LEN *MUST* be enforced when combinating path and filename!
+    snprintf(file_name, PATH_LEN, "%s%s_%s-%d_%s-%d.tpm", conf->data_path, con->log_time, con->dst_addr, con->dest_port, con->src_addr, con->src_port);
+    con->file_name = strdup(file_name);
     if(loglevel>0) {
-        fprintf(stderr, "%s [PID %d] CONNECTION from %s:%d to %s:%d\n", log_time, getpid(), src_addr, src_port, dst_addr, dest_port);
+        fprintf(stderr, "%s [PID %d] FILENAME: %s\n", con->log_time, getpid(), con->file_name);
     } else {
-        fprintf(stderr, "%s [PID %d] CONNECTION from %s:%d to %s:%d\n", log_time, getpid(), "<Masked by default loglevel>", src_port, dst_addr, dest_port);
+        fprintf(stderr, "%s [PID %d] FILENAME: %s%s_%s-%d_%s-%d.tpm\n", con->log_time, getpid(), \
+                conf->data_path, con->log_time, con->dst_addr, con->dest_port, "<Masked by default loglevel>", con->src_port);
+    }
+    con->file_fd = open(con->file_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666); //Open File
+    if (con->file_fd < 0) {
+        tcp_con_file_error(con);
+        return false;
     }
+    return true;
+}
 
+//Writes the part of the payload, which is not yet in the stream file. Returns false on failure, see tcp_con_file_error(...)
+static bool tcp_con_flush(struct tcp_con_t* con)
+{
+    if (con->file_error)
+        return false;
+    while (con->file_len < con->payload_len) {
+        ssize_t written = write(con->file_fd, con->payload + con->file_len, con->payload_len - con->file_len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            if (written == 0) errno = ENOSPC; //write(2) of regular files returns 0 only, if nothing could be written
+            tcp_con_file_error(con);
+            return false;
+        }
+        con->file_len += written;
+    }
+    return true;
+}
 
-    //Open new JSON and log connection to STDOUT in json-format (Suricata-alike)
-    json_value.string = "MADCAT";
-    dict_update(json_dict(true), JSON_STR, json_value, 1, "origin");
-    json_value.string = (char*) src_addr;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-    json_value.integer = dest_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "dest_port");
-    json_value.string = log_time;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-    json_value.string = (char*) dst_addr;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-    json_value.integer = src_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "src_port");
-    json_value.string = proto_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "proto");
-    json_value.string = "flow";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "event_type");
-    json_value.floating = atof(log_time_unix);
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
+//Bytes, that may still be written to the stream file after the payload, i.e. beyond max_file_size
+static size_t tcp_con_stream_room(const struct tcp_con_t* con)
+{
+    const struct tcp_worker_conf_t* conf = con->conf;
+    if (conf->max_stream_size < 0)
+        return SIZE_MAX;
+    return (size_t) conf->max_stream_size > con->file_len ? conf->max_stream_size - con->file_len : 0;
+}
 
-    //Generate connection tag to identify connection. Maximum is 28 Bytes, e.g. "123.456.789.012_43210_98765\0"
-    snprintf(con_status.tag, 28, "%s_%d_%d", src_addr, dest_port, src_port);
-    //initialize connection state for connection con_status by postprocessor
-    snprintf(con_status.state, 16, "%s", "open");
-    snprintf(con_status.reason, 16, "%s", "n/a");
-    snprintf(con_status.start, 64, "%s", log_time);
-    snprintf(con_status.end, 64, "%s", log_time);
-    con_status.timeasdouble = unix_timeasdouble;
-    con_status.data_bytes = 0;
-
-    //make socket non blocking
-    fcntl(s, F_SETFL, O_NONBLOCK);
-
-    //initialize beginning time and time now for first run
-    gettimeofday(&begin, NULL);
-    bool firstpacket = true;
-    while(1) { //receiving loop
-        //get current time
-        gettimeofday(&now, NULL);  //now is the receiving time
-        time_str(NULL, 0, now_time, sizeof(now_time)); //Get Human readable string only
-        timediff = (now.tv_sec - begin.tv_sec) + 1e-6 * (now.tv_usec - begin.tv_usec); //time elapsed in seconds
-        //break after timeout
-        if(timediff > timeout) {
-            if (!size_exceeded) { //test if size has been exceeded (con_status.data_bytes >= max_file_size) to not overwritte con_status.reason.
-                snprintf(con_status.reason, 16, "%s", "timeout");
-            }
-            break;
+//Moves up to len bytes from the socket to the stream file through a pipe, without copying them to user space.
+//Returns like recv(...), -1 with con->file_error set, if the file can not be written.
+static ssize_t tcp_con_splice(struct tcp_con_t* con, size_t len)
+{
+    if (tcp_pipe[0] < 0) {
+        CHECK(pipe2(tcp_pipe, O_CLOEXEC), == 0);
+        fcntl(tcp_pipe[1], F_SETPIPE_SZ, TCP_WORKER_PIPE); //may fail due to /proc/sys/fs/pipe-max-size, then the default size is used
+        tcp_pipe_size = CHECK(fcntl(tcp_pipe[1], F_GETPIPE_SZ), > 0);
+    }
+    if (!tcp_con_file(con))
+        return -1;
+    if (len > (size_t) tcp_pipe_size)
+        len = tcp_pipe_size;
+    ssize_t size_in = splice(con->fd, NULL, tcp_pipe[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (size_in <= 0)
+        return size_in;
+    for (ssize_t size_out = 0; size_out < size_in; ) { //empty the pipe completely, it is shared by all connections
+        ssize_t moved = splice(tcp_pipe[0], NULL, con->file_fd, NULL, size_in - size_out, SPLICE_F_MOVE);
+        if (moved < 0 && errno == EINTR)
+            continue;
+        if (moved <= 0) {
+            if (moved == 0) errno = ENOSPC;
+            tcp_con_file_error(con);
+            //the data left in the pipe belongs to this connection, so the next one gets a new, empty pipe
+            close(tcp_pipe[0]);
+            close(tcp_pipe[1]);
+            tcp_pipe[0] = tcp_pipe[1] = -1;
+            return -1;
         }
+        size_out += moved;
+    }
+    con->file_len += size_in;
+    return size_in;
+}
+
+//Receives all pending data of a connection, returns false if the connection has been closed by the peer or failed.
+//Receive errors are kept as reason, a stream file, which can not be written, sets con->file_error.
+static bool tcp_con_recv(struct tcp_con_t* con)
+{
+    const struct tcp_worker_conf_t* conf = con->conf;
+    char lastrecv_time[64] = "";
+    ssize_t size_recv;
+
+    while(1) { //receive until the socket would block
         //test if max_file_size is exceeded
-        if((con_status.data_bytes >= max_file_size) && max_file_size >= 0) {
-            snprintf(con_status.reason, 16, "%s", "size exceeded");
-            size_exceeded = true;
+        if((con->con_status.data_bytes >= conf->max_file_size) && conf->max_file_size >= 0) {
+            snprintf(con->con_status.reason, 16, "%s", "size exceeded");
+            con->size_exceeded = true;
         }
 
-        memset(chunk,0, CHUNK_SIZE);    //clear the variable
-        size_recv =  recv(s, chunk, CHUNK_SIZE, 0);
-        if(size_recv <= 0) {
-            //if nothing was received then we want to wait a little before trying again, 0.1 seconds
-            usleep(50000);
-        } else {
-            //reset beginning time
-            gettimeofday(&begin, NULL);
-            con_status.data_bytes += size_recv; //calculate totale size received
-            if (con_status.data_bytes > 0 && !size_exceeded) { //proceed for writing payload in file / JSON only if max_file_size has not been exceeded.
-
-                if (file == 0) { //if somthing had been received and no file is open yet...
-                    //...generate filename LinuxTimeStamp-milisecends_destinationAddress-destinationPort_sourceAddress-sourcePort.tpm
-                    sprintf(file_name, "%s%s_%s-%d_%s-%d.tpm", data_path, log_time, dst_addr, dest_port, src_addr, src_port);
-                    file_name[PATH_LEN-1] = 0; //Enforcing PATH_LEN
-                    if(loglevel>0) {
-                        fprintf(stderr, "%s [PID %d] FILENAME: %s\n",log_time, getpid(), file_name);
-                    } else {
-                        fprintf(stderr, "%s [PID %d] FILENAME: %s%s_%s-%d_%s-%d.tpm\n",log_time, getpid(), \
-                                data_path, log_time, dst_addr, dest_port, "<Masked by default loglevel>", src_port);
-                    }
-                    file = fopen(file_name,"wb"); //Open File
-                }
-                //Write when -and only WHEN nothing went wrong- data in chunk to file
-                if (file != 0) {
-                    fwrite(chunk, size_recv, 1, file);
-                    CHECK(fflush(file), == 0);
-                    //Save Payload for JSON-Output
-                    payload = realloc(payload, con_status.data_bytes); //get memory for all received bytes so far
-                    memcpy(payload + con_status.data_bytes - size_recv, chunk, size_recv); //copy chunk to payload
-                } else { //if somthing went wrong, abort.
-                    fprintf(stderr, "%s [PID %d] ERROR: Could not write to file %s\n",now_time, getpid(), file_name);
-                    free(payload);
-                    abort();
-                }
+        if (con->size_exceeded) { //the payload is complete and has been written to the stream file
+            size_t room = tcp_con_stream_room(con);
+            if (room > 0) { //move further data to the stream file without copying it
+                size_recv = tcp_con_splice(con, room);
+            } else { //only count, what exceeds the stream file: MSG_TRUNC discards data of TCP sockets without copying it
+                size_recv = recv(con->fd, NULL, TCP_WORKER_DRAIN, MSG_TRUNC);
             }
-            long double duration_saved = duration;
-            duration = time_str(NULL, 0, lastrecv_time, sizeof(lastrecv_time)) - con_status.timeasdouble;
-            if(!firstpacket && ( duration - duration_saved < min_rtt || min_rtt == 0) ) {
-                min_rtt = duration - duration_saved;
+        } else {
+            if (con->payload_len == con->payload_size) { //grow payload geometrically, but not beyond max_file_size
+                con->payload_size *= 2;
+                if (conf->max_file_size >= 0 && con->payload_size > (size_t) conf->max_file_size)
+                    con->payload_size = conf->max_file_size;
+                con->payload = realloc(con->payload, con->payload_size);
             }
-            snprintf(con_status.end, sizeof(con_status.end), "%s", lastrecv_time); //save current time as end time candidate
-            firstpacket = false;
+            size_t room = con->payload_size - con->payload_len;
+            if (conf->max_file_size >= 0 && con->payload_len + room > (size_t) conf->max_file_size) //initial payload may exceed a small max_file_size
+                room = conf->max_file_size - con->payload_len;
+            //receive directly into payload
+            size_recv = recv(con->fd, con->payload + con->payload_len, room, 0);
+        }
+        if (con->file_error)
+            return false;
+        if(size_recv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return true;
+        if(size_recv < 0) { //e.g. reset by the peer, unlike an orderly close it ends the flow with an error
+            if (strcmp(con->con_status.reason, "n/a") == 0)
+                snprintf(con->con_status.reason, 16, "%s", errno == ECONNRESET ? "reset" : "recv error");
+            return false;
+        }
+        if(size_recv == 0) //closed by the peer
+            return false;
+
+        //reset beginning time
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &con->begin);
+        con->con_status.data_bytes += size_recv; //calculate totale size received
+        if (!con->size_exceeded) { //proceed for writing payload in file / JSON only if max_file_size has not been exceeded.
+            if (!tcp_con_file(con)) //open file, if somthing had been received and no file is open yet
+                return false;
+            //Update SHA1 for JSON-Output, the payload itself has been received in place.
+            EVP_DigestUpdate(con->sha1, con->payload + con->payload_len, size_recv);
+            con->payload_len += size_recv;
+            //Write to file in batches. Write the complete payload before further data is spliced to the file.
+            if ((con->payload_len - con->file_len >= TCP_WORKER_FLUSH || (conf->max_file_size >= 0 && con->payload_len >= (size_t) conf->max_file_size))
+                    && !tcp_con_flush(con))
+                return false;
         }
-    } //end of receiving loop
-    //if a file has been opened, because a stream had been received, close its filepointer to prevent data loss.
-    if (file != 0) {
-        fclose(file);
+        long double duration_saved = con->duration;
+        con->duration = time_str(NULL, 0, lastrecv_time, sizeof(lastrecv_time)) - con->con_status.timeasdouble;
+        if(!con->firstpacket && ( con->duration - duration_saved < con->min_rtt || con->min_rtt == 0) ) {
+            con->min_rtt = con->duration - duration_saved;
+        }
+        snprintf(con->con_status.end, sizeof(con->con_status.end), "%s", lastrecv_time); //save current time as end time candidate
+        con->firstpacket = false;
+    }
+}
+
+//Emitters for tcp_output_event(...)
+static size_t tcp_emit_flow_object(struct dict_buffer* buf, const void* event)
+{
+    return emit_tcp_flow_object(buf, (const struct tcp_flow_event_t*) event);
+}
+
+static size_t tcp_emit_flow_event(struct dict_buffer* buf, const void* event)
+{
+    return emit_tcp_flow_event(buf, (const struct tcp_flow_event_t*) event);
+}
+
+static size_t tcp_emit_syn_headers(struct dict_buffer* buf, const void* event)
+{
+    const struct tcp_syn_event_t* syn = (const struct tcp_syn_event_t*) event;
+    if(buf->format == DICT_FORMAT_CBOR)
+        dict_dump_cbor(buf, syn->headers);
+    else
+        dict_dumpbuf(buf, syn->headers);
+    return buf->len;
+}
+
+static size_t tcp_emit_syn_event(struct dict_buffer* buf, const void* event)
+{
+    return emit_tcp_syn_event(buf, (const struct tcp_syn_event_t*) event);
+}
+
+//Closes a connection after its timeout, writes its payload file and flow event and frees its state
+static void tcp_con_close(struct tcp_con_t* con)
+{
+    const struct tcp_worker_conf_t* conf = con->conf;
+    unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
+    char now_time[64] = "";
+
+    if (strcmp(con->con_status.reason, "n/a") == 0) { //test if size or max_duration has been exceeded to not overwritte con_status.reason.
+        snprintf(con->con_status.reason, 16, "%s", "timeout");
+    }
+    close(con->fd); //Close connection
+
+    time_str(NULL, 0, now_time, sizeof(now_time)); //Get Human readable string only
+    //if a file has been opened, because a stream had been received, write the rest of the payload and close it.
+    //On a write error the payload is still in the flow event.
+    if (con->file_fd >= 0) {
+        tcp_con_flush(con);
+        close(con->file_fd);
         if(loglevel>0) {
-            fprintf(stderr, "%s [PID %d] FILE %s closed\n", now_time, getpid(), file_name);
+            fprintf(stderr, "%s [PID %d] FILE %s closed\n", now_time, getpid(), con->file_name);
         } else {
-            fprintf(stderr, "%s [PID %d] FILE %s%s_%s-%d_%s-%d.tpm closed\n",log_time, getpid(), \
-                    data_path, log_time, dst_addr, dest_port, "<Masked by default loglevel>", src_port);
+            fprintf(stderr, "%s [PID %d] FILE %s%s_%s-%d_%s-%d.tpm closed\n", con->log_time, getpid(), \
+                    conf->data_path, con->log_time, con->dst_addr, con->dest_port, "<Masked by default loglevel>", con->src_port);
         }
     }
-    snprintf(con_status.state, 16, "%s", "closed");
+    snprintf(con->con_status.state, 16, "%s", "closed");
 
-    //Compute SHA1 of payload
-    SHA1(payload, (size_exceeded ? max_file_size : con_status.data_bytes), payload_sha1);
-    payload_sha1_str = print_hex_string(payload_sha1, SHA_DIGEST_LENGTH); //must be freed
-    //Make HexDump output out of binary payload
-    payload_hd_str = hex_dump(payload, (size_exceeded ? max_file_size : con_status.data_bytes), true); //must be freed
-    payload_str = print_hex_string(payload, (size_exceeded ? max_file_size : con_status.data_bytes)); //must be freed
+    //Finish SHA1 of payload
+    EVP_DigestFinal_ex(con->sha1, payload_sha1, NULL);
 
     //Log flow information in json-format (Suricata-like)
-    json_value.string = con_status.start;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "start");
-    json_value.string = con_status.end;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "end");
-    json_value.floating = duration;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "duration");
-    json_value.floating = min_rtt;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "min_rtt");
-    json_value.string = con_status.state;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "state");
-    json_value.string = con_status.reason;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "reason");
-    json_value.integer = con_status.data_bytes;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
-    
-    json_value.string = payload_hd_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_hd");
-    json_value.string = payload_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_str");
-    json_value.string = payload_sha1_str;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_sha1");
-
-#if DEBUG >= 2
-    int consem_val = -127;
-    CHECK(sem_getvalue(consem, &consem_val), != -1); //Ceck
-    fprintf(stderr, "*** DEBUG [PID %d] Acquire lock for output.\n", getpid());
-    fprintf(stderr, "%s [PID %d] : Value of connection semaphore: %d.\n", log_time, getpid(), consem_val);
-#endif
-    struct timespec sem_timeout; //time to wait in sem_timedwait() call
-    clock_gettime(CLOCK_REALTIME, &sem_timeout);
-    sem_timeout.tv_sec += 1;
-    char* output = dict_dumpstr(json_dict(false));
-    if(strlen(output) > 2) { //do not print empty JSON-Objects
-        sem_timedwait(consem, &sem_timeout); //Acquire lock for output
-        fprintf(confifo, "%s\n", output); //print json output for further analysis
-        fflush(confifo);
-        sem_post(consem); //release lock
-        fprintf(stdout,"{\"CONNECTION\": %s}\n", output); //print json output for logging
-        fflush(stdout);
-    }
-    free(output);
+    struct tcp_flow_event_t event;
+    event.src_ip = con->src_addr;
+    event.dest_port = con->dest_port;
+    event.timestamp = con->log_time;
+    event.dest_ip = con->dst_addr;
+    event.src_port = con->src_port;
+    event.proto = conf->proto_str;
+    event.unixtime = atof(con->log_time_unix);
+    event.start = con->con_status.start;
+    event.end = con->con_status.end;
+    event.duration = con->duration;
+    event.min_rtt = con->min_rtt;
+    event.state = con->con_status.state;
+    event.reason = con->con_status.reason;
+    event.bytes_toserver = con->con_status.data_bytes;
+    event.payload = con->payload;
+    event.payload_len = con->payload_len;
+    event.payload_sha1 = payload_sha1;
+
+    struct tcp_corr_record_t rec; //the correlator needs only the FLOW object
+    if(tcp_correlation)
+        tcp_corr_record(&rec, TCP_CORR_FLOW, event.src_ip, event.src_port, event.dest_ip, event.dest_port, event.timestamp, event.unixtime, event.proto, "flow");
+    tcp_output_event(conf->ring, TCP_CORR_FLOW, &rec, tcp_emit_flow_object, tcp_emit_flow_event, &event);
 
     if(loglevel>0) {
-        fprintf(stderr, "%s [PID %d] END of connection from %s:%d started %s\n",now_time, getpid(), src_addr, src_port, log_time);
+        fprintf(stderr, "%s [PID %d] END of connection from %s:%d started %s\n",now_time, getpid(), con->src_addr, con->src_port, con->log_time);
     } else {
-        fprintf(stderr, "%s [PID %d] END of connection from %s:%d started %s\n",now_time, getpid(), "<Masked by default loglevel>", src_port, log_time);
+        fprintf(stderr, "%s [PID %d] END of connection from %s:%d started %s\n",now_time, getpid(), "<Masked by default loglevel>", con->src_port, con->log_time);
+    }
+
+    free(con->file_name);
+    free(con->payload);
+    EVP_MD_CTX_free(con->sha1);
+    free(con);
+    return;
+}
+
+//Time in ms until a connection has to be closed, 0 if it is due. Sets the reason, if max_duration or max_file_size has been exceeded.
+static long int tcp_con_remaining(struct tcp_con_t* con, const struct timespec* now)
+{
+    const struct tcp_worker_conf_t* conf = con->conf;
+    if (con->file_error || (con->size_exceeded && conf->close_size_exceeded && tcp_con_stream_room(con) == 0))
+        return 0;
+    long double remaining = conf->timeout - ((now->tv_sec - con->begin.tv_sec) + 1e-9 * (now->tv_nsec - con->begin.tv_nsec)); //idle timeout
+    if (conf->max_duration > 0) {
+        long double duration_left = conf->max_duration - ((now->tv_sec - con->start.tv_sec) + 1e-9 * (now->tv_nsec - con->start.tv_nsec));
+        if (duration_left <= 0 && !con->size_exceeded) //like in tcp_con_close(...), do not overwrite "size exceeded"
+            snprintf(con->con_status.reason, 16, "%s", "max duration");
+        if (duration_left < remaining)
+            remaining = duration_left;
+    }
+    return remaining > 0 ? (long int) (remaining * 1000) + 1 : 0;
+}
+
+//Timer callback: closes a connection, if it is due. Receiving data does not restart the timer, instead it is restarted here with the time left.
+//Writes pending payload, so a batch below TCP_WORKER_FLUSH does not wait for the connection to be closed.
+static void tcp_con_expire(struct timer_entry_t* timer, void* user)
+{
+    struct timer_wheel_t* timers = (struct timer_wheel_t*) user;
+    struct tcp_con_t* con = (struct tcp_con_t*) ((char*) timer - offsetof(struct tcp_con_t, timer));
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    long int remaining = tcp_con_remaining(con, &now);
+    if (remaining > 0) {
+        //fired early to write a small batch, see worker_tcp(...), on failure the connection is closed right away
+        if (con->file_len >= con->payload_len || tcp_con_flush(con)) {
+            timer_add(timers, timer, remaining);
+            return;
+        }
+    }
+    tcp_con_close(con); //closing the fd removes it from epoll
+    return;
+}
+
+//Shutdown: closes a connection regardless of its timeout, so its payload and flow event are written
+static void tcp_con_shutdown(struct timer_entry_t* timer, void* user)
+{
+    struct tcp_con_t* con = (struct tcp_con_t*) ((char*) timer - offsetof(struct tcp_con_t, timer));
+    if (strcmp(con->con_status.reason, "n/a") == 0)
+        snprintf(con->con_status.reason, 16, "%s", "shutdown");
+    tcp_con_close(con);
+    return;
+}
+
+//Lets the timer fire within TCP_WORKER_FLUSH_DELAY, if payload is waiting to be written, unless it expires earlier anyway. See tcp_con_expire(...)
+static void tcp_con_flush_later(struct timer_wheel_t* timers, struct tcp_con_t* con)
+{
+    if (con->file_len < con->payload_len && con->timer.expires > timers->now + TCP_WORKER_FLUSH_DELAY / TCP_WORKER_TICK)
+        timer_add(timers, &con->timer, TCP_WORKER_FLUSH_DELAY);
+    return;
+}
+
+//Accepts all pending connections on listenfd, registers them with epoll and starts their timers
+static void tcp_con_accept(const int listenfd, const int epfd, struct timer_wheel_t* timers, const struct tcp_worker_conf_t* conf, long int* flow_count)
+{
+    struct sockaddr_in trgaddr; //Storage for original destination port
+    struct sockaddr_in claddr; //Clientaddress
+    char clientaddr[INET_ADDRSTRLEN] = "";
+    char trgaddr_str[INET_ADDRSTRLEN] = "";
+    char log_time[64] = "";
+
+    while(1) {
+        socklen_t claddr_len = sizeof(claddr); //reinitialize claddr_len, because in the call to accept(...) it is a value-result argument!
+        socklen_t trgaddr_len = sizeof(trgaddr);
+        int s = accept(listenfd, (struct sockaddr*)&claddr, &claddr_len);  //Accept incoming connection
+        if (s < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNABORTED) {
+                time_str(NULL, 0, log_time, sizeof(log_time));
+                fprintf(stderr, "%s [PID %d] Listner: accept: %s\n", log_time, getpid(), strerror(errno));
+            }
+            return;
+        }
+        fcntl(s, F_SETFL, O_NONBLOCK); //make socket non blocking
+        if (loglevel > 1) {
+            time_str(NULL, 0, log_time, sizeof(log_time));
+            fprintf(stderr, "%s [PID %d] Connection incoming, trying to resolve original destination port on socket fd: %d...\n", log_time, getpid(), s);
+        }
+        //Read original dst. port from NAT-table (may collide with TCP Postprcessor lookup).
+        //If the connection has not been redirected, e.g. because it was directly targeting the listening port, use the local address.
+        if (getsockopt(s, SOL_IP, SO_ORIGINAL_DST, (struct sockaddr*)&trgaddr, &trgaddr_len) == -1) {
+            trgaddr_len = sizeof(trgaddr);
+            if (getsockname(s, (struct sockaddr*)&trgaddr, &trgaddr_len) == -1) {
+                close(s);
+                continue;
+            }
+        }
+        //retrieve client target IPv4 (important when listening on ANY_ADDR)
+        inet_ntop(AF_INET, &(claddr.sin_addr), clientaddr, sizeof(clientaddr));
+        inet_ntop(AF_INET, &(trgaddr.sin_addr), trgaddr_str, sizeof(trgaddr_str));
+        struct tcp_con_t* con = tcp_con_open(s, trgaddr_str, ntohs(trgaddr.sin_port), clientaddr, ntohs(claddr.sin_port), conf);
+        if (con == NULL) {
+            close(s);
+            continue;
+        }
+        //Data sent along with the handshake is usually already there, so receive it right away.
+        struct epoll_event event = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = con };
+        if (!tcp_con_recv(con) || epoll_ctl(epfd, EPOLL_CTL_ADD, s, &event) == -1) {
+            con->closed = true; //nothing more can be received, wait for timeout anyway
+        }
+        timer_add(timers, &con->timer, tcp_con_remaining(con, &con->begin));
+        tcp_con_flush_later(timers, con);
+        fprintf(stderr, "%s [PID %d] Connection No. %ld accepted\n", con->log_time, getpid(), ++(*flow_count));
+    }
+}
+
+void worker_tcp(const int listenfd, const struct tcp_worker_conf_t* conf)
+{
+    struct epoll_event events[TCP_WORKER_EVENTS];
+    struct timer_wheel_t timers; //timers of all open connections
+    long int flow_count = 0;
+    struct timespec now;
+    char log_time[64] = "";
+
+    int epfd = CHECK(epoll_create1(EPOLL_CLOEXEC), != -1);
+    fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event listen_event = { .events = EPOLLIN, .data.ptr = NULL }; //NULL marks the listening socket
+    CHECK(epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &listen_event), != -1);
+
+    //SIGTERM and SIGINT are only delivered while waiting, so tcp_worker_stop can not be set after it has been tested
+    sigset_t stop_signals, wait_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGTERM);
+    sigaddset(&stop_signals, SIGINT);
+    sigprocmask(SIG_BLOCK, &stop_signals, &wait_mask);
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    timer_init(&timers, &now, TCP_WORKER_TICK);
+    while(!tcp_worker_stop) {
+        //Sleep until the next timer is due, or for ever without open connections
+        int nfds = epoll_pwait(epfd, events, TCP_WORKER_EVENTS, timer_next(&timers, &now), &wait_mask);
+        if (tcp_worker_stop)
+            break;
+        for (int i = 0; i < nfds; i++) {
+            struct tcp_con_t* con = events[i].data.ptr;
+            if (con == NULL) {
+                tcp_con_accept(listenfd, epfd, &timers, conf, &flow_count);
+                continue;
+            }
+            if (!tcp_con_recv(con)) {
+                //Peer closed the connection, but like before the flow ends by timeout, so stop polling the socket until then.
+                epoll_ctl(epfd, EPOLL_CTL_DEL, con->fd, NULL);
+                con->closed = true;
+            }
+            if (con->file_error || (con->size_exceeded && conf->close_size_exceeded && tcp_con_stream_room(con) == 0))
+                timer_add(&timers, &con->timer, 0); //close with the next tick
+            else
+                tcp_con_flush_later(&timers, con);
+        }
+
+        //Close connections, whose timers are due. Done after handling the events, because it frees connections.
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+        timer_expire(&timers, &now, tcp_con_expire, &timers);
     }
 
-    free(payload_sha1_str);
-    free(payload_str);
-    free(payload_hd_str);
-    free(payload);
-    
-    return con_status.data_bytes;
+    //Stopped by a signal: write payload and flow event of all open connections, like on timeout
+    long int open_cons = timers.count;
+    timer_drain(&timers, tcp_con_shutdown, NULL);
+    close(epfd);
+    time_str(NULL, 0, log_time, sizeof(log_time));
+    fprintf(stderr, "%s [PID %d] Listner: closed %ld open connections on shutdown\n", log_time, getpid(), open_cons);
+    sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+    return;
+}
+
+//Sniffer callback
+
+void worker_syn(u_char* user, const struct pcap_pkthdr* header, const u_char* packet)
+{
+    long int* syn_count = (long int*) user;
+    char log_time[64] = ""; //Human readable capture time (actual time zone)
+    char log_time_unix[64] = ""; //Unix timestamp of capture (UTC)
+
+    //Preserve actuall start time of Connection attempt, as captured by the kernel.
+    struct timespec packet_time = { header->ts.tv_sec, header->ts.tv_usec * 1000 };
+    time_str_ts(&packet_time, log_time_unix, sizeof(log_time_unix), log_time, sizeof(log_time));
+    //Begin new global JSON output for the headers
+    struct tcp_syn_event_t event;
+    event.timestamp = log_time;
+    event.headers = json_dict(true);
+    //Analyze Headers and discard malformed packets
+    int ip_hdr_id = analyze_ip_header(packet, header->caplen);
+    if( ip_hdr_id < 0) {
+        return;
+    }
+    int data_bytes = analyze_tcp_header(packet, header->caplen); //eventually exisiting data bytes in SYN (yes, this would be akward)
+    if(data_bytes < 0) {
+        return;
+    }
+    //final JSON Ouput
+    event.data_bytes = data_bytes;
+    event.unixtime = atof(log_time_unix);
+    struct tcp_corr_record_t rec; //the correlator needs only the headers
+    if(tcp_correlation) {
+        struct iphdr* iphdr = (struct iphdr*) (packet + ETHERNET_HEADER_LEN); //already checked by analyze_*_header(...)
+        struct tcphdr* tcphdr = (struct tcphdr*) (packet + ETHERNET_HEADER_LEN + iphdr->ihl*4);
+        char src_ip[INET_ADDRSTRLEN] = "";
+        char dest_ip[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &iphdr->saddr, src_ip, sizeof(src_ip));
+        inet_ntop(AF_INET, &iphdr->daddr, dest_ip, sizeof(dest_ip));
+        tcp_corr_record(&rec, TCP_CORR_SYN, src_ip, ntohs(tcphdr->source), dest_ip, ntohs(tcphdr->dest), log_time, event.unixtime, NULL, NULL);
+    }
+    tcp_output_event(event_ring, TCP_CORR_SYN, &rec, tcp_emit_syn_headers, tcp_emit_syn_event, &event);
+    fprintf(stderr, "%s [PID %d] Sniffer: TCP-SYN No. %ld with id 0x%x received\n", log_time, getpid(), ++(*syn_count), ip_hdr_id);
+    return;
 }
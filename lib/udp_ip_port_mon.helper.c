@@ -472,88 +472,50 @@ char* backend_port: %d\n\
 
 void json_out(struct udpcon_data_node_t* uc_node)
 {
-    char* payload_hd_str = "NONE"; //Payload as string in HexDump Format
-    char* payload_str = "NONE"; //Payload as string
-    char * payload_sha1_str = "NONE"; //Paylod SHA1 hash
     unsigned char payload_sha1[SHA_DIGEST_LENGTH]; //SHA1 of payload
 
-    //Begin new JSON output and open new JSON
     //Log connection to STDOUT in json-format (Suricata-like)
-
-    json_value.string = "MADCAT";
-    dict_update(json_dict(true), JSON_STR, json_value, 1, "origin");
-    json_value.string = uc_node->src_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "src_ip");
-    json_value.integer = uc_node->src_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "src_port");
-    json_value.string = uc_node->dest_ip;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "dest_ip");
-    json_value.integer = uc_node->dest_port;
-    dict_update(json_dict(false), JSON_INT, json_value, 1, "dest_port");
-    json_value.string = uc_node->timestamp;
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "timestamp");
-    json_value.floating = uc_node->timeasdouble;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 1, "unixtime");
-    json_value.string = "UDP";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "proto");
-    json_value.string = uc_node->proxied ? "proxy_flow" : "flow";
-    dict_update(json_dict(false), JSON_STR, json_value, 1, "event_type");
-    json_value.string = uc_node->start;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "start");
-    json_value.string = uc_node->end;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "end");
-    json_value.floating = uc_node->duration;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "duration");
-    json_value.floating = uc_node->min_rtt;
-    dict_update(json_dict(false), JSON_FLOAT, json_value, 2, "FLOW", "min_rtt");
-    json_value.integer = uc_node->bytes_toserver;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toserver");
-    json_value.integer = uc_node->bytes_toclient;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "bytes_toclient");
+    struct udp_flow_event_t event;
+    event.proxied = uc_node->proxied;
+    event.src_ip = uc_node->src_ip;
+    event.src_port = uc_node->src_port;
+    event.dest_ip = uc_node->dest_ip;
+    event.dest_port = uc_node->dest_port;
+    event.timestamp = uc_node->timestamp;
+    event.unixtime = uc_node->timeasdouble;
+    event.start = uc_node->start;
+    event.end = uc_node->end;
+    event.duration = uc_node->duration;
+    event.min_rtt = uc_node->min_rtt;
+    event.bytes_toserver = uc_node->bytes_toserver;
+    event.bytes_toclient = uc_node->bytes_toclient;
 
     if( uc_node->proxied ) { //Proxy specific JSON output
-        json_value.string = uc_node->proxy_ip;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "proxy_ip");
-        json_value.integer = uc_node->proxy_port;
-        dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "proxy_port");
-        json_value.string = uc_node->backend_ip;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "backend_ip");
-        json_value.integer = uc_node->backend_port;
-        dict_update(json_dict(false), JSON_INT, json_value, 2, "FLOW", "backend_port");
+        event.proxy_ip = uc_node->proxy_ip;
+        event.proxy_port = uc_node->proxy_port;
+        event.backend_ip = uc_node->backend_ip;
+        event.backend_port = uc_node->backend_port;
     } else {
         //Do only include payload and compute sha1, if this was not a connection handled by proxy.
         //Overhead might easily become too large and it is intended to be logged and processed by backend, anyway.
         //Compute SHA1 of payload
         SHA1(uc_node->payload, uc_node->payload_len, payload_sha1);
-        payload_sha1_str = print_hex_string(payload_sha1, SHA_DIGEST_LENGTH);
-        //Make HexDump output out of binary payload
-        payload_hd_str = hex_dump(uc_node->payload, uc_node->payload_len, true); //must be freed
-        payload_str = print_hex_string(uc_node->payload, uc_node->payload_len); //must be freed
-
-
-        json_value.string = payload_hd_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_hd");
-        json_value.string = payload_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_str");
-        json_value.string = payload_sha1_str;
-        dict_update(json_dict(false), JSON_STR, json_value, 2, "FLOW", "payload_sha1");
-
-        free(payload_hd_str);
-        free(payload_str);
-        free(payload_sha1_str);
+        event.payload = uc_node->payload;
+        event.payload_len = uc_node->payload_len;
+        event.payload_sha1 = payload_sha1;
     }
 
-    //Analyse IP & TCP Headers and concat to global JSON using json_dict(...)
+    //Analyse IP & UDP Headers and concat to the event using json_dict(...)
+    event.headers = json_dict(true);
     analyze_ip_header(uc_node->first_dgram, uc_node->first_dgram_len);
     analyze_udp_header(uc_node->first_dgram, uc_node->first_dgram_len);
     //print JSON Object to stdout for logging
-    char* output = dict_dumpstr(json_dict(false));
-        if(strlen(output) > 2) { //do not print empty JSON-Objects
-            fprintf(stdout,"%s\n", output);
-            fflush(stdout);
-        }
-    free(output);
-
+    static struct dict_buffer output = {0}; //reused for every event
+    output.format = output_format;
+    if(emit_udp_flow_event(&output, &event) > 2) { //do not print empty JSON-Objects
+        print_event(stdout, &output);
+        fflush(stdout);
+    }
     return;
 }
 
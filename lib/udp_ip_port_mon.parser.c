@@ -65,31 +65,31 @@ int analyze_ip_header(const unsigned char* packet, int recv_len)
 
     //printf("\n\nlength: %d\n version:%x\n TOS: %x\n tot_len: %d\nid: 0x%x\n flags: 0x%04x\n ttl: %d\n protocol: %d\n check: 0x%04x\n src_addr: %s dst_addr: %s\n\n",
     json_value.integer = iphdr->ihl*4;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "IP", "hdr_len");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "IP", "hdr_len");
     json_value.integer = iphdr->version;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "IP", "version");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "IP", "version");
     json_value.hex.number = iphdr->tos;
     json_value.hex.format = HEX_FORMAT_02;
-    dict_update(json_dict(false), JSON_HEX, json_value, 2, "IP", "tos");
+    DICT_SET_PATH(json_dict(false), JSON_HEX, json_value, 2, "IP", "tos");
     json_value.integer = ntohs(iphdr->tot_len);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "IP", "tot_len");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "IP", "tot_len");
     json_value.hex.number = ntohs(iphdr->id);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(json_dict(false), JSON_HEX, json_value, 2, "IP", "id");
+    DICT_SET_PATH(json_dict(false), JSON_HEX, json_value, 2, "IP", "id");
     json_value.hex.number = ntohs(iphdr->frag_off);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(json_dict(false), JSON_HEX, json_value, 2, "IP", "flags");
+    DICT_SET_PATH(json_dict(false), JSON_HEX, json_value, 2, "IP", "flags");
     json_value.integer = iphdr->ttl;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "IP", "ttl");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "IP", "ttl");
     json_value.integer = iphdr->protocol;
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "IP", "protocol");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "IP", "protocol");
     json_value.hex.number = ntohs(iphdr->check);
     json_value.hex.format = HEX_FORMAT_04;
-    dict_update(json_dict(false), JSON_HEX, json_value, 2, "IP", "checksum");
+    DICT_SET_PATH(json_dict(false), JSON_HEX, json_value, 2, "IP", "checksum");
     json_value.string = ip_saddr;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "IP", "src_addr");
+    DICT_SET_PATH(json_dict(false), JSON_STR, json_value, 2, "IP", "src_addr");
     json_value.string = ip_daddr;
-    dict_update(json_dict(false), JSON_STR, json_value, 2, "IP", "dest_addr");
+    DICT_SET_PATH(json_dict(false), JSON_STR, json_value, 2, "IP", "dest_addr");
 
     //Parse IP options
     if (iphdr->ihl > 5) { //If Options/Padding present (IP Header longer than 5*4 = 20Byte)
@@ -109,13 +109,13 @@ int analyze_ip_header(const unsigned char* packet, int recv_len)
             switch(*opt_ptr) {
                 case MY_IPOPT_EOOL: //EOL is only one byte, so this is hopefully going to be easy.
                     json_value.string = "";
-                    dict_update(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "eol");
+                    DICT_SET_PATH(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "eol");
                     opt_ptr++;
                     eol = true;
                     break;
                 case MY_IPOPT_NOP: //NOP is only one byte, so this is going to be easy, too
                     json_value.string = "";
-                    dict_update(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "nop");
+                    DICT_SET_PATH(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "nop");
                     opt_ptr++;
                     break;
                 case MY_IPOPT_SEC:
@@ -202,9 +202,9 @@ int analyze_ip_header(const unsigned char* packet, int recv_len)
         //output tainted status, hex output (even if not tainted, cause padding might be usefull too) and close json
         char* hex_string = print_hex_string(opt_ptr, endofoptions_addr-opt_ptr);
         json_value.boolean = tainted;
-        dict_update(json_dict(false), JSON_BOOL, json_value, 3, "IP", "ip_options", "tained");
+        DICT_SET_PATH(json_dict(false), JSON_BOOL, json_value, 3, "IP", "ip_options", "tained");
         json_value.string = hex_string;
-        dict_update(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "padding_hex");
+        DICT_SET_PATH(json_dict(false), JSON_STR, json_value, 3, "IP", "ip_options", "padding_hex");
         free(hex_string);
     } //End of if
     //free
@@ -222,13 +222,13 @@ int analyze_udp_header(const unsigned char* packet, int recv_len)
     struct udphdr *udphdr = (struct udphdr *) (packet + iphdr->ihl*4);
 
     json_value.integer = ntohs(udphdr->source);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "UDP", "src_port");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "UDP", "src_port");
     json_value.integer = ntohs(udphdr->dest);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "UDP", "dest_port");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "UDP", "dest_port");
     json_value.integer = ntohs(udphdr->len);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "UDP", "len");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "UDP", "len");
     json_value.integer = ntohs(udphdr->check);
-    dict_update(json_dict(false), JSON_INT, json_value, 2, "UDP", "checksum");
+    DICT_SET_PATH(json_dict(false), JSON_INT, json_value, 2, "UDP", "checksum");
     return 0;
 }
 
@@ -15,4 +15,10 @@ sudo /opt/madcat/tcp_ip_port_mon /etc/madcat/config.lua 2>>/data/error.tcp.log 1
 # Give TCP-Module some time to start up and open configured FIFOs /tmp/confifo.tpm and /tmp/hdrfifo.tpm
 sleep 1
 # Start TCP Postprocessor, let it pipe results to Enrichment Processor FIFO.
-sudo /usr/bin/python3 /opt/madcat/tcp_ip_port_mon_postprocessor.py /etc/madcat/config.lua 2>>/data/error.tcppost.log 1>>/tmp/logs.erm &
+# With tcp_correlation = "true" the TCP-Module already writes the correlated events to /tmp/connect_json.tpm,
+# in the format of the postprocessor, so pipe them to the Enrichment Processor FIFO instead.
+if grep -Eq '^[[:space:]]*tcp_correlation[[:space:]]*=[[:space:]]*"true"' /etc/madcat/config.lua; then
+    sudo sh -c 'cat /tmp/connect_json.tpm 1>>/tmp/logs.erm 2>>/data/error.tcppost.log' &
+else
+    sudo /usr/bin/python3 /opt/madcat/tcp_ip_port_mon_postprocessor.py /etc/madcat/config.lua 2>>/data/error.tcppost.log 1>>/tmp/logs.erm &
+fi
@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+  #include "madcat.capture.h"
+  #include "madcat.common.h"
+  #include <stdlib.h>
+}
+
+#define TEST_CAPTURE_PORT 47113
+#define TEST_CAPTURE_PACKETS 16
+
+//counts UDP packets to TEST_CAPTURE_PORT on the loopback device, which are seen twice: outgoing and incoming
+static void count_udp(u_char* user, const struct pcap_pkthdr* header, const u_char* packet) {
+  if (header->caplen < 14 + 20 + 8) return;
+  if (packet[12] != 0x08 || packet[13] != 0x00 || packet[14 + 9] != IPPROTO_UDP) return;
+  const struct udphdr* udp = (const struct udphdr*) (packet + 14 + (packet[14] & 0x0f) * 4);
+  if (ntohs(udp->dest) != TEST_CAPTURE_PORT) return;
+  ASSERT_GT(header->ts.tv_sec, 0);
+  ASSERT_GE(header->len, header->caplen);
+  (*(int*) user)++;
+}
+
+static void send_udp(int packets) {
+  int s = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(TEST_CAPTURE_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  for (int i = 0; i < packets; i++)
+    sendto(s, "MADCAT", 6, 0, (struct sockaddr*) &addr, sizeof(addr));
+  close(s);
+}
+
+static struct capture_conf_t test_conf = { CAPTURE_AFPACKET, 2048, 0, true, 0, 1 };
+
+TEST(madcat_capture, afpacket_loopback) {
+  struct capture_t cap;
+  int ret = init_afpacket(&cap, "lo", "", &test_conf);
+  if (ret == -1) GTEST_SKIP() << "AF_PACKET sockets need CAP_NET_RAW";
+  ASSERT_EQ(ret, 0);
+
+  send_udp(TEST_CAPTURE_PACKETS);
+  int count = 0;
+  for (int i = 0; i < 20 && count < 2 * TEST_CAPTURE_PACKETS; i++)
+    ASSERT_GE(capture_dispatch(&cap, count_udp, (u_char*) &count), 0);
+  ASSERT_EQ(count, 2 * TEST_CAPTURE_PACKETS);
+
+  struct pcap_stat ps;
+  ASSERT_EQ(capture_stats(&cap, &ps), 0);
+  ASSERT_GE(ps.ps_recv, (unsigned int) count);
+  ASSERT_EQ(ps.ps_drop, 0u);
+  capture_close(&cap);
+}
+
+TEST(madcat_capture, afpacket_fanout) {
+  struct capture_conf_t conf = test_conf;
+  conf.fanout = (getpid() & 0xffff) | 1;
+  struct capture_t cap[2];
+  int ret = init_afpacket(&cap[0], "lo", "", &conf);
+  if (ret == -1) GTEST_SKIP() << "AF_PACKET sockets need CAP_NET_RAW";
+  ASSERT_EQ(ret, 0);
+  ASSERT_EQ(init_afpacket(&cap[1], "lo", "", &conf), 0);
+
+  send_udp(TEST_CAPTURE_PACKETS);
+  int count[2] = { 0, 0 };
+  for (int i = 0; i < 20 && count[0] + count[1] < 2 * TEST_CAPTURE_PACKETS; i++) {
+    ASSERT_GE(capture_dispatch(&cap[0], count_udp, (u_char*) &count[0]), 0);
+    ASSERT_GE(capture_dispatch(&cap[1], count_udp, (u_char*) &count[1]), 0);
+  }
+  ASSERT_EQ(count[0] + count[1], 2 * TEST_CAPTURE_PACKETS); //every packet is delivered to exactly one member of the group
+  capture_close(&cap[0]);
+  capture_close(&cap[1]);
+}
+
+TEST(madcat_capture, afpacket_unknown_device) {
+  struct capture_t cap;
+  int ret = init_afpacket(&cap, "madcat_nodev0", "", &test_conf);
+  if (ret == -1) GTEST_SKIP() << "AF_PACKET sockets need CAP_NET_RAW";
+  ASSERT_EQ(ret, -5);
+  capture_close(&cap);
+}
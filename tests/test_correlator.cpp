@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "tcp_ip_port_mon.correlator.h"
+}
+
+static const char test_syn[] = "{\"IP\":{\"src_addr\":\"192.0.2.1\"}, \"TCP\":{\"src_port\":4711}}";
+static const char test_flow[] = "{\"FLOW\":{\"state\":\"closed\"}}";
+
+static struct tcp_corr_record_t test_record(int type, int src_port, int dest_port, long double unixtime) {
+  struct tcp_corr_record_t rec;
+  tcp_corr_record(&rec, type, "192.0.2.1", src_port, "192.0.2.2", dest_port, "T", unixtime,
+                  type == TCP_CORR_FLOW ? "TCP" : NULL, type == TCP_CORR_FLOW ? "flow" : NULL);
+  rec.len = type == TCP_CORR_SYN ? strlen(test_syn) : strlen(test_flow);
+  return rec;
+}
+
+static void test_add(struct tcp_corr_t* corr, int type, int src_port, int dest_port, long double unixtime) {
+  struct tcp_corr_record_t rec = test_record(type, src_port, dest_port, unixtime);
+  tcp_corr_add(corr, &rec, type == TCP_CORR_SYN ? test_syn : test_flow);
+}
+
+static std::vector<std::string> test_lines(FILE* output) {
+  std::vector<std::string> lines;
+  char line[1024];
+  fflush(output);
+  rewind(output);
+  while (fgets(line, sizeof(line), output) != NULL) lines.push_back(line);
+  return lines;
+}
+
+TEST(tcp_correlator, merge_and_expire) {
+  static bool portmap[65536] = { false };
+  portmap[443] = true;
+  struct tcp_corr_conf_t conf = { 10, 70, 100, portmap, tmpfile() };
+  struct timespec now = { 100, 0 };
+  struct timespec realtime;
+  clock_gettime(CLOCK_REALTIME, &realtime);
+  long double unixtime = realtime.tv_sec;
+  output_format = DICT_FORMAT_JSON;
+  struct tcp_corr_t* corr = tcp_corr_init(&conf, &now);
+
+  //SYN first, as usual, resp. flow first
+  test_add(corr, TCP_CORR_SYN, 4711, 80, unixtime);
+  test_add(corr, TCP_CORR_SYN, 4711, 80, unixtime); //retransmission
+  test_add(corr, TCP_CORR_FLOW, 4711, 80, unixtime);
+  test_add(corr, TCP_CORR_FLOW, 4712, 80, unixtime);
+  test_add(corr, TCP_CORR_SYN, 4712, 80, unixtime);
+  ASSERT_EQ(corr->accept, 2);
+  ASSERT_EQ(corr->duplicates, 1);
+  ASSERT_EQ(corr->pending, 0);
+
+  //unmatched: SYN to a proxied port waits syn_wait_proxy, flow waits con_wait + syn_timeout
+  test_add(corr, TCP_CORR_SYN, 1, 80, unixtime);
+  test_add(corr, TCP_CORR_SYN, 1, 443, unixtime);
+  test_add(corr, TCP_CORR_FLOW, 2, 80, unixtime);
+  now.tv_sec += 71;
+  ASSERT_EQ(tcp_corr_expire(corr, &now), 1);
+  now.tv_sec += 10;
+  ASSERT_EQ(tcp_corr_expire(corr, &now), 1);
+  now.tv_sec += 20;
+  ASSERT_EQ(tcp_corr_expire(corr, &now), 1);
+  ASSERT_EQ(corr->syn_scan, 2);
+  ASSERT_EQ(corr->no_syn, 1);
+
+  //pending ones are discarded when the correlator is freed, like by the postprocessor
+  test_add(corr, TCP_CORR_SYN, 3, 80, unixtime);
+  test_add(corr, TCP_CORR_FLOW, 4, 80, unixtime);
+  tcp_corr_free(corr);
+
+  std::vector<std::string> lines = test_lines(conf.output);
+  ASSERT_EQ(lines.size(), 5u);
+  std::string head = "{\"origin\":\"MADCAT\", \"timestamp\":\"T\", \"src_ip\":\"192.0.2.1\", ";
+  std::string time = "\"unixtime\":" + std::to_string(realtime.tv_sec) + ".000000, ";
+  ASSERT_EQ(lines[0], head + "\"src_port\":4711, \"dest_ip\":\"192.0.2.2\", \"dest_port\":80, \"proto\":\"TCP\", \"event_type\":\"flow\", " + time +
+                      "\"FLOW\":{\"state\":\"closed\"}, \"IP\":{\"src_addr\":\"192.0.2.1\"}, \"TCP\":{\"src_port\":4711}}\n");
+  ASSERT_EQ(lines[2], head + "\"src_port\":1, \"dest_ip\":\"192.0.2.2\", \"dest_port\":80, \"proto\":\"TCP\", \"event_type\":\"syn_scan\", " + time +
+                      "\"IP\":{\"src_addr\":\"192.0.2.1\"}, \"TCP\":{\"src_port\":4711}}\n");
+  ASSERT_EQ(lines[3], head + "\"src_port\":2, \"dest_ip\":\"192.0.2.2\", \"dest_port\":80, \"proto\":\"TCP\", \"event_type\":\"no_syn\", " + time +
+                      "\"FLOW\":{\"state\":\"closed\"}, \"IP\":{\"src_addr\":\"192.0.2.1\", \"dest_addr\":\"192.0.2.2\"}}\n");
+  ASSERT_NE(lines[4].find("\"dest_port\":443, \"proto\":\"TCP\", \"event_type\":\"syn_scan\""), std::string::npos);
+  fclose(conf.output);
+}
+
+TEST(tcp_correlator, pipes_and_resync) {
+  struct tcp_corr_conf_t conf = { 10, 70, 100, NULL, tmpfile() };
+  int synpipe[2], flowpipe[2];
+  ASSERT_EQ(tcp_corr_pipe(synpipe), 0);
+  ASSERT_EQ(tcp_corr_pipe(flowpipe), 0);
+  FILE* synfifo = fdopen(synpipe[1], "w");
+  FILE* flowfifo = fdopen(flowpipe[1], "w");
+  struct event_ring_t* ring = event_ring_init(2, 1 << 20);
+  output_format = DICT_FORMAT_JSON;
+  struct dict_buffer syn = { 0 }, flow = { 0 };
+  syn.data = (char*) test_syn;
+  syn.len = strlen(test_syn);
+  flow.data = (char*) test_flow;
+  flow.len = strlen(test_flow);
+
+  //garbage between and before records is skipped
+  for (int port = 1; port <= 100; port++) {
+    struct tcp_corr_record_t rec = test_record(TCP_CORR_SYN, port, 80, 0);
+    if (port % 10 == 0) event_ring_put(ring, 0, "garbage", 7, NULL, 0);
+    ASSERT_TRUE(tcp_corr_send(ring, 0, &rec, &syn));
+    rec = test_record(TCP_CORR_FLOW, port, 80, 0);
+    if (port % 50 == 0) event_ring_put(ring, 1, "\x4d\x43", 2, NULL, 0); //partial magic
+    ASSERT_TRUE(tcp_corr_send(ring, 1, &rec, &flow));
+  }
+  event_ring_drain(ring, 0, synfifo);
+  event_ring_drain(ring, 1, flowfifo);
+  fclose(synfifo);
+  fclose(flowfifo);
+
+  //returns, when both pipes have been closed
+  worker_corr(synpipe[0], flowpipe[0], &conf);
+  close(synpipe[0]);
+  close(flowpipe[0]);
+
+  std::vector<std::string> lines = test_lines(conf.output);
+  ASSERT_EQ(lines.size(), 100u);
+  for (size_t i = 0; i < lines.size(); i++)
+    ASSERT_NE(lines[i].find("\"event_type\":\"flow\""), std::string::npos) << lines[i];
+  fclose(conf.output);
+}
+
+TEST(tcp_correlator, stop_reads_pipes_to_end) {
+  struct tcp_corr_conf_t conf = { 10, 70, 100, NULL, tmpfile() };
+  int synpipe[2], flowpipe[2];
+  ASSERT_EQ(tcp_corr_pipe(synpipe), 0);
+  ASSERT_EQ(tcp_corr_pipe(flowpipe), 0);
+  struct event_ring_t* ring = event_ring_init(2, 1 << 20);
+  output_format = DICT_FORMAT_JSON;
+  struct dict_buffer syn = { 0 }, flow = { 0 };
+  syn.data = (char*) test_syn;
+  syn.len = strlen(test_syn);
+  flow.data = (char*) test_flow;
+  flow.len = strlen(test_flow);
+
+  //the flows of a shutdown are still in the pipe, when the correlator is stopped
+  for (int port = 1; port <= 100; port++) {
+    struct tcp_corr_record_t rec = test_record(TCP_CORR_SYN, port, 80, time(NULL));
+    ASSERT_TRUE(tcp_corr_send(ring, 0, &rec, &syn));
+    rec = test_record(TCP_CORR_FLOW, port, 80, time(NULL));
+    ASSERT_TRUE(tcp_corr_send(ring, 1, &rec, &flow));
+  }
+  struct tcp_corr_record_t rec = test_record(TCP_CORR_FLOW, 4711, 80, time(NULL)); //SYN lost, but no "no_syn" on shutdown
+  ASSERT_TRUE(tcp_corr_send(ring, 1, &rec, &flow));
+  FILE* synfifo = fdopen(synpipe[1], "w");
+  FILE* flowfifo = fdopen(flowpipe[1], "w");
+  event_ring_drain(ring, 0, synfifo);
+  fclose(synfifo);
+  pid_t writer = fork();
+  if (writer == 0) { //writes the flows after the correlator has been stopped
+    usleep(200000);
+    event_ring_drain(ring, 1, flowfifo);
+    _exit(0);
+  }
+  fclose(flowfifo);
+
+  tcp_corr_stop = 1;
+  worker_corr(synpipe[0], flowpipe[0], &conf);
+  tcp_corr_stop = 0;
+  waitpid(writer, NULL, 0);
+  close(synpipe[0]);
+  close(flowpipe[0]);
+
+  std::vector<std::string> lines = test_lines(conf.output);
+  ASSERT_EQ(lines.size(), 100u);
+  for (size_t i = 0; i < lines.size(); i++)
+    ASSERT_NE(lines[i].find("\"event_type\":\"flow\""), std::string::npos) << lines[i];
+  fclose(conf.output);
+}
@@ -84,6 +84,469 @@ TEST(madcat_dict_c,test_add_elememts) {
 }
 
 
+TEST(madcat_dict_c,test_indexed_lookup) {
+    struct dict* dict = dict_new();
+    union json_type value;
+    char key[16];
+    char expected[2048] = "{";
+    char* output = 0;
+
+    //grow root and a nested object beyond DICT_INDEX_THRESHOLD, so both get indexed
+    for(int i = 0; i < 4 * DICT_INDEX_THRESHOLD; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        value.integer = i;
+        dict_update(dict, JSON_INT, value, 1, key);
+        dict_update(dict, JSON_INT, value, 2, "INNER", key);
+    }
+    EXPECT_TRUE(dict->index != NULL);
+    EXPECT_TRUE(dict_get(dict, 1, "INNER")->value.object->index != NULL);
+
+    for(int i = 0; i < 4 * DICT_INDEX_THRESHOLD; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ASSERT_EQ(dict_get(dict, 1, key)->value.integer, i);
+        ASSERT_EQ(dict_get(dict, 2, "INNER", key)->value.integer, i);
+    }
+    EXPECT_TRUE(dict_get(dict, 1, "missing") == NULL);
+    EXPECT_TRUE(dict_get(dict, 2, "k1", "missing") == NULL);
+
+    //updates keep the position of existing elements
+    value.integer = 100;
+    dict_update(dict, JSON_INT, value, 1, "k3");
+    ASSERT_EQ(dict_get(dict, 1, "k3")->value.integer, 100);
+
+    //delete first, middle and last element, the index has to follow
+    ASSERT_TRUE(dict_del(&dict, 1, "k0"));
+    ASSERT_TRUE(dict_del(&dict, 1, "k5"));
+    ASSERT_TRUE(dict_del(&dict, 2, "INNER", "k0"));
+    EXPECT_TRUE(dict->index != NULL);
+    EXPECT_TRUE(dict_get(dict, 1, "k0") == NULL);
+    EXPECT_TRUE(dict_get(dict, 1, "k5") == NULL);
+    EXPECT_TRUE(dict_get(dict, 2, "INNER", "k0") == NULL);
+    ASSERT_EQ(dict_get(dict, 2, "INNER", "k1")->value.integer, 1);
+    ASSERT_EQ(dict_get(dict, 1, "k6")->value.integer, 6);
+
+    //output is in insertion order, exactly as without index
+    ASSERT_TRUE(dict_del(&dict, 1, "INNER"));
+    for(int i = 1; i < 4 * DICT_INDEX_THRESHOLD; i++) {
+        if(i == 5) continue;
+        snprintf(expected + strlen(expected), sizeof(expected) - strlen(expected), "%s\"k%d\":%d", i == 1 ? "" : ", ", i, i == 3 ? 100 : i);
+    }
+    strcat(expected, "}");
+    output = dict_dumpstr(dict);
+    ASSERT_STREQ(output, expected);
+    free(output);
+
+    dict_free(dict);
+}
+
+
+TEST(madcat_dict_c,test_arena) {
+    struct dict_arena* arena = dict_arena_new(256);
+    struct dict* heap_dict = dict_new();
+    struct dict* arena_dict = NULL;
+    union json_type value;
+    char large[1024];
+    char* heap_output = 0;
+    char* arena_output = 0;
+
+    ASSERT_TRUE(arena != NULL);
+    memset(large, 'A', sizeof(large) - 1);
+    large[sizeof(large) - 1] = 0;
+
+    //same updates on heap and arena dict result in the same output, also if chunks are exhausted
+    for(int round = 0; round < 3; round++) {
+        arena_dict = dict_new_arena(arena);
+        ASSERT_TRUE(arena_dict->arena == arena);
+        for(struct dict** dict_ptr : {&heap_dict, &arena_dict}) {
+            struct dict* dict = *dict_ptr;
+            value.string = (char*)"Hurz";
+            dict_update(dict, JSON_STR, value, 1, "Wolf");
+            value.string = large;
+            dict_update(dict, JSON_STR, value, 2, "INNER", "large");
+            value.integer = round;
+            dict_update(dict, JSON_INT, value, 2, "INNER", "round");
+            value.array = array_new_arena(dict->arena);
+            dict_update(dict, JSON_ARRAY, value, 2, "INNER", "ARRAY");
+            value.string = (char*)"asdfjklo";
+            array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_STR, value);
+            array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_STR, value);
+            dict_del(dict_ptr, 1, "Wolf");
+        }
+        ASSERT_TRUE(dict_get(arena_dict, 2, "INNER", "round")->arena == arena);
+        heap_output = dict_dumpstr(heap_dict);
+        arena_output = dict_dumpstr(arena_dict);
+        ASSERT_STREQ(heap_output, arena_output);
+        free(heap_output);
+        free(arena_output);
+        dict_arena_reset(arena);
+        dict_free(heap_dict);
+        heap_dict = dict_new();
+    }
+
+    //the static dict of json_dict is rewound on reset
+    value.integer = 1;
+    dict_update(json_dict(true), JSON_INT, value, 2, "A", "B");
+    dict_update(json_dict(true), JSON_INT, value, 1, "C");
+    arena_output = dict_dumpstr(json_dict(false));
+    ASSERT_STREQ(arena_output, "{\"C\":1}");
+    free(arena_output);
+
+    dict_free(heap_dict);
+    dict_arena_free(arena);
+}
+
+
+TEST(madcat_dict_c,test_dumpbuf) {
+    struct dict* dict = dict_new();
+    struct dict_buffer buf = {0};
+    union json_type value;
+    char* output = 0;
+
+    //empty dict
+    ASSERT_EQ(dict_dumpbuf(&buf, dict), 2u);
+    ASSERT_STREQ(buf.data, "{}");
+
+    value.integer = -9223372036854775807LL - 1;
+    dict_update(dict, JSON_INT, value, 1, "Int");
+    value.floating = 1634567890.123456;
+    dict_update(dict, JSON_FLOAT, value, 1, "Float");
+    value.floating = -0.0000004;
+    dict_update(dict, JSON_FLOAT, value, 1, "NegZero");
+    value.floating = 1e30;
+    dict_update(dict, JSON_FLOAT, value, 1, "Large");
+    value.hex.number = 0xa; value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, value, 1, "Hex");
+    value.hex.number = 0xdeadbeef; value.hex.format = HEX_FORMAT_02;
+    dict_update(dict, JSON_HEX, value, 1, "Hex2");
+    dict_update(dict, JSON_NULL, value, 2, "INNER", "Null");
+    value.array = array_new();
+    dict_update(dict, JSON_ARRAY, value, 2, "INNER", "ARRAY");
+    array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_NULL, value);
+    value.boolean = false;
+    array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_BOOL, value);
+    value.object = dict_new();
+    array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_OBJ, value);
+    value.array = array_new();
+    array_add(dict_get(dict, 2, "INNER", "ARRAY")->value.array, JSON_ARRAY, value);
+    value.string = (char*)"Hurz";
+    dict_update(dict, JSON_STR, value, 1, "Str");
+
+    const char* expected = "{\"Int\":-9223372036854775808, \"Float\":1634567890.123456, \"NegZero\":-0.000000, "
+                           "\"Large\":1000000000000000019884624838656.000000, \"Hex\":\"0x000a\", \"Hex2\":\"0xdeadbeef\", "
+                           "\"INNER\":{\"Null\":null, \"ARRAY\":[null , false, {}, []]}, \"Str\":\"Hurz\"}";
+    ASSERT_EQ(dict_dumpbuf(&buf, dict), strlen(expected));
+    ASSERT_STREQ(buf.data, expected);
+    output = dict_dumpstr(dict);
+    ASSERT_STREQ(output, expected);
+    free(output);
+
+    //buffer is reused
+    ASSERT_EQ(array_dumpbuf(&buf, dict_get(dict, 2, "INNER", "ARRAY")->value.array), strlen("[null , false, {}, []]"));
+    ASSERT_STREQ(buf.data, "[null , false, {}, []]");
+
+    dict_buffer_free(&buf);
+    dict_free(dict);
+}
+
+
+TEST(madcat_dict_c,test_str_ownership) {
+    struct dict_arena* arena = dict_arena_new(256);
+    struct dict* heap_dict = dict_new();
+    struct dict* arena_dict = dict_new_arena(arena);
+    union json_type value;
+    char ref[] = "Referenced";
+    char* output = 0;
+
+    for(struct dict* dict : {heap_dict, arena_dict}) {
+        //referenced strings are not copied, changes are visible at dump time
+        value.string = ref;
+        ASSERT_TRUE(dict_update(dict, JSON_STR_REF, value, 2, "FLOW", "ref")->value.string == ref);
+        ASSERT_EQ(dict_get(dict, 2, "FLOW", "ref")->type, JSON_STR);
+        ASSERT_EQ(dict_get(dict, 2, "FLOW", "ref")->str_mode, DICT_STR_REF);
+        //owned strings are taken over and freed by libdict_c, also if overwritten or deleted
+        value.string = strdup("Owned");
+        ASSERT_TRUE(dict_update(dict, JSON_STR_OWN, value, 2, "FLOW", "own")->value.string == value.string);
+        ASSERT_EQ(dict_get(dict, 2, "FLOW", "own")->str_mode, DICT_STR_OWN);
+        value.string = strdup("Overwritten");
+        dict_update(dict, JSON_STR_OWN, value, 2, "FLOW", "own");
+        value.string = strdup("Deleted");
+        dict_update(dict, JSON_STR_OWN, value, 1, "del");
+        value.string = strdup("Failed");
+        ASSERT_TRUE(dict_update(dict, JSON_STR_OWN, value, 3, "FLOW", "own", "blocked") == NULL);
+        //a reused element is copied again
+        value.string = (char*)"Copied";
+        dict_update(dict, JSON_STR, value, 1, "del");
+        ASSERT_EQ(dict_get(dict, 1, "del")->str_mode, DICT_STR_COPY);
+        dict_del(&dict, 1, "del");
+        value.array = array_new_arena(dict->arena);
+        dict_update(dict, JSON_ARRAY, value, 1, "ARRAY");
+        value.string = strdup("Array");
+        array_add(dict_get(dict, 1, "ARRAY")->value.array, JSON_STR_OWN, value);
+        value.string = ref;
+        array_add(dict_get(dict, 1, "ARRAY")->value.array, JSON_STR_REF, value);
+        array_del(dict_get(dict, 1, "ARRAY")->value.array, 0);
+        ASSERT_EQ(dict_get(dict, 1, "ARRAY")->value.array->str_mode, DICT_STR_REF);
+    }
+
+    ref[0] = 'r';
+    for(struct dict* dict : {heap_dict, arena_dict}) {
+        output = dict_dumpstr(dict);
+        ASSERT_STREQ(output, "{\"FLOW\":{\"ref\":\"referenced\", \"own\":\"Overwritten\"}, \"ARRAY\":[\"referenced\"]}");
+        free(output);
+    }
+
+    dict_free(heap_dict);
+    dict_arena_free(arena); //frees strings owned by arena_dict
+}
+
+
+TEST(madcat_dict_c,test_compiled_path) {
+    struct dict_path* seq = dict_path_compile(2, "TCP", "seq");
+    struct dict_path* ack = dict_path_compile(2, "TCP", "ack");
+    struct dict_path* blocked = dict_path_compile(3, "TCP", "seq", "blocked");
+    struct dict* dict = NULL;
+    union json_type value;
+    char* output = 0;
+
+    ASSERT_TRUE(seq != NULL && ack != NULL && blocked != NULL);
+    ASSERT_TRUE(seq->parent == ack->parent); //parent path is shared
+
+    //the same paths are used for each new event
+    for(int round = 0; round < 3; round++) {
+        value.integer = round;
+        dict_update(json_dict(true), JSON_INT, value, 1, "round");
+        dict_set_path(json_dict(false), seq, JSON_INT, value);
+        value.integer = round + 1;
+        dict_set_path(json_dict(false), ack, JSON_INT, value);
+        dict_set_path(json_dict(false), seq, JSON_INT, value); //updated in place
+        ASSERT_TRUE(dict_get(json_dict(false), 2, "TCP", "seq") == seq->element);
+        ASSERT_TRUE(dict_set_path(json_dict(false), blocked, JSON_INT, value) == NULL);
+        value.boolean = true;
+        DICT_SET_PATH(json_dict(false), JSON_BOOL, value, 2, "TCP", "urg");
+        output = dict_dumpstr(json_dict(false));
+        std::string expected = "{\"round\":" + std::to_string(round) + ", \"TCP\":{\"seq\":" + std::to_string(round + 1) +
+                               ", \"ack\":" + std::to_string(round + 1) + ", \"urg\":true}}";
+        ASSERT_STREQ(output, expected.c_str());
+        free(output);
+    }
+
+    //cached elements are not used after being deleted
+    dict = dict_new();
+    value.integer = 1;
+    dict_set_path(dict, seq, JSON_INT, value);
+    dict_set_path(dict, ack, JSON_INT, value);
+    dict_del(&dict, 1, "TCP");
+    value.integer = 2;
+    dict_set_path(dict, ack, JSON_INT, value);
+    output = dict_dumpstr(dict);
+    ASSERT_STREQ(output, "{\"TCP\":{\"ack\":2}}");
+    free(output);
+
+    dict_free(dict);
+    dict_path_free(seq);
+    dict_path_free(ack);
+    dict_path_free(blocked);
+}
+
+
+TEST(madcat_dict_c,test_emit) {
+    struct dict_buffer buf = {0};
+    struct dict* dict = dict_new();
+    union json_type value;
+
+    //empty object
+    dict_emit_begin(&buf);
+    dict_emit_members(&buf, dict);
+    ASSERT_EQ(dict_emit_end(&buf), 2u);
+    ASSERT_STREQ(buf.data, "{}");
+
+    value.integer = 1;
+    dict_update(dict, JSON_INT, value, 2, "IP", "ttl");
+    value.string = (char*)"eol";
+    dict_update(dict, JSON_STR, value, 3, "IP", "ip_options", "eol");
+
+    dict_emit_begin(&buf);
+    dict_emit_str(&buf, "origin", "MADCAT");
+    dict_emit_members(&buf, dict);
+    dict_emit_object(&buf, "FLOW");
+    dict_emit_int(&buf, "bytes_toserver", -42);
+    dict_emit_float(&buf, "duration", 0.5);
+    dict_emit_hex(&buf, "checksum", 0xbeef, HEX_FORMAT_08);
+    dict_emit_bool(&buf, "tainted", false);
+    dict_emit_dict(&buf, "options", dict_get(dict, 2, "IP", "ip_options")->value.object);
+    dict_emit_object_end(&buf);
+    dict_emit_members(&buf, NULL);
+    dict_emit_end(&buf);
+    ASSERT_STREQ(buf.data, "{\"origin\":\"MADCAT\", \"IP\":{\"ttl\":1, \"ip_options\":{\"eol\":\"eol\"}}, "
+                           "\"FLOW\":{\"bytes_toserver\":-42, \"duration\":0.500000, \"checksum\":\"0x0000beef\", "
+                           "\"tainted\":false, \"options\":{\"eol\":\"eol\"}}}");
+    ASSERT_EQ(buf.len, strlen(buf.data));
+
+    //members first
+    dict_emit_begin(&buf);
+    dict_emit_members(&buf, dict_get(dict, 1, "IP")->value.object);
+    dict_emit_str(&buf, "last", NULL);
+    dict_emit_end(&buf);
+    ASSERT_STREQ(buf.data, "{\"ttl\":1, \"ip_options\":{\"eol\":\"eol\"}, \"last\":\"(null)\"}");
+
+    dict_buffer_free(&buf);
+    dict_free(dict);
+}
+
+TEST(madcat_dict_c,test_cbor) {
+    struct dict_buffer buf = {0};
+    struct dict* dict = dict_new();
+    union json_type value;
+
+    value.integer = 500;
+    dict_update(dict, JSON_INT, value, 2, "IP", "tot_len");
+    value.hex.number = 0xbeef; value.hex.format = HEX_FORMAT_04;
+    dict_update(dict, JSON_HEX, value, 2, "IP", "id");
+    value.array = array_new();
+    dict_update(dict, JSON_ARRAY, value, 1, "list");
+    value.integer = -1;
+    array_add(dict_get(dict, 1, "list")->value.array, JSON_INT, value);
+    value.boolean = true;
+    array_add(dict_get(dict, 1, "list")->value.array, JSON_BOOL, value);
+    dict_update(dict, JSON_NULL, value, 1, "none");
+
+    //{"IP": {"tot_len": 500, "id": 48879}, "list": [-1, true], "none": null}
+    const unsigned char expected[] = {0xbf, 0x62, 'I', 'P', 0xbf, 0x67, 't', 'o', 't', '_', 'l', 'e', 'n', 0x19, 0x01, 0xf4,
+                                      0x62, 'i', 'd', 0x19, 0xbe, 0xef, 0xff,
+                                      0x64, 'l', 'i', 's', 't', 0x9f, 0x20, 0xf5, 0xff,
+                                      0x64, 'n', 'o', 'n', 'e', 0xf6, 0xff};
+    ASSERT_EQ(dict_dump_cbor(&buf, dict), sizeof(expected));
+    ASSERT_EQ(memcmp(buf.data, expected, sizeof(expected)), 0);
+
+    //emitters, members of dict spliced in
+    const unsigned char payload[] = {0xde, 0xad, 0x00};
+    buf.format = DICT_FORMAT_CBOR;
+    dict_emit_begin(&buf);
+    dict_emit_members(&buf, dict_get(dict, 1, "IP")->value.object);
+    dict_emit_object(&buf, "F");
+    dict_emit_float(&buf, "d", 1.5);
+    dict_emit_bytes(&buf, "p", payload, sizeof(payload));
+    dict_emit_object_end(&buf);
+    const unsigned char expected_emit[] = {0xbf, 0x67, 't', 'o', 't', '_', 'l', 'e', 'n', 0x19, 0x01, 0xf4,
+                                           0x62, 'i', 'd', 0x19, 0xbe, 0xef,
+                                           0x61, 'F', 0xbf, 0x61, 'd', 0xfb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,
+                                           0x61, 'p', 0x43, 0xde, 0xad, 0x00, 0xff, 0xff};
+    ASSERT_EQ(dict_emit_end(&buf), sizeof(expected_emit));
+    ASSERT_EQ(memcmp(buf.data, expected_emit, sizeof(expected_emit)), 0);
+
+    //empty object, same check for empty output as for JSON
+    dict_emit_begin(&buf);
+    ASSERT_EQ(dict_emit_end(&buf), 2u);
+
+    //bytes in JSON as hex string
+    buf.format = DICT_FORMAT_JSON;
+    dict_emit_begin(&buf);
+    dict_emit_bytes(&buf, "p", payload, sizeof(payload));
+    dict_emit_end(&buf);
+    ASSERT_STREQ(buf.data, "{\"p\":\"dead00\"}");
+
+    dict_buffer_free(&buf);
+    dict_free(dict);
+}
+
+TEST(madcat_dict_c,test_emit_raw) {
+    struct dict_buffer part = {0}, buf = {0};
+
+    //object serialized before, e.g. by another process
+    dict_emit_begin(&part);
+    dict_emit_int(&part, "ttl", 1);
+    dict_emit_object(&part, "TCP");
+    dict_emit_int(&part, "src_port", 4711);
+    dict_emit_object_end(&part);
+    dict_emit_end(&part);
+
+    dict_emit_begin(&buf);
+    dict_emit_raw_members(&buf, part.data, part.len);
+    dict_emit_str(&buf, "origin", "MADCAT");
+    dict_emit_raw_members(&buf, part.data, part.len);
+    dict_emit_raw_members(&buf, "{}", 2);
+    dict_emit_raw_members(&buf, NULL, 0);
+    dict_emit_end(&buf);
+    ASSERT_STREQ(buf.data, "{\"ttl\":1, \"TCP\":{\"src_port\":4711}, \"origin\":\"MADCAT\", \"ttl\":1, \"TCP\":{\"src_port\":4711}}");
+
+    part.format = DICT_FORMAT_CBOR;
+    dict_emit_begin(&part);
+    dict_emit_int(&part, "a", 1);
+    dict_emit_end(&part);
+    buf.format = DICT_FORMAT_CBOR;
+    dict_emit_begin(&buf);
+    dict_emit_raw_members(&buf, part.data, part.len);
+    dict_emit_int(&buf, "b", 2);
+    const unsigned char expected[] = {0xbf, 0x61, 'a', 0x01, 0x61, 'b', 0x02, 0xff};
+    ASSERT_EQ(dict_emit_end(&buf), sizeof(expected));
+    ASSERT_EQ(memcmp(buf.data, expected, sizeof(expected)), 0);
+
+    dict_buffer_free(&part);
+    dict_buffer_free(&buf);
+}
+
+TEST(madcat_dict_c,test_tail_append) {
+    union json_type value;
+    char key[16];
+
+    //long array, appended and freed without deep recursion
+    struct array* array = array_new();
+    for(long int i = 0; i < 200000; i++) {
+        value.integer = i;
+        ASSERT_EQ(array_add(array, JSON_INT, value)->value.integer, i);
+    }
+    ASSERT_EQ(array_len(array), 200000);
+    ASSERT_EQ(array->tail->value.integer, 199999);
+    //deleting the last element moves the tail back
+    ASSERT_TRUE(array_del(array, 199999));
+    value.integer = -1;
+    array_add(array, JSON_INT, value);
+    ASSERT_EQ(array_get(array, 199999)->value.integer, -1);
+    array_free(array);
+
+    //two elements, first one deleted
+    array = array_new();
+    array_add(array, JSON_INT, value);
+    value.integer = 2;
+    array_add(array, JSON_INT, value);
+    ASSERT_TRUE(array_del(array, 0));
+    value.integer = 3;
+    array_add(array, JSON_INT, value);
+    char* str = array_dumpstr(array);
+    ASSERT_STREQ(str, "[2, 3]");
+    free(str);
+    array_free(array);
+
+    //large object with index, last and first element deleted
+    struct dict* dict = dict_new();
+    for(int i = 0; i < 20; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        value.integer = i;
+        dict_update(dict, JSON_INT, value, 1, key);
+    }
+    ASSERT_TRUE(dict_del(&dict, 1, "k19"));
+    ASSERT_TRUE(dict_del(&dict, 1, "k0"));
+    value.integer = 20;
+    dict_update(dict, JSON_INT, value, 1, "k20");
+    ASSERT_STREQ(dict->tail->key, "k20");
+    ASSERT_EQ(dict_get(dict, 1, "k20")->prev, dict_get(dict, 1, "k18"));
+
+    //appended object becomes the new tail
+    struct dict* source = dict_new();
+    dict_update(source, JSON_INT, value, 1, "s0");
+    dict_update(source, JSON_INT, value, 1, "s1");
+    ASSERT_TRUE(dict_append(source, dict));
+    ASSERT_STREQ(dict->tail->key, "s1");
+    dict_update(dict, JSON_INT, value, 1, "k21");
+    ASSERT_EQ(dict_get(dict, 1, "k21")->prev, dict_get(dict, 1, "s1"));
+    str = dict_dumpstr(dict);
+    ASSERT_EQ(strncmp(str, "{\"k1\":1, ", 9), 0);
+    ASSERT_NE(strstr(str, "\"k20\":20, \"s0\":20, \"s1\":20, \"k21\":20}"), nullptr);
+    free(str);
+    dict_free(dict);
+}
+
+
 TEST(madcat_dict_c,test_add_all_elememts) {
     /*
     value.object = dict_new();
@@ -102,3 +102,66 @@ TEST(madcat_helper, print_hex_to_file) {
   
   
 }
+
+TEST(madcat_helper, hex_encode) {
+  unsigned char data[40];
+  char output[HEX_DUMP_LEN(sizeof(data))];
+
+  for(int i = 0; i < (int) sizeof(data); i++) data[i] = 0x5a + 7 * i;
+
+  ASSERT_EQ(hex_encode(output, data, 0), 0);
+  ASSERT_STREQ(output, "");
+  ASSERT_EQ(hex_encode(output, data, 3), 6);
+  ASSERT_STREQ(output, "5a6168");
+  ASSERT_EQ(hex_encode(output, data, sizeof(data)), 2 * sizeof(data));
+  ASSERT_STREQ(output, "5a61686f767d848b9299a0a7aeb5bcc3cad1d8dfe6edf4fb020910171e252c333a41484f565d646b");
+
+  char* str = print_hex_string(data, sizeof(data));
+  ASSERT_STREQ(str, output);
+  free(str);
+}
+
+TEST(madcat_helper, hex_dump_encode) {
+  unsigned char data[20];
+  char output[HEX_DUMP_LEN(sizeof(data))];
+
+  for(int i = 0; i < (int) sizeof(data); i++) data[i] = i + 0x50;
+  data[2] = '"';
+  data[3] = '\\';
+
+  ASSERT_EQ(hex_dump_encode(output, data, 0, true), 0);
+  ASSERT_STREQ(output, "");
+  hex_dump_encode(output, data, sizeof(data), true);
+  ASSERT_STREQ(output, "00000000  50 51 22 5c 54 55 56 57  58 59 5a 5b 5c 5d 5e 5f  |PQ'/TUVWXYZ[/]^_|\\n"
+                       "00000010  60 61 62 63                                       |`abc|");
+  hex_dump_encode(output, data, 9, false);
+  ASSERT_STREQ(output, "00000000  50 51 22 5c 54 55 56 57  58                       |PQ\"\\TUVWX|");
+
+  char* str = hex_dump(data, 9, false);
+  ASSERT_STREQ(str, output);
+  free(str);
+}
+
+TEST(madcat_helper, time_str_ts) {
+  char unix_buf[64];
+  char readable_buf[64];
+  struct timespec ts = { 1534477913, 835934123 };
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  ASSERT_EQ(time_str_ts(&ts, unix_buf, sizeof(unix_buf), readable_buf, sizeof(readable_buf)), (long double) 1534477913 + (long double) 835934 * 1e-6);
+  ASSERT_STREQ(unix_buf, "1534477913.835934");
+  ASSERT_STREQ(readable_buf, "2018-08-17T03:51:53.835934+0000");
+
+  //same second from cache, microseconds padded in readable format only
+  ts.tv_nsec = 5000;
+  time_str_ts(&ts, unix_buf, sizeof(unix_buf), readable_buf, sizeof(readable_buf));
+  ASSERT_STREQ(unix_buf, "1534477913.5");
+  ASSERT_STREQ(readable_buf, "2018-08-17T03:51:53.000005+0000");
+
+  //next second, truncated like snprintf
+  ts.tv_sec++;
+  time_str_ts(&ts, unix_buf, 11, readable_buf, 20);
+  ASSERT_STREQ(unix_buf, "1534477914");
+  ASSERT_STREQ(readable_buf, "2018-08-17T03:51:54");
+}
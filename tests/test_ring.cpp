@@ -0,0 +1,159 @@
+#include "gtest/gtest.h"
+#include <string>
+
+extern "C" {
+  #include "madcat.ring.h"
+}
+
+#define TEST_RING_PRODUCERS 4
+#define TEST_RING_EVENTS 20000
+
+static std::string test_read(FILE* output) {
+  std::string content;
+  char buf[4096];
+  size_t n;
+  fflush(output);
+  rewind(output);
+  while ((n = fread(buf, 1, sizeof(buf), output)) > 0) content.append(buf, n);
+  return content;
+}
+
+TEST(madcat_ring, producer_processes) {
+  struct event_ring_t* ring = event_ring_init(1, 65536); //small, so the ring wraps often
+  ASSERT_NE(ring, (struct event_ring_t*) NULL);
+  struct event_drain_t drain;
+  memset(&drain, 0, sizeof(drain));
+  drain.ring = ring;
+  drain.output[0] = tmpfile();
+  ASSERT_EQ(event_drain_start(&drain), 0);
+
+  pid_t pid[TEST_RING_PRODUCERS];
+  for (int p = 0; p < TEST_RING_PRODUCERS; p++) {
+    if ((pid[p] = fork()) == 0) {
+      char event[128];
+      for (int i = 0; i < TEST_RING_EVENTS; i++) {
+        int len = snprintf(event, sizeof(event), "%d %d %.*s\n", p, i, i % 50, "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        while (!event_ring_put(ring, 0, event, len, NULL, 0)) usleep(10); //retry, the test expects all events
+      }
+      _exit(0);
+    }
+  }
+  for (int p = 0; p < TEST_RING_PRODUCERS; p++) {
+    int status;
+    waitpid(pid[p], &status, 0);
+    ASSERT_EQ(status, 0);
+  }
+  event_drain_stop(&drain);
+
+  //every event exactly once and in order per producer
+  std::string content = test_read(drain.output[0]);
+  int next[TEST_RING_PRODUCERS] = { 0 };
+  size_t pos = 0;
+  long int lines = 0;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    ASSERT_NE(end, std::string::npos);
+    int p = -1, i = -1;
+    ASSERT_EQ(sscanf(content.c_str() + pos, "%d %d", &p, &i), 2);
+    ASSERT_TRUE(p >= 0 && p < TEST_RING_PRODUCERS);
+    ASSERT_EQ(i, next[p]++);
+    ASSERT_EQ(end - pos, (size_t) snprintf(NULL, 0, "%d %d ", p, i) + i % 50);
+    pos = end + 1;
+    lines++;
+  }
+  ASSERT_EQ(lines, TEST_RING_PRODUCERS * TEST_RING_EVENTS);
+  ASSERT_EQ(ring->queue[0].events, lines);
+  ASSERT_EQ(ring->queue[0].skipped, 0);
+  fclose(drain.output[0]);
+}
+
+TEST(madcat_ring, overflow_and_wrap) {
+  struct event_ring_t* ring = event_ring_init(2, 4096);
+  ASSERT_NE(ring, (struct event_ring_t*) NULL);
+  FILE* output = tmpfile();
+  char event[100];
+  memset(event, 'a', sizeof(event));
+
+  //ring full: further events are dropped and counted, not blocked
+  int put = 0;
+  while (event_ring_put(ring, 1, event, sizeof(event), "\n", 1)) put++;
+  ASSERT_EQ(put, 4096 / 128); //record: 24 bytes header + 101 bytes, aligned to 8
+  ASSERT_FALSE(event_ring_put(ring, 1, event, sizeof(event), NULL, 0));
+  ASSERT_EQ(ring->queue[1].dropped, 2);
+  ASSERT_EQ(ring->queue[1].dropped_bytes, 201);
+  ASSERT_FALSE(event_ring_put(ring, 1, event, 5000, NULL, 0)); //larger than the ring
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 0); //other ring is unaffected
+  ASSERT_EQ(event_ring_drain(ring, 1, output), put);
+
+  //records do not wrap around the end, but are preceded by padding
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(event_ring_put(ring, 1, event, i % sizeof(event), "\n", 1));
+    if (i % 7 == 0) event_ring_drain(ring, 1, output);
+  }
+  event_ring_drain(ring, 1, output);
+  std::string content = test_read(output);
+  size_t expected = put * (sizeof(event) + 1);
+  for (int i = 0; i < 1000; i++) expected += i % sizeof(event) + 1;
+  ASSERT_EQ(content.size(), expected);
+  ASSERT_EQ(ring->queue[1].events, put + 1000);
+  ASSERT_EQ(ring->queue[1].head, ring->queue[1].tail);
+  fclose(output);
+}
+
+TEST(madcat_ring, skip_stalled) {
+  struct event_ring_t* ring = event_ring_init(1, 4096);
+  FILE* output = tmpfile();
+
+  //a producer reserved a record and died before committing it
+  pid_t pid = fork();
+  if (pid == 0) _exit(0);
+  waitpid(pid, NULL, 0);
+  struct event_ring_record_t* rec = (struct event_ring_record_t*) ((char*) ring + sizeof(struct event_ring_t));
+  rec->len = 32;
+  ring->queue[0].head = 32;
+  ASSERT_TRUE(event_ring_put(ring, 0, "ok\n", 3, NULL, 0));
+
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 0); //waits for the producer first
+  ring->queue[0].stall_since.tv_sec -= EVENT_RING_STALL / 1000 + 1;
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 0); //owner not yet known
+  rec->pid = pid;
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 1);
+  ASSERT_EQ(ring->queue[0].skipped, 1);
+  ASSERT_EQ(test_read(output), "ok\n");
+  fclose(output);
+}
+
+TEST(madcat_ring, commit_late) {
+  struct event_ring_t* ring = event_ring_init(1, 4096);
+  FILE* output = tmpfile();
+
+  //a producer reserved a record and has been stopped before committing it, e.g. by SIGSTOP
+  pid_t pid = fork();
+  if (pid == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL); //do not outlive the test, if an assertion fails
+    pause();
+    _exit(0);
+  }
+  struct event_ring_record_t* rec = (struct event_ring_record_t*) ((char*) ring + sizeof(struct event_ring_t));
+  rec->len = 32;
+  rec->data_len = 6;
+  rec->pid = pid;
+  ring->queue[0].head = 32;
+  ASSERT_TRUE(event_ring_put(ring, 0, "next\n", 5, NULL, 0));
+
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 0);
+  ring->queue[0].stall_since.tv_sec -= EVENT_RING_STALL / 1000 + 1;
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 0); //still alive, thus not skipped
+  ASSERT_EQ(ring->queue[0].tail, 0);
+  ASSERT_EQ(ring->queue[0].skipped, 0);
+
+  //the producer continues and commits into its own record, which has not been reused
+  memcpy(rec + 1, "first\n", 6);
+  __atomic_store_n(&rec->seq, 1, __ATOMIC_RELEASE);
+  ASSERT_EQ(event_ring_drain(ring, 0, output), 2);
+  ASSERT_EQ(test_read(output), "first\nnext\n");
+  ASSERT_EQ(ring->queue[0].head, ring->queue[0].tail);
+  kill(pid, SIGKILL);
+  waitpid(pid, NULL, 0);
+  fclose(output);
+}
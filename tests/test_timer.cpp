@@ -0,0 +1,131 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+  #include "tcp_ip_port_mon.timer.h"
+}
+
+#define TEST_TIMER_TICK 10 //ms
+#define TEST_TIMER_COUNT 1000
+
+struct test_timer_t {
+  struct timer_entry_t timer;
+  uint64_t fired; //tick, at which the timer expired, 0 if not
+};
+
+static struct timespec test_time(const struct timespec* base, const uint64_t ms) {
+  struct timespec ts = *base;
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (ms % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  return ts;
+}
+
+static void test_expire(struct timer_entry_t* t, void* user) {
+  struct test_timer_t* tt = (struct test_timer_t*) t; //timer is the first member
+  tt->fired = *(uint64_t*) user;
+}
+
+static void test_restart(struct timer_entry_t* t, void* user) {
+  struct timer_wheel_t* tw = (struct timer_wheel_t*) user;
+  ((struct test_timer_t*) t)->fired++;
+  timer_add(tw, t, TEST_TIMER_TICK); //restart from within the callback
+}
+
+TEST(tcp_timer, expire_all_levels) {
+  static struct timer_wheel_t tw;
+  static struct test_timer_t timers[TEST_TIMER_COUNT];
+  struct timespec base = { 1000, 500000000 };
+  timer_init(&tw, &base, TEST_TIMER_TICK);
+
+  //spread timeouts over all wheels, from 1 tick up to beyond a revolution of the third wheel
+  uint64_t timeout[TEST_TIMER_COUNT];
+  for (int i = 0; i < TEST_TIMER_COUNT; i++) {
+    timeout[i] = ((uint64_t) i * i * 997 % 400000 + 1) * TEST_TIMER_TICK;
+    timers[i].timer.prev = NULL;
+    timers[i].fired = 0;
+    timer_add(&tw, &timers[i].timer, timeout[i]);
+    ASSERT_TRUE(timer_pending(&timers[i].timer));
+  }
+  ASSERT_EQ(tw.count, TEST_TIMER_COUNT);
+
+  //advance like an event loop, sleeping exactly as long as timer_next(...) tells
+  uint64_t ms = 0;
+  long int expired = 0;
+  while (tw.count > 0) {
+    struct timespec now = test_time(&base, ms);
+    int next = timer_next(&tw, &now);
+    ASSERT_GE(next, 0);
+    ms += next;
+    now = test_time(&base, ms);
+    uint64_t tick = ms / TEST_TIMER_TICK;
+    expired += timer_expire(&tw, &now, test_expire, &tick);
+  }
+  ASSERT_EQ(expired, TEST_TIMER_COUNT);
+  for (int i = 0; i < TEST_TIMER_COUNT; i++) {
+    ASSERT_FALSE(timer_pending(&timers[i].timer));
+    ASSERT_EQ(timers[i].fired, timeout[i] / TEST_TIMER_TICK) << "timer " << i; //neither early nor late
+  }
+  struct timespec now = test_time(&base, ms);
+  ASSERT_EQ(timer_next(&tw, &now), -1);
+}
+
+TEST(tcp_timer, del_and_restart) {
+  static struct timer_wheel_t tw;
+  struct test_timer_t a = { { 0, NULL, NULL, NULL }, 0 }, b = { { 0, NULL, NULL, NULL }, 0 };
+  struct timespec base = { 0, 0 };
+  timer_init(&tw, &base, TEST_TIMER_TICK);
+
+  timer_add(&tw, &a.timer, 5000);
+  timer_add(&tw, &b.timer, 100);
+  timer_add(&tw, &b.timer, 200); //restart moves the timer
+  ASSERT_EQ(tw.count, 2);
+  timer_del(&tw, &a.timer);
+  timer_del(&tw, &a.timer); //deleting twice is harmless
+  ASSERT_EQ(tw.count, 1);
+  ASSERT_FALSE(timer_pending(&a.timer));
+
+  struct timespec now = test_time(&base, 150);
+  uint64_t tick = 15;
+  ASSERT_EQ(timer_expire(&tw, &now, test_expire, &tick), 0);
+  ASSERT_EQ(timer_next(&tw, &now), 50);
+  now = test_time(&base, 10000);
+  tick = 1000;
+  ASSERT_EQ(timer_expire(&tw, &now, test_expire, &tick), 1);
+  ASSERT_EQ(a.fired, 0u);
+  ASSERT_EQ(b.fired, 1000u);
+  ASSERT_EQ(tw.count, 0);
+
+  //a timer restarted by its callback expires again with the following ticks
+  timer_add(&tw, &b.timer, TEST_TIMER_TICK);
+  b.fired = 0;
+  now = test_time(&base, 10000 + 10 * TEST_TIMER_TICK);
+  ASSERT_EQ(timer_expire(&tw, &now, test_restart, &tw), 10);
+  ASSERT_EQ(b.fired, 10u);
+  ASSERT_TRUE(timer_pending(&b.timer));
+}
+
+TEST(tcp_timer, drain) {
+  static struct timer_wheel_t tw;
+  static struct test_timer_t timers[TEST_TIMER_COUNT];
+  struct timespec base = { 0, 0 };
+  timer_init(&tw, &base, TEST_TIMER_TICK);
+
+  for (int i = 0; i < TEST_TIMER_COUNT; i++) {
+    timers[i].timer.prev = NULL;
+    timers[i].fired = 0;
+    timer_add(&tw, &timers[i].timer, ((uint64_t) i * 7919 % 400000 + 1) * TEST_TIMER_TICK);
+  }
+  //all timers fire at once, regardless of their expiry
+  uint64_t tick = 1;
+  ASSERT_EQ(timer_drain(&tw, test_expire, &tick), TEST_TIMER_COUNT);
+  ASSERT_EQ(tw.count, 0);
+  for (int i = 0; i < TEST_TIMER_COUNT; i++) {
+    ASSERT_FALSE(timer_pending(&timers[i].timer));
+    ASSERT_EQ(timers[i].fired, 1u) << "timer " << i;
+  }
+  ASSERT_EQ(timer_next(&tw, &base), -1);
+  ASSERT_EQ(timer_drain(&tw, test_expire, &tick), 0);
+}
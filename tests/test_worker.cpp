@@ -0,0 +1,256 @@
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+extern "C" {
+  #include "tcp_ip_port_mon.h"
+  #include <dirent.h>
+  #include <sys/resource.h>
+}
+
+#define TEST_WORKER_CONS 3
+#define TEST_WORKER_PAYLOAD "GET / HTTP/1.0\r\n\r\n"
+
+static std::string test_read(FILE* output) {
+  std::string content;
+  char buf[4096];
+  size_t n;
+  fflush(output);
+  rewind(output);
+  while ((n = fread(buf, 1, sizeof(buf), output)) > 0) content.append(buf, n);
+  return content;
+}
+
+static long int test_count(const std::string& content, const std::string& pattern) {
+  long int count = 0;
+  for (size_t pos = content.find(pattern); pos != std::string::npos; pos = content.find(pattern, pos + 1)) count++;
+  return count;
+}
+
+//Runs worker_tcp(...) in a child on a listening socket on the loopback device, stopped by SIGTERM.
+//If no_files is set, stream files can be created, but not written.
+static pid_t test_worker_start(char* data_path, struct sockaddr_in* addr, bool no_files = false) {
+  EMPTY_STR[0] = 0;
+  loglevel = 0;
+  output_format = DICT_FORMAT_JSON;
+  snprintf(hostaddr, sizeof(hostaddr), "127.0.0.1");
+  if (event_ring == NULL) event_ring = event_ring_init(2, EVENT_RING_SIZE);
+  if (mkdtemp(data_path) == NULL) return -1;
+  data_path[strlen(data_path)] = '/';
+
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(*addr);
+  int listenfd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (bind(listenfd, (struct sockaddr*) addr, addr_len) != 0 || listen(listenfd, SOMAXCONN) != 0 ||
+      getsockname(listenfd, (struct sockaddr*) addr, &addr_len) != 0) return -1;
+
+  pid_t worker_pid = fork();
+  if (worker_pid == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    freopen("/dev/null", "w", stdout); //JSON log lines
+    freopen("/dev/null", "w", stderr); //connection log
+    signal(SIGTERM, sig_handler_listnerchild);
+    if (no_files) {
+      struct rlimit fsize = { 0, 0 };
+      signal(SIGXFSZ, SIG_IGN); //write(...) fails with EFBIG instead
+      setrlimit(RLIMIT_FSIZE, &fsize);
+    }
+    //Timeout far beyond the test, so the connections are only closed on shutdown
+    char proto[] = "TCP";
+    struct tcp_worker_conf_t conf = { 3600, data_path, 1024, event_ring, proto, 0, false, 1024 };
+    worker_tcp(listenfd, &conf);
+    _exit(0);
+  }
+  close(listenfd);
+  return worker_pid;
+}
+
+//Returns the contents of all .tpm files in data_path and removes them and data_path, if remove is set
+static std::vector<std::string> test_files(const char* data_path, bool remove) {
+  std::vector<std::string> files;
+  DIR* dir = opendir(data_path);
+  struct dirent* entry;
+  while (dir != NULL && (entry = readdir(dir)) != NULL) {
+    if (strstr(entry->d_name, ".tpm") == NULL) continue;
+    std::string file_name = std::string(data_path) + entry->d_name;
+    FILE* file = fopen(file_name.c_str(), "r");
+    if (file == NULL) continue;
+    files.push_back(test_read(file));
+    fclose(file);
+    if (remove) unlink(file_name.c_str());
+  }
+  if (dir != NULL) closedir(dir);
+  if (remove) rmdir(data_path);
+  return files;
+}
+
+TEST(tcp_worker, shutdown_writes_open_connections) {
+  char data_path[] = "/tmp/test_tcp_worker.XXXXXX/";
+  data_path[strlen(data_path) - 1] = 0;
+  struct sockaddr_in addr;
+  pid_t worker_pid = test_worker_start(data_path, &addr);
+  ASSERT_GT(worker_pid, 0);
+
+  int client[TEST_WORKER_CONS];
+  for (int i = 0; i < TEST_WORKER_CONS; i++) {
+    client[i] = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client[i], (struct sockaddr*) &addr, sizeof(addr)), 0);
+    ASSERT_EQ(send(client[i], TEST_WORKER_PAYLOAD, strlen(TEST_WORKER_PAYLOAD), 0), (ssize_t) strlen(TEST_WORKER_PAYLOAD));
+  }
+  usleep(300000); //let the worker accept and receive
+  kill(worker_pid, SIGTERM);
+  int status = -1;
+  ASSERT_EQ(waitpid(worker_pid, &status, 0), worker_pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  for (int i = 0; i < TEST_WORKER_CONS; i++) close(client[i]);
+
+  //one flow event per open connection, closed by the shutdown and with its payload
+  FILE* output = tmpfile();
+  ASSERT_EQ(event_ring_drain(event_ring, TCP_RING_CON, output), TEST_WORKER_CONS);
+  std::string events = test_read(output);
+  fclose(output);
+  ASSERT_EQ(test_count(events, "\"reason\":\"shutdown\""), TEST_WORKER_CONS);
+  ASSERT_EQ(test_count(events, "\"bytes_toserver\":" + std::to_string(strlen(TEST_WORKER_PAYLOAD))), TEST_WORKER_CONS);
+
+  //and one .tpm file each, containing the payload
+  std::vector<std::string> files = test_files(data_path, true);
+  ASSERT_EQ(files.size(), (size_t) TEST_WORKER_CONS);
+  for (size_t i = 0; i < files.size(); i++) ASSERT_EQ(files[i], TEST_WORKER_PAYLOAD);
+}
+
+TEST(tcp_worker, flush_small_batches) {
+  char data_path[] = "/tmp/test_tcp_worker.XXXXXX/";
+  data_path[strlen(data_path) - 1] = 0;
+  struct sockaddr_in addr;
+  pid_t worker_pid = test_worker_start(data_path, &addr);
+  ASSERT_GT(worker_pid, 0);
+
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(client, (struct sockaddr*) &addr, sizeof(addr)), 0);
+  ASSERT_EQ(send(client, TEST_WORKER_PAYLOAD, strlen(TEST_WORKER_PAYLOAD), 0), (ssize_t) strlen(TEST_WORKER_PAYLOAD));
+  //far below TCP_WORKER_FLUSH and long before the timeout, the payload is in the file after TCP_WORKER_FLUSH_DELAY
+  usleep((TCP_WORKER_FLUSH_DELAY + 500) * 1000);
+  std::vector<std::string> files = test_files(data_path, false);
+
+  kill(worker_pid, SIGTERM);
+  int status = -1;
+  ASSERT_EQ(waitpid(worker_pid, &status, 0), worker_pid);
+  close(client);
+  FILE* output = tmpfile();
+  ASSERT_EQ(event_ring_drain(event_ring, TCP_RING_CON, output), 1);
+  fclose(output);
+  test_files(data_path, true);
+
+  ASSERT_EQ(files.size(), 1u);
+  ASSERT_EQ(files[0], TEST_WORKER_PAYLOAD);
+}
+
+TEST(tcp_worker, file_error_closes_only_its_connection) {
+  char data_path[] = "/tmp/test_tcp_worker.XXXXXX/";
+  data_path[strlen(data_path) - 1] = 0;
+  struct sockaddr_in addr;
+  pid_t worker_pid = test_worker_start(data_path, &addr, true);
+  ASSERT_GT(worker_pid, 0);
+
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(client, (struct sockaddr*) &addr, sizeof(addr)), 0);
+  ASSERT_EQ(send(client, TEST_WORKER_PAYLOAD, strlen(TEST_WORKER_PAYLOAD), 0), (ssize_t) strlen(TEST_WORKER_PAYLOAD));
+  //the payload is written after TCP_WORKER_FLUSH_DELAY, which fails and closes the connection right away
+  usleep((TCP_WORKER_FLUSH_DELAY + 500) * 1000);
+  FILE* output = tmpfile();
+  ASSERT_EQ(event_ring_drain(event_ring, TCP_RING_CON, output), 1);
+  std::string events = test_read(output);
+  fclose(output);
+  ASSERT_EQ(test_count(events, "\"reason\":\"file error\""), 1);
+  ASSERT_EQ(test_count(events, "\"bytes_toserver\":" + std::to_string(strlen(TEST_WORKER_PAYLOAD))), 1);
+  char buf[16];
+  ASSERT_EQ(recv(client, buf, sizeof(buf), 0), 0); //closed by the worker
+  close(client);
+
+  //the worker still serves further connections
+  ASSERT_EQ(kill(worker_pid, 0), 0);
+  client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(client, (struct sockaddr*) &addr, sizeof(addr)), 0);
+  usleep(300000);
+  kill(worker_pid, SIGTERM);
+  int status = -1;
+  ASSERT_EQ(waitpid(worker_pid, &status, 0), worker_pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  close(client);
+  output = tmpfile();
+  ASSERT_EQ(event_ring_drain(event_ring, TCP_RING_CON, output), 1);
+  events = test_read(output);
+  fclose(output);
+  ASSERT_EQ(test_count(events, "\"reason\":\"shutdown\""), 1);
+  test_files(data_path, true);
+}
+
+TEST(tcp_worker, reset_is_kept_as_reason) {
+  char data_path[] = "/tmp/test_tcp_worker.XXXXXX/";
+  data_path[strlen(data_path) - 1] = 0;
+  struct sockaddr_in addr;
+  pid_t worker_pid = test_worker_start(data_path, &addr);
+  ASSERT_GT(worker_pid, 0);
+
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(client, (struct sockaddr*) &addr, sizeof(addr)), 0);
+  ASSERT_EQ(send(client, TEST_WORKER_PAYLOAD, strlen(TEST_WORKER_PAYLOAD), 0), (ssize_t) strlen(TEST_WORKER_PAYLOAD));
+  usleep(200000);
+  struct linger reset = { 1, 0 }; //close(...) sends a RST
+  setsockopt(client, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+  close(client);
+  usleep(200000);
+  kill(worker_pid, SIGTERM);
+  int status = -1;
+  ASSERT_EQ(waitpid(worker_pid, &status, 0), worker_pid);
+  FILE* output = tmpfile();
+  ASSERT_EQ(event_ring_drain(event_ring, TCP_RING_CON, output), 1);
+  std::string events = test_read(output);
+  fclose(output);
+  test_files(data_path, true);
+  ASSERT_EQ(test_count(events, "\"reason\":\"reset\""), 1);
+}
+
+TEST(tcp_worker, supervisor_restarts_listners) {
+  int started[2]; //listners report their number and PID
+  ASSERT_EQ(pipe(started), 0);
+  pid_t supervisor = fork();
+  if (supervisor == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    freopen("/dev/null", "w", stderr); //restart log
+    signal(SIGTERM, sig_handler_listnerchild);
+    int worker = supervise_listners(2);
+    if (worker < 0) _exit(0); //all listners have exited
+    int report[2] = { worker, getpid() };
+    if (write(started[1], report, sizeof(report)) != (ssize_t) sizeof(report)) _exit(1);
+    while (!tcp_worker_stop) usleep(10000); //like worker_tcp(...)
+    _exit(0);
+  }
+  close(started[1]);
+
+  int report[2], pid[2] = { 0, 0 };
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(read(started[0], report, sizeof(report)), (ssize_t) sizeof(report));
+    ASSERT_TRUE(report[0] == 0 || report[0] == 1);
+    pid[report[0]] = report[1];
+  }
+  ASSERT_TRUE(pid[0] > 0 && pid[1] > 0);
+
+  //a crashed listner is restarted with the same number
+  kill(pid[1], SIGKILL);
+  ASSERT_EQ(read(started[0], report, sizeof(report)), (ssize_t) sizeof(report));
+  ASSERT_EQ(report[0], 1);
+  ASSERT_NE(report[1], pid[1]);
+  pid[1] = report[1];
+
+  //SIGTERM stops all listners, then the supervisor
+  kill(supervisor, SIGTERM);
+  int status = -1;
+  ASSERT_EQ(waitpid(supervisor, &status, 0), supervisor);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(kill(pid[0], 0), -1);
+  ASSERT_EQ(kill(pid[1], 0), -1);
+  close(started[0]);
+}
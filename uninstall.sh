@@ -0,0 +1,4 @@
+#!/bin/bash
+cat install_manifest.txt | sudo xargs rm -v
+echo done ...
+ 